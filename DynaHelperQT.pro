@@ -4,7 +4,7 @@
 #
 #-------------------------------------------------
 
-QT       += core gui sql
+QT       += core gui sql concurrent
 
 greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
@@ -23,7 +23,10 @@ LIBS += -LC:/opencv/build/x86/vc12/lib \
     opencv_calib3d249.lib \
     opencv_objdetect249.lib \
     opencv_flann249.lib \
-    opencv_nonfree249.lib
+    opencv_nonfree249.lib \
+    winmm.lib
+
+unix:!macx: LIBS += -lX11 -lXtst
 
 SOURCES += main.cpp\
     hotkey/GlobalHotKeyThreadWin.cpp \
@@ -53,9 +56,19 @@ SOURCES += main.cpp\
     model/MacroEvent.cpp \
     controller/macro_activation/MacroActivationController.cpp \
     macro_activation/MacroActivator.cpp \
+    macro_activation/ReplayScheduler.cpp \
+    macro_activation/MouseMotion.cpp \
+    macro_activation/InputInjector.cpp \
+    macro_activation/InputInjectorWin.cpp \
+    macro_activation/InputInjectorX11.cpp \
+    macro_activation/LoopbackInputInjector.cpp \
+    macro_activation/TargetResolver.cpp \
+    macro_activation/MacroJobScheduler.cpp \
+    macro_activation/ReplayTrace.cpp \
     view/macro_editor/MacroEditor.cpp \
     controller/macro_editor/MacroEditorController.cpp \
     view/macro_editor/MacroEventsTable.cpp \
+    view/macro_editor/MacroEventsTableModel.cpp \
     view/macro_editor/MacroIdsLabel.cpp \
     view/macro_menu/MacroMenu.cpp \
     controller/macro_menu/MacroMenuController.cpp \
@@ -64,7 +77,16 @@ SOURCES += main.cpp\
     view/macro_menu/MacroMenuContextMenu.cpp \
     model/proxy/MacroEventEditProxy.cpp \
     model/proxy/MacroEventLogBuffer.cpp \
-    controller/macro_add/MacroAddController.cpp
+    controller/macro_add/MacroAddController.cpp \
+    model/DBMaintenanceThread.cpp \
+    model/SqlIdSet.cpp \
+    model/ScreenshotHandle.cpp \
+    model/ScreenshotStore.cpp \
+    model/ScreenshotThumbnails.cpp \
+    model/ScreenshotCodec.cpp \
+    model/ScreenshotDelta.cpp \
+    model/ReplayPlan.cpp \
+    model/DBService.cpp
 
 HEADERS  += \
     hotkey/GlobalHotKeyThreadWin.h \
@@ -98,11 +120,21 @@ HEADERS  += \
     io_logging/IOUtil.h \
     controller/macro_activation/MacroActivationController.h \
     macro_activation/MacroActivator.h \
+    macro_activation/ReplayScheduler.h \
+    macro_activation/MouseMotion.h \
+    macro_activation/InputInjector.h \
+    macro_activation/InputInjectorWin.h \
+    macro_activation/InputInjectorX11.h \
+    macro_activation/LoopbackInputInjector.h \
+    macro_activation/TargetResolver.h \
+    macro_activation/MacroJobScheduler.h \
+    macro_activation/ReplayTrace.h \
     util/ProducerConsumerQueue.hpp \
     controller/macro_menu/MacroMenuEventListener.h \
     view/macro_editor/MacroEditor.h \
     controller/macro_editor/MacroEditorController.h \
     view/macro_editor/MacroEventsTable.h \
+    view/macro_editor/MacroEventsTableModel.h \
     view/macro_editor/MacroIdsLabel.h \
     controller/macro_menu/MacroMenuController.h \
     controller/macro_editor/MacroEditorEventListener.h \
@@ -114,7 +146,16 @@ HEADERS  += \
     util/ChangeLog.hpp \
     model/proxy/MacroEventLogBuffer.h \
     controller/macro_add/MacroAddController.h \
-    model/proxy/MacroEventEdit.h
+    model/proxy/MacroEventEdit.h \
+    model/DBMaintenanceThread.h \
+    model/SqlIdSet.h \
+    model/ScreenshotHandle.h \
+    model/ScreenshotStore.h \
+    model/ScreenshotThumbnails.h \
+    model/ScreenshotCodec.h \
+    model/ScreenshotDelta.h \
+    model/ReplayPlan.h \
+    model/DBService.h
 
 FORMS    += view/macro_menu/MacroMenu.ui \
     view/macro_menu/CustomDialog.ui \
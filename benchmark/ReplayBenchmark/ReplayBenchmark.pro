@@ -0,0 +1,36 @@
+#-------------------------------------------------
+#
+# Headless replay benchmark: injection throughput, timing accuracy, and tracing overhead against the loopback
+# input injector.
+# Usage: ReplayBenchmark [events (default 1000)] [event delay ms (default 5)]
+#
+#-------------------------------------------------
+
+QT       += core
+
+TARGET = ReplayBenchmark
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../../macro_activation
+
+win32: LIBS += winmm.lib
+unix:!macx: LIBS += -lX11 -lXtst
+
+SOURCES += main.cpp \
+    ../../macro_activation/ReplayScheduler.cpp \
+    ../../macro_activation/MouseMotion.cpp \
+    ../../macro_activation/InputInjector.cpp \
+    ../../macro_activation/InputInjectorWin.cpp \
+    ../../macro_activation/InputInjectorX11.cpp \
+    ../../macro_activation/LoopbackInputInjector.cpp \
+    ../../macro_activation/ReplayTrace.cpp
+
+HEADERS += ../../macro_activation/ReplayScheduler.h \
+    ../../macro_activation/MouseMotion.h \
+    ../../macro_activation/InputInjector.h \
+    ../../macro_activation/InputInjectorWin.h \
+    ../../macro_activation/InputInjectorX11.h \
+    ../../macro_activation/LoopbackInputInjector.h \
+    ../../macro_activation/ReplayTrace.h
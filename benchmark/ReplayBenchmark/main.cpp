@@ -0,0 +1,167 @@
+#include "ReplayScheduler.h"
+#include "MouseMotion.h"
+#include "LoopbackInputInjector.h"
+#include "ReplayTrace.h"
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTextStream>
+#include <QVector>
+#include <QtMath>
+
+
+/**
+ * Replays synthetic Macro Events into the loopback input injector, headless, and reports:
+ *  - Raw injection throughput of click batches.
+ *  - Text throughput of a long mixed Unicode key string, typed in chunks (as a press and a release per character)
+ *    and pasted.
+ *  - Timing accuracy of a fixed delay event stream, both as the scheduler sees it and as the gaps between the
+ *    recorded input timestamps.
+ *  - The duration and number of cursor placements of a mouse move for each motion model.
+ *  - The cost of a trace span with tracing off and on, and the size of the exported trace.
+ */
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QTextStream out(stdout);
+
+    int nEvents = (argc > 1) ? qMax(1, QString(argv[1]).toInt()) : 1000;
+    int delayMs = (argc > 2) ? qMax(0, QString(argv[2]).toInt()) : 5;
+    LoopbackInputInjector injector;
+    QElapsedTimer timer;
+
+    // Raw injection throughput.
+    const int nBatches = 200000;
+    InputInjector::Input click[2] = { InputInjector::mouseButton(InputInjector::Left, true),
+                                      InputInjector::mouseButton(InputInjector::Left, false) };
+    injector.begin();
+    timer.start();
+    for (int i = 0; i < nBatches; i++) {
+        injector.inject(click, 2);
+    }
+    qint64 injectNs = timer.nsecsElapsed();
+    out << "Injection: " << nBatches << " click batches in " << QString::number(injectNs / 1e6, 'f', 1) << " ms, "
+        << QString::number(nBatches / (injectNs / 1e9), 'f', 0) << " batches/s" << endl << endl;
+    injector.clear();
+
+    // Text throughput, with characters outside the BMP so chunks must keep surrogate pairs together.
+    const int nTextChars = 100000;
+    const QString textPattern = QString::fromUtf8("Macro text \xC3\xA9\xC3\xBC\xE4\xB8\xAD\xE6\x96\x87 "
+                                                  "\xF0\x9F\x98\x80\n");
+    QString text;
+    text.reserve(nTextChars + textPattern.size());
+    while (text.size() < nTextChars) {
+        text += textPattern;
+    }
+    injector.begin();
+    timer.start();
+    injector.enterText(text, 0);
+    qint64 typeNs = timer.nsecsElapsed();
+    QVector<LoopbackInputInjector::RecordedInput> typedInputs = injector.getRecordedInputs();
+    QString typedText;
+    foreach (const LoopbackInputInjector::RecordedInput &recordedInput, typedInputs) {
+        if (recordedInput.input.down) typedText += recordedInput.text;
+    }
+    int nChunks = typedInputs.isEmpty() ? 0 : typedInputs.last().batch + 1;
+    out << "Text: " << text.size() << " characters typed as " << typedInputs.size() << " key inputs in " << nChunks
+        << " chunks, " << QString::number(typeNs / 1e6, 'f', 1) << " ms, "
+        << QString::number(text.size() / (typeNs / 1e9), 'f', 0) << " chars/s"
+        << (typedText == text ? "" : " (MISMATCH)") << endl;
+    injector.clear();
+    injector.begin();
+    timer.start();
+    injector.enterText(text, 1);
+    qint64 pasteNs = timer.nsecsElapsed();
+    out << "  pasted in " << injector.getRecordedInputs().size() << " batch, " << QString::number(pasteNs / 1e6, 'f', 3)
+        << " ms" << endl << endl;
+    injector.clear();
+
+    // Timing accuracy of a fixed delay event stream.
+    ReplayScheduler scheduler;
+    injector.begin();
+    scheduler.start();
+    for (int i = 0; i < nEvents && scheduler.isRunning(); i++) {
+        scheduler.advance(delayMs * 1000000LL);
+        if (!scheduler.waitForDeadline()) break;
+        injector.inject(click, 2);
+    }
+    scheduler.stop();
+    scheduler.finish();
+
+    QVector<LoopbackInputInjector::RecordedInput> recorded = injector.getRecordedInputs();
+    qint64 totalErrorNs = 0,
+           maxErrorNs = 0,
+           sumSquaredErrorUs = 0;
+    int nGaps = 0;
+    for (int i = 2; i < recorded.size(); i += 2) {
+        qint64 errorNs = qAbs(recorded[i].timestampNs - recorded[i - 2].timestampNs - delayMs * 1000000LL);
+        totalErrorNs += errorNs;
+        maxErrorNs = qMax(maxErrorNs, errorNs);
+        sumSquaredErrorUs += (errorNs / 1000) * (errorNs / 1000);
+        nGaps++;
+    }
+    nGaps = qMax(nGaps, 1);
+    out << "Replay: " << nEvents << " events, " << delayMs << " ms apart" << endl
+        << "  scheduler lateness: " << ReplayScheduler::statsSummary(scheduler.stats()) << endl
+        << "  recorded gap error: mean " << QString::number(totalErrorNs / nGaps / 1000.0, 'f', 1) << " us, rms "
+        << QString::number(qSqrt((double)sumSquaredErrorUs / nGaps), 'f', 1) << " us, max "
+        << QString::number(maxErrorNs / 1000.0, 'f', 1) << " us" << endl << endl;
+    injector.clear();
+
+    // Mouse moves of each motion model.
+    const int nMoves = 10;
+    const char *modelNames[] = { "Teleport", "Linear", "Eased", "Bezier" };
+    out << qSetFieldWidth(12) << left << "Model" << qSetFieldWidth(16) << right
+        << "Move ms" << "Placements" << qSetFieldWidth(0) << endl;
+    for (int model = MouseMotion::Teleport; model <= MouseMotion::Bezier; model++) {
+        MouseMotion motion;
+        MouseMotion::Settings settings = MouseMotion::DEFAULT_SETTINGS;
+        settings.model = (MouseMotion::Model)model;
+        motion.setSettings(settings);
+
+        ReplayScheduler moveScheduler;
+        injector.clear();
+        injector.begin();
+        moveScheduler.start();
+        timer.start();
+        for (int i = 0; i < nMoves; i++) {
+            motion.moveTo((i % 2) ? 0 : 1000, (i % 2) ? 0 : 600, moveScheduler, injector);
+        }
+        qint64 moveNs = timer.nsecsElapsed();
+        moveScheduler.stop();
+        moveScheduler.finish();
+
+        out << qSetFieldWidth(12) << left << modelNames[model] << qSetFieldWidth(16) << right
+            << QString::number(moveNs / 1e6 / nMoves, 'f', 2)
+            << QString::number((double)injector.getRecordedInputs().size() / nMoves, 'f', 1)
+            << qSetFieldWidth(0) << endl;
+    }
+    out << endl;
+
+    // Trace span cost, off and on (each span here wraps a click batch, like the Inject span of a replay).
+    const int nSpans = ReplayTrace::CAPACITY;
+    qint64 spanNs[2];
+    for (int tracing = 0; tracing <= 1; tracing++) {
+        ReplayTrace::setEnabled(tracing == 1);
+        ReplayTrace::begin();
+        injector.clear();
+        injector.begin();
+        timer.start();
+        for (int i = 0; i < nSpans; i++) {
+            ReplayTrace::Scope injectSpan("Inject", i);
+            injector.inject(click, 2);
+        }
+        spanNs[tracing] = timer.nsecsElapsed();
+    }
+    ReplayTrace::setEnabled(false);
+    injector.clear();
+    timer.start();
+    QByteArray trace = ReplayTrace::toChromeTrace();
+    qint64 exportNs = timer.nsecsElapsed();
+    out << "Tracing: " << nSpans << " spans around click batches, "
+        << QString::number((double)spanNs[0] / nSpans, 'f', 1) << " ns each off, "
+        << QString::number((double)spanNs[1] / nSpans, 'f', 1) << " ns each on" << endl
+        << "  " << ReplayTrace::spans().size() << " spans (" << ReplayTrace::droppedCount() << " dropped) exported as "
+        << trace.size() / 1024 << " KiB of Chrome trace JSON in " << QString::number(exportNs / 1e6, 'f', 1) << " ms"
+        << endl;
+    return 0;
+}
@@ -0,0 +1,20 @@
+#-------------------------------------------------
+#
+# Encode/decode benchmark of the screenshot codecs.
+# Usage: ScreenshotCodecBenchmark [corpus dir (default ./screenshots/)] [repetitions (default 3)]
+#
+#-------------------------------------------------
+
+QT       += core gui
+
+TARGET = ScreenshotCodecBenchmark
+TEMPLATE = app
+CONFIG += console
+CONFIG -= app_bundle
+
+INCLUDEPATH += ../../model
+
+SOURCES += main.cpp \
+    ../../model/ScreenshotCodec.cpp
+
+HEADERS += ../../model/ScreenshotCodec.h
@@ -0,0 +1,92 @@
+#include "ScreenshotCodec.h"
+#include <QCoreApplication>
+#include <QDir>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QTextStream>
+
+
+/**
+ * Encodes and decodes every image in a corpus of screenshots with each available screenshot codec, and reports
+ * the encode and decode throughput (MB/s of uncompressed 32 bit pixels) and the compression ratio of each.
+ * Also checks that each codec round trips every image losslessly.
+ */
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QTextStream out(stdout);
+
+    QString corpusPath = (argc > 1) ? argv[1] : "./screenshots/";
+    int repetitions = (argc > 2) ? qMax(1, QString(argv[2]).toInt()) : 3;
+
+    // Load the corpus.
+    QDir corpusDir(corpusPath);
+    QStringList nameFilters;
+    nameFilters << "*.png" << "*.bmp" << "*.jpg" << "*.jpeg" << "*.webp";
+    QList<QImage> corpus;
+    qint64 rawBytes = 0;
+    foreach (const QString &fileName, corpusDir.entryList(nameFilters, QDir::Files)) {
+        QImage image(corpusDir.filePath(fileName));
+        if (image.isNull()) continue;
+        corpus.append(image);
+        rawBytes += (qint64)image.width() * image.height() * 4;
+    }
+    if (corpus.isEmpty()) {
+        out << "No screenshots found in " << corpusPath << endl;
+        return 1;
+    }
+    out << corpus.size() << " screenshots, " << QString::number(rawBytes / 1048576.0, 'f', 1) << " MB uncompressed, "
+        << repetitions << " repetitions" << endl << endl;
+
+    out << qSetFieldWidth(20) << left << "Codec" << qSetFieldWidth(14) << right
+        << "Encode MB/s" << "Decode MB/s" << "Ratio" << "Lossless" << qSetFieldWidth(0) << endl;
+
+    foreach (const ScreenshotCodec *codec, ScreenshotCodec::all()) {
+        if (!codec->isAvailable()) {
+            out << qSetFieldWidth(20) << left << codec->name() << qSetFieldWidth(0) << "not available" << endl;
+            continue;
+        }
+
+        QList<QByteArray> encoded;
+        qint64 encodedBytes = 0,
+               encodeNs = 0,
+               decodeNs = 0;
+        bool lossless = true;
+        QElapsedTimer timer;
+
+        for (int rep = 0; rep < repetitions; rep++) {
+            encoded.clear();
+            timer.start();
+            foreach (const QImage &image, corpus) {
+                encoded.append(codec->encode(image));
+            }
+            encodeNs += timer.nsecsElapsed();
+
+            QList<QImage> decoded;
+            timer.start();
+            foreach (const QByteArray &data, encoded) {
+                decoded.append(codec->decode((const uchar*)data.constData(), data.size()));
+            }
+            decodeNs += timer.nsecsElapsed();
+
+            // Only needs checking once, and is not timed.
+            if (rep == 0) {
+                for (int i = 0; i < corpus.size(); i++) {
+                    QImage::Format format = corpus[i].hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32;
+                    lossless = lossless && (decoded[i].convertToFormat(format) == corpus[i].convertToFormat(format));
+                }
+            }
+        }
+        foreach (const QByteArray &data, encoded) {
+            encodedBytes += data.size();
+        }
+
+        double totalMb = rawBytes * repetitions / 1048576.0;
+        out << qSetFieldWidth(20) << left << codec->name() << qSetFieldWidth(14) << right
+            << QString::number(totalMb / qMax(encodeNs, (qint64)1) * 1e9, 'f', 1)
+            << QString::number(totalMb / qMax(decodeNs, (qint64)1) * 1e9, 'f', 1)
+            << QString::number((double)rawBytes / qMax(encodedBytes, (qint64)1), 'f', 2)
+            << (lossless ? "yes" : "NO") << qSetFieldWidth(0) << endl;
+    }
+    return 0;
+}
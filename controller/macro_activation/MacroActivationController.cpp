@@ -2,63 +2,72 @@
 #include <QDebug>
 
 
-MacroActivationController::MacroActivationController(GlobalHotKeyMonitor &hotkeyMonitor, MacroEventModel &macroEventModel)
+MacroActivationController::MacroActivationController(GlobalHotKeyMonitor &hotkeyMonitor)
     : _hotkeyMonitor(hotkeyMonitor),
-      _macroEventModel(macroEventModel),
-      _macroActivator(),
-      _loggingInfo()
+      _loggingInfo(),
+      _jobScheduler(),
+      _jobId(-1)
 {
     _loggingInfo.setHeader("Running Selected Macro\nStop Running: ctrl + w");
-    qRegisterMetaType<MacroEvent>();
-    connect(&_macroActivator, SIGNAL(activatingMacroEvent(MacroEvent)), this, SLOT(handleMacroEvent(MacroEvent)));
+    connect(&_jobScheduler, SIGNAL(activatingMacroEvent(QString)), this, SLOT(handleMacroEvent(QString)));
+    connect(&_jobScheduler, SIGNAL(jobFinished(int)), this, SLOT(handleJobFinished(int)));
+    _jobScheduler.start();
 }
 
 
-void MacroActivationController::assumeControlFromParent(int macroId, Controller *parentController)
+void MacroActivationController::assumeControlFromParent(int macroId, Controller *parentController,
+                                                        const MacroActivator::ActivationOptions &options)
 {
     // Setup state.
     Controller::assumeControlFromParent(parentController);
-    _macroEventModel.setActiveMacro(macroId);
     _loggingInfo.showNormal();
 
-    // Connect to global hot key monitor and macro activator signals.
+    // Connect to global hot key monitor signal.
     connect(&_hotkeyMonitor, SIGNAL(hotKeyEvent()), this, SLOT(surrenderControlToParent()));
-    connect(&_macroActivator, SIGNAL(macroActivatorStopped(bool, const QString&)),
-            this, SLOT(surrenderControlToParent(bool, const QString&)));
 
-    // Get the events to activate and run the macro activator with them.
-    QList<MacroEvent> events = _macroEventModel.getUniformEvents();
-    _macroActivator.runMacro(events);
+    // Queue a single run of the macro; the job scheduler gets its compiled replay plan (usually already cached).
+    MacroJobScheduler::MacroJob job;
+    job.macroId = macroId;
+    job.options = options;
+    job.repeatCount = 1;
+    job.repeatIntervalMs = 0;
+    job.startAt = QDateTime();
+    _jobId = _jobScheduler.enqueue(job);
 }
 
 
 void MacroActivationController::surrenderControlToParent(bool deactivateDueToError, const QString &errorMsg)
 {
     _loggingInfo.close();
-    _macroActivator.stopMacro();
 
-    // Disconnect from global hot key monitor and macro activator signals.
+    // Cleared first, since cancelling a job that has not started yet finishes it right away.
+    int jobId = _jobId;
+    _jobId = -1;
+    if (jobId != -1) {
+        _jobScheduler.cancel(jobId);
+    }
+
+    // Disconnect from global hot key monitor signal.
     disconnect(&_hotkeyMonitor, SIGNAL(hotKeyEvent()), this, SLOT(surrenderControlToParent()));
-    disconnect(&_macroActivator, SIGNAL(macroActivatorStopped(bool, const QString&)),
-               this, SLOT(surrenderControlToParent(bool, const QString&)));
 
     Controller::surrenderControlToParent(deactivateDueToError, errorMsg);
 }
 
 
-void MacroActivationController::handleMacroEvent(const MacroEvent &event)
+void MacroActivationController::handleMacroEvent(const QString &eventInfo)
 {
-    QString eventInfo;
-
-    // Get event info string to display based off of event type.
-    if (event.type == MacroEventType::MouseEvent) {
-        eventInfo = getMacroMouseEventInfoStr(event.mouseEvent);
-    }
-    else {
-        eventInfo = getMacroKeyboardEventInfoStr(event.keyboardEvent);
-    }
-
+    // The info string was built when the replay plan was compiled.
     _loggingInfo.updateEventInfo(eventInfo);
     qDebug() << "Updated event info!";
     _loggingInfo.update();
 }
+
+
+void MacroActivationController::handleJobFinished(int jobId)
+{
+    // Always take the result, even of a job that was cancelled when control was handed back.
+    MacroJobScheduler::MacroJobResult result;
+    if (!_jobScheduler.takeResult(jobId, result) || jobId != _jobId) return;
+
+    surrenderControlToParent(!result.errorMsg.isEmpty(), result.errorMsg);
+}
@@ -2,17 +2,14 @@
 #define MacroActivationController_H
 
 
-#include "model/MacroEventModel.h"
 #include "controller/Controller.h"
 #include "view/io_logging/IOLoggingInfo.h"
 #include "macro_activation/MacroActivator.h"
+#include "macro_activation/MacroJobScheduler.h"
 #include "hotkey/GlobalHotKeyMonitor.h"
 #include "model/MacroEvent.h"
 
 
-Q_DECLARE_METATYPE(MacroEvent)
-
-
 /**
  * @brief The MacroActivationController class
  * Contains functionality for the activation of a Macro record.
@@ -23,7 +20,7 @@ class MacroActivationController : public Controller
 
 public:
 
-    MacroActivationController(GlobalHotKeyMonitor &hotkeyMonitor, MacroEventModel &macroEventModel);
+    MacroActivationController(GlobalHotKeyMonitor &hotkeyMonitor);
 
 
 public slots:
@@ -35,8 +32,11 @@ public slots:
      * The ID of the Macro to activate.
      * @param parentController
      * The parent controller. Used to hand control back to the parent when finished.
+     * @param options (OPTIONAL)
+     * How to activate the Macro: in recorded time (default), sped up, or as fast as the UI is ready.
      */
-    void assumeControlFromParent(int macroId, Controller *parentController);
+    void assumeControlFromParent(int macroId, Controller *parentController,
+                                 const MacroActivator::ActivationOptions &options = MacroActivator::DEFAULT_OPTIONS);
 
 
 private slots:
@@ -54,10 +54,18 @@ private slots:
     /**
      * @brief handleMacroEvent
      * Handles the display of info for a Macro Event that is currently being activated.
-     * @param event
-     * The Macro Event that is being activated.
+     * @param eventInfo
+     * The info string of the Macro Event that is being activated.
+     */
+    void handleMacroEvent(const QString &eventInfo);
+
+    /**
+     * @brief handleJobFinished
+     * Hands control back to the parent once the activation job has finished.
+     * @param jobId
+     * The ID of the finished job.
      */
-    void handleMacroEvent(const MacroEvent &event);
+    void handleJobFinished(int jobId);
 
 
 private:
@@ -68,13 +76,6 @@ private:
      */
     GlobalHotKeyMonitor &_hotkeyMonitor;
 
-    /**
-     * @brief _macroEventModel
-     * Model for Macro Events. Used to retrieve all Macro Event data for
-     * activation of a Macro record.
-     */
-    MacroEventModel &_macroEventModel;
-
     /**
      * @brief _loggingInfo
      * Logging info GUI view.
@@ -82,10 +83,16 @@ private:
     IOLoggingInfo _loggingInfo;
 
     /**
-     * @brief _macroActivator
-     * The driver behind Macro activation or playback.
+     * @brief _jobScheduler
+     * Runs the activations on its executor thread, compiling (or taking the cached) replay plan there as well.
+     */
+    MacroJobScheduler _jobScheduler;
+
+    /**
+     * @brief _jobId
+     * The ID of the activation job that is running, or -1 if none.
      */
-    MacroActivator _macroActivator;
+    int _jobId;
 };
 
 
@@ -34,6 +34,7 @@ void MacroAddController::assumeControlFromChild(const SrcControllerInfo &srcCont
 {
     if (!srcControllerInfo.error) {
         _macroEventModel.addEvents(_ioLoggingController.takeAddedMacroEvents());
+        _macroEventModel.requestReplayPlans();
     }
     surrenderControlToParent(srcControllerInfo.error, srcControllerInfo.errorMsg);
 }
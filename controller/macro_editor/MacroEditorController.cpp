@@ -1,18 +1,35 @@
 #include "MacroEditorController.h"
 #include "view/macro_menu/MacroMenu.h"
+#include "model/ScreenshotStore.h"
 #include <QDebug>
 
 
 MacroEditorController::MacroEditorController(GlobalHotKeyMonitor &hotKeyMonitor,
                                              IOLoggingController &ioLoggingController,
-                                             MacroEventModel &macroEventModel)
+                                             MacroEventModel &macroEventModel,
+                                             DBService &dbService)
     : Controller(),
       MacroEditorEventListener(),
       _macroEditor(*this),
-      _macroEventEditProxy(macroEventModel),
-      _ioLoggingController(ioLoggingController)
+      _macroEventEditProxy(macroEventModel, dbService),
+      _ioLoggingController(ioLoggingController),
+      _dbService(dbService),
+      _loadRequestId(-1),
+      _loadMacroIds(),
+      _saveRequestIds(),
+      _editing(false),
+      _holdingSweep(false)
 {
     connect(&_macroEditor, SIGNAL(closed()), this, SLOT(surrenderControlToParent()));
+    // The view only applies the rows that each edit, undo and redo changed.
+    connect(&_macroEventEditProxy, SIGNAL(eventsInserted(int,QList<MacroEvent>)),
+            &_macroEditor, SLOT(insertEventRows(int,QList<MacroEvent>)));
+    connect(&_macroEventEditProxy, SIGNAL(eventsRemoved(int,int)),
+            &_macroEditor, SLOT(removeEventRows(int,int)));
+    connect(&_macroEventEditProxy, SIGNAL(eventsUpdated(int,QList<MacroEvent>)),
+            &_macroEditor, SLOT(updateEventRows(int,QList<MacroEvent>)));
+    connect(&_dbService, SIGNAL(requestProgress(int,int,int)), this, SLOT(handleRequestProgress(int,int,int)));
+    connect(&_dbService, SIGNAL(requestFinished(int)), this, SLOT(handleRequestFinished(int)));
 }
 
 
@@ -33,14 +50,18 @@ void MacroEditorController::insertEventsAt(int macroEventIndex)
 void MacroEditorController::copyEvents(QList<int> &macroEventIndexes)
 {
     _macroEventEditProxy.copyMacroEvents(macroEventIndexes);
-    refreshView();
 }
 
 
 void MacroEditorController::deleteEvents(QList<int> &macroEventIndexes)
 {
     _macroEventEditProxy.deleteMacroEvents(macroEventIndexes);
-    refreshView();
+}
+
+
+void MacroEditorController::moveEvents(QList<int> &macroEventIndexes, int destIndex)
+{
+    _macroEventEditProxy.moveMacroEvents(macroEventIndexes, destIndex);
 }
 
 
@@ -76,31 +97,37 @@ bool MacroEditorController::hasUnsavedChanges()
 
 void MacroEditorController::saveEvents()
 {
-    _macroEventEditProxy.saveEvents();
+    _saveRequestIds.append(_macroEventEditProxy.saveEvents());
+    _macroEditor.showSaveProgress(0, 0);
 }
 
 
 void MacroEditorController::undoLastEventChange()
 {
     _macroEventEditProxy.undoChange();
-    refreshView();
 }
 
 
 void MacroEditorController::redoLastEventChange()
 {
     _macroEventEditProxy.redoChange();
-    refreshView();
 }
 
 
 void MacroEditorController::assumeControlFromParent(const QList<int> &macroIds, Controller *parentController)
 {
     Controller::assumeControlFromParent(parentController);
-    _macroEventEditProxy.setEditMacros(macroIds);
+    _editing = true;
+    if (!_holdingSweep) {
+        ScreenshotStore::holdSweep();
+        _holdingSweep = true;
+    }
 
-    QList<MacroEvent> macroEvents = _macroEventEditProxy.getLatestMacroEvents();
-    _macroEditor.refresh(macroEvents, &macroIds);
+    // Queued behind any pending writes, so the events are read as they will be once those are committed.
+    DBService::Request request = DBService::newRequest(DBService::LoadMacroEvents);
+    request.macroIds = macroIds;
+    _loadMacroIds = macroIds;
+    _loadRequestId = _dbService.enqueue(request);
 }
 
 
@@ -110,10 +137,10 @@ void MacroEditorController::assumeControlFromChild(const SrcControllerInfo &srcC
 
     // If we are coming back from IOLogging for new Macro Events.
     if (srcControllerInfo.controllerId == _ioLoggingController.CONTROLLER_ID) {
-        // Get logged events, add them to the edit proxy, and refresh the view.
+        // Get logged events and add them to the edit proxy, which inserts them into the view.
         QList<MacroEvent> addedEvents = _ioLoggingController.takeAddedMacroEvents();
         _macroEventEditProxy.insertMacroEvents(addedEvents);
-        refreshView();
+        _macroEditor.show();
     }
 }
 
@@ -123,12 +150,49 @@ void MacroEditorController::surrenderControlToParent(bool deactivateDueToError,
     _macroEditor.hide();
     // Make sure we refresh the proxy so all contained change/save logs are cleared so we do not reuse old state when editing later!
     _macroEventEditProxy.refresh();
+    _editing = false;
+    releaseSweepIfDone();
     Controller::surrenderControlToParent(deactivateDueToError, errorMsg);
 }
 
 
-void MacroEditorController::refreshView()
+void MacroEditorController::handleRequestProgress(int requestId, int doneCount, int totalCount)
+{
+    if (_saveRequestIds.contains(requestId)) {
+        _macroEditor.showSaveProgress(doneCount, totalCount);
+    }
+}
+
+
+void MacroEditorController::handleRequestFinished(int requestId)
 {
-    QList<MacroEvent> latestEvents = _macroEventEditProxy.getLatestMacroEvents();
-    _macroEditor.refresh(latestEvents);
+    if (requestId == _loadRequestId) {
+        DBService::Result result;
+        _dbService.takeResult(requestId, result);
+        _loadRequestId = -1;
+        _macroEventEditProxy.setEditMacros(_loadMacroIds, result.macroEvents);
+
+        QList<MacroEvent> macroEvents = _macroEventEditProxy.getLatestMacroEvents();
+        _macroEditor.refresh(macroEvents, &_loadMacroIds);
+        return;
+    }
+
+    // Other controllers' requests are left for them to take.
+    if (!_saveRequestIds.removeOne(requestId)) return;
+
+    DBService::Result result;
+    _dbService.takeResult(requestId, result);
+    if (_saveRequestIds.isEmpty()) {
+        _macroEditor.showSaveFinished();
+        releaseSweepIfDone();
+    }
+}
+
+
+void MacroEditorController::releaseSweepIfDone()
+{
+    if (_holdingSweep && !_editing && _saveRequestIds.isEmpty()) {
+        ScreenshotStore::releaseSweep();
+        _holdingSweep = false;
+    }
 }
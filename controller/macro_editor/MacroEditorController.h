@@ -8,6 +8,7 @@
 #include "model/MacroEventModel.h"
 #include "model/MacroEvent.h"
 #include "model/proxy/MacroEventEditProxy.h"
+#include "model/DBService.h"
 #include "MacroEditorEventListener.h"
 #include "controller/io_logging/IOLoggingController.h"
 #include <QList>
@@ -42,12 +43,50 @@ private:
      */
     IOLoggingController &_ioLoggingController;
 
+    /**
+     * @brief _dbService
+     * Service that commits saves off of the GUI thread.
+     */
+    DBService &_dbService;
+
+    /**
+     * @brief _loadRequestId
+     * The DB service request ID of the load of the Macro Events to edit. -1 if none is running.
+     */
+    int _loadRequestId;
+
+    /**
+     * @brief _loadMacroIds
+     * The IDs of the Macros whose events are being loaded.
+     */
+    QList<int> _loadMacroIds;
+
+    /**
+     * @brief _saveRequestIds
+     * The DB service request IDs of the saves that have not finished yet.
+     */
+    QList<int> _saveRequestIds;
+
+    /**
+     * @brief _editing
+     * Set while the editor has control (including while events are being logged for it).
+     */
+    bool _editing;
+
+    /**
+     * @brief _holdingSweep
+     * Set while this controller holds the screenshot sweep (see ScreenshotStore::holdSweep()), which is from when
+     * editing starts until editing has stopped and its saves have finished.
+     */
+    bool _holdingSweep;
+
 
 public:
 
     explicit MacroEditorController(GlobalHotKeyMonitor &hotKeyMonitor,
                                    IOLoggingController &ioLoggingController,
-                                   MacroEventModel &macroEventModel);
+                                   MacroEventModel &macroEventModel,
+                                   DBService &dbService);
 
 
     /**
@@ -83,6 +122,16 @@ public:
      */
     void deleteEvents(QList<int> &macroEventIndexes) override;
 
+    /**
+     * @brief moveEvents
+     * Moves a set of Macro Events in all Macros being edited (drag and drop reorder).
+     * @param macroEventIndexes
+     * The indexes of the Macro Events to move.
+     * @param destIndex
+     * The index of the first moved Macro Event once the moved events have been taken out of their old positions.
+     */
+    void moveEvents(QList<int> &macroEventIndexes, int destIndex) override;
+
     /**
      * @brief updateEventDelay
      * Updates the delay before a given Macro Event is exectued. The event is updated among all
@@ -137,7 +186,8 @@ public:
 
     /**
      * @brief saveEvents
-     * Saves all changes to the Macro Events of the Macros that are being edited.
+     * Saves all changes to the Macro Events of the Macros that are being edited. The save runs in the background,
+     * and its progress is shown in the editor.
      */
     void saveEvents() override;
 
@@ -158,7 +208,8 @@ public slots:
 
     /**
      * @brief assumeControlFromParent
-     * Should be invoked whenever this controller is granted control by a parent controller.
+     * Should be invoked whenever this controller is granted control by a parent controller. The editor is shown once
+     * the Macro Events have been loaded through the DB service (after any saves that are still queued).
      * @param macroIds
      * A list of the IDs of the Macros that are being edited.
      * @param parentController
@@ -188,14 +239,34 @@ private slots:
      */
     void surrenderControlToParent(bool deactivateDueToError = false, const QString &errorMsg = "") override;
 
+    /**
+     * @brief handleRequestProgress
+     * Shows the progress of a running save.
+     * @param requestId
+     * The DB service request ID.
+     * @param doneCount
+     * The number of changes saved so far.
+     * @param totalCount
+     * The total number of changes being saved.
+     */
+    void handleRequestProgress(int requestId, int doneCount, int totalCount);
+
+    /**
+     * @brief handleRequestFinished
+     * Shows the loaded Macro Events, or shows that a save has finished.
+     * @param requestId
+     * The DB service request ID.
+     */
+    void handleRequestFinished(int requestId);
+
 
 private:
 
     /**
-     * @brief refreshView
-     * Refreshes the editor view.
+     * @brief releaseSweepIfDone
+     * Releases the screenshot sweep hold once editing has stopped and its saves have finished.
      */
-    void refreshView();
+    void releaseSweepIfDone();
 };
 
 
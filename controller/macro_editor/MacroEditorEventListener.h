@@ -49,6 +49,16 @@ public:
      */
     virtual void deleteEvents(QList<int> &macroEventIndexes) = 0;
 
+    /**
+     * @brief moveEvents
+     * Moves a set of Macro Events in all Macros being edited (drag and drop reorder).
+     * @param macroEventIndexes
+     * The indexes of the Macro Events to move.
+     * @param destIndex
+     * The index of the first moved Macro Event once the moved events have been taken out of their old positions.
+     */
+    virtual void moveEvents(QList<int> &macroEventIndexes, int destIndex) = 0;
+
     /**
      * @brief updateEventDelay
      * Updates the delay before a given Macro Event is exectued. The event is updated among all
@@ -4,9 +4,36 @@
 #include <QMessageBox>
 
 
+namespace {
+// Folds only the case of ASCII letters, as SQLite LIKE does, rather than Qt's Unicode case folding.
+QString asciiLower(const QString &str)
+{
+    QString lower = str;
+    for (int i = 0; i < lower.size(); i++) {
+        ushort c = lower.at(i).unicode();
+        if (c >= 'A' && c <= 'Z') {
+            lower[i] = QChar(c + ('a' - 'A'));
+        }
+    }
+    return lower;
+}
+
+bool isAscii(const QString &str)
+{
+    foreach (const QChar &c, str) {
+        if (c.unicode() > 0x7f) return false;
+    }
+    return true;
+}
+}
+
+
 MacroMenuController::MacroMenuController() :
     Controller(),
     RETRIEVAL_SEG_SIZE(100),
+    SEARCH_DEBOUNCE_MS(150),
+    TABLE_READ_KEY(0),
+    _dbService(),
     // Models
     _macroEventModel(),
     _macroMetaModel(_macroEventModel),
@@ -15,10 +42,22 @@ MacroMenuController::MacroMenuController() :
     _hotKeyMonitor(),
     // Child Controllers
     _ioLoggingController(_hotKeyMonitor),
-    _macroActivationController(_hotKeyMonitor, _macroEventModel),
+    _macroActivationController(_hotKeyMonitor),
     _macroAddController(_ioLoggingController, _macroMetaModel, _macroEventModel),
-    _macroEditorController(_hotKeyMonitor, _ioLoggingController, _macroEventModel)
+    _macroEditorController(_hotKeyMonitor, _ioLoggingController, _macroEventModel, _dbService),
+    // Search
+    _searchDebounceTimer(),
+    _searchSortOrder(ID_ASC),
+    _lastSearchSortOrder(ID_ASC),
+    _pendingRequests(),
+    _writeGeneration(0)
 {
+    _searchDebounceTimer.setSingleShot(true);
+    _searchDebounceTimer.setInterval(SEARCH_DEBOUNCE_MS);
+    connect(&_searchDebounceTimer, SIGNAL(timeout()), this, SLOT(runSearch()));
+    connect(&_dbService, SIGNAL(requestProgress(int,int,int)), this, SLOT(handleRequestProgress(int,int,int)));
+    connect(&_dbService, SIGNAL(requestFinished(int)), this, SLOT(handleRequestFinished(int)));
+    _dbService.start();
     _hotKeyMonitor.start();
 }
 
@@ -74,6 +113,8 @@ void MacroMenuController::handleHotKey()
 void MacroMenuController::activateMacro(int id)
 {
     surrenderControl();
+    // Activation reads the Macro outside of the DB service, so it must see every queued write first.
+    _dbService.waitForWrites();
     _macroActivationController.assumeControlFromParent(id, this);
 }
 
@@ -81,13 +122,20 @@ void MacroMenuController::activateMacro(int id)
 void MacroMenuController::createNewMacro(const QString &name)
 {
     surrenderControl();
+    // Adding writes through the GUI thread's models, so it must come after every queued write.
+    _dbService.waitForWrites();
     _macroAddController.assumeControlFromParent(name, this);
 }
 
 
 void MacroMenuController::renameMacro(int id, const QString &name)
 {
-    _macroMetaModel.setMacroName(id, name);
+    DBService::Request request = DBService::newRequest(DBService::RenameMacro);
+    request.macroIds.append(id);
+    request.macroName = name;
+    enqueueRequest(request, RENAME_REQUEST);
+    _lastSearchFilter = ""; // Search results are out of date.
+    _writeGeneration++;
 }
 
 
@@ -100,33 +148,172 @@ void MacroMenuController::editMacros(const QList<int> &ids)
 
 void MacroMenuController::removeMacros(const QList<int> &ids)
 {
-    _macroMetaModel.removeMacros(ids);
+    DBService::Request request = DBService::newRequest(DBService::RemoveMacros);
+    request.macroIds = ids;
+    enqueueRequest(request, REMOVE_REQUEST);
+    _lastSearchFilter = ""; // Search results are out of date.
+    _writeGeneration++;
 }
 
 
-QList<MacroMetadata> MacroMenuController::copyMacros(const QList<int> &ids)
+void MacroMenuController::copyMacros(const QList<int> &ids)
 {
-    return _macroMetaModel.copyMacros(ids);
+    DBService::Request request = DBService::newRequest(DBService::CopyMacros);
+    request.macroIds = ids;
+    enqueueRequest(request, COPY_REQUEST);
+    _macroMenu.showProgress("Copying Macros", 0, ids.size());
+    _lastSearchFilter = ""; // Search results are out of date.
+    _writeGeneration++;
 }
 
 
-QList<MacroMetadata> MacroMenuController::requestMacroMetadataWithFilter(const QString &nameOrIdFilter, int offset,
-                                                                         MacroMetadataSortOrder sortOrder)
+void MacroMenuController::requestMacroMetadataWithFilter(const QString &nameOrIdFilter, const MacroMetadata *after,
+                                                         MacroMetadataSortOrder sortOrder)
 {
-    return requestMacroMetadataWithFilter(nameOrIdFilter, offset, RETRIEVAL_SEG_SIZE, sortOrder);
+    requestMacroMetadataWithFilter(nameOrIdFilter, after, RETRIEVAL_SEG_SIZE, sortOrder);
 }
 
 
-QList<MacroMetadata> MacroMenuController::requestMacroMetadataWithFilter(const QString &nameOrIdFilter, int offset, int limit,
-                                                                         MacroMetadataSortOrder sortOrder)
+void MacroMenuController::requestMacroMetadataWithFilter(const QString &nameOrIdFilter, const MacroMetadata *after,
+                                                         int limit, MacroMetadataSortOrder sortOrder)
 {
-    return _macroMetaModel.getMacroMetadata(nameOrIdFilter, offset, limit, sortOrder);
+    DBService::Request request = DBService::newRequest(DBService::LoadMacroMetadata);
+    request.nameOrIdFilter = nameOrIdFilter;
+    request.hasAfter = (after != nullptr);
+    if (request.hasAfter) {
+        request.after = *after;
+    }
+    request.limit = limit;
+    request.sortOrder = sortOrder;
+    // Reads from the beginning replace the whole table, while pages are appended to whatever the table holds.
+    if (!request.hasAfter) {
+        request.supersedeKey = TABLE_READ_KEY;
+    }
+    enqueueRequest(request, ROWS_REQUEST);
+}
+
+
+void MacroMenuController::searchMacroMetadata(const QString &nameOrIdFilter, MacroMetadataSortOrder sortOrder)
+{
+    _searchFilter = nameOrIdFilter;
+    _searchSortOrder = sortOrder;
+
+    // Typing further into a name that all matches are already known for needs no query.
+    QList<MacroMetadata> results;
+    if (refineLastSearch(nameOrIdFilter, sortOrder, results)) {
+        _searchDebounceTimer.stop();
+        _lastSearchFilter = nameOrIdFilter;
+        _lastSearchResults = results;
+        _macroMenu.handleSearchResults(nameOrIdFilter, results);
+        return;
+    }
+    _searchDebounceTimer.start(); // Restarts if already waiting.
+}
+
+
+void MacroMenuController::runSearch()
+{
+    // Supersedes any search that is still queued or running, since its results would be discarded anyway.
+    DBService::Request request = DBService::newRequest(DBService::LoadMacroMetadata);
+    request.supersedeKey = TABLE_READ_KEY;
+    request.nameOrIdFilter = _searchFilter;
+    request.limit = RETRIEVAL_SEG_SIZE;
+    request.sortOrder = _searchSortOrder;
+    enqueueRequest(request, SEARCH_REQUEST);
+}
+
+
+void MacroMenuController::handleRequestProgress(int requestId, int doneCount, int totalCount)
+{
+    if (_pendingRequests.contains(requestId) && _pendingRequests.value(requestId).kind == COPY_REQUEST) {
+        _macroMenu.showProgress("Copying Macros", doneCount, totalCount);
+    }
+}
+
+
+void MacroMenuController::handleRequestFinished(int requestId)
+{
+    // Requests made by other controllers (e.g. editor saves) are left for them.
+    if (!_pendingRequests.contains(requestId)) return;
+
+    PendingRequest pending = _pendingRequests.take(requestId);
+    DBService::Result result;
+    if (!_dbService.takeResult(requestId, result) || result.cancelled) return;
+
+    switch (pending.kind) {
+    case RELOAD_REQUEST:
+        _macroMenu.refresh(result.macroMetadata, pending.sortOrder, pending.selectFirst);
+        break;
+    case SEARCH_REQUEST:
+        // Results read before a later write only go to the view, which drops them if the user has typed on.
+        if (pending.writeGeneration == _writeGeneration) {
+            _lastSearchFilter = pending.nameOrIdFilter;
+            _lastSearchSortOrder = pending.sortOrder;
+            _lastSearchResults = result.macroMetadata;
+        }
+        _macroMenu.handleSearchResults(pending.nameOrIdFilter, result.macroMetadata);
+        break;
+    case ROWS_REQUEST:
+        _macroMenu.handleMacroMetadata(pending.nameOrIdFilter, pending.sortOrder,
+                                       pending.hasAfter ? &pending.after : nullptr, result.macroMetadata);
+        break;
+    case COPY_REQUEST:
+        _macroMenu.clearProgress();
+        _macroMenu.handleCopyResults(result.macroMetadata);
+        break;
+    case RENAME_REQUEST:
+        // A new name may move the Macro within the table or out of the current filter.
+        _macroMenu.reloadTable();
+        break;
+    case REMOVE_REQUEST:
+        // The view dropped the removed rows already, so read as many more to fill in for them.
+        _macroMenu.reloadTable(pending.macroCount);
+        break;
+    }
+}
+
+
+bool MacroMenuController::refineLastSearch(const QString &nameFilter, MacroMetadataSortOrder sortOrder,
+                                           QList<MacroMetadata> &results) const
+{
+    bool isNum;
+    _lastSearchFilter.toInt(&isNum);
+    // The last search must have been a name search that found every match (fewer than a full segment).
+    // The name search index folds the case of non-ASCII letters too, so filters holding any are re-queried.
+    QString lowerFilter = asciiLower(nameFilter);
+    if (_lastSearchFilter == "" || isNum || _lastSearchResults.size() >= RETRIEVAL_SEG_SIZE
+            || sortOrder != _lastSearchSortOrder || !isAscii(nameFilter)
+            || !lowerFilter.contains(asciiLower(_lastSearchFilter))) {
+        return false;
+    }
+    nameFilter.toInt(&isNum);
+    if (isNum) return false;
+
+    results.clear();
+    foreach (const MacroMetadata &macroMeta, _lastSearchResults) {
+        if (asciiLower(macroMeta.name).contains(lowerFilter)) {
+            results.append(macroMeta);
+        }
+    }
+    return true;
 }
 
 
 void MacroMenuController::syncViewWithModel(MacroMetadataSortOrder sortOrder, bool selectFirstRow)
 {
-    // Refresh the view based off of latest Model data!
-    QList<MacroMetadata> macroMetaList = _macroMetaModel.getMacroMetadata("", 0, RETRIEVAL_SEG_SIZE, sortOrder);
-    _macroMenu.refresh(macroMetaList, sortOrder, selectFirstRow);
+    // Refresh the view based off of latest Model data, once it has been read after any queued writes!
+    _lastSearchFilter = "";
+    DBService::Request request = DBService::newRequest(DBService::LoadMacroMetadata);
+    request.supersedeKey = TABLE_READ_KEY;
+    request.limit = RETRIEVAL_SEG_SIZE;
+    request.sortOrder = sortOrder;
+    enqueueRequest(request, RELOAD_REQUEST, selectFirstRow);
+}
+
+
+void MacroMenuController::enqueueRequest(const DBService::Request &request, PendingRequestKind kind, bool selectFirst)
+{
+    PendingRequest pending = { kind, request.nameOrIdFilter, request.sortOrder, selectFirst,
+                               request.hasAfter, request.after, request.macroIds.size(), _writeGeneration };
+    _pendingRequests.insert(_dbService.enqueue(request), pending);
 }
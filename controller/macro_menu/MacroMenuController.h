@@ -6,17 +6,21 @@
 #include "MacroMenuEventListener.h"
 #include "model/MacroMetaModel.h"
 #include "model/MacroEventModel.h"
+#include "model/DBService.h"
 #include "view/macro_menu/MacroMenu.h"
 #include "hotkey/GlobalHotKeyMonitor.h"
 #include "controller/io_logging/IOLoggingController.h"
 #include "controller/macro_activation/MacroActivationController.h"
 #include "controller/macro_add/MacroAddController.h"
 #include "controller/macro_editor/MacroEditorController.h"
+#include <QTimer>
+#include <QHash>
 
 
 /**
  * @brief The MacroMenuController class
  * The macro menu controller class. Primary controller associated with the main macro menu GUI view.
+ * Owns the DB service that the menu's reads and writes (and the editor's saves) run on, so they never block the GUI.
  */
 class MacroMenuController : public Controller, MacroMenuEventListener
 {
@@ -70,45 +74,55 @@ public:
 
     /**
      * @brief copyMacro
-     * Initializes macro copying.
+     * Initializes macro copying. The copies are made in the background, and are delivered to
+     * MacroMenu::handleCopyResults().
      * @param ids
      * A list of IDs of macros to be copied.
-     * @return
-     * A list of the result of the copy operation.
      */
-    QList<MacroMetadata> copyMacros(const QList<int> &ids) override;
+    void copyMacros(const QList<int> &ids) override;
 
     /**
      * @brief requestMacroMetadataWithFilter
-     * Requests Macro metadata with optional filter values.
+     * Requests Macro metadata with optional filter values. The Macro metadata is read in the background after any
+     * queued writes, and is delivered to MacroMenu::handleMacroMetadata().
      * @param nameOrIdFilter (OPTIONAL)
      * The macro id or name to filter by. Default is empty string for no filter.
-     * @param offset (OPTIONAL)
-     * The offset of the start point macro metadata records to be requested. Default is 0 for no offset.
+     * @param after (OPTIONAL)
+     * The last Macro of the previous page, which the requested Macros come after in the sort order. Default is null
+     * to start from the beginning.
      * @param sortOrder (OPTIONAL)
      * The order by which Macro metadata records will be sorted in. Default is sorting by ID number in ascending order.
-     * @return
-     * A list of the Macro metadata corresponding to the request.
      */
-    QList<MacroMetadata> requestMacroMetadataWithFilter(const QString &nameOrIdFilter = "", int offset = 0,
-                                                        MacroMetadataSortOrder sortOrder = ID_ASC) override;
+    void requestMacroMetadataWithFilter(const QString &nameOrIdFilter = "", const MacroMetadata *after = nullptr,
+                                        MacroMetadataSortOrder sortOrder = ID_ASC) override;
 
     /**
      * @brief requestMacroMetadataWithFilter
-     * Requests Macro metadata with optional filter values.
+     * Requests Macro metadata with optional filter values. The Macro metadata is read in the background after any
+     * queued writes, and is delivered to MacroMenu::handleMacroMetadata().
      * @param nameOrIdFilter (OPTIONAL)
      * The macro id or name to filter by. Default is empty string for no filter.
-     * @param offset (OPTIONAL)
-     * The offset of the start point macro metadata records to be requested. Default is 0 for no offset.
+     * @param after (OPTIONAL)
+     * The last Macro of the previous page, which the requested Macros come after in the sort order. Default is null
+     * to start from the beginning.
      * @param limit (OPTIONAL)
      * The limit on the number of macro metadata records to be requested. Default is -1 for no limit (request all).
      * @param sortOrder (OPTIONAL)
      * The order by which Macro metadata records will be sorted in. Default is sorting by ID number in ascending order.
-     * @return
-     * A list of the Macro metadata corresponding to the request.
      */
-    QList<MacroMetadata> requestMacroMetadataWithFilter(const QString &nameOrIdFilter = "", int offset = 0, int limit = -1,
-                                                        MacroMetadataSortOrder sortOrder = ID_ASC) override;
+    void requestMacroMetadataWithFilter(const QString &nameOrIdFilter = "", const MacroMetadata *after = nullptr,
+                                        int limit = -1, MacroMetadataSortOrder sortOrder = ID_ASC) override;
+
+    /**
+     * @brief searchMacroMetadata
+     * Requests a search of the Macro metadata. The search runs in the background shortly after the last of a burst
+     * of requests, and its results are delivered to MacroMenu::handleSearchResults().
+     * @param nameOrIdFilter
+     * The macro id or name to filter by.
+     * @param sortOrder
+     * The order by which Macro metadata records will be sorted in.
+     */
+    void searchMacroMetadata(const QString &nameOrIdFilter, MacroMetadataSortOrder sortOrder) override;
 
 public slots:
 
@@ -143,6 +157,32 @@ private slots:
      */
     void handleHotKey();
 
+    /**
+     * @brief runSearch
+     * Runs the latest requested Macro metadata search, once the requests have stopped coming for a moment.
+     */
+    void runSearch();
+
+    /**
+     * @brief handleRequestProgress
+     * Shows the progress of a running write.
+     * @param requestId
+     * The DB service request ID.
+     * @param doneCount
+     * The number of Macros done so far.
+     * @param totalCount
+     * The total number of Macros.
+     */
+    void handleRequestProgress(int requestId, int doneCount, int totalCount);
+
+    /**
+     * @brief handleRequestFinished
+     * Hands the results of a finished DB service request to the view.
+     * @param requestId
+     * The DB service request ID.
+     */
+    void handleRequestFinished(int requestId);
+
 private:
 
     /**
@@ -152,6 +192,49 @@ private:
      */
     const int RETRIEVAL_SEG_SIZE;
 
+    /**
+     * @brief SEARCH_DEBOUNCE_MS
+     * How long the search requests must stop coming (e.g. the user stops typing) before a search is run.
+     */
+    const int SEARCH_DEBOUNCE_MS;
+
+    /**
+     * @brief TABLE_READ_KEY
+     * The DB service supersede key of the reads that replace the whole selection table (reloads, searches and
+     * sorts), so that only the latest of them is ever run to completion.
+     */
+    const int TABLE_READ_KEY;
+
+    /**
+     * @brief The PendingRequestKind enum
+     * What the result of a pending DB service request is for.
+     */
+    typedef enum PendingRequestKind {
+        RELOAD_REQUEST, SEARCH_REQUEST, ROWS_REQUEST, RENAME_REQUEST, REMOVE_REQUEST, COPY_REQUEST
+    } PendingRequestKind;
+
+    /**
+     * @brief The PendingRequest struct
+     * A DB service request whose result has not been handled yet.
+     */
+    typedef struct PendingRequest {
+        PendingRequestKind kind;
+        QString nameOrIdFilter;
+        MacroMetadataSortOrder sortOrder;
+        bool selectFirst;       // RELOAD_REQUEST
+        bool hasAfter;          // ROWS_REQUEST
+        MacroMetadata after;    // ROWS_REQUEST
+        int macroCount;         // REMOVE_REQUEST
+        int writeGeneration;    // The value of _writeGeneration when the request was made.
+    } PendingRequest;
+
+    /**
+     * @brief _dbService
+     * Runs the database reads and writes off of the GUI thread. Declared before the models and controllers so
+     * that it outlives them.
+     */
+    DBService _dbService;
+
     /**
      * @brief _macroMetaModel
      * A model for the Macro metadata.
@@ -200,6 +283,56 @@ private:
      */
     MacroEditorController _macroEditorController;
 
+    /**
+     * @brief _searchDebounceTimer
+     * Delays searches until the search requests stop coming.
+     */
+    QTimer _searchDebounceTimer;
+
+    /**
+     * @brief _searchFilter
+     * The filter of the latest requested search.
+     */
+    QString _searchFilter;
+
+    /**
+     * @brief _searchSortOrder
+     * The sort order of the latest requested search.
+     */
+    MacroMetadataSortOrder _searchSortOrder;
+
+    /**
+     * @brief _lastSearchFilter
+     * The filter of the last completed search.
+     */
+    QString _lastSearchFilter;
+
+    /**
+     * @brief _lastSearchSortOrder
+     * The sort order of the last completed search.
+     */
+    MacroMetadataSortOrder _lastSearchSortOrder;
+
+    /**
+     * @brief _lastSearchResults
+     * The results of the last completed search. Narrower name searches are answered from these when they hold
+     * every match.
+     */
+    QList<MacroMetadata> _lastSearchResults;
+
+    /**
+     * @brief _pendingRequests
+     * The DB service requests whose results have not been handled yet, by request ID.
+     */
+    QHash<int, PendingRequest> _pendingRequests;
+
+    /**
+     * @brief _writeGeneration
+     * Counts the Macro writes that have been requested. Searches that were requested before a write are not kept
+     * as the last search, since they may be out of date.
+     */
+    int _writeGeneration;
+
 
     /**
      * @brief initListeners
@@ -209,13 +342,40 @@ private:
 
     /**
      * @brief syncViewWithModel
-     * Synchronizes the view with the model data.
+     * Synchronizes the view with the model data, once it has been read in the background.
      * @param sortOrder (OPTIONAL)
      * The order in which to retrieve the Macro Metadata to feed to the view refresh method.
      * @param selectFirst (OPTIONAL)
      * Set true to instruct the view to select the first element if there is one.
      */
     void syncViewWithModel(MacroMetadataSortOrder sortOrder = ID_ASC, bool selectFirst = false);
+
+    /**
+     * @brief enqueueRequest
+     * Queues a DB service request and keeps track of what its result is for.
+     * @param request
+     * The request.
+     * @param kind
+     * What the result of the request is for.
+     * @param selectFirst (OPTIONAL)
+     * For reloads, set true to instruct the view to select the first element if there is one.
+     */
+    void enqueueRequest(const DBService::Request &request, PendingRequestKind kind, bool selectFirst = false);
+
+    /**
+     * @brief refineLastSearch
+     * Answers a name search from the results of the last completed search, if it was a name search whose matches
+     * include all matches of the new one.
+     * @param nameFilter
+     * The name to filter by.
+     * @param sortOrder
+     * The order by which Macro metadata records will be sorted in.
+     * @param results
+     * Set to the search results on success.
+     * @return
+     * true if the search was answered, false if it must be run against the database.
+     */
+    bool refineLastSearch(const QString &nameFilter, MacroMetadataSortOrder sortOrder, QList<MacroMetadata> &results) const;
 };
 
 
@@ -60,45 +60,55 @@ public:
 
     /**
      * @brief copyMacro
-     * Initializes macro copying.
+     * Initializes macro copying. The copies are made in the background, and are delivered to
+     * MacroMenu::handleCopyResults().
      * @param ids
      * A list of IDs of macros to be copied.
-     * @return
-     * A list of the result of the copy operation.
      */
-    virtual QList<MacroMetadata> copyMacros(const QList<int> &ids) = 0;
+    virtual void copyMacros(const QList<int> &ids) = 0;
 
     /**
      * @brief requestMacroMetadataWithFilter
-     * Requests Macro metadata with optional filter values.
+     * Requests Macro metadata with optional filter values. The Macro metadata is read in the background after any
+     * queued writes, and is delivered to MacroMenu::handleMacroMetadata().
      * @param nameOrIdFilter (OPTIONAL)
      * The macro id or name to filter by. Default is empty string for no filter.
-     * @param offset (OPTIONAL)
-     * The offset of the start point macro metadata records to be requested. Default is 0 for no offset.
+     * @param after (OPTIONAL)
+     * The last Macro of the previous page, which the requested Macros come after in the sort order. Default is null
+     * to start from the beginning.
      * @param sortOrder (OPTIONAL)
      * The order by which Macro metadata records will be sorted in. Default is sorting by ID number in ascending order.
-     * @return
-     * A list of the Macro metadata corresponding to the request.
      */
-    virtual QList<MacroMetadata> requestMacroMetadataWithFilter(const QString &nameOrIdFilter = "", int offset = 0,
-                                                                MacroMetadataSortOrder sortOrder = ID_ASC) = 0;
+    virtual void requestMacroMetadataWithFilter(const QString &nameOrIdFilter = "", const MacroMetadata *after = nullptr,
+                                                MacroMetadataSortOrder sortOrder = ID_ASC) = 0;
 
     /**
      * @brief requestMacroMetadataWithFilter
-     * Requests Macro metadata with optional filter values.
+     * Requests Macro metadata with optional filter values. The Macro metadata is read in the background after any
+     * queued writes, and is delivered to MacroMenu::handleMacroMetadata().
      * @param nameOrIdFilter (OPTIONAL)
      * The macro id or name to filter by. Default is empty string for no filter.
-     * @param offset (OPTIONAL)
-     * The offset of the start point macro metadata records to be requested. Default is 0 for no offset.
+     * @param after (OPTIONAL)
+     * The last Macro of the previous page, which the requested Macros come after in the sort order. Default is null
+     * to start from the beginning.
      * @param limit (OPTIONAL)
      * The limit on the number of macro metadata records to be requested. Default is -1 for no limit (request all).
      * @param sortOrder (OPTIONAL)
      * The order by which Macro metadata records will be sorted in. Default is sorting by ID number in ascending order.
-     * @return
-     * A list of the Macro metadata corresponding to the request.
      */
-    virtual QList<MacroMetadata> requestMacroMetadataWithFilter(const QString &nameOrIdFilter = "", int offset = 0, int limit = -1,
-                                                                MacroMetadataSortOrder sortOrder = ID_ASC) = 0;
+    virtual void requestMacroMetadataWithFilter(const QString &nameOrIdFilter = "", const MacroMetadata *after = nullptr,
+                                                int limit = -1, MacroMetadataSortOrder sortOrder = ID_ASC) = 0;
+
+    /**
+     * @brief searchMacroMetadata
+     * Requests a search of the Macro metadata. The search runs in the background shortly after the last of a burst
+     * of requests, and its results are delivered to MacroMenu::handleSearchResults().
+     * @param nameOrIdFilter
+     * The macro id or name to filter by.
+     * @param sortOrder
+     * The order by which Macro metadata records will be sorted in.
+     */
+    virtual void searchMacroMetadata(const QString &nameOrIdFilter, MacroMetadataSortOrder sortOrder) = 0;
 };
 
 
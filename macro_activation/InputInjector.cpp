@@ -0,0 +1,98 @@
+#include "InputInjector.h"
+#include <cstring>
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+#include "InputInjectorWin.h"
+#elif defined(__linux__)
+#include "InputInjectorX11.h"
+#endif
+
+
+const int InputInjector::TEXT_CHUNK_CHARS = 256;
+
+
+void InputInjector::inject(const Input &input)
+{
+    inject(&input, 1);
+}
+
+
+void InputInjector::typeText(const QString &text)
+{
+    int start = 0;
+    while (start < text.size()) {
+        int length = qMin(TEXT_CHUNK_CHARS, text.size() - start);
+        // Keep surrogate pairs together.
+        if (length > 1 && start + length < text.size() && text.at(start + length - 1).isHighSurrogate()) {
+            length--;
+        }
+        typeTextChunk(text.mid(start, length));
+        start += length;
+    }
+}
+
+
+void InputInjector::enterText(const QString &text, int pasteMinChars)
+{
+    if (pasteMinChars > 0 && text.size() >= pasteMinChars) {
+        pasteText(text);
+    }
+    else {
+        typeText(text);
+    }
+}
+
+
+std::unique_ptr<InputInjector> InputInjector::createPlatformInjector()
+{
+    #if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    return std::unique_ptr<InputInjector>(new InputInjectorWin());
+    #elif defined(__linux__)
+    return std::unique_ptr<InputInjector>(new InputInjectorX11());
+    #else
+    return std::unique_ptr<InputInjector>();
+    #endif
+}
+
+
+InputInjector::Input InputInjector::mouseMove(int x, int y)
+{
+    Input input;
+    memset(&input, 0, sizeof(Input));
+    input.type = MouseMove;
+    input.x = x;
+    input.y = y;
+    return input;
+}
+
+
+InputInjector::Input InputInjector::mouseButton(Button button, bool down)
+{
+    Input input;
+    memset(&input, 0, sizeof(Input));
+    input.type = MouseButton;
+    input.button = button;
+    input.down = down;
+    return input;
+}
+
+
+InputInjector::Input InputInjector::mouseWheel(int wheelDelta)
+{
+    Input input;
+    memset(&input, 0, sizeof(Input));
+    input.type = MouseWheel;
+    input.wheelDelta = wheelDelta;
+    return input;
+}
+
+
+InputInjector::Input InputInjector::key(int keyCode, bool down)
+{
+    Input input;
+    memset(&input, 0, sizeof(Input));
+    input.type = Key;
+    input.keyCode = keyCode;
+    input.down = down;
+    return input;
+}
@@ -0,0 +1,168 @@
+#ifndef INPUTINJECTOR_H
+#define INPUTINJECTOR_H
+
+
+#include <QString>
+#include <QPoint>
+#include <memory>
+
+
+/**
+ * @brief The InputInjector class
+ * Platform independent pure virtual base class for injecting synthetic mouse and keyboard input. Inputs are
+ * handed over in batches, so a click or a key stroke with its modifiers reaches the platform in a single call.
+ */
+class InputInjector
+{
+public:
+
+    /**
+     * @brief The InputType enum
+     * The kind of an injected input.
+     */
+    enum InputType
+    {
+        MouseMove,
+        MouseButton,
+        MouseWheel,
+        Key
+    };
+
+    /**
+     * @brief The Button enum
+     * The mouse buttons.
+     */
+    enum Button
+    {
+        Left,
+        Right,
+        Middle
+    };
+
+    /**
+     * @brief The Input struct
+     * A single injected input. Only the members of its type are used.
+     */
+    typedef struct Input
+    {
+        InputType type;
+        int x;              // MouseMove: absolute screen coordinates.
+        int y;
+        Button button;      // MouseButton.
+        bool down;          // MouseButton and Key: press (true) or release (false).
+        int wheelDelta;     // MouseWheel: 120 per notch, positive scrolls up.
+        int keyCode;        // Key: Qt key code, as recorded in MacroKeyboardEvent::keyCode.
+    } Input;
+
+    /**
+     * @brief TEXT_CHUNK_CHARS
+     * The most UTF-16 characters that typeText() hands to the platform in one call. Keeps every call well within
+     * what the platform input queue accepts at once, so no input is dropped.
+     */
+    const static int TEXT_CHUNK_CHARS;
+
+    virtual ~InputInjector() {}
+
+    /**
+     * @brief begin
+     * Prepares for a Macro activation. Platform state that does not change during an activation
+     * (e.g. screen metrics) is read here, once per activation.
+     */
+    virtual void begin() = 0;
+
+    /**
+     * @brief inject
+     * Injects a batch of inputs in order.
+     * @param inputs The inputs.
+     * @param count The number of inputs.
+     */
+    virtual void inject(const Input *inputs, int count) = 0;
+
+    /**
+     * @brief inject
+     * Injects a single input.
+     * @param input The input.
+     */
+    void inject(const Input &input);
+
+    /**
+     * @brief typeText
+     * Types a string of text into the focused window as Unicode characters, independent of the keyboard layout.
+     * The text is handed to the platform in chunks of at most TEXT_CHUNK_CHARS.
+     * @param text The text.
+     */
+    void typeText(const QString &text);
+
+    /**
+     * @brief pasteText
+     * Enters a string of text into the focused window through the clipboard, which is fastest for long text but
+     * replaces the clipboard's content.
+     * @param text The text.
+     */
+    virtual void pasteText(const QString &text) = 0;
+
+    /**
+     * @brief enterText
+     * Enters a string of text into the focused window, typing it unless it is long enough to be pasted.
+     * @param text The text.
+     * @param pasteMinChars Text at least this long is pasted (0 to always type).
+     */
+    void enterText(const QString &text, int pasteMinChars);
+
+    /**
+     * @brief cursorPos
+     * @return The current mouse position in screen coordinates.
+     */
+    virtual QPoint cursorPos() const = 0;
+
+    /**
+     * @brief isKeyToggled
+     * Checks the toggle state of a lock key.
+     * @param keyCode The Qt key code of the lock key (Qt::Key_CapsLock or Qt::Key_NumLock).
+     * @return true if the lock is on.
+     */
+    virtual bool isKeyToggled(int keyCode) const = 0;
+
+    /**
+     * @brief createPlatformInjector
+     * Creates the injector of the platform that the application is built for.
+     * @return The injector, or null if the platform has none.
+     */
+    static std::unique_ptr<InputInjector> createPlatformInjector();
+
+    /**
+     * @brief mouseMove
+     * @return A MouseMove input to absolute screen coordinates x and y.
+     */
+    static Input mouseMove(int x, int y);
+
+    /**
+     * @brief mouseButton
+     * @return A MouseButton press (down) or release input.
+     */
+    static Input mouseButton(Button button, bool down);
+
+    /**
+     * @brief mouseWheel
+     * @return A MouseWheel input.
+     */
+    static Input mouseWheel(int wheelDelta);
+
+    /**
+     * @brief key
+     * @return A Key press (down) or release input of a Qt key code.
+     */
+    static Input key(int keyCode, bool down);
+
+protected:
+
+    /**
+     * @brief typeTextChunk
+     * Types a chunk of text (see typeText()) in a single platform call.
+     * @param chunk The chunk, which never ends in the middle of a surrogate pair.
+     */
+    virtual void typeTextChunk(const QString &chunk) = 0;
+};
+
+
+#endif // INPUTINJECTOR_H
@@ -0,0 +1,218 @@
+#include "InputInjectorWin.h"
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+
+#include <QDebug>
+#include <cstring>
+
+
+InputInjectorWin::InputInjectorWin()
+    : InputInjector(),
+      _screenWidth(0),
+      _screenHeight(0),
+      _batch()
+{}
+
+
+void InputInjectorWin::begin()
+{
+    RECT dims;
+    HWND desktop = GetDesktopWindow();
+    GetClientRect(desktop, &dims);
+    _screenWidth = dims.right;
+    _screenHeight = dims.bottom;
+}
+
+
+void InputInjectorWin::inject(const Input *inputs, int count)
+{
+    if (count <= 0) return;
+    _batch.resize(count);
+    for (int i = 0; i < count; i++) {
+        _batch[i] = toWinInput(inputs[i]);
+    }
+    SendInput(count, _batch.data(), sizeof(INPUT));
+}
+
+
+void InputInjectorWin::pasteText(const QString &text)
+{
+    if(OpenClipboard(NULL)) {
+        EmptyClipboard();
+        size_t size = (text.size() + 1) * sizeof(wchar_t);
+        HGLOBAL clipbuffer = GlobalAlloc(GMEM_MOVEABLE, size);
+        if (clipbuffer != NULL) {
+            wchar_t *buffer = (wchar_t*)GlobalLock(clipbuffer);
+            memcpy(buffer, text.utf16(), size); // Includes the terminating null.
+            GlobalUnlock(clipbuffer);
+            SetClipboardData(CF_UNICODETEXT, clipbuffer);
+        }
+        CloseClipboard();
+    }
+
+    Input inputs[4] = { key(Qt::Key_Control, true),
+                        key(Qt::Key_V, true),
+                        key(Qt::Key_V, false),
+                        key(Qt::Key_Control, false) };
+    inject(inputs, 4);
+}
+
+
+QPoint InputInjectorWin::cursorPos() const
+{
+    POINT curPos;
+    GetCursorPos(&curPos);
+    return QPoint(curPos.x, curPos.y);
+}
+
+
+bool InputInjectorWin::isKeyToggled(int keyCode) const
+{
+    return (GetKeyState(mapQtVkToWinVk(keyCode)) & 0x0001) != 0;
+}
+
+
+void InputInjectorWin::typeTextChunk(const QString &chunk)
+{
+    _batch.resize(0);
+    _batch.reserve(chunk.size() * 2);
+    for (int i = 0; i < chunk.size(); i++) {
+        ushort character = chunk.at(i).unicode();
+        if (character == '\r' && i + 1 < chunk.size() && chunk.at(i + 1) == '\n') continue;
+
+        INPUT winInput;
+        ZeroMemory(&winInput, sizeof(INPUT));
+        winInput.type = INPUT_KEYBOARD;
+        if (character == '\n' || character == '\r' || character == '\t') {
+            winInput.ki.wVk = (character == '\t') ? VK_TAB : VK_RETURN;
+        }
+        else {
+            winInput.ki.dwFlags = KEYEVENTF_UNICODE;
+            winInput.ki.wScan = character;
+        }
+        _batch.append(winInput);
+        winInput.ki.dwFlags |= KEYEVENTF_KEYUP;
+        _batch.append(winInput);
+    }
+
+    UINT sent = SendInput(_batch.size(), _batch.data(), sizeof(INPUT));
+    if (sent != (UINT)_batch.size()) {
+        qDebug() << "Error: SendInput() only took " << sent << " of " << _batch.size() << " text inputs";
+    }
+}
+
+
+INPUT InputInjectorWin::toWinInput(const Input &input) const
+{
+    INPUT winInput;
+    ZeroMemory(&winInput, sizeof(INPUT));
+
+    switch (input.type) {
+    case MouseMove:
+        // Set the absolute mouse position.
+        winInput.type = INPUT_MOUSE;
+        winInput.mi.dwFlags = (MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE);
+        winInput.mi.dx = (int)(65536.0 / _screenWidth * input.x + 1);
+        winInput.mi.dy = (int)(65536.0 / _screenHeight * input.y + 1);
+        break;
+    case MouseButton:
+        winInput.type = INPUT_MOUSE;
+        switch (input.button) {
+        case Left:      winInput.mi.dwFlags = input.down ? MOUSEEVENTF_LEFTDOWN : MOUSEEVENTF_LEFTUP;      break;
+        case Right:     winInput.mi.dwFlags = input.down ? MOUSEEVENTF_RIGHTDOWN : MOUSEEVENTF_RIGHTUP;    break;
+        case Middle:    winInput.mi.dwFlags = input.down ? MOUSEEVENTF_MIDDLEDOWN : MOUSEEVENTF_MIDDLEUP;  break;
+        }
+        break;
+    case MouseWheel:
+        winInput.type = INPUT_MOUSE;
+        winInput.mi.dwFlags = MOUSEEVENTF_WHEEL;
+        winInput.mi.mouseData = input.wheelDelta;
+        break;
+    case Key:
+        winInput.type = INPUT_KEYBOARD;
+        winInput.ki.dwFlags = input.down ? KEYEVENTF_SCANCODE : (KEYEVENTF_SCANCODE | KEYEVENTF_KEYUP);
+        winInput.ki.wScan = MapVirtualKey((UINT)mapQtVkToWinVk(input.keyCode), MAPVK_VK_TO_VSC);
+        break;
+    }
+    return winInput;
+}
+
+
+int InputInjectorWin::mapQtVkToWinVk(int qtVk)
+{
+    switch(qtVk) {
+    case Qt::Key_Tab:                           return VK_TAB;
+    case Qt::Key_Backspace:                     return VK_BACK;
+    case Qt::Key_Escape:                        return VK_ESCAPE;
+    case Qt::Key_Return:                        return VK_RETURN;
+    case Qt::Key_CapsLock:                      return VK_CAPITAL;
+    case Qt::Key_Print:                         return VK_SNAPSHOT;
+    case Qt::Key_Delete:                        return VK_DELETE;
+    case Qt::Key_Home:                          return VK_HOME;
+    case Qt::Key_End:                           return VK_END;
+    case Qt::Key_PageUp:                        return VK_PRIOR;
+    case Qt::Key_PageDown:                      return VK_NEXT;
+    case Qt::Key_NumLock:                       return VK_NUMLOCK;
+    case Qt::Key_Plus | Qt::KeypadModifier:     return VK_ADD;
+    case Qt::Key_Minus | Qt::KeypadModifier:    return VK_SUBTRACT;
+    case Qt::Key_Asterisk | Qt::KeypadModifier: return VK_MULTIPLY;
+    case Qt::Key_Slash | Qt::KeypadModifier:    return VK_DIVIDE;
+    case Qt::Key_Period | Qt::KeypadModifier:   return VK_DECIMAL;
+    case Qt::Key_0 | Qt::KeypadModifier:        return VK_NUMPAD0;
+    case Qt::Key_1 | Qt::KeypadModifier:        return VK_NUMPAD1;
+    case Qt::Key_2 | Qt::KeypadModifier:        return VK_NUMPAD2;
+    case Qt::Key_3 | Qt::KeypadModifier:        return VK_NUMPAD3;
+    case Qt::Key_4 | Qt::KeypadModifier:        return VK_NUMPAD4;
+    case Qt::Key_5 | Qt::KeypadModifier:        return VK_NUMPAD5;
+    case Qt::Key_6 | Qt::KeypadModifier:        return VK_NUMPAD6;
+    case Qt::Key_7 | Qt::KeypadModifier:        return VK_NUMPAD7;
+    case Qt::Key_8 | Qt::KeypadModifier:        return VK_NUMPAD8;
+    case Qt::Key_9 | Qt::KeypadModifier:        return VK_NUMPAD9;
+    case Qt::Key_Up:                            return VK_UP;
+    case Qt::Key_Down:                          return VK_DOWN;
+    case Qt::Key_Left:                          return VK_LEFT;
+    case Qt::Key_Right:                         return VK_RIGHT;
+    case Qt::Key_Comma:                         return VK_OEM_COMMA;
+    case Qt::Key_Period:                        return VK_OEM_PERIOD;
+    case Qt::Key_Minus:                         return VK_OEM_MINUS;
+    case Qt::Key_Equal:                         return VK_OEM_PLUS;
+    case Qt::Key_Semicolon:                     return VK_OEM_1;
+    case Qt::Key_Slash:                         return VK_OEM_2;
+    case Qt::Key_QuoteLeft:                     return VK_OEM_3;
+    case Qt::Key_BraceLeft:                     return VK_OEM_4;
+    case Qt::Key_Backslash:                     return VK_OEM_5;
+    case Qt::Key_BraceRight:                    return VK_OEM_6;
+    case Qt::Key_QuoteDbl:                      return VK_OEM_7;
+    case Qt::Key_F1:                            return VK_F1;
+    case Qt::Key_F2:                            return VK_F2;
+    case Qt::Key_F3:                            return VK_F3;
+    case Qt::Key_F4:                            return VK_F4;
+    case Qt::Key_F5:                            return VK_F5;
+    case Qt::Key_F6:                            return VK_F6;
+    case Qt::Key_F7:                            return VK_F7;
+    case Qt::Key_F8:                            return VK_F8;
+    case Qt::Key_F9:                            return VK_F9;
+    case Qt::Key_F10:                           return VK_F10;
+    case Qt::Key_F11:                           return VK_F11;
+    case Qt::Key_F12:                           return VK_F12;
+    case Qt::Key_F13:                           return VK_F13;
+    case Qt::Key_F14:                           return VK_F14;
+    case Qt::Key_F15:                           return VK_F15;
+    case Qt::Key_F16:                           return VK_F16;
+    case Qt::Key_F17:                           return VK_F17;
+    case Qt::Key_F18:                           return VK_F18;
+    case Qt::Key_F19:                           return VK_F19;
+    case Qt::Key_F20:                           return VK_F20;
+    case Qt::Key_F21:                           return VK_F21;
+    case Qt::Key_F22:                           return VK_F22;
+    case Qt::Key_F23:                           return VK_F23;
+    case Qt::Key_F24:                           return VK_F24;
+    case Qt::Key_Shift:                         return VK_SHIFT;
+    case Qt::Key_Alt:                           return VK_MENU;
+    case Qt::Key_Control:                       return VK_CONTROL;
+    default:                                    return qtVk; // [A, Z] [0, 9].
+    }
+}
+
+
+#endif
@@ -0,0 +1,109 @@
+#ifndef INPUTINJECTORWIN_H
+#define INPUTINJECTORWIN_H
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+
+
+#include "InputInjector.h"
+#include <windows.h>
+#include <QVector>
+#include <qnamespace.h>
+#pragma comment(lib, "user32.lib")
+
+
+/**
+ * @brief The InputInjectorWin class
+ * Injects input on Windows through SendInput(), one call per batch.
+ */
+class InputInjectorWin : public InputInjector
+{
+public:
+
+    InputInjectorWin();
+
+    /**
+     * @brief begin
+     * Reads the screen size that absolute mouse positions are scaled by.
+     */
+    void begin() override;
+
+    /**
+     * @brief inject
+     * Injects a batch of inputs with a single SendInput() call.
+     * @param inputs The inputs.
+     * @param count The number of inputs.
+     */
+    void inject(const Input *inputs, int count) override;
+    using InputInjector::inject;
+
+    /**
+     * @brief pasteText
+     * Puts the text on the clipboard (as Unicode) and pastes it with CTRL+V.
+     * @param text The text.
+     */
+    void pasteText(const QString &text) override;
+
+    /**
+     * @brief cursorPos
+     * @return The current mouse position in screen coordinates.
+     */
+    QPoint cursorPos() const override;
+
+    /**
+     * @brief isKeyToggled
+     * Checks the toggle state of a lock key.
+     * @param keyCode The Qt key code of the lock key.
+     * @return true if the lock is on.
+     */
+    bool isKeyToggled(int keyCode) const override;
+
+protected:
+
+    /**
+     * @brief typeTextChunk
+     * Types a chunk of text as KEYEVENTF_UNICODE key strokes with a single SendInput() call. Line breaks and tabs
+     * are sent as the RETURN and TAB keys, since many applications ignore them as Unicode characters.
+     * @param chunk The chunk.
+     */
+    void typeTextChunk(const QString &chunk) override;
+
+private:
+
+    /**
+     * @brief _screenWidth
+     * The screen width read by begin().
+     */
+    int _screenWidth;
+
+    /**
+     * @brief _screenHeight
+     * The screen height read by begin().
+     */
+    int _screenHeight;
+
+    /**
+     * @brief _batch
+     * The SendInput() buffer, reused between batches.
+     */
+    QVector<INPUT> _batch;
+
+    /**
+     * @brief toWinInput
+     * Converts an input to its SendInput() form.
+     * @param input The input.
+     * @return The SendInput() form.
+     */
+    INPUT toWinInput(const Input &input) const;
+
+    /**
+     * @brief mapQtVkToWinVk
+     * Maps a QT virtual key code to a Windows virtual key code.
+     * @param qtVk The QT virtual key code.
+     * @return The Windows virtual key code.
+     */
+    static int mapQtVkToWinVk(int qtVk);
+};
+
+
+#endif
+#endif // INPUTINJECTORWIN_H
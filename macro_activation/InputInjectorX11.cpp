@@ -0,0 +1,269 @@
+#include "InputInjectorX11.h"
+
+#if defined(__linux__)
+
+#include <qnamespace.h>
+#include <QDebug>
+// Xlib defines macros (e.g. KeyPress, None, Bool) that clash with Qt and Macro Event names, so it comes last.
+#include <X11/Xlib.h>
+#include <X11/XKBlib.h>
+#include <X11/keysym.h>
+#include <X11/extensions/XTest.h>
+
+
+const int InputInjectorX11::MAX_SPARE_KEYCODES = 8;
+
+
+InputInjectorX11::InputInjectorX11()
+    : InputInjector(),
+      _display(nullptr),
+      _spareKeycodes()
+{}
+
+
+InputInjectorX11::~InputInjectorX11()
+{
+    if (_display != nullptr) {
+        XCloseDisplay(_display);
+    }
+}
+
+
+void InputInjectorX11::begin()
+{
+    if (_display == nullptr) {
+        _display = XOpenDisplay(nullptr);
+        if (_display == nullptr) {
+            qDebug() << "Error: Could not open the X display for input injection";
+        }
+        else {
+            _spareKeycodes = findSpareKeycodes();
+        }
+    }
+}
+
+
+void InputInjectorX11::inject(const Input *inputs, int count)
+{
+    if (_display == nullptr) return;
+
+    for (int i = 0; i < count; i++) {
+        const Input &input = inputs[i];
+        switch (input.type) {
+        case MouseMove:
+            XTestFakeMotionEvent(_display, -1, input.x, input.y, CurrentTime);
+            break;
+        case MouseButton:
+            XTestFakeButtonEvent(_display, (input.button == Left) ? 1 : (input.button == Middle) ? 2 : 3,
+                                 input.down, CurrentTime);
+            break;
+        case MouseWheel: {
+            // Every wheel notch is a click of button 4 (up) or 5 (down).
+            unsigned int wheelButton = (input.wheelDelta > 0) ? 4 : 5;
+            for (int notch = qMax(qAbs(input.wheelDelta) / 120, 1); notch > 0; notch--) {
+                XTestFakeButtonEvent(_display, wheelButton, True, CurrentTime);
+                XTestFakeButtonEvent(_display, wheelButton, False, CurrentTime);
+            }
+            break;
+        }
+        case Key:
+            queueKey(mapQtVkToKeysym(input.keyCode), input.down);
+            break;
+        }
+    }
+    XFlush(_display);
+}
+
+
+void InputInjectorX11::pasteText(const QString &text)
+{
+    typeText(text);
+}
+
+
+void InputInjectorX11::typeTextChunk(const QString &chunk)
+{
+    if (_display == nullptr) return;
+
+    // The keysym that each spare keycode is mapped to, and the spare keycode to map next.
+    QList<KeySym> spareKeysyms;
+    for (int i = 0; i < _spareKeycodes.size(); i++) spareKeysyms.append(NoSymbol);
+    int nextSpare = 0;
+    foreach (uint codePoint, chunk.toUcs4()) {
+        // Latin-1 keysyms equal their code points; all others are offset (see keysymdef.h).
+        KeySym keysym = (codePoint < 0x100) ? codePoint : (0x01000000 | codePoint);
+        if (codePoint == '\n') keysym = XK_Return;
+        else if (codePoint == '\t') keysym = XK_Tab;
+
+        // Only the first two levels of the layout can be reached with SHIFT alone.
+        KeyCode keycode = XKeysymToKeycode(_display, keysym);
+        bool shift = false;
+        if (keycode != 0 && XkbKeycodeToKeysym(_display, keycode, 0, 0) != keysym) {
+            shift = (XkbKeycodeToKeysym(_display, keycode, 0, 1) == keysym);
+            if (!shift) keycode = 0;
+        }
+
+        // Anything else is typed by temporarily mapping its keysym to a spare keycode. The spare keycodes are
+        // mapped in turn, so that a keycode is only remapped after all others, long after its key events were sent.
+        if (keycode == 0) {
+            if (_spareKeycodes.isEmpty()) {
+                qDebug() << "Error: No key to type character " << codePoint << " with, and no spare keycode to map it to";
+                continue;
+            }
+            int spare = spareKeysyms.indexOf(keysym);
+            if (spare == -1) {
+                spare = nextSpare;
+                nextSpare = (nextSpare + 1) % _spareKeycodes.size();
+                // The key events sent with the old mapping must be processed before the keycode is remapped.
+                if (spareKeysyms[spare] != NoSymbol) XSync(_display, False);
+                mapSpareKeycode(_spareKeycodes[spare], keysym);
+                spareKeysyms[spare] = keysym;
+            }
+            keycode = _spareKeycodes[spare];
+        }
+
+        if (shift) queueKey(XK_Shift_L, true);
+        XTestFakeKeyEvent(_display, keycode, True, CurrentTime);
+        XTestFakeKeyEvent(_display, keycode, False, CurrentTime);
+        if (shift) queueKey(XK_Shift_L, false);
+    }
+
+    // The key events must also be processed before the spare keycodes are unmapped again.
+    if (spareKeysyms.count(NoSymbol) < spareKeysyms.size()) XSync(_display, False);
+    for (int i = 0; i < spareKeysyms.size(); i++) {
+        if (spareKeysyms[i] != NoSymbol) mapSpareKeycode(_spareKeycodes[i], NoSymbol);
+    }
+    XFlush(_display);
+}
+
+
+QPoint InputInjectorX11::cursorPos() const
+{
+    if (_display == nullptr) return QPoint();
+
+    Window root, child;
+    int rootX = 0, rootY = 0, winX, winY;
+    unsigned int mask;
+    XQueryPointer(_display, DefaultRootWindow(_display), &root, &child, &rootX, &rootY, &winX, &winY, &mask);
+    return QPoint(rootX, rootY);
+}
+
+
+bool InputInjectorX11::isKeyToggled(int keyCode) const
+{
+    if (_display == nullptr) return false;
+
+    unsigned int indicators = 0;
+    XkbGetIndicatorState(_display, XkbUseCoreKbd, &indicators);
+    switch (keyCode) {
+    case Qt::Key_CapsLock:  return (indicators & 0x01) != 0;
+    case Qt::Key_NumLock:   return (indicators & 0x02) != 0;
+    default:                return false;
+    }
+}
+
+
+void InputInjectorX11::queueKey(unsigned long keysym, bool down)
+{
+    KeyCode keycode = XKeysymToKeycode(_display, keysym);
+    if (keycode != 0) {
+        XTestFakeKeyEvent(_display, keycode, down, CurrentTime);
+    }
+}
+
+
+QList<int> InputInjectorX11::findSpareKeycodes() const
+{
+    QList<int> spareKeycodes;
+    int minKeycode = 0,
+        maxKeycode = 0,
+        keysymsPerKeycode = 0;
+    XDisplayKeycodes(_display, &minKeycode, &maxKeycode);
+    KeySym *keysyms = XGetKeyboardMapping(_display, minKeycode, maxKeycode - minKeycode + 1, &keysymsPerKeycode);
+    if (keysyms == nullptr) return spareKeycodes;
+
+    // Unused keycodes are usually at the top of the range.
+    for (int keycode = maxKeycode; keycode >= minKeycode && spareKeycodes.size() < MAX_SPARE_KEYCODES; keycode--) {
+        bool isUnused = true;
+        for (int i = 0; i < keysymsPerKeycode; i++) {
+            isUnused &= (keysyms[(keycode - minKeycode) * keysymsPerKeycode + i] == NoSymbol);
+        }
+        if (isUnused) spareKeycodes.append(keycode);
+    }
+    XFree(keysyms);
+
+    if (spareKeycodes.isEmpty()) {
+        qDebug() << "Warning: No spare keycode, so characters missing from the keyboard layout cannot be typed";
+    }
+    return spareKeycodes;
+}
+
+
+void InputInjectorX11::mapSpareKeycode(int keycode, unsigned long keysym)
+{
+    // On both levels, so that a held SHIFT does not matter. Synced so that the mapping is in place before the
+    // key events that use it are sent.
+    KeySym keysyms[2] = { keysym, keysym };
+    XChangeKeyboardMapping(_display, keycode, 2, keysyms, 1);
+    XSync(_display, False);
+}
+
+
+unsigned long InputInjectorX11::mapQtVkToKeysym(int qtVk)
+{
+    switch(qtVk) {
+    case Qt::Key_Tab:                           return XK_Tab;
+    case Qt::Key_Backspace:                     return XK_BackSpace;
+    case Qt::Key_Escape:                        return XK_Escape;
+    case Qt::Key_Return:                        return XK_Return;
+    case Qt::Key_CapsLock:                      return XK_Caps_Lock;
+    case Qt::Key_Print:                         return XK_Print;
+    case Qt::Key_Delete:                        return XK_Delete;
+    case Qt::Key_Home:                          return XK_Home;
+    case Qt::Key_End:                           return XK_End;
+    case Qt::Key_PageUp:                        return XK_Page_Up;
+    case Qt::Key_PageDown:                      return XK_Page_Down;
+    case Qt::Key_NumLock:                       return XK_Num_Lock;
+    case Qt::Key_Plus | Qt::KeypadModifier:     return XK_KP_Add;
+    case Qt::Key_Minus | Qt::KeypadModifier:    return XK_KP_Subtract;
+    case Qt::Key_Asterisk | Qt::KeypadModifier: return XK_KP_Multiply;
+    case Qt::Key_Slash | Qt::KeypadModifier:    return XK_KP_Divide;
+    case Qt::Key_Period | Qt::KeypadModifier:   return XK_KP_Decimal;
+    case Qt::Key_0 | Qt::KeypadModifier:        return XK_KP_0;
+    case Qt::Key_1 | Qt::KeypadModifier:        return XK_KP_1;
+    case Qt::Key_2 | Qt::KeypadModifier:        return XK_KP_2;
+    case Qt::Key_3 | Qt::KeypadModifier:        return XK_KP_3;
+    case Qt::Key_4 | Qt::KeypadModifier:        return XK_KP_4;
+    case Qt::Key_5 | Qt::KeypadModifier:        return XK_KP_5;
+    case Qt::Key_6 | Qt::KeypadModifier:        return XK_KP_6;
+    case Qt::Key_7 | Qt::KeypadModifier:        return XK_KP_7;
+    case Qt::Key_8 | Qt::KeypadModifier:        return XK_KP_8;
+    case Qt::Key_9 | Qt::KeypadModifier:        return XK_KP_9;
+    case Qt::Key_Up:                            return XK_Up;
+    case Qt::Key_Down:                          return XK_Down;
+    case Qt::Key_Left:                          return XK_Left;
+    case Qt::Key_Right:                         return XK_Right;
+    case Qt::Key_Comma:                         return XK_comma;
+    case Qt::Key_Period:                        return XK_period;
+    case Qt::Key_Minus:                         return XK_minus;
+    case Qt::Key_Equal:                         return XK_equal;
+    case Qt::Key_Semicolon:                     return XK_semicolon;
+    case Qt::Key_Slash:                         return XK_slash;
+    case Qt::Key_QuoteLeft:                     return XK_grave;
+    case Qt::Key_BraceLeft:                     return XK_bracketleft;
+    case Qt::Key_Backslash:                     return XK_backslash;
+    case Qt::Key_BraceRight:                    return XK_bracketright;
+    case Qt::Key_QuoteDbl:                      return XK_apostrophe;
+    case Qt::Key_Space:                         return XK_space;
+    case Qt::Key_Shift:                         return XK_Shift_L;
+    case Qt::Key_Alt:                           return XK_Alt_L;
+    case Qt::Key_Control:                       return XK_Control_L;
+    default:
+        if (qtVk >= Qt::Key_F1 && qtVk <= Qt::Key_F24) return XK_F1 + (qtVk - Qt::Key_F1);
+        if (qtVk >= Qt::Key_A && qtVk <= Qt::Key_Z) return XK_a + (qtVk - Qt::Key_A);
+        return qtVk; // [0, 9] (and other Latin-1 keys) equal their keysyms.
+    }
+}
+
+
+#endif
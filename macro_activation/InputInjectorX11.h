@@ -0,0 +1,127 @@
+#ifndef INPUTINJECTORX11_H
+#define INPUTINJECTORX11_H
+
+#if defined(__linux__)
+
+
+#include "InputInjector.h"
+#include <QList>
+
+typedef struct _XDisplay Display;
+
+
+/**
+ * @brief The InputInjectorX11 class
+ * Injects input on Linux (X11) through the XTest extension. A batch is queued and then flushed to the X server
+ * in a single round trip.
+ */
+class InputInjectorX11 : public InputInjector
+{
+public:
+
+    InputInjectorX11();
+    ~InputInjectorX11();
+
+    /**
+     * @brief begin
+     * Opens the display connection if it is not open yet.
+     */
+    void begin() override;
+
+    /**
+     * @brief inject
+     * Queues a batch of inputs and flushes them to the X server.
+     * @param inputs The inputs.
+     * @param count The number of inputs.
+     */
+    void inject(const Input *inputs, int count) override;
+    using InputInjector::inject;
+
+    /**
+     * @brief pasteText
+     * Types the text (see typeText()). Owning the X selection takes an event loop, which the activation thread
+     * does not run.
+     * @param text The text.
+     */
+    void pasteText(const QString &text) override;
+
+    /**
+     * @brief cursorPos
+     * @return The current mouse position in screen coordinates.
+     */
+    QPoint cursorPos() const override;
+
+    /**
+     * @brief isKeyToggled
+     * Checks the toggle state of a lock key through the keyboard indicators.
+     * @param keyCode The Qt key code of the lock key.
+     * @return true if the lock is on.
+     */
+    bool isKeyToggled(int keyCode) const override;
+
+protected:
+
+    /**
+     * @brief typeTextChunk
+     * Types a chunk of text character by character, with SHIFT where the keyboard layout needs it, and flushes it to
+     * the X server at once. Characters that the layout has no key for, or that need more than SHIFT, are typed by
+     * temporarily mapping them to the spare keycodes in turn. They are only skipped if there are no spare keycodes.
+     * @param chunk The chunk.
+     */
+    void typeTextChunk(const QString &chunk) override;
+
+private:
+
+    /**
+     * @brief MAX_SPARE_KEYCODES
+     * The most spare keycodes that are used to type characters missing from the keyboard layout.
+     */
+    const static int MAX_SPARE_KEYCODES;
+
+    /**
+     * @brief _display
+     * The X display connection, or null if it could not be opened.
+     */
+    Display *_display;
+
+    /**
+     * @brief _spareKeycodes
+     * Keycodes that the keyboard layout does not use (up to MAX_SPARE_KEYCODES).
+     */
+    QList<int> _spareKeycodes;
+
+    /**
+     * @brief queueKey
+     * Queues a key press or release of an X keysym.
+     * @param keysym The keysym.
+     * @param down Press (true) or release (false).
+     */
+    void queueKey(unsigned long keysym, bool down);
+
+    /**
+     * @brief findSpareKeycodes
+     * Finds keycodes that have no keysyms in the keyboard layout.
+     * @return Up to MAX_SPARE_KEYCODES keycodes, none if there are none.
+     */
+    QList<int> findSpareKeycodes() const;
+
+    /**
+     * @brief mapSpareKeycode
+     * Maps a spare keycode to a keysym.
+     * @param keycode The spare keycode.
+     * @param keysym The keysym (NoSymbol to unmap it again).
+     */
+    void mapSpareKeycode(int keycode, unsigned long keysym);
+
+    /**
+     * @brief mapQtVkToKeysym
+     * Maps a QT virtual key code to an X keysym.
+     * @param qtVk The QT virtual key code.
+     * @return The X keysym.
+     */
+    static unsigned long mapQtVkToKeysym(int qtVk);
+};
+
+
+#endif
+#endif // INPUTINJECTORX11_H
@@ -0,0 +1,124 @@
+#include "LoopbackInputInjector.h"
+#include <QMutexLocker>
+#include <qnamespace.h>
+#include <cstring>
+
+
+LoopbackInputInjector::LoopbackInputInjector()
+    : InputInjector(),
+      _clock(),
+      _recordedInputs(),
+      _batches(0),
+      _cursorPos(),
+      _capsLock(false),
+      _numLock(false),
+      _recordMutex()
+{
+    _clock.start();
+}
+
+
+void LoopbackInputInjector::begin()
+{
+    QMutexLocker recordLocker(&_recordMutex);
+    _clock.restart();
+}
+
+
+void LoopbackInputInjector::inject(const Input *inputs, int count)
+{
+    QMutexLocker recordLocker(&_recordMutex);
+    qint64 timestampNs = _clock.nsecsElapsed();
+    for (int i = 0; i < count; i++) {
+        const Input &input = inputs[i];
+        if (input.type == MouseMove) {
+            _cursorPos = QPoint(input.x, input.y);
+        }
+        else if (input.type == Key && input.down) {
+            if (input.keyCode == Qt::Key_CapsLock) _capsLock = !_capsLock;
+            else if (input.keyCode == Qt::Key_NumLock) _numLock = !_numLock;
+        }
+
+        RecordedInput recorded;
+        recorded.timestampNs = timestampNs;
+        recorded.batch = _batches;
+        recorded.input = input;
+        recorded.pasted = false;
+        _recordedInputs.append(recorded);
+    }
+    _batches++;
+}
+
+
+void LoopbackInputInjector::pasteText(const QString &text)
+{
+    QMutexLocker recordLocker(&_recordMutex);
+    _recordedInputs.append(textInput(_clock.nsecsElapsed(), text, true, true));
+    _batches++;
+}
+
+
+void LoopbackInputInjector::typeTextChunk(const QString &chunk)
+{
+    QMutexLocker recordLocker(&_recordMutex);
+    qint64 timestampNs = _clock.nsecsElapsed();
+    _recordedInputs.reserve(_recordedInputs.size() + chunk.size() * 2);
+    for (int i = 0; i < chunk.size(); i++) {
+        // A surrogate pair is a single character.
+        int length = (chunk.at(i).isHighSurrogate() && i + 1 < chunk.size()) ? 2 : 1;
+        QString character = chunk.mid(i, length);
+        _recordedInputs.append(textInput(timestampNs, character, true, false));
+        _recordedInputs.append(textInput(timestampNs, character, false, false));
+        i += length - 1;
+    }
+    _batches++;
+}
+
+
+LoopbackInputInjector::RecordedInput LoopbackInputInjector::textInput(qint64 timestampNs, const QString &text,
+                                                                      bool down, bool pasted) const
+{
+    RecordedInput recorded;
+    recorded.timestampNs = timestampNs;
+    recorded.batch = _batches;
+    memset(&recorded.input, 0, sizeof(Input));
+    recorded.input.type = Key;
+    recorded.input.keyCode = -1;
+    recorded.input.down = down;
+    recorded.text = text;
+    recorded.pasted = pasted;
+    return recorded;
+}
+
+
+QPoint LoopbackInputInjector::cursorPos() const
+{
+    QMutexLocker recordLocker(&_recordMutex);
+    return _cursorPos;
+}
+
+
+bool LoopbackInputInjector::isKeyToggled(int keyCode) const
+{
+    QMutexLocker recordLocker(&_recordMutex);
+    switch (keyCode) {
+    case Qt::Key_CapsLock:  return _capsLock;
+    case Qt::Key_NumLock:   return _numLock;
+    default:                return false;
+    }
+}
+
+
+QVector<LoopbackInputInjector::RecordedInput> LoopbackInputInjector::getRecordedInputs() const
+{
+    QMutexLocker recordLocker(&_recordMutex);
+    return _recordedInputs;
+}
+
+
+void LoopbackInputInjector::clear()
+{
+    QMutexLocker recordLocker(&_recordMutex);
+    _recordedInputs.clear();
+    _batches = 0;
+}
@@ -0,0 +1,151 @@
+#ifndef LOOPBACKINPUTINJECTOR_H
+#define LOOPBACKINPUTINJECTOR_H
+
+
+#include "InputInjector.h"
+#include <QElapsedTimer>
+#include <QVector>
+#include <QMutex>
+
+
+/**
+ * @brief The LoopbackInputInjector class
+ * Injects nothing; records every input with the time it was injected instead. Tracks the cursor position and the
+ * lock key states that the recorded inputs would have led to. Lets Macro replay run headless, e.g. to measure
+ * throughput and timing accuracy on a build machine.
+ */
+class LoopbackInputInjector : public InputInjector
+{
+public:
+
+    /**
+     * @brief The RecordedInput struct
+     * An injected input and when it was injected.
+     */
+    typedef struct RecordedInput
+    {
+        qint64 timestampNs;     // Since the last begin().
+        int batch;              // Index of the inject() call that the input was part of.
+        Input input;
+        QString text;           // Only set for text, which is recorded with an input type of Key and a keyCode of -1:
+                                // a press and a release per typed character, or a single input for pasted text.
+        bool pasted;            // Text that was pasted rather than typed.
+    } RecordedInput;
+
+    LoopbackInputInjector();
+
+    /**
+     * @brief begin
+     * Restarts the timestamps. Recorded inputs are kept until clear().
+     */
+    void begin() override;
+
+    /**
+     * @brief inject
+     * Records a batch of inputs.
+     * @param inputs The inputs.
+     * @param count The number of inputs.
+     */
+    void inject(const Input *inputs, int count) override;
+    using InputInjector::inject;
+
+    /**
+     * @brief pasteText
+     * Records the text as pasted.
+     * @param text The text.
+     */
+    void pasteText(const QString &text) override;
+
+    /**
+     * @brief cursorPos
+     * @return The position of the last recorded mouse move.
+     */
+    QPoint cursorPos() const override;
+
+    /**
+     * @brief isKeyToggled
+     * @return true if the lock key has been pressed an odd number of times.
+     */
+    bool isKeyToggled(int keyCode) const override;
+
+    /**
+     * @brief getRecordedInputs
+     * Gets the recorded inputs. Safe to call from any thread.
+     * @return The recorded inputs in injection order.
+     */
+    QVector<RecordedInput> getRecordedInputs() const;
+
+    /**
+     * @brief clear
+     * Drops the recorded inputs. Safe to call from any thread.
+     */
+    void clear();
+
+protected:
+
+    /**
+     * @brief typeTextChunk
+     * Records a chunk of typed text as one batch holding a press and a release of each character, like the
+     * platform injectors build it.
+     * @param chunk The chunk.
+     */
+    void typeTextChunk(const QString &chunk) override;
+
+private:
+
+    /**
+     * @brief textInput
+     * Builds the recorded input of a text.
+     * @param timestampNs When it was injected.
+     * @param text The text.
+     * @param down Press (true) or release (false).
+     * @param pasted Whether it was pasted rather than typed.
+     * @return The recorded input.
+     */
+    RecordedInput textInput(qint64 timestampNs, const QString &text, bool down, bool pasted) const;
+
+    /**
+     * @brief _clock
+     * The clock that the timestamps are taken from.
+     */
+    QElapsedTimer _clock;
+
+    /**
+     * @brief _recordedInputs
+     * The recorded inputs.
+     */
+    QVector<RecordedInput> _recordedInputs;
+
+    /**
+     * @brief _batches
+     * The number of recorded batches.
+     */
+    int _batches;
+
+    /**
+     * @brief _cursorPos
+     * The position of the last recorded mouse move.
+     */
+    QPoint _cursorPos;
+
+    /**
+     * @brief _capsLock
+     * The simulated CAPS LOCK state.
+     */
+    bool _capsLock;
+
+    /**
+     * @brief _numLock
+     * The simulated NUM LOCK state.
+     */
+    bool _numLock;
+
+    /**
+     * @brief _recordMutex
+     * Guards the recorded inputs, which may be read from another thread.
+     */
+    mutable QMutex _recordMutex;
+};
+
+
+#endif // LOOPBACKINPUTINJECTOR_H
@@ -1,92 +1,158 @@
 #include "MacroActivator.h"
-#include "record_img/RecordImageUtil.h"
-#include <Windows.h>
-#include <QDateTime>
+#include "ReplayTrace.h"
 #include <QThread>
 #include <QtConcurrent/QtConcurrent>
 #include <QDebug>
 
 
-MacroActivator::MacroActivator()
+const MacroActivator::ActivationOptions MacroActivator::DEFAULT_OPTIONS = { MacroActivator::RecordedTime, 1.0, 0, 0,
+                                                                           100, 5000, 1000, QString() };
+const int MacroActivator::PRE_MOVE_DELAY_MS = 350;
+std::atomic<bool> MacroActivator::_activating(false);
+
+
+MacroActivator::MacroActivator(std::unique_ptr<InputInjector> injector)
     : QObject(),
-      _run(false)
+      _run(false),
+      _options(DEFAULT_OPTIONS),
+      _injector(injector ? std::move(injector) : InputInjector::createPlatformInjector()),
+      _scheduler(),
+      _mouseMotion(),
+      _targetResolver()
 {}
 
 
-void MacroActivator::runMacro(const QList<MacroEvent> &macroEvents)
+bool MacroActivator::runMacro(const QSharedPointer<const ReplayPlan> &plan, const ActivationOptions &options)
 {
-    // Be sure to set _run on main thread so we do not create race condition!
-    _run = true;
+    // Be sure to start on main thread so we do not create race condition!
+    if (!startMacro(options)) return false;
     // Must be run in a separate thread so that main event thread can process interrupt hotkey!
-    QtConcurrent::run(this, &MacroActivator::runMacroInOwnThread, macroEvents);
+    QtConcurrent::run(this, &MacroActivator::executeMacro, plan);
+    return true;
+}
+
+
+bool MacroActivator::startMacro(const ActivationOptions &options)
+{
+    if (_activating.exchange(true)) {
+        qDebug() << "Error: A Macro is already running";
+        return false;
+    }
+    _run = true;
+    _options = options;
+    _options.speed = (options.speed > 0) ? options.speed : 1.0;
+    _scheduler.start();
+    return true;
 }
 
 
 void MacroActivator::stopMacro()
 {
     _run = false;
+    _scheduler.stop();
+}
+
+
+void MacroActivator::setMouseMotion(const MouseMotion::Settings &settings)
+{
+    _mouseMotion.setSettings(settings);
 }
 
 
-void MacroActivator::runMacroInOwnThread(QList<MacroEvent> &macroEvents)
+QString MacroActivator::optionsSummary(const ActivationOptions &options)
+{
+    switch (options.pacing) {
+    case ScaledTime:
+        return QString("%1x recorded time, floors %2 ms delay / %3 ms duration")
+                .arg(options.speed).arg(options.minDelayMs).arg(options.minDurationMs);
+    case AsFastAsReady:
+        return QString("as fast as ready (stable for %1 ms, timeout %2 ms), floors %3 ms delay / %4 ms duration")
+                .arg(options.stableMs).arg(options.readyTimeoutMs).arg(options.minDelayMs).arg(options.minDurationMs);
+    default:
+        return "recorded time";
+    }
+}
+
+
+QString MacroActivator::executeMacro(QSharedPointer<const ReplayPlan> plan)
 {
     bool err = false;
     QString errMsg;
-    int i; // Need in this scope to feed to cleanup method!
+    int i = 0; // Need in this scope to feed to cleanup method!
+    const ReplayPlan::Instruction *instructions = plan->instructions();
+
+    if (_injector == nullptr) {
+        stopMacro();
+        _scheduler.finish();
+        errMsg = "Error when attempting to execute Macro: no input injection on this platform";
+        _activating = false;
+        emit macroActivatorStopped(true, errMsg);
+        return errMsg;
+    }
+    _injector->begin();
+    _targetResolver.start(plan);
 
-    // At start of method, always get timestamp to calculate delay & duration.
-    qint64 timeSinceLastEventMs,
-           lastEventTimestampMs = QDateTime::currentMSecsSinceEpoch(),
-           remainingDelayMs,
-           repeatDelayMs;
+    // A run with a trace file is traced even if tracing is off; otherwise the trace holds the latest traced run.
+    bool wasTracing = ReplayTrace::isEnabled();
+    if (!_options.traceFilePath.isEmpty()) ReplayTrace::setEnabled(true);
+    if (ReplayTrace::isEnabled()) ReplayTrace::begin();
 
     try {
-        for (i = 0; i < macroEvents.size() && _run; i++) {
+        for (i = 0; i < plan->size() && _run; i++) {
+            const ReplayPlan::Instruction &instruction = instructions[i];
+            ReplayTrace::Scope eventSpan("Event", i);
+
+            // Search for upcoming targets while this event delays and executes.
+            _targetResolver.lookAhead(i);
+
             // Move mouse before delay for event if location sensitive mouse event.
-            if (   macroEvents.at(i).type == MacroEventType::MouseEvent
-                && macroEvents.at(i).mouseEvent.type != MacroMouseEventType::ScrollUp
-                && macroEvents.at(i).mouseEvent.type != MacroMouseEventType::ScrollDown)
-            {
-                // Just sleep a little before each mouse move!
-                QThread::msleep(350);
-                moveMouseToPos(macroEvents.at(i).mouseEvent.loc.x(), macroEvents.at(i).mouseEvent.loc.y());
-            }
-            // Simply set duration of all key string events to 0 for now... later we will actually type it out.
-            else if (   macroEvents.at(i).type == MacroEventType::KeyboardEvent
-                     && macroEvents.at(i).keyboardEvent.type == MacroKeyboardEventType::KeyString)
-            {
-                macroEvents[i].durationMs = 0;
+            if (instruction.moveToTarget) {
+                // Just sleep a little before each mouse move, or wait until the target is ready when going fast!
+                if (!traceSleep("Pre-move delay", i, paceNs(PRE_MOVE_DELAY_MS, 0))) continue;
+                bool waitsForTarget = (_options.pacing == AsFastAsReady && instruction.targetInd >= 0);
+                if (   waitsForTarget
+                    && !_targetResolver.waitForStableTarget(i, _options.stableMs, _options.readyTimeoutMs, _scheduler))
+                {
+                    continue;
+                }
+                QPoint target(instruction.x, instruction.y);
+                if (instruction.autoCorrect) {
+                    ReplayTrace::Scope resolveSpan("Resolve target", i);
+                    target = _targetResolver.resolve(i);
+                }
+                ReplayTrace::Scope moveSpan("Mouse move", i);
+                if (!_mouseMotion.moveTo(target.x(), target.y(), _scheduler, *_injector)) continue;
+
+                // The pause and move count toward the event's delay on the recorded timeline, but after waiting for
+                // the target to get ready, the delay counts from when the mouse arrives.
+                if (waitsForTarget) _scheduler.resync();
             }
 
             // Display info pertaining to the event that we are activating.
-            printMacroEvent(macroEvents.at(i));
-            emit activatingMacroEvent(macroEvents.at(i));
-
-            // Update elapsed time.
-            timeSinceLastEventMs = QDateTime::currentMSecsSinceEpoch() - lastEventTimestampMs;
-            remainingDelayMs = (macroEvents.at(i).delayMs - timeSinceLastEventMs);
+            emit activatingMacroEvent(plan->eventInfo(instruction.eventInd));
 
-            // Sleep for remaining delay time before the event starts!
-            interruptableSleepMs(remainingDelayMs);
+            // The event starts its delay after the end of the previous event on the timeline.
+            _scheduler.advance(paceNs(instruction.delayMs, _options.minDelayMs));
+            qint64 scheduledNs = traceDeadlineNs();
+            if (!traceDeadlineWait("Delay", i)) continue; // Stopped; the loop exits on _run.
 
-            // Calculate duration time per repeat event. If no repeat, then will be durationMs identity.
-            repeatDelayMs = (macroEvents.at(i).durationMs / (macroEvents.at(i).nRepeats + 1));
-
-            for (int r = 0; r <= macroEvents.at(i).nRepeats && _run; r++) {
+            for (int r = 0; r <= instruction.nRepeats && _run; r++) {
                 // Run either mouse or keyboard event.
-                if (macroEvents.at(i).type == MacroEventType::MouseEvent) {
-                    runMouseEvent(macroEvents.at(i).mouseEvent);
-                }
-                else {
-                    runKeyboardEvent(macroEvents.at(i).keyboardEvent);
+                {
+                    ReplayTrace::Scope injectSpan("Inject", i, scheduledNs);
+                    if (instruction.type == MacroEventType::MouseEvent) {
+                        runMouseEvent(instruction);
+                    }
+                    else {
+                        runKeyboardEvent(*plan, instruction);
+                    }
                 }
 
-                // Sleep between every repeated event to fill in whole duration time of event!
-                interruptableSleepMs(repeatDelayMs);
+                // Space every repeated event out to fill in whole duration time of event!
+                _scheduler.advance(paceNs(instruction.repeatDelayMs, _options.minDurationMs / (instruction.nRepeats + 1)));
+                scheduledNs = traceDeadlineNs();
+                if (!traceDeadlineWait("Repeat delay", i, r < instruction.nRepeats)) break;
             }
-
-            // Set timestamp to time after this event has completed.
-            lastEventTimestampMs = QDateTime::currentMSecsSinceEpoch();
         }
 
         i--; // Bring i back by one so that cleanup gets the last activated event!
@@ -99,488 +165,230 @@ void MacroActivator::runMacroInOwnThread(QList<MacroEvent> &macroEvents)
     }
 
     // Be sure to do Macro cleanup in case some key or mouse state is left behind!
-    cleanupMacro(macroEvents, i);
+    cleanupMacro(*plan, i);
     stopMacro();
-    emit macroActivatorStopped(err, errMsg);
-}
-
-
-void MacroActivator::runMouseEvent(const MacroMouseEvent &mEvent) const
-{
-    switch(mEvent.type) {
-    case LeftPress:     leftPress();            break;
-    case LeftRelease:   leftRelease();          break;
-    case LeftClick:     leftPress();
-                        leftRelease();          break;
-    case DoubleClick:   leftPress();
-                        leftRelease();
-                        QThread::msleep(50);
-                        leftPress();
-                        leftRelease();          break;
-    case RightPress:    rightPress();           break;
-    case RightRelease:  rightRelease();         break;
-    case RightClick:    rightPress();
-                        rightRelease();         break;
-    case MiddlePress:   middlePress();          break;
-    case MiddleRelease: middleRelease();        break;
-    case MiddleClick:   middlePress();
-                        middleRelease();        break;
-    case ScrollUp:      scrollUp();             break;
-    case ScrollDown:    scrollDown();           break;
-    default:
-        qDebug() << "Error: incorrect Mouse Event Type: " << mEvent.type;
-        exit(1);
-    }
-}
-
-
-void MacroActivator::runKeyboardEvent(const MacroKeyboardEvent &kEvent) const
-{
-    switch (kEvent.type) {
-    case KeyPress:      keyPress(kEvent);               break;
-    case KeyRelease:    keyRelease(kEvent);             break;
-    case KeyType:       keyPress(kEvent);
-                        keyRelease(kEvent);             break;
-    case KeyString:     keyString(kEvent.keyString);    break;
-    default:
-        qDebug() << "Error: incorrect Keyboard Event Type: " << kEvent.type;
-        exit(1);
-    }
-}
-
-
-void MacroActivator::moveMouseToPos(int x, int y) const
-{
-    const float RATE = 2.0;
-    POINT curPos;
-    double dx,
-           dy,
-           dt,
-           propX,
-           propY;
-
-    do {
-        GetCursorPos(&curPos);
-
-        // X and Y distance remaining.
-        dx = x - curPos.x;
-        dy = y - curPos.y;
-        // Total distance remaining.
-        dt = floor(sqrt(pow(dx, 2) + pow(dy, 2)));
-
-        // If remaining distance is greater than 10, then move normally.
-        if (dt > 10) {
-            // Proportions to move in x and y directions.
-            propX = dx / dt;
-            propY = dy / dt;
-
-            qDebug() << "Total dist remaining: " << dt;
-            qDebug() << "X: " << curPos.x << " + " << ceil(RATE * propX);
-            qDebug() << "Y: " << curPos.y << " + " << ceil(RATE * propY);
-
-            // Update current mouse position and set.
-            curPos.x += ceil(RATE * propX);
-            curPos.y += ceil(RATE * propY);
-
-            qDebug() << "New X position: " << curPos.x;
-            qDebug() << "New Y position: " << curPos.y;
-
-            setMousePos(curPos.x, curPos.y);
+    _targetResolver.stop();
+    _scheduler.finish();
+    qDebug() << "Macro pacing: " << optionsSummary(_options);
+    qDebug() << "Macro Event lateness: " << ReplayScheduler::statsSummary(_scheduler.stats());
+    qDebug() << "Macro target resolution: " << TargetResolver::statsSummary(_targetResolver.stats());
+    if (!_options.traceFilePath.isEmpty()) {
+        ReplayTrace::setEnabled(wasTracing);
+        if (ReplayTrace::exportChromeTrace(_options.traceFilePath)) {
+            qDebug() << "Macro trace: " << ReplayTrace::spans().size() << " spans (" << ReplayTrace::droppedCount()
+                     << " dropped) written to " << _options.traceFilePath;
         }
-        // Else, move right to destination if close enough...
         else {
-            curPos.x = x;
-            curPos.y = y;
-            setMousePos(curPos.x, curPos.y);
+            qDebug() << "Error: could not write Macro trace to " << _options.traceFilePath;
         }
     }
-    while ((curPos.x != x || curPos.y != y) && _run);
-}
-
-
-void MacroActivator::setMousePos(int x, int y) const
-{
-    // Get screen dimensions.
-    RECT dims;
-    HWND desktop = GetDesktopWindow();
-    GetClientRect(desktop, &dims);
-
-    // Set the absolute mouse position.
-    INPUT input;
-    ZeroMemory(&input, sizeof(INPUT));
-    input.type = INPUT_MOUSE;
-    input.mi.dwFlags = (MOUSEEVENTF_MOVE | MOUSEEVENTF_ABSOLUTE);
-    input.mi.dx = (int)(65536.0 / dims.right * x + 1);
-    input.mi.dy = (int)(65536.0 / dims.bottom * y + 1);
-    SendInput(1, &input, sizeof(INPUT));
-}
-
-
-void MacroActivator::leftPress() const
-{
-    INPUT input;
-    ZeroMemory(&input, sizeof(INPUT));
-    input.type = INPUT_MOUSE;
-    input.mi.dwFlags = MOUSEEVENTF_LEFTDOWN;
-    SendInput(1, &input, sizeof(INPUT));
+    _activating = false;
+    emit macroActivatorStopped(err, errMsg);
+    return errMsg;
 }
 
 
-void MacroActivator::leftRelease() const
+qint64 MacroActivator::paceNs(int recordedMs, int minMs) const
 {
-    INPUT input;
-    ZeroMemory(&input, sizeof(INPUT));
-    input.type = INPUT_MOUSE;
-    input.mi.dwFlags = MOUSEEVENTF_LEFTUP;
-    SendInput(1, &input, sizeof(INPUT));
+    qint64 recordedNs = (qint64)recordedMs * 1000000;
+    qint64 minNs = qMin((qint64)minMs * 1000000, recordedNs);
+    switch (_options.pacing) {
+    case ScaledTime:    return qMax((qint64)(recordedNs / _options.speed), minNs);
+    case AsFastAsReady: return minNs;
+    default:            return recordedNs;
+    }
 }
 
 
-void MacroActivator::rightPress() const
+qint64 MacroActivator::traceDeadlineNs() const
 {
-    INPUT input;
-    ZeroMemory(&input, sizeof(INPUT));
-    input.type = INPUT_MOUSE;
-    input.mi.dwFlags = MOUSEEVENTF_RIGHTDOWN;
-    SendInput(1, &input, sizeof(INPUT));
+    return ReplayTrace::isEnabled() ? ReplayTrace::nowNs() + _scheduler.untilDeadlineNs() : -1;
 }
 
 
-void MacroActivator::rightRelease() const
+bool MacroActivator::traceDeadlineWait(const char *name, int instructionInd, bool record)
 {
-    INPUT input;
-    ZeroMemory(&input, sizeof(INPUT));
-    input.type = INPUT_MOUSE;
-    input.mi.dwFlags = MOUSEEVENTF_RIGHTUP;
-    SendInput(1, &input, sizeof(INPUT));
+    ReplayTrace::Scope waitSpan(name, instructionInd);
+    return _scheduler.waitForDeadline(record);
 }
 
 
-void MacroActivator::middlePress() const
+bool MacroActivator::traceSleep(const char *name, int instructionInd, qint64 ns)
 {
-    INPUT input;
-    ZeroMemory(&input, sizeof(INPUT));
-    input.type = INPUT_MOUSE;
-    input.mi.dwFlags = MOUSEEVENTF_MIDDLEDOWN;
-    SendInput(1, &input, sizeof(INPUT));
+    ReplayTrace::Scope sleepSpan(name, instructionInd);
+    return _scheduler.sleepFor(ns);
 }
 
 
-void MacroActivator::middleRelease() const
+void MacroActivator::runMouseEvent(const ReplayPlan::Instruction &instruction) const
 {
-    INPUT input;
-    ZeroMemory(&input, sizeof(INPUT));
-    input.type = INPUT_MOUSE;
-    input.mi.dwFlags = MOUSEEVENTF_MIDDLEUP;
-    SendInput(1, &input, sizeof(INPUT));
+    switch(instruction.action) {
+    case LeftPress:     _injector->inject(InputInjector::mouseButton(InputInjector::Left, true));      break;
+    case LeftRelease:   _injector->inject(InputInjector::mouseButton(InputInjector::Left, false));     break;
+    case LeftClick:     click(InputInjector::Left);                                                     break;
+    case DoubleClick:   click(InputInjector::Left);
+                        QThread::msleep(50);
+                        click(InputInjector::Left);                                                     break;
+    case RightPress:    _injector->inject(InputInjector::mouseButton(InputInjector::Right, true));     break;
+    case RightRelease:  _injector->inject(InputInjector::mouseButton(InputInjector::Right, false));    break;
+    case RightClick:    click(InputInjector::Right);                                                    break;
+    case MiddlePress:   _injector->inject(InputInjector::mouseButton(InputInjector::Middle, true));    break;
+    case MiddleRelease: _injector->inject(InputInjector::mouseButton(InputInjector::Middle, false));   break;
+    case MiddleClick:   click(InputInjector::Middle);                                                   break;
+    case ScrollUp:      _injector->inject(InputInjector::mouseWheel(120));                              break;
+    case ScrollDown:    _injector->inject(InputInjector::mouseWheel(-120));                             break;
+    default:
+        qDebug() << "Error: incorrect Mouse Event Type: " << instruction.action;
+        exit(1);
+    }
 }
 
 
-void MacroActivator::scrollUp() const
+void MacroActivator::runKeyboardEvent(const ReplayPlan &plan, const ReplayPlan::Instruction &instruction) const
 {
-    INPUT input;
-    ZeroMemory(&input, sizeof(INPUT));
-    input.type = INPUT_MOUSE;
-    input.mi.dwFlags = MOUSEEVENTF_WHEEL;
-    input.mi.mouseData = WHEEL_DELTA;
-    SendInput(1, &input, sizeof(INPUT));
+    switch (instruction.action) {
+    case KeyPress:      keyStroke(instruction.keyStroke, true, false);                      break;
+    case KeyRelease:    keyStroke(instruction.keyStroke, false, true);                      break;
+    case KeyType:       keyStroke(instruction.keyStroke, true, true);                       break;
+    case KeyString:
+        _injector->enterText(plan.keyString(instruction.keyStringInd), _options.pasteMinChars);
+        break;
+    default:
+        qDebug() << "Error: incorrect Keyboard Event Type: " << instruction.action;
+        exit(1);
+    }
 }
 
 
-void MacroActivator::scrollDown() const
+void MacroActivator::click(InputInjector::Button button) const
 {
-    INPUT input;
-    ZeroMemory(&input, sizeof(INPUT));
-    input.type = INPUT_MOUSE;
-    input.mi.dwFlags = MOUSEEVENTF_WHEEL;
-    input.mi.mouseData = -WHEEL_DELTA;
-    SendInput(1, &input, sizeof(INPUT));
+    InputInjector::Input inputs[2] = { InputInjector::mouseButton(button, true),
+                                       InputInjector::mouseButton(button, false) };
+    _injector->inject(inputs, 2);
 }
 
 
-void MacroActivator::keyString(const QString &qText) const
+void MacroActivator::keyStroke(const ReplayPlan::KeyStroke &keyStroke, bool press, bool release) const
 {
-    std::string text(qText.toLocal8Bit().constData());
-    if(OpenClipboard(NULL)) {
-        HGLOBAL clipbuffer;
-        char* buffer;
-        EmptyClipboard();
-        clipbuffer = GlobalAlloc(GMEM_DDESHARE, text.length() + 1);
-        buffer = (char*)GlobalLock(clipbuffer);
-        strcpy_s(buffer, text.length() + 1, text.c_str());
-        GlobalUnlock(clipbuffer);
-        SetClipboardData(CF_TEXT,clipbuffer);
-        CloseClipboard();
+    InputBatch batch;
+    applyKeyMods(keyStroke, batch);
+    if (press) {
+        batch.append(InputInjector::key(keyStroke.keyCode, true));
     }
-    INPUT input[4];
-    for(int i(0) ; i < 4 ; i++) {
-        ZeroMemory(&input[i], sizeof(INPUT));
-        input[i].type = INPUT_KEYBOARD;
+    if (release) {
+        batch.append(InputInjector::key(keyStroke.keyCode, false));
     }
-    input[0].ki.dwFlags = KEYEVENTF_SCANCODE;
-    input[0].ki.wScan = MapVirtualKey(VK_CONTROL, MAPVK_VK_TO_VSC);
-    input[1].ki.dwFlags = KEYEVENTF_SCANCODE;
-    input[1].ki.wScan = MapVirtualKey(0x56, MAPVK_VK_TO_VSC);; // 0x2F == 'V'
-    input[2].ki.dwFlags = (KEYEVENTF_SCANCODE | KEYEVENTF_KEYUP);
-    input[2].ki.wScan = MapVirtualKey(VK_CONTROL, MAPVK_VK_TO_VSC);
-    input[3].ki.dwFlags = (KEYEVENTF_SCANCODE | KEYEVENTF_KEYUP);
-    input[3].ki.wScan = MapVirtualKey(0x56, MAPVK_VK_TO_VSC);;
-    SendInput(4, &input[0], sizeof(INPUT));
-}
-
+    removeKeyMods(keyStroke, batch);
 
-void MacroActivator::keyPress(const MacroKeyboardEvent &kEvent) const
-{
-    int winKeyCode = mapQtVkToWinVk(kEvent.keyCode);
-    int scanCode = MapVirtualKey((UINT)winKeyCode, MAPVK_VK_TO_VSC);
-
-    applyKeyMods(kEvent);
-
-    INPUT input;
-    ZeroMemory(&input, sizeof(INPUT));
-    input.type = INPUT_KEYBOARD;
-    input.ki.dwFlags = KEYEVENTF_SCANCODE;
-    input.ki.wScan = scanCode;
-    SendInput(1, &input, sizeof(INPUT));
-
-    removeKeyMods(kEvent);
+    // The whole stroke goes out in one call, so no real input can slip in between the mods and the key.
+    _injector->inject(batch.constData(), batch.size());
 }
 
 
-void MacroActivator::keyRelease(const MacroKeyboardEvent &kEvent) const
+void MacroActivator::applyKeyMods(const ReplayPlan::KeyStroke &keyStroke, InputBatch &batch) const
 {
-    int winKeyCode = mapQtVkToWinVk(kEvent.keyCode);
-    int scanCode = MapVirtualKey((UINT)winKeyCode, MAPVK_VK_TO_VSC);
-
-    applyKeyMods(kEvent);
+    bool capsLockOn = _injector->isKeyToggled(Qt::Key_CapsLock);
+    bool numLockOn = _injector->isKeyToggled(Qt::Key_NumLock);
 
-    INPUT input;
-    ZeroMemory(&input, sizeof(INPUT));
-    input.type = INPUT_KEYBOARD;
-    input.ki.dwFlags = (KEYEVENTF_SCANCODE | KEYEVENTF_KEYUP);
-    input.ki.wScan = scanCode;
-    SendInput(1, &input, sizeof(INPUT));
-
-    removeKeyMods(kEvent);
-}
-
-
-int MacroActivator::mapQtVkToWinVk(int qtVk) const
-{
-    switch(qtVk) {
-    case Qt::Key_Tab:                           return VK_TAB;
-    case Qt::Key_Backspace:                     return VK_BACK;
-    case Qt::Key_Escape:                        return VK_ESCAPE;
-    case Qt::Key_Return:                        return VK_RETURN;
-    case Qt::Key_CapsLock:                      return VK_CAPITAL;
-    case Qt::Key_Print:                         return VK_SNAPSHOT;
-    case Qt::Key_Delete:                        return VK_DELETE;
-    case Qt::Key_Home:                          return VK_HOME;
-    case Qt::Key_End:                           return VK_END;
-    case Qt::Key_PageUp:                        return VK_PRIOR;
-    case Qt::Key_PageDown:                      return VK_NEXT;
-    case Qt::Key_NumLock:                       return VK_NUMLOCK;
-    case Qt::Key_Plus | Qt::KeypadModifier:     return VK_ADD;
-    case Qt::Key_Minus | Qt::KeypadModifier:    return VK_SUBTRACT;
-    case Qt::Key_Asterisk | Qt::KeypadModifier: return VK_MULTIPLY;
-    case Qt::Key_Slash | Qt::KeypadModifier:    return VK_DIVIDE;
-    case Qt::Key_Period | Qt::KeypadModifier:   return VK_DECIMAL;
-    case Qt::Key_0 | Qt::KeypadModifier:        return VK_NUMPAD0;
-    case Qt::Key_1 | Qt::KeypadModifier:        return VK_NUMPAD1;
-    case Qt::Key_2 | Qt::KeypadModifier:        return VK_NUMPAD2;
-    case Qt::Key_3 | Qt::KeypadModifier:        return VK_NUMPAD3;
-    case Qt::Key_4 | Qt::KeypadModifier:        return VK_NUMPAD4;
-    case Qt::Key_5 | Qt::KeypadModifier:        return VK_NUMPAD5;
-    case Qt::Key_6 | Qt::KeypadModifier:        return VK_NUMPAD6;
-    case Qt::Key_7 | Qt::KeypadModifier:        return VK_NUMPAD7;
-    case Qt::Key_8 | Qt::KeypadModifier:        return VK_NUMPAD8;
-    case Qt::Key_9 | Qt::KeypadModifier:        return VK_NUMPAD9;
-    case Qt::Key_Up:                            return VK_UP;
-    case Qt::Key_Down:                          return VK_DOWN;
-    case Qt::Key_Left:                          return VK_LEFT;
-    case Qt::Key_Right:                         return VK_RIGHT;
-    case Qt::Key_Comma:                         return VK_OEM_COMMA;
-    case Qt::Key_Period:                        return VK_OEM_PERIOD;
-    case Qt::Key_Minus:                         return VK_OEM_MINUS;
-    case Qt::Key_Equal:                         return VK_OEM_PLUS;
-    case Qt::Key_Semicolon:                     return VK_OEM_1;
-    case Qt::Key_Slash:                         return VK_OEM_2;
-    case Qt::Key_QuoteLeft:                     return VK_OEM_3;
-    case Qt::Key_BraceLeft:                     return VK_OEM_4;
-    case Qt::Key_Backslash:                     return VK_OEM_5;
-    case Qt::Key_BraceRight:                    return VK_OEM_6;
-    case Qt::Key_QuoteDbl:                      return VK_OEM_7;
-    case Qt::Key_F1:                            return VK_F1;
-    case Qt::Key_F2:                            return VK_F2;
-    case Qt::Key_F3:                            return VK_F3;
-    case Qt::Key_F4:                            return VK_F4;
-    case Qt::Key_F5:                            return VK_F5;
-    case Qt::Key_F6:                            return VK_F6;
-    case Qt::Key_F7:                            return VK_F7;
-    case Qt::Key_F8:                            return VK_F8;
-    case Qt::Key_F9:                            return VK_F9;
-    case Qt::Key_F10:                           return VK_F10;
-    case Qt::Key_F11:                           return VK_F11;
-    case Qt::Key_F12:                           return VK_F12;
-    case Qt::Key_F13:                           return VK_F13;
-    case Qt::Key_F14:                           return VK_F14;
-    case Qt::Key_F15:                           return VK_F15;
-    case Qt::Key_F16:                           return VK_F16;
-    case Qt::Key_F17:                           return VK_F17;
-    case Qt::Key_F18:                           return VK_F18;
-    case Qt::Key_F19:                           return VK_F19;
-    case Qt::Key_F20:                           return VK_F20;
-    case Qt::Key_F21:                           return VK_F21;
-    case Qt::Key_F22:                           return VK_F22;
-    case Qt::Key_F23:                           return VK_F23;
-    case Qt::Key_F24:                           return VK_F24;
-    case Qt::Key_Shift:                         return VK_SHIFT;
-    case Qt::Key_Alt:                           return VK_MENU;
-    case Qt::Key_Control:                       return VK_CONTROL;
-    default:                                    return qtVk; // [A, Z] [0, 9].
-    }
-}
-
-
-void MacroActivator::applyKeyMods(const MacroKeyboardEvent &kEvent) const
-{
-    INPUT input;
-    ZeroMemory(&input, sizeof(INPUT));
-    input.type = INPUT_KEYBOARD;
-
-    bool capsLockNeedsToTurnOn =   kEvent.capsLock
-                                && (GetKeyState(VK_CAPITAL) & 0x0001) == 0;
-
-    bool capsLockNeedsToTurnOff =   !kEvent.capsLock
-                                 && (GetKeyState(VK_CAPITAL) & 0x0001) != 0;
-
-    bool numLockNeedsToTurnOn =    kEvent.numLock
-                                 && (GetKeyState(VK_NUMLOCK) & 0x0001) == 0
-                                 && !isKeyCodeAssocWithNumpadOff(kEvent.keyCode);
-
-    bool numLockNeedsToTurnOff =    (!kEvent.numLock || isKeyCodeAssocWithNumpadOff(kEvent.keyCode))
-                                 && (GetKeyState(VK_NUMLOCK) & 0x0001) != 0;
+    bool capsLockNeedsToTurnOn = keyStroke.capsLock && !capsLockOn;
+    bool capsLockNeedsToTurnOff = !keyStroke.capsLock && capsLockOn;
+    bool numLockNeedsToTurnOn = keyStroke.numLock && !numLockOn && !keyStroke.numpadOff;
+    bool numLockNeedsToTurnOff = (!keyStroke.numLock || keyStroke.numpadOff) && numLockOn;
 
     // Should we toggle CAPS LOCK?
     if (   capsLockNeedsToTurnOn
         || capsLockNeedsToTurnOff)
     {
-        input.ki.dwFlags = KEYEVENTF_SCANCODE;
-        input.ki.wScan = MapVirtualKey((UINT)VK_CAPITAL, MAPVK_VK_TO_VSC);
-        SendInput(1, &input, sizeof(INPUT));
-        input.ki.dwFlags = (KEYEVENTF_SCANCODE | KEYEVENTF_KEYUP);
-        SendInput(1, &input, sizeof(INPUT));
+        appendKeyToggle(Qt::Key_CapsLock, batch);
     }
 
     // Should we toggle NUM LOCK?
     if (   numLockNeedsToTurnOn
         || numLockNeedsToTurnOff)
     {
-        input.ki.dwFlags = KEYEVENTF_SCANCODE;
-        input.ki.wScan = MapVirtualKey((UINT)VK_NUMLOCK, MAPVK_VK_TO_VSC);
-        SendInput(1, &input, sizeof(INPUT));
-        input.ki.dwFlags = (KEYEVENTF_SCANCODE | KEYEVENTF_KEYUP);
-        SendInput(1, &input, sizeof(INPUT));
+        appendKeyToggle(Qt::Key_NumLock, batch);
     }
 
-    input.ki.dwFlags = KEYEVENTF_SCANCODE;
-
     // Do we have Shift, Alt, or Control in mod1?
-    if (kEvent.mod1 != -1) {
-        input.ki.wScan = MapVirtualKey((UINT)mapQtVkToWinVk(kEvent.mod1), MAPVK_VK_TO_VSC);
-        SendInput(1, &input, sizeof(INPUT));
+    if (keyStroke.mod1 != -1) {
+        batch.append(InputInjector::key(keyStroke.mod1, true));
     }
 
     // Do we have Shift, Alt, or Control in mod2?
-    if (kEvent.mod2 != -1) {
-        input.ki.wScan = MapVirtualKey((UINT)mapQtVkToWinVk(kEvent.mod2), MAPVK_VK_TO_VSC);
-        SendInput(1, &input, sizeof(INPUT));
+    if (keyStroke.mod2 != -1) {
+        batch.append(InputInjector::key(keyStroke.mod2, true));
     }
 }
 
 
-void MacroActivator::removeKeyMods(const MacroKeyboardEvent &kEvent) const
+void MacroActivator::removeKeyMods(const ReplayPlan::KeyStroke &keyStroke, InputBatch &batch) const
 {
-    INPUT input;
-    ZeroMemory(&input, sizeof(INPUT));
-    input.type = INPUT_KEYBOARD;
-
     // Do we need to turn CAPS LOCK off?
-    if (kEvent.capsLock) {
-        input.ki.dwFlags = KEYEVENTF_SCANCODE;
-        input.ki.wScan = MapVirtualKey((UINT)VK_CAPITAL, MAPVK_VK_TO_VSC);
-        SendInput(1, &input, sizeof(INPUT));
-        input.ki.dwFlags = (KEYEVENTF_SCANCODE | KEYEVENTF_KEYUP);
-        SendInput(1, &input, sizeof(INPUT));
+    if (keyStroke.capsLock) {
+        appendKeyToggle(Qt::Key_CapsLock, batch);
     }
 
     // No need to really clean up NUM LOCK...
 
-    input.ki.dwFlags = (KEYEVENTF_SCANCODE | KEYEVENTF_KEYUP);
-
     // Do we need to release mod1 if we have one?
-    if (kEvent.mod1 != -1) {
-        input.ki.wScan = MapVirtualKey((UINT)mapQtVkToWinVk(kEvent.mod1), MAPVK_VK_TO_VSC);
-        SendInput(1, &input, sizeof(INPUT));
+    if (keyStroke.mod1 != -1) {
+        batch.append(InputInjector::key(keyStroke.mod1, false));
     }
 
     // Do we need to release mod2 if we have one?
-    if (kEvent.mod2 != -1) {
-        input.ki.wScan = MapVirtualKey((UINT)mapQtVkToWinVk(kEvent.mod2), MAPVK_VK_TO_VSC);
-        SendInput(1, &input, sizeof(INPUT));
+    if (keyStroke.mod2 != -1) {
+        batch.append(InputInjector::key(keyStroke.mod2, false));
     }
 }
 
 
-void MacroActivator::cleanupMacro(const QList<MacroEvent> &macroEvents, int lastEventInd) const
+void MacroActivator::appendKeyToggle(int keyCode, InputBatch &batch)
+{
+    batch.append(InputInjector::key(keyCode, true));
+    batch.append(InputInjector::key(keyCode, false));
+}
+
+
+void MacroActivator::cleanupMacro(const ReplayPlan &plan, int lastInstructionInd) const
 {
     // We met a hard stop either by exception or user kill hotkey.
-    if (!_run) {
-        qDebug() << "Cleaning up at index: " << lastEventInd;
-        const MacroEvent &lastExecEvent = macroEvents.at(lastEventInd);
+    if (!_run && lastInstructionInd >= 0) {
+        qDebug() << "Cleaning up at index: " << lastInstructionInd;
+        const ReplayPlan::Instruction &lastExecInstruction = plan.instructions()[lastInstructionInd];
 
         // If mouse event that could leave state behind, we must attempt to erase that state!
-        if (   lastExecEvent.type == MacroEventType::MouseEvent
-            && lastExecEvent.mouseEvent.type != MacroMouseEventType::ScrollUp
-            && lastExecEvent.mouseEvent.type != MacroMouseEventType::ScrollDown)
+        if (   lastExecInstruction.type == MacroEventType::MouseEvent
+            && lastExecInstruction.action != MacroMouseEventType::ScrollUp
+            && lastExecInstruction.action != MacroMouseEventType::ScrollDown)
         {
             // Set mouse event to be run to erase any remaining state with a specific button release.
-            MacroMouseEvent mEvent = lastExecEvent.mouseEvent;
-            switch (mEvent.type) {
+            ReplayPlan::Instruction releaseInstruction = lastExecInstruction;
+            switch (releaseInstruction.action) {
             case LeftPress:
             case LeftRelease: // May not have finished release!
             case LeftClick:
-                mEvent.type = LeftRelease;      break;
+                releaseInstruction.action = LeftRelease;      break;
             case RightPress:
             case RightRelease:
             case RightClick:
-                mEvent.type = RightRelease;     break;
+                releaseInstruction.action = RightRelease;     break;
             case MiddlePress:
             case MiddleRelease:
             case MiddleClick:
-                mEvent.type = MiddleRelease;    break;
+                releaseInstruction.action = MiddleRelease;    break;
             }
 
             // Now run mouse event that will release any possible remaining state!
-            runMouseEvent(mEvent);
+            runMouseEvent(releaseInstruction);
         }
         // If keyboard event that could leave state behind, we must attempt to erase that state!
-        else if (   lastExecEvent.type == MacroEventType::KeyboardEvent
-                 && lastExecEvent.keyboardEvent.type != MacroKeyboardEventType::KeyString)
+        else if (   lastExecInstruction.type == MacroEventType::KeyboardEvent
+                 && lastExecInstruction.action != MacroKeyboardEventType::KeyString)
         {
-            MacroKeyboardEvent kEvent = lastExecEvent.keyboardEvent;
-            kEvent.type = MacroKeyboardEventType::KeyRelease;
-            runKeyboardEvent(kEvent);
+            ReplayPlan::Instruction releaseInstruction = lastExecInstruction;
+            releaseInstruction.action = MacroKeyboardEventType::KeyRelease;
+            runKeyboardEvent(plan, releaseInstruction);
         }
     }
 }
 
-
-void MacroActivator::interruptableSleepMs(int sleepMs) const
-{
-    // Sleeps in approximately 50ms chunks.
-    while (sleepMs > 0 && _run) {
-        QThread::msleep(sleepMs > 50 ? 50 : sleepMs);
-        sleepMs -= 50;
-    }
-}
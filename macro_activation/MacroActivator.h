@@ -3,7 +3,15 @@
 
 
 #include <QObject>
-#include "model/MacroEvent.h"
+#include "model/ReplayPlan.h"
+#include "ReplayScheduler.h"
+#include "MouseMotion.h"
+#include "TargetResolver.h"
+#include "InputInjector.h"
+#include <QSharedPointer>
+#include <QVarLengthArray>
+#include <memory>
+#include <atomic>
 
 
 /**
@@ -16,14 +24,71 @@ class MacroActivator : public QObject
 
 public:
 
-    explicit MacroActivator();
+    /**
+     * @brief The Pacing enum
+     * What decides when each Macro Event runs.
+     */
+    enum Pacing
+    {
+        RecordedTime,   // The recorded delays and durations.
+        ScaledTime,     // The recorded delays and durations, sped up by a factor.
+        AsFastAsReady   // Only the minimum delays and durations; mouse events wait until their target area is stable.
+    };
+
+    /**
+     * @brief The ActivationOptions struct
+     * How a Macro is activated.
+     */
+    typedef struct ActivationOptions
+    {
+        Pacing pacing;
+        double speed;           // ScaledTime: recorded times are divided by it (e.g. 2.0 runs twice as fast).
+        int minDelayMs;         // ScaledTime and AsFastAsReady: floor of an event's delay (never above the recorded).
+        int minDurationMs;      // ScaledTime and AsFastAsReady: floor of an event's duration (never above the recorded).
+        int stableMs;           // AsFastAsReady: how long a target area must stay unchanged to be ready.
+        int readyTimeoutMs;     // AsFastAsReady: how long to wait for readiness before running an event anyway.
+        int pasteMinChars;      // Key strings at least this long are pasted through the clipboard (0 to always type).
+        QString traceFilePath;  // If set, the run is traced and exported to this file as Chrome trace JSON.
+    } ActivationOptions;
+
+    /**
+     * @brief DEFAULT_OPTIONS
+     * Replays Macros in recorded time.
+     */
+    const static ActivationOptions DEFAULT_OPTIONS;
+
+    /**
+     * @brief MacroActivator
+     * @param injector The injector that Macro Events are replayed through. The platform injector if null.
+     */
+    explicit MacroActivator(std::unique_ptr<InputInjector> injector = nullptr);
 
     /**
      * @brief runMacro
-     * Runs a given Macro record.
-     * @param macroEvents A list of the Macro Events associated with the Macro record to run.
+     * Runs a given Macro record in its own thread.
+     * @param plan The compiled replay plan of the Macro record to run.
+     * @param options (OPTIONAL) How to run it.
+     * @return false if not started because a Macro is already running (in any activator), true otherwise.
+     */
+    bool runMacro(const QSharedPointer<const ReplayPlan> &plan, const ActivationOptions &options = DEFAULT_OPTIONS);
+
+    /**
+     * @brief startMacro
+     * First half of running a Macro on the caller's own thread: claims the activation, so that a stopMacro()
+     * made from now on is not missed. Must be followed by executeMacro() if it succeeds.
+     * @param options How to run the Macro.
+     * @return false if a Macro is already running (in any activator), true otherwise.
+     */
+    bool startMacro(const ActivationOptions &options);
+
+    /**
+     * @brief executeMacro
+     * Second half of running a Macro on the caller's own thread (see startMacro()). Blocks until the Macro is
+     * finished or stopped, then releases the activation and emits macroActivatorStopped().
+     * @param plan The compiled replay plan of the Macro to run.
+     * @return The error message if the Macro stopped due to an error, otherwise an empty string.
      */
-    void runMacro(const QList<MacroEvent> &macroEvents);
+    QString executeMacro(QSharedPointer<const ReplayPlan> plan);
 
     /**
      * @brief stopMacro
@@ -31,15 +96,30 @@ public:
      */
     void stopMacro();
 
+    /**
+     * @brief setMouseMotion
+     * Sets how the mouse is moved to the targets of mouse events.
+     * @param settings The mouse motion settings.
+     */
+    void setMouseMotion(const MouseMotion::Settings &settings);
+
+    /**
+     * @brief optionsSummary
+     * Describes activation options in one line.
+     * @param options The options.
+     * @return The description.
+     */
+    static QString optionsSummary(const ActivationOptions &options);
+
 signals:
 
     /**
      * @brief activatingMacroEvent
-     * Gives the Macro Event that is currently being activated.
-     * @param event
-     * The Macro Event that is being activated.
+     * Gives the info of the Macro Event that is currently being activated.
+     * @param eventInfo
+     * The info string of the Macro Event that is being activated.
      */
-    void activatingMacroEvent(const MacroEvent &event);
+    void activatingMacroEvent(const QString &eventInfo);
 
     /**
      * @brief macroActivatorStopped
@@ -62,144 +142,151 @@ private:
     bool _run;
 
     /**
-     * @brief runMacroInOwnThread
-     * This will be invoked in its own separate thread so that the main event thread isn't
-     * hogged by the loop inside. It will run the Macro.
-     * @param macroEvents The Macro Events of the Macro to run.
+     * @brief _activating
+     * Set while any activator is running a Macro, so that activations never overlap.
      */
-    void runMacroInOwnThread(QList<MacroEvent> &macroEvents);
+    static std::atomic<bool> _activating;
 
     /**
-     * @brief runMouseEvent
-     * Runs a Macro Mouse Event.
-     * @param mEvent The Macro Mouse Event.
+     * @brief _options
+     * How the running Macro is activated.
      */
-    void runMouseEvent(const MacroMouseEvent &mEvent) const;
+    ActivationOptions _options;
+
     /**
-     * @brief runKeyboardEvent
-     * Runs a Macro Keyboard Event.
-     * @param kEvent The Macro Keyboard Event.
+     * @brief _injector
+     * Injects the replayed mouse and keyboard input.
      */
-    void runKeyboardEvent(const MacroKeyboardEvent &kEvent) const;
+    std::unique_ptr<InputInjector> _injector;
 
     /**
-     * @brief moveMouseToPos
-     * Moves the mouse to the specified position in screen coordinates.
-     * @param x The x-cooridinate.
-     * @param y The y-cooridinate.
+     * @brief _scheduler
+     * Times the Macro Events of the running Macro.
      */
-    void moveMouseToPos(int x, int y) const;
+    ReplayScheduler _scheduler;
+
     /**
-     * @brief setMousePos
-     * Sets the mouse position to absolute screen coordinates x and y.
-     * @param x The x-coordinate.
-     * @param y The y-coordinate.
+     * @brief _mouseMotion
+     * Moves the mouse to the targets of mouse events.
      */
-    void setMousePos(int x, int y) const;
+    MouseMotion _mouseMotion;
 
     /**
-     * @brief leftPress
-     * Executes a left mouse press event.
+     * @brief _targetResolver
+     * Finds the current screen positions of the targets of auto corrected mouse events, ahead of time.
      */
-    void leftPress() const;
+    TargetResolver _targetResolver;
+
     /**
-     * @brief leftRelease
-     * Executes a left mouse release event.
+     * @brief PRE_MOVE_DELAY_MS
+     * The pause before moving the mouse to the target of a location sensitive mouse event, in recorded time.
      */
-    void leftRelease() const;
+    const static int PRE_MOVE_DELAY_MS;
 
     /**
-     * @brief rightPress
-     * Executes a right mouse press event.
+     * @brief paceNs
+     * Applies the pacing of the activation options to a recorded time.
+     * @param recordedMs The recorded time.
+     * @param minMs The floor of the time when it is sped up.
+     * @return The time to wait in nanoseconds.
      */
-    void rightPress() const;
+    qint64 paceNs(int recordedMs, int minMs) const;
+
     /**
-     * @brief rightRelease
-     * Executes a right mouse release event.
+     * @brief traceDeadlineNs
+     * @return The next deadline on the trace clock, or -1 if tracing is off.
      */
-    void rightRelease() const;
+    qint64 traceDeadlineNs() const;
 
     /**
-     * @brief middlePress
-     * Executes a middle mouse press event.
+     * @brief traceDeadlineWait
+     * Waits for the next deadline (see ReplayScheduler::waitForDeadline()) in a trace span. The span is not
+     * scheduled itself, since the deadline is when it ends; the lateness shows on the span that follows it.
+     * @param name The span name (must be a string literal).
+     * @param instructionInd The index of the instruction that is waited for.
+     * @param record (OPTIONAL) Set false to not record the lateness.
+     * @return false if the activation was stopped, true otherwise.
      */
-    void middlePress() const;
+    bool traceDeadlineWait(const char *name, int instructionInd, bool record = true);
+
     /**
-     * @brief middleRelease
-     * Executes a middle mouse release event.
+     * @brief traceSleep
+     * Sleeps (see ReplayScheduler::sleepFor()) in a trace span.
+     * @param name The span name (must be a string literal).
+     * @param instructionInd The index of the instruction that is slept for.
+     * @param ns The time to sleep.
+     * @return false if the activation was stopped, true otherwise.
      */
-    void middleRelease() const;
+    bool traceSleep(const char *name, int instructionInd, qint64 ns);
 
     /**
-     * @brief scrollUp
-     * Executes a mouse scroll up event.
+     * @brief runMouseEvent
+     * Runs a compiled Macro Mouse Event.
+     * @param instruction The mouse instruction.
      */
-    void scrollUp() const;
+    void runMouseEvent(const ReplayPlan::Instruction &instruction) const;
     /**
-     * @brief scrollDown
-     * Executes a mouse scroll down event.
+     * @brief runKeyboardEvent
+     * Runs a compiled Macro Keyboard Event.
+     * @param plan The replay plan that the instruction belongs to.
+     * @param instruction The keyboard instruction.
      */
-    void scrollDown() const;
+    void runKeyboardEvent(const ReplayPlan &plan, const ReplayPlan::Instruction &instruction) const;
 
     /**
-     * @brief keyString
-     * Executes a key string event. Types out a string of characters.
-     * @param qText The key string to type out.
+     * @brief InputBatch
+     * The inputs of a single Macro Event, which are injected together.
      */
-    void keyString(const QString &qText) const;
+    typedef QVarLengthArray<InputInjector::Input, 16> InputBatch;
 
     /**
-     * @brief keyPress
-     * Executes a keyboard press event.
-     * @param kEvent The keyboard press event details. Will include the key code and any key modifiers.
+     * @brief click
+     * Executes a mouse click (press and release) of a button.
+     * @param button The mouse button.
      */
-    void keyPress(const MacroKeyboardEvent &kEvent) const;
-    /**
-     * @brief keyRelease
-     * Executes a keyboard release event.
-     * @param kEvent The keyboard release event details. Will include the key code and any key modifiers.
-     */
-    void keyRelease(const MacroKeyboardEvent &kEvent) const;
+    void click(InputInjector::Button button) const;
 
     /**
-     * @brief mapQtVkToWinVk
-     * Maps a QT virtual key code to a Windows virtual key code.
-     * @param qtVk The QT virtual key code.
-     * @return The Windows virtual key code.
+     * @brief keyStroke
+     * Executes a keyboard press and/or release event with all of its key modifiers.
+     * @param keyStroke The key code and any key modifiers.
+     * @param press Whether to press the key.
+     * @param release Whether to release the key.
      */
-    int mapQtVkToWinVk(int qtVk) const;
+    void keyStroke(const ReplayPlan::KeyStroke &keyStroke, bool press, bool release) const;
 
     /**
      * @brief applyKeyMods
-     * Apply all keyboard mods necessary for execution of the event.
-     * @param kEvent The keyboard event to apply mods for.
+     * Appends the inputs that apply all keyboard mods necessary for execution of the event.
+     * @param keyStroke The key stroke to apply mods for.
+     * @param batch The batch to append to.
      */
-    void applyKeyMods(const MacroKeyboardEvent &kEvent) const;
+    void applyKeyMods(const ReplayPlan::KeyStroke &keyStroke, InputBatch &batch) const;
     /**
      * @brief removeKeyMods
-     * Remove all keyboard mods associated with the execution of an event.
-     * @param kEvent The keyboard event to remove the mods after.
+     * Appends the inputs that remove all keyboard mods associated with the execution of an event.
+     * @param keyStroke The key stroke to remove the mods after.
+     * @param batch The batch to append to.
      */
-    void removeKeyMods(const MacroKeyboardEvent &kEvent) const;
+    void removeKeyMods(const ReplayPlan::KeyStroke &keyStroke, InputBatch &batch) const;
 
     /**
-     * @brief cleanupMacro
-     * Cleans up any left behind Mouse and Keyboard State for the Macro when it is either automatically finished
-     * with execution or forcefully finished (by either user or exception).
-     * @param macroEvents The list of Macro Events that should have been fully executed.
-     * @param lastEventInd The index of the last event to execute. This event may
-     *                     or may not have completed fully.
+     * @brief appendKeyToggle
+     * Appends a press and release of a lock key.
+     * @param keyCode The Qt key code of the lock key.
+     * @param batch The batch to append to.
      */
-    void cleanupMacro(const QList<MacroEvent> &macroEvents, int lastEventInd) const;
+    static void appendKeyToggle(int keyCode, InputBatch &batch);
 
     /**
-     * @brief interruptableSleepMs
-     * Sleeps for the given amount of milliseconds. The sleep is in short increments
-     * so that if the user interrupts the Macro Activation, a long sleep will not
-     * continue.
-     * @param sleepMs The sleep time in milliseconds.
+     * @brief cleanupMacro
+     * Cleans up any left behind Mouse and Keyboard State for the Macro when it is either automatically finished
+     * with execution or forcefully finished (by either user or exception).
+     * @param plan The replay plan that should have been fully executed.
+     * @param lastInstructionInd The index of the last instruction to execute. This instruction may
+     *                           or may not have completed fully.
      */
-    void interruptableSleepMs(int sleepMs) const;
+    void cleanupMacro(const ReplayPlan &plan, int lastInstructionInd) const;
 };
 
 
@@ -0,0 +1,281 @@
+#include "MacroJobScheduler.h"
+#include "model/MacroEventModel.h"
+#include "model/DBUtil.h"
+#include <QtConcurrent/QtConcurrent>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QDebug>
+
+
+MacroJobScheduler::MacroJobScheduler()
+    : _run(true),
+      _queue(),
+      _nextJobId(1),
+      _runningJobId(-1),
+      _runningJobCancelled(false),
+      _results(),
+      _queueLock(),
+      _queueWaitCondition(),
+      _activator(),
+      _preloadPool(),
+      _preloadMacroId(-1),
+      _preload()
+{
+    _preloadPool.setMaxThreadCount(1);
+    _preloadPool.setExpiryTimeout(-1); // Keep the thread, since its database connection is per thread.
+    connect(&_activator, SIGNAL(activatingMacroEvent(QString)), this, SIGNAL(activatingMacroEvent(QString)));
+}
+
+
+MacroJobScheduler::~MacroJobScheduler()
+{
+    stop();
+}
+
+
+void MacroJobScheduler::stop()
+{
+    _queueLock.lock();
+    _run = false;
+    _queue.clear();
+    _runningJobCancelled = true;
+    _activator.stopMacro();
+    _queueWaitCondition.wakeAll();
+    _queueLock.unlock();
+    wait();
+
+    // The preload connection can only be removed from the thread that opened it.
+    QtConcurrent::run(&_preloadPool, []() { DBUtil::removeThreadConnection("JobPreload"); }).waitForFinished();
+}
+
+
+int MacroJobScheduler::enqueue(const MacroJob &job)
+{
+    QMutexLocker queueLocker(&_queueLock);
+    MacroJob queuedJob = job;
+    queuedJob.jobId = _nextJobId++;
+    queuedJob.repeatCount = qMax(job.repeatCount, 1);
+    _queue.append(queuedJob);
+    _queueWaitCondition.wakeAll();
+    return queuedJob.jobId;
+}
+
+
+void MacroJobScheduler::cancel(int jobId)
+{
+    QMutexLocker queueLocker(&_queueLock);
+    if (jobId == _runningJobId) {
+        _runningJobCancelled = true;
+        _activator.stopMacro();
+        _queueWaitCondition.wakeAll();
+        return;
+    }
+
+    for (int i = 0; i < _queue.size(); i++) {
+        if (_queue[i].jobId != jobId) continue;
+
+        MacroJob job = _queue.takeAt(i);
+        MacroJobResult result = { job.jobId, job.macroId, job.repeatCount, 0, true, QString(), 0 };
+        _results.insert(jobId, result);
+        queueLocker.unlock();
+        emit jobFinished(jobId);
+        return;
+    }
+}
+
+
+void MacroJobScheduler::cancelAll()
+{
+    QMutexLocker queueLocker(&_queueLock);
+    QList<MacroJob> cancelledJobs = _queue;
+    _queue.clear();
+    foreach (const MacroJob &job, cancelledJobs) {
+        MacroJobResult result = { job.jobId, job.macroId, job.repeatCount, 0, true, QString(), 0 };
+        _results.insert(job.jobId, result);
+    }
+    if (_runningJobId != -1) {
+        _runningJobCancelled = true;
+        _activator.stopMacro();
+        _queueWaitCondition.wakeAll();
+    }
+    queueLocker.unlock();
+
+    foreach (const MacroJob &job, cancelledJobs) {
+        emit jobFinished(job.jobId);
+    }
+}
+
+
+bool MacroJobScheduler::takeResult(int jobId, MacroJobResult &result)
+{
+    QMutexLocker queueLocker(&_queueLock);
+    if (!_results.contains(jobId)) return false;
+    result = _results.take(jobId);
+    return true;
+}
+
+
+int MacroJobScheduler::getQueuedJobCount() const
+{
+    QMutexLocker queueLocker(&_queueLock);
+    return _queue.size();
+}
+
+
+void MacroJobScheduler::run()
+{
+    MacroEventModel *macroEventModel = new MacroEventModel(DBUtil::threadConnection("Jobs"));
+    MacroJob job;
+
+    while (takeNextDueJob(job)) {
+        emit jobStarted(job.jobId);
+        MacroJobResult result = runJob(job, *macroEventModel);
+        qDebug() << "Macro job " << job.jobId << ": " << result.runsCompleted << " of " << result.runsRequested
+                 << " runs in " << result.elapsedMs << " ms" << (result.cancelled ? " (cancelled)" : "")
+                 << result.errorMsg;
+
+        _queueLock.lock();
+        _runningJobId = -1;
+        _results.insert(job.jobId, result);
+        _queueLock.unlock();
+        emit jobFinished(job.jobId);
+    }
+
+    delete macroEventModel;
+    DBUtil::removeThreadConnection("Jobs");
+}
+
+
+bool MacroJobScheduler::takeNextDueJob(MacroJob &job)
+{
+    QMutexLocker queueLocker(&_queueLock);
+    while (_run) {
+        QDateTime now = QDateTime::currentDateTime();
+        qint64 waitMs = -1;
+
+        // Jobs run in queue order, except that a job scheduled for later lets the jobs behind it go first.
+        for (int i = 0; i < _queue.size(); i++) {
+            const QDateTime &startAt = _queue[i].startAt;
+            if (!startAt.isValid() || startAt <= now) {
+                job = _queue.takeAt(i);
+                _runningJobId = job.jobId;
+                _runningJobCancelled = false;
+                return true;
+            }
+            qint64 untilStartMs = now.msecsTo(startAt);
+            waitMs = (waitMs < 0) ? untilStartMs : qMin(waitMs, untilStartMs);
+        }
+
+        if (waitMs < 0) {
+            _queueWaitCondition.wait(&_queueLock);
+        }
+        else {
+            _queueWaitCondition.wait(&_queueLock, (unsigned long)waitMs);
+        }
+    }
+    return false;
+}
+
+
+MacroJobScheduler::MacroJobResult MacroJobScheduler::runJob(const MacroJob &job, MacroEventModel &macroEventModel)
+{
+    MacroJobResult result = { job.jobId, job.macroId, job.repeatCount, 0, false, QString(), 0 };
+    QSharedPointer<const ReplayPlan> plan = getPlan(job.macroId, macroEventModel);
+    // The current plan is ready, so get the next job's plan ready while this one runs.
+    preloadNextJob();
+
+    QElapsedTimer jobTimer;
+    jobTimer.start();
+    for (int run = 0; run < job.repeatCount; run++) {
+        if (run > 0) {
+            if (job.repeatIntervalMs > 0 && !waitBetweenRuns(job.repeatIntervalMs)) break;
+            // Usually still cached; only recompiled if the Macro was edited since the last run.
+            plan = getPlan(job.macroId, macroEventModel);
+        }
+
+        // Started under the lock, so that a cancel either comes before the start (and is seen here)
+        // or after it (and stops the run).
+        _queueLock.lock();
+        bool start = _run && !_runningJobCancelled;
+        if (start && !_activator.startMacro(job.options)) {
+            result.errorMsg = "Another Macro is already running";
+            start = false;
+        }
+        _queueLock.unlock();
+        if (!start) break;
+
+        QString errorMsg = _activator.executeMacro(plan);
+        if (!errorMsg.isEmpty()) {
+            result.errorMsg = errorMsg;
+            break;
+        }
+
+        QMutexLocker queueLocker(&_queueLock);
+        if (_runningJobCancelled) break; // Stopped partway through.
+        result.runsCompleted++;
+    }
+
+    result.elapsedMs = jobTimer.elapsed();
+    QMutexLocker queueLocker(&_queueLock);
+    result.cancelled = _runningJobCancelled;
+    return result;
+}
+
+
+void MacroJobScheduler::preloadNextJob()
+{
+    _queueLock.lock();
+    int macroId = _queue.isEmpty() ? -1 : _queue.first().macroId;
+    _queueLock.unlock();
+
+    if (   macroId == -1
+        || macroId == _preloadMacroId
+        || !ReplayPlan::cached(macroId).isNull())
+    {
+        return;
+    }
+    _preloadMacroId = macroId;
+    _preload = QtConcurrent::run(&_preloadPool, &MacroJobScheduler::compilePlan, macroId);
+}
+
+
+QSharedPointer<const ReplayPlan> MacroJobScheduler::getPlan(int macroId, MacroEventModel &macroEventModel)
+{
+    if (macroId == _preloadMacroId) {
+        _preload.waitForFinished();
+        _preloadMacroId = -1;
+    }
+
+    // A preloaded plan is only cached if the Macro was not edited while it was compiled.
+    QSharedPointer<const ReplayPlan> plan = ReplayPlan::cached(macroId);
+    if (plan.isNull()) {
+        macroEventModel.setActiveMacro(macroId);
+        plan = macroEventModel.getReplayPlan();
+    }
+    return plan;
+}
+
+
+QSharedPointer<const ReplayPlan> MacroJobScheduler::compilePlan(int macroId)
+{
+    // Compiling also queues the target screenshots to be decoded.
+    MacroEventModel macroEventModel(DBUtil::threadConnection("JobPreload"));
+    macroEventModel.setActiveMacro(macroId);
+    return macroEventModel.getReplayPlan();
+}
+
+
+bool MacroJobScheduler::waitBetweenRuns(int ms)
+{
+    QElapsedTimer waitTimer;
+    waitTimer.start();
+    QMutexLocker queueLocker(&_queueLock);
+    qint64 remainingMs;
+    while (   _run
+           && !_runningJobCancelled
+           && (remainingMs = ms - waitTimer.elapsed()) > 0)
+    {
+        _queueWaitCondition.wait(&_queueLock, (unsigned long)remainingMs);
+    }
+    return _run && !_runningJobCancelled;
+}
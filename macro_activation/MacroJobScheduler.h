@@ -0,0 +1,265 @@
+#ifndef MACROJOBSCHEDULER_H
+#define MACROJOBSCHEDULER_H
+
+
+#include "MacroActivator.h"
+#include "model/ReplayPlan.h"
+#include <QThread>
+#include <QThreadPool>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QDateTime>
+#include <QFuture>
+#include <QList>
+#include <QHash>
+
+
+class MacroEventModel;
+
+
+/**
+ * @brief The MacroJobScheduler class
+ * Runs queued Macro activations (jobs) one after another on a single dedicated executor thread. A job runs a Macro
+ * a number of times, either as soon as possible or from a scheduled time on. While a job runs, the replay plan of
+ * the next queued job is compiled (and its target screenshots decoded) on a background thread, so that unattended
+ * batch runs go back-to-back without reload gaps. Jobs can be cancelled while queued or running, and every job
+ * leaves a result behind.
+ */
+class MacroJobScheduler : public QThread
+{
+
+    Q_OBJECT
+
+public:
+
+    /**
+     * @brief The MacroJob struct
+     * A queued activation.
+     */
+    typedef struct MacroJob
+    {
+        int jobId;                                  // Assigned by enqueue().
+        int macroId;
+        MacroActivator::ActivationOptions options;
+        int repeatCount;                            // How many times the Macro is run.
+        int repeatIntervalMs;                       // Pause between runs (0 for back-to-back).
+        QDateTime startAt;                          // Not started before this time (invalid to start when possible).
+    } MacroJob;
+
+    /**
+     * @brief The MacroJobResult struct
+     * The outcome of a job.
+     */
+    typedef struct MacroJobResult
+    {
+        int jobId;
+        int macroId;
+        int runsRequested;
+        int runsCompleted;
+        bool cancelled;
+        QString errorMsg;                           // Empty unless a run stopped due to an error.
+        qint64 elapsedMs;                           // From the start of the first run to the end of the last.
+    } MacroJobResult;
+
+    explicit MacroJobScheduler();
+    ~MacroJobScheduler();
+
+    /**
+     * @brief stop
+     * Cancels the running job, drops the queued ones, and waits for the executor thread to finish.
+     */
+    void stop();
+
+    /**
+     * @brief enqueue
+     * Queues a job. Safe to call from any thread.
+     * @param job The job (its jobId is ignored).
+     * @return The ID of the queued job.
+     */
+    int enqueue(const MacroJob &job);
+
+    /**
+     * @brief cancel
+     * Cancels a queued or running job. A running job stops its current run at the next event. Safe to call from
+     * any thread.
+     * @param jobId The ID of the job.
+     */
+    void cancel(int jobId);
+
+    /**
+     * @brief cancelAll
+     * Cancels the running job and all queued jobs. Safe to call from any thread.
+     */
+    void cancelAll();
+
+    /**
+     * @brief takeResult
+     * Takes the result of a finished job. Safe to call from any thread.
+     * @param jobId The ID of the job.
+     * @param result (OUTPUT) The result.
+     * @return true if the job has finished (the result is taken), false otherwise.
+     */
+    bool takeResult(int jobId, MacroJobResult &result);
+
+    /**
+     * @brief getQueuedJobCount
+     * @return The number of jobs waiting to run (not counting the running job).
+     */
+    int getQueuedJobCount() const;
+
+signals:
+
+    /**
+     * @brief jobStarted
+     * Emitted from the executor thread when a job starts.
+     * @param jobId The ID of the job.
+     */
+    void jobStarted(int jobId);
+
+    /**
+     * @brief jobFinished
+     * Emitted when a job has finished, was cancelled, or stopped due to an error. Its result can then be taken.
+     * @param jobId The ID of the job.
+     */
+    void jobFinished(int jobId);
+
+    /**
+     * @brief activatingMacroEvent
+     * Emitted from the executor thread with the info of the Macro Event that is being activated.
+     * @param eventInfo The info string of the Macro Event.
+     */
+    void activatingMacroEvent(const QString &eventInfo);
+
+protected:
+
+    /**
+     * @brief run
+     * Executor thread main loop.
+     */
+    void run() override;
+
+private:
+
+    /**
+     * @brief _run
+     * Flag that is set false when the executor thread should stop.
+     */
+    bool _run;
+
+    /**
+     * @brief _queue
+     * The queued jobs in the order they were queued.
+     */
+    QList<MacroJob> _queue;
+
+    /**
+     * @brief _nextJobId
+     * The ID given to the next queued job.
+     */
+    int _nextJobId;
+
+    /**
+     * @brief _runningJobId
+     * The ID of the running job, or -1 if none.
+     */
+    int _runningJobId;
+
+    /**
+     * @brief _runningJobCancelled
+     * Set when the running job is cancelled.
+     */
+    bool _runningJobCancelled;
+
+    /**
+     * @brief _results
+     * The results of finished jobs that have not been taken, keyed by job ID.
+     */
+    QHash<int, MacroJobResult> _results;
+
+    /**
+     * @brief _queueLock
+     * Lock guarding all of the above.
+     */
+    mutable QMutex _queueLock;
+
+    /**
+     * @brief _queueWaitCondition
+     * Woken whenever a job is queued or cancelled, or the thread is stopped.
+     */
+    QWaitCondition _queueWaitCondition;
+
+    /**
+     * @brief _activator
+     * Runs the Macros of the jobs.
+     */
+    MacroActivator _activator;
+
+    /**
+     * @brief _preloadPool
+     * The single background thread that compiles the replay plan of the next job.
+     */
+    QThreadPool _preloadPool;
+
+    /**
+     * @brief _preloadMacroId
+     * The Macro whose plan is being (or was last) preloaded, or -1 if none.
+     */
+    int _preloadMacroId;
+
+    /**
+     * @brief _preload
+     * The plan being (or last) preloaded.
+     */
+    QFuture<QSharedPointer<const ReplayPlan>> _preload;
+
+    /**
+     * @brief takeNextDueJob
+     * Waits until a queued job is due (or the thread is stopped) and takes it off the queue.
+     * @param job (OUTPUT) The job.
+     * @return false if the thread is stopping, true otherwise.
+     */
+    bool takeNextDueJob(MacroJob &job);
+
+    /**
+     * @brief runJob
+     * Runs all runs of a job on the executor thread.
+     * @param job The job.
+     * @param macroEventModel The executor thread's model, used to compile a plan that was not preloaded.
+     * @return The result.
+     */
+    MacroJobResult runJob(const MacroJob &job, MacroEventModel &macroEventModel);
+
+    /**
+     * @brief preloadNextJob
+     * Starts compiling the plan of the job that is queued next, unless it is already cached.
+     */
+    void preloadNextJob();
+
+    /**
+     * @brief getPlan
+     * Gets the plan of a Macro: cached, preloaded, or compiled in line (in that order of preference).
+     * @param macroId The ID of the Macro.
+     * @param macroEventModel The executor thread's model.
+     * @return The plan.
+     */
+    QSharedPointer<const ReplayPlan> getPlan(int macroId, MacroEventModel &macroEventModel);
+
+    /**
+     * @brief compilePlan
+     * Runs on the preload thread. Compiles and caches the plan of a Macro with the thread's own connection.
+     * @param macroId The ID of the Macro.
+     * @return The plan.
+     */
+    static QSharedPointer<const ReplayPlan> compilePlan(int macroId);
+
+    /**
+     * @brief waitBetweenRuns
+     * Sleeps between the runs of a job, waking early if the job is cancelled.
+     * @param ms The time to sleep.
+     * @return false if the job was cancelled (or the thread stopped), true otherwise.
+     */
+    bool waitBetweenRuns(int ms);
+};
+
+
+#endif // MACROJOBSCHEDULER_H
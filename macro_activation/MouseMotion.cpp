@@ -0,0 +1,84 @@
+#include "MouseMotion.h"
+#include <QElapsedTimer>
+
+
+const MouseMotion::Settings MouseMotion::DEFAULT_SETTINGS = { MouseMotion::Eased, 120, 120 };
+
+namespace {
+// How far the Bezier path bends away from the straight line, as a fraction of the move distance.
+const double BEZIER_BEND = 0.15;
+}
+
+
+MouseMotion::MouseMotion()
+    : _settings(DEFAULT_SETTINGS)
+{}
+
+
+void MouseMotion::setSettings(const Settings &settings)
+{
+    _settings = settings;
+    _settings.durationMs = qMax(settings.durationMs, 0);
+    _settings.updateHz = qMax(settings.updateHz, 1);
+}
+
+
+MouseMotion::Settings MouseMotion::getSettings() const
+{
+    return _settings;
+}
+
+
+bool MouseMotion::moveTo(int x, int y, ReplayScheduler &scheduler, InputInjector &injector) const
+{
+    int steps = (int)((qint64)_settings.durationMs * _settings.updateHz / 1000);
+    if (_settings.model == Teleport || steps < 1) {
+        injector.inject(InputInjector::mouseMove(x, y));
+        return scheduler.isRunning();
+    }
+
+    QPointF from(injector.cursorPos()),
+            to(x, y);
+    qint64 durationNs = _settings.durationMs * 1000000LL;
+
+    // Each placement is timed from the start of the move, so the move always takes the same time.
+    QElapsedTimer moveClock;
+    moveClock.start();
+    for (int step = 1; step <= steps; step++) {
+        if (!scheduler.sleepFor(durationNs * step / steps - moveClock.nsecsElapsed())) return false;
+
+        QPointF pos = (step == steps) ? to : pointAt(from, to, (double)step / steps);
+        injector.inject(InputInjector::mouseMove(qRound(pos.x()), qRound(pos.y())));
+    }
+    return true;
+}
+
+
+QPointF MouseMotion::pointAt(const QPointF &from, const QPointF &to, double t) const
+{
+    switch (_settings.model) {
+    case Linear:
+        return from + (to - from) * t;
+    case Eased:
+        return from + (to - from) * ease(t);
+    case Bezier: {
+        // Both control points are pushed to the same side of the line, so the path is a single shallow arc.
+        QPointF delta = to - from,
+                bend = QPointF(-delta.y(), delta.x()) * BEZIER_BEND,
+                ctrl1 = from + delta * 0.25 + bend,
+                ctrl2 = from + delta * 0.75 + bend;
+        double s = ease(t),
+               u = 1 - s;
+        return from * (u * u * u) + ctrl1 * (3 * u * u * s) + ctrl2 * (3 * u * s * s) + to * (s * s * s);
+    }
+    default:
+        return to;
+    }
+}
+
+
+double MouseMotion::ease(double t)
+{
+    return t * t * (3 - 2 * t);
+}
+
@@ -0,0 +1,104 @@
+#ifndef MOUSEMOTION_H
+#define MOUSEMOTION_H
+
+
+#include "ReplayScheduler.h"
+#include "InputInjector.h"
+#include <QPointF>
+
+
+/**
+ * @brief The MouseMotion class
+ * Moves the mouse to the target of a replayed mouse event along the path of a selectable motion model. Every move
+ * takes the same configured time no matter how far it goes, and the cursor is placed at a fixed update rate, so
+ * replay throughput is predictable.
+ */
+class MouseMotion
+{
+public:
+
+    /**
+     * @brief The Model enum
+     * The path that the cursor takes to its target.
+     */
+    enum Model
+    {
+        Teleport,   // Straight to the target in a single step.
+        Linear,     // Straight line at constant speed.
+        Eased,      // Straight line that speeds up and then slows down into the target.
+        Bezier      // Eased along a gentle curve, which looks more like a hand movement.
+    };
+
+    /**
+     * @brief The Settings struct
+     * How mouse moves are made.
+     */
+    typedef struct Settings
+    {
+        Model model;
+        int durationMs;     // Time that every move takes (ignored by Teleport).
+        int updateHz;       // Cursor placements per second during a move (ignored by Teleport).
+    } Settings;
+
+    /**
+     * @brief DEFAULT_SETTINGS
+     * The settings that mouse moves are made with unless set otherwise.
+     */
+    const static Settings DEFAULT_SETTINGS;
+
+    explicit MouseMotion();
+
+    /**
+     * @brief setSettings
+     * Sets how mouse moves are made.
+     * @param settings The settings.
+     */
+    void setSettings(const Settings &settings);
+
+    /**
+     * @brief getSettings
+     * @return How mouse moves are made.
+     */
+    Settings getSettings() const;
+
+    /**
+     * @brief moveTo
+     * Moves the mouse from its current position to a position in screen coordinates.
+     * @param x The x-coordinate.
+     * @param y The y-coordinate.
+     * @param scheduler The scheduler of the running activation, which the move waits on between cursor placements.
+     * @param injector The injector that the cursor placements are injected through.
+     * @return false if the activation was stopped during the move, true otherwise.
+     */
+    bool moveTo(int x, int y, ReplayScheduler &scheduler, InputInjector &injector) const;
+
+private:
+
+    /**
+     * @brief _settings
+     * How mouse moves are made.
+     */
+    Settings _settings;
+
+    /**
+     * @brief pointAt
+     * Gets the position along the path of the motion model.
+     * @param from The start of the move.
+     * @param to The target of the move.
+     * @param t The fraction of the move time that has passed, in [0, 1].
+     * @return The position.
+     */
+    QPointF pointAt(const QPointF &from, const QPointF &to, double t) const;
+
+    /**
+     * @brief ease
+     * Smoothstep easing, which starts and ends with zero speed.
+     * @param t The fraction of the move time that has passed, in [0, 1].
+     * @return The fraction of the path covered, in [0, 1].
+     */
+    static double ease(double t);
+
+};
+
+
+#endif // MOUSEMOTION_H
@@ -0,0 +1,185 @@
+#include "ReplayScheduler.h"
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+#include <Windows.h>
+#endif
+#include <QMutexLocker>
+#include <QtMath>
+
+
+const qint64 ReplayScheduler::SPIN_NS = 2000000; // 2 ms
+const qint64 ReplayScheduler::MAX_LATENESS_NS = 50000000; // 50 ms
+const int ReplayScheduler::HISTOGRAM_BUCKETS = 24;
+
+
+ReplayScheduler::ReplayScheduler()
+    : _clock(),
+      _deadlineNs(0),
+      _run(false),
+      _highResolution(false),
+      _waitMutex(),
+      _wakeUp(),
+      _stats()
+{
+    _stats.histogram.fill(0, HISTOGRAM_BUCKETS);
+}
+
+
+ReplayScheduler::~ReplayScheduler()
+{
+    stop();
+    finish();
+}
+
+
+void ReplayScheduler::start()
+{
+    // Sleeps are only as fine as the system timer, which is 15.6 ms on Windows unless raised.
+    #if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    if (!_highResolution) {
+        timeBeginPeriod(1);
+        _highResolution = true;
+    }
+    #endif
+
+    _stats.count = 0;
+    _stats.totalNs = 0;
+    _stats.maxNs = 0;
+    _stats.rebases = 0;
+    _stats.histogram.fill(0, HISTOGRAM_BUCKETS);
+
+    _deadlineNs = 0;
+    _run = true;
+    _clock.start();
+}
+
+
+void ReplayScheduler::stop()
+{
+    _run = false;
+    QMutexLocker waitLocker(&_waitMutex);
+    _wakeUp.wakeAll();
+}
+
+
+void ReplayScheduler::finish()
+{
+    #if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+    if (_highResolution) {
+        timeEndPeriod(1);
+        _highResolution = false;
+    }
+    #endif
+}
+
+
+bool ReplayScheduler::isRunning() const
+{
+    return _run;
+}
+
+
+void ReplayScheduler::advance(qint64 ns)
+{
+    _deadlineNs += qMax(ns, (qint64)0);
+}
+
+
+bool ReplayScheduler::waitForDeadline(bool record)
+{
+    if (!waitUntil(_deadlineNs)) return false;
+
+    qint64 latenessNs = _clock.nsecsElapsed() - _deadlineNs;
+    if (record) {
+        recordLateness(latenessNs);
+    }
+    // Too late to catch up, so continue the timeline from here.
+    if (latenessNs > MAX_LATENESS_NS) {
+        _deadlineNs += latenessNs;
+        _stats.rebases++;
+    }
+    return true;
+}
+
+
+void ReplayScheduler::resync()
+{
+    _deadlineNs = qMax(_deadlineNs, _clock.nsecsElapsed());
+}
+
+
+qint64 ReplayScheduler::untilDeadlineNs() const
+{
+    return _deadlineNs - _clock.nsecsElapsed();
+}
+
+
+bool ReplayScheduler::sleepFor(qint64 ns)
+{
+    return waitUntil(_clock.nsecsElapsed() + ns);
+}
+
+
+ReplayScheduler::LatenessStats ReplayScheduler::stats() const
+{
+    return _stats;
+}
+
+
+QString ReplayScheduler::statsSummary(const LatenessStats &stats)
+{
+    if (stats.count == 0) return "No events scheduled";
+    return QString("%1 events late by mean %2 us, p50 < %3 us, p99 < %4 us, max %5 us, %6 timeline moves")
+            .arg(stats.count)
+            .arg(stats.totalNs / stats.count / 1000)
+            .arg(percentileUs(stats, 0.5))
+            .arg(percentileUs(stats, 0.99))
+            .arg(stats.maxNs / 1000)
+            .arg(stats.rebases);
+}
+
+
+bool ReplayScheduler::waitUntil(qint64 timeNs)
+{
+    qint64 remainingNs;
+    while (_run && (remainingNs = timeNs - _clock.nsecsElapsed()) > 0) {
+        // Sleep coarsely, leaving the last stretch to the spin below.
+        if (remainingNs > SPIN_NS) {
+            QMutexLocker waitLocker(&_waitMutex);
+            if (!_run) break;
+            _wakeUp.wait(&_waitMutex, (unsigned long)((remainingNs - SPIN_NS) / 1000000));
+        }
+        #if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+        else {
+            YieldProcessor();
+        }
+        #endif
+    }
+    return _run;
+}
+
+
+void ReplayScheduler::recordLateness(qint64 latenessNs)
+{
+    qint64 latenessUs = latenessNs / 1000;
+    int bucket = 0;
+    while (latenessUs > 0 && bucket < HISTOGRAM_BUCKETS - 1) {
+        latenessUs >>= 1;
+        bucket++;
+    }
+    _stats.histogram[bucket]++;
+    _stats.count++;
+    _stats.totalNs += latenessNs;
+    _stats.maxNs = qMax(_stats.maxNs, latenessNs);
+}
+
+
+qint64 ReplayScheduler::percentileUs(const LatenessStats &stats, double fraction)
+{
+    int target = qCeil(stats.count * fraction),
+        seen = 0;
+    for (int bucket = 0; bucket < stats.histogram.size(); bucket++) {
+        seen += stats.histogram[bucket];
+        if (seen >= target) return (qint64)1 << bucket;
+    }
+    return stats.maxNs / 1000;
+}
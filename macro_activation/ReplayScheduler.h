@@ -0,0 +1,206 @@
+#ifndef REPLAYSCHEDULER_H
+#define REPLAYSCHEDULER_H
+
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QVector>
+#include <QString>
+#include <atomic>
+
+
+/**
+ * @brief The ReplayScheduler class
+ * Times the events of a Macro activation on the monotonic high resolution clock. Events are scheduled against
+ * absolute deadlines on a timeline that starts when the activation starts, so the time that it takes to run each
+ * event does not add up over long Macros. Waits sleep coarsely until shortly before a deadline and then spin for
+ * the last stretch, and they are woken immediately when the activation is stopped. The lateness of every
+ * scheduled event is collected in a histogram.
+ */
+class ReplayScheduler
+{
+public:
+
+    /**
+     * @brief SPIN_NS
+     * The last stretch before a deadline that is spun instead of slept, which covers the sleep granularity.
+     */
+    const static qint64 SPIN_NS;
+    /**
+     * @brief MAX_LATENESS_NS
+     * The lateness after which the timeline is moved to the late event. Events after a long stall (e.g. a slow
+     * mouse move) then keep their recorded spacing instead of firing in a burst to catch up.
+     */
+    const static qint64 MAX_LATENESS_NS;
+    /**
+     * @brief HISTOGRAM_BUCKETS
+     * The number of lateness histogram buckets. Bucket 0 counts lateness under 1 us, bucket i counts lateness in
+     * [2^(i-1), 2^i) us, and the last bucket also counts everything above.
+     */
+    const static int HISTOGRAM_BUCKETS;
+
+    /**
+     * @brief The LatenessStats struct
+     * The lateness of the scheduled events of an activation.
+     */
+    typedef struct LatenessStats
+    {
+        int count;
+        qint64 totalNs;
+        qint64 maxNs;
+        int rebases;            // Number of times the timeline was moved (see MAX_LATENESS_NS).
+        QVector<int> histogram; // See HISTOGRAM_BUCKETS.
+    } LatenessStats;
+
+    explicit ReplayScheduler();
+    ~ReplayScheduler();
+
+    /**
+     * @brief start
+     * Starts the timeline at the current time and clears the lateness stats. Also raises the system timer
+     * resolution until finish() is called.
+     */
+    void start();
+
+    /**
+     * @brief stop
+     * Cancels the activation. Any wait returns right away. Safe to call from any thread.
+     */
+    void stop();
+
+    /**
+     * @brief finish
+     * Ends the activation and restores the system timer resolution.
+     */
+    void finish();
+
+    /**
+     * @brief isRunning
+     * @return true if started and not stopped.
+     */
+    bool isRunning() const;
+
+    /**
+     * @brief advance
+     * Moves the next deadline further along the timeline.
+     * @param ns The time from the previous deadline to the next one.
+     */
+    void advance(qint64 ns);
+
+    /**
+     * @brief waitForDeadline
+     * Waits until the next deadline and records how late the wait returned.
+     * @param record (OPTIONAL) Set false to not record the lateness, for deadlines that no event is run at.
+     * @return false if the activation was stopped, true otherwise.
+     */
+    bool waitForDeadline(bool record = true);
+
+    /**
+     * @brief resync
+     * Continues the timeline from now, after untimed work between events (e.g. a mouse move or a readiness wait),
+     * so that the work is not counted as lateness of the next event.
+     */
+    void resync();
+
+    /**
+     * @brief untilDeadlineNs
+     * @return The time from now until the next deadline (negative if it has passed).
+     */
+    qint64 untilDeadlineNs() const;
+
+    /**
+     * @brief sleepFor
+     * Waits for a time that is not part of the timeline (nothing is recorded and no deadline is moved).
+     * @param ns The time to wait.
+     * @return false if the activation was stopped, true otherwise.
+     */
+    bool sleepFor(qint64 ns);
+
+    /**
+     * @brief stats
+     * Gets the lateness stats of the current (or last) activation.
+     * @return The stats.
+     */
+    LatenessStats stats() const;
+
+    /**
+     * @brief statsSummary
+     * Describes lateness stats in one line: count, mean, median, 99th percentile, max, and timeline moves.
+     * Percentiles are the upper bounds of their histogram buckets.
+     * @param stats The stats.
+     * @return The summary.
+     */
+    static QString statsSummary(const LatenessStats &stats);
+
+private:
+
+    /**
+     * @brief _clock
+     * The monotonic clock that the timeline is measured on.
+     */
+    QElapsedTimer _clock;
+
+    /**
+     * @brief _deadlineNs
+     * The next deadline in nanoseconds since start().
+     */
+    qint64 _deadlineNs;
+
+    /**
+     * @brief _run
+     * Cleared by stop().
+     */
+    std::atomic<bool> _run;
+
+    /**
+     * @brief _highResolution
+     * Set while the system timer resolution is raised.
+     */
+    bool _highResolution;
+
+    /**
+     * @brief _waitMutex
+     * Guards the sleeps against a stop() that comes between checking _run and sleeping.
+     */
+    QMutex _waitMutex;
+
+    /**
+     * @brief _wakeUp
+     * Woken by stop().
+     */
+    QWaitCondition _wakeUp;
+
+    /**
+     * @brief _stats
+     * The lateness stats of the activation.
+     */
+    LatenessStats _stats;
+
+    /**
+     * @brief waitUntil
+     * Sleeps until SPIN_NS before a time on the timeline, then spins until the time.
+     * @param timeNs The time in nanoseconds since start().
+     * @return false if the activation was stopped, true otherwise.
+     */
+    bool waitUntil(qint64 timeNs);
+
+    /**
+     * @brief recordLateness
+     * Adds a lateness to the stats.
+     * @param latenessNs The lateness.
+     */
+    void recordLateness(qint64 latenessNs);
+
+    /**
+     * @brief percentileUs
+     * Gets an upper bound of a lateness percentile from the histogram.
+     * @param stats The stats.
+     * @param fraction The percentile as a fraction (e.g. 0.99).
+     * @return The upper bound of the bucket that the percentile falls in, in microseconds.
+     */
+    static qint64 percentileUs(const LatenessStats &stats, double fraction);
+};
+
+
+#endif // REPLAYSCHEDULER_H
@@ -0,0 +1,184 @@
+#include "ReplayTrace.h"
+#include <QThread>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <atomic>
+
+
+const int ReplayTrace::CAPACITY = 65536;
+
+namespace {
+// A span along with whether it has been completely written, which lets readers skip slots that are claimed
+// but still being written without taking a lock.
+typedef struct Slot
+{
+    ReplayTrace::Span span;
+    std::atomic<bool> ready;
+} Slot;
+
+QElapsedTimer startedClock()
+{
+    QElapsedTimer clock;
+    clock.start();
+    return clock;
+}
+
+Slot traceSlots[ReplayTrace::CAPACITY];
+std::atomic<int> slotCount(0);
+std::atomic<int> droppedSpans(0);
+std::atomic<bool> tracing(false);
+QElapsedTimer traceClock = startedClock();
+}
+
+
+ReplayTrace::Scope::Scope(const char *name, int instructionInd, qint64 scheduledNs)
+    : _name(name),
+      _instructionInd(instructionInd),
+      _scheduledNs(scheduledNs),
+      _startNs(isEnabled() ? nowNs() : -1)
+{}
+
+
+ReplayTrace::Scope::~Scope()
+{
+    if (_startNs >= 0) {
+        record(_name, _instructionInd, _startNs, nowNs() - _startNs, _scheduledNs);
+    }
+}
+
+
+void ReplayTrace::setEnabled(bool enabled)
+{
+    tracing.store(enabled, std::memory_order_relaxed);
+}
+
+
+bool ReplayTrace::isEnabled()
+{
+    return tracing.load(std::memory_order_relaxed);
+}
+
+
+void ReplayTrace::begin()
+{
+    int count = qMin(slotCount.load(), CAPACITY);
+    for (int i = 0; i < count; i++) {
+        traceSlots[i].ready.store(false, std::memory_order_relaxed);
+    }
+    slotCount = 0;
+    droppedSpans = 0;
+    traceClock.restart();
+}
+
+
+qint64 ReplayTrace::nowNs()
+{
+    return traceClock.nsecsElapsed();
+}
+
+
+void ReplayTrace::record(const char *name, int instructionInd, qint64 startNs, qint64 durationNs, qint64 scheduledNs)
+{
+    if (!isEnabled()) return;
+
+    // Checked first so that the slot count stays bounded while the buffer is full.
+    int ind = (slotCount.load(std::memory_order_relaxed) < CAPACITY)
+            ? slotCount.fetch_add(1, std::memory_order_relaxed)
+            : CAPACITY;
+    if (ind >= CAPACITY) {
+        droppedSpans.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    Span &span = traceSlots[ind].span;
+    span.name = name;
+    span.instructionInd = instructionInd;
+    span.startNs = startNs;
+    span.durationNs = durationNs;
+    span.scheduledNs = scheduledNs;
+    span.threadId = (quintptr)QThread::currentThreadId();
+    traceSlots[ind].ready.store(true, std::memory_order_release);
+}
+
+
+QVector<ReplayTrace::Span> ReplayTrace::spans()
+{
+    QVector<Span> recorded;
+    int count = qMin(slotCount.load(), CAPACITY);
+    recorded.reserve(count);
+    for (int i = 0; i < count; i++) {
+        if (traceSlots[i].ready.load(std::memory_order_acquire)) {
+            recorded.append(traceSlots[i].span);
+        }
+    }
+    return recorded;
+}
+
+
+int ReplayTrace::droppedCount()
+{
+    return droppedSpans.load();
+}
+
+
+QByteArray ReplayTrace::toChromeTrace()
+{
+    QJsonArray traceEvents;
+    QHash<quintptr, int> threadNumbers;
+
+    foreach (const Span &span, spans()) {
+        if (!threadNumbers.contains(span.threadId)) {
+            int threadNumber = threadNumbers.size() + 1;
+            threadNumbers.insert(span.threadId, threadNumber);
+
+            // Small thread numbers show instead of raw thread IDs.
+            QJsonObject threadName;
+            threadName["name"] = QString("Thread %1").arg(threadNumber);
+            QJsonObject threadNameEvent;
+            threadNameEvent["name"] = "thread_name";
+            threadNameEvent["ph"] = "M";
+            threadNameEvent["pid"] = 1;
+            threadNameEvent["tid"] = threadNumber;
+            threadNameEvent["args"] = threadName;
+            traceEvents.append(threadNameEvent);
+        }
+
+        QJsonObject args;
+        args["instruction"] = span.instructionInd;
+        if (span.scheduledNs >= 0) {
+            args["scheduledUs"] = span.scheduledNs / 1000.0;
+            args["latenessUs"] = (span.startNs - span.scheduledNs) / 1000.0;
+        }
+
+        // Complete events, with times in microseconds.
+        QJsonObject traceEvent;
+        traceEvent["name"] = span.name;
+        traceEvent["cat"] = "replay";
+        traceEvent["ph"] = "X";
+        traceEvent["ts"] = span.startNs / 1000.0;
+        traceEvent["dur"] = span.durationNs / 1000.0;
+        traceEvent["pid"] = 1;
+        traceEvent["tid"] = threadNumbers.value(span.threadId);
+        traceEvent["args"] = args;
+        traceEvents.append(traceEvent);
+    }
+
+    QJsonObject trace;
+    trace["traceEvents"] = traceEvents;
+    trace["displayTimeUnit"] = "ms";
+    return QJsonDocument(trace).toJson(QJsonDocument::Compact);
+}
+
+
+bool ReplayTrace::exportChromeTrace(const QString &filePath)
+{
+    QFile traceFile(filePath);
+    if (!traceFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) return false;
+
+    QByteArray trace = toChromeTrace();
+    return traceFile.write(trace) == trace.size();
+}
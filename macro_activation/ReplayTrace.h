@@ -0,0 +1,144 @@
+#ifndef REPLAYTRACE_H
+#define REPLAYTRACE_H
+
+
+#include <QtGlobal>
+#include <QVector>
+#include <QByteArray>
+#include <QString>
+
+
+/**
+ * @brief The ReplayTrace class
+ * Records timed spans of the phases of each replayed Macro Event (delay, mouse move, target search, screen capture,
+ * and input injection) into a fixed size in-memory buffer. Spans can be recorded from any thread without locking,
+ * and cost a single flag check while tracing is off. The spans of the latest run can be exported as Chrome trace
+ * JSON, which chrome://tracing and Perfetto open as a per-thread timeline.
+ */
+class ReplayTrace
+{
+public:
+
+    /**
+     * @brief CAPACITY
+     * The most spans that are kept per run. Spans past it are dropped (and counted).
+     */
+    const static int CAPACITY;
+
+    /**
+     * @brief The Span struct
+     * A timed phase of a replayed Macro Event.
+     */
+    typedef struct Span
+    {
+        const char *name;       // Phase name (must be a string literal).
+        int instructionInd;     // Index of the replayed instruction, or -1 if none.
+        qint64 startNs;         // Since begin().
+        qint64 durationNs;
+        qint64 scheduledNs;     // When the phase was scheduled to start, since begin() (-1 if it was not scheduled).
+        quintptr threadId;
+    } Span;
+
+    /**
+     * @brief The Scope class
+     * Records a span from its construction to its destruction.
+     */
+    class Scope
+    {
+    public:
+
+        /**
+         * @brief Scope
+         * Starts the span (nothing is recorded if tracing is off).
+         * @param name The phase name (must be a string literal).
+         * @param instructionInd The index of the replayed instruction, or -1 if none.
+         * @param scheduledNs (OPTIONAL) When the phase was scheduled to start, since begin().
+         */
+        explicit Scope(const char *name, int instructionInd, qint64 scheduledNs = -1);
+        ~Scope();
+
+    private:
+
+        const char *_name;
+        int _instructionInd;
+        qint64 _scheduledNs;
+        qint64 _startNs;        // -1 if tracing was off when the span started.
+
+        Scope(const Scope &copyFrom);
+        Scope& operator=(const Scope &rhs);
+    };
+
+    /**
+     * @brief setEnabled
+     * Turns tracing on or off.
+     * @param enabled true to record spans, false to ignore them.
+     */
+    static void setEnabled(bool enabled);
+
+    /**
+     * @brief isEnabled
+     * @return true if spans are recorded, false otherwise.
+     */
+    static bool isEnabled();
+
+    /**
+     * @brief begin
+     * Drops all recorded spans and restarts the trace clock. Must not be called while spans are being recorded.
+     */
+    static void begin();
+
+    /**
+     * @brief nowNs
+     * @return The trace clock, in nanoseconds since begin().
+     */
+    static qint64 nowNs();
+
+    /**
+     * @brief record
+     * Records a span if tracing is on. Safe to call from any thread.
+     * @param name The phase name (must be a string literal).
+     * @param instructionInd The index of the replayed instruction, or -1 if none.
+     * @param startNs When the phase started, since begin().
+     * @param durationNs How long the phase took.
+     * @param scheduledNs (OPTIONAL) When the phase was scheduled to start, since begin().
+     */
+    static void record(const char *name, int instructionInd, qint64 startNs, qint64 durationNs,
+                       qint64 scheduledNs = -1);
+
+    /**
+     * @brief spans
+     * @return The spans recorded since begin(), in the order they finished.
+     */
+    static QVector<Span> spans();
+
+    /**
+     * @brief droppedCount
+     * @return The number of spans dropped since begin() because the buffer was full.
+     */
+    static int droppedCount();
+
+    /**
+     * @brief toChromeTrace
+     * Formats the spans recorded since begin() as Chrome trace JSON.
+     * @return The JSON.
+     */
+    static QByteArray toChromeTrace();
+
+    /**
+     * @brief exportChromeTrace
+     * Writes the spans recorded since begin() to a file as Chrome trace JSON.
+     * @param filePath The path of the file.
+     * @return true on success, false if the file could not be written.
+     */
+    static bool exportChromeTrace(const QString &filePath);
+
+private:
+
+    // Static utility class; no constructors, no copies!
+    ReplayTrace();
+    ReplayTrace(const ReplayTrace &copyFrom){}
+    ReplayTrace& operator=(const ReplayTrace &rhs){}
+};
+
+
+#endif // REPLAYTRACE_H
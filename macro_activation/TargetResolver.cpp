@@ -0,0 +1,327 @@
+#ifndef QT_NO_DEBUG
+#define TEST_TARGET_RESOLVER
+#endif
+
+#include "TargetResolver.h"
+#include "ReplayTrace.h"
+#include "record_img/RecordImageUtil.h"
+#include <QtConcurrent/QtConcurrent>
+#include <QMutexLocker>
+#include <QElapsedTimer>
+#include <QApplication>
+#include <QDesktopWidget>
+#include <QDebug>
+#include <cstring>
+
+
+const int TargetResolver::LOOK_AHEAD = 2;
+#ifdef TEST_TARGET_RESOLVER
+    QImage TargetResolver::_testScreen;
+#endif
+
+
+TargetResolver::TargetResolver()
+    : _plan(),
+      _pool(),
+      _resolutions(),
+      _lookAheadInd(0),
+      _stats(),
+      _resolveMutex(),
+      _resolveDone()
+{
+    _pool.setMaxThreadCount(1);
+    _pool.setExpiryTimeout(-1);
+    memset(&_stats, 0, sizeof(Stats));
+    targetResolverTest();
+}
+
+
+TargetResolver::~TargetResolver()
+{
+    stop();
+}
+
+
+void TargetResolver::start(const QSharedPointer<const ReplayPlan> &plan)
+{
+    stop();
+    QMutexLocker resolveLocker(&_resolveMutex);
+    _plan = plan;
+    _lookAheadInd = 0;
+    memset(&_stats, 0, sizeof(Stats));
+}
+
+
+void TargetResolver::stop()
+{
+    _pool.clear();
+    _pool.waitForDone();
+    QMutexLocker resolveLocker(&_resolveMutex);
+    _resolutions.clear();
+}
+
+
+void TargetResolver::lookAhead(int instructionInd)
+{
+    QMutexLocker resolveLocker(&_resolveMutex);
+    if (_plan.isNull()) return;
+
+    // Results of earlier instructions will never be used.
+    QHash<int, Resolution>::iterator it = _resolutions.begin();
+    while (it != _resolutions.end()) {
+        if (it.key() < instructionInd) it = _resolutions.erase(it);
+        else ++it;
+    }
+
+    const ReplayPlan::Instruction *instructions = _plan->instructions();
+    int queued = _resolutions.size();
+    int i = qMax(_lookAheadInd, instructionInd);
+    for (; i < _plan->size() && queued < LOOK_AHEAD; i++) {
+        if (!instructions[i].autoCorrect) continue;
+
+        Resolution resolution;
+        resolution.done = false;
+        _resolutions.insert(i, resolution);
+        QtConcurrent::run(&_pool, this, &TargetResolver::searchAhead, i);
+        queued++;
+    }
+    _lookAheadInd = i;
+}
+
+
+QPoint TargetResolver::resolve(int instructionInd)
+{
+    const ReplayPlan::Instruction &instruction = _plan->instructions()[instructionInd];
+    const ReplayPlan::Target &target = _plan->target(instruction.targetInd);
+    QRect rect;
+
+    QMutexLocker resolveLocker(&_resolveMutex);
+    if (_resolutions.contains(instructionInd)) {
+        // The search may still be running (or queued); it started earlier than a new one would, so wait for it.
+        QElapsedTimer waitTimer;
+        waitTimer.start();
+        while (!_resolutions.value(instructionInd).done) {
+            _resolveDone.wait(&_resolveMutex);
+        }
+        _stats.waitNs += waitTimer.nsecsElapsed();
+        Resolution resolution = _resolutions.take(instructionInd);
+        resolveLocker.unlock();
+
+        QImage screenshot = captureScreen(instructionInd);
+        if (isUnchanged(resolution.screenshot, screenshot, resolution.rect)) {
+            rect = resolution.rect;
+            resolveLocker.relock();
+            _stats.speculativeHits++;
+        }
+        else {
+            rect = search(instructionInd, screenshot);
+            resolveLocker.relock();
+            _stats.staleFallbacks++;
+        }
+    }
+    else {
+        resolveLocker.unlock();
+        rect = search(instructionInd, captureScreen(instructionInd));
+        resolveLocker.relock();
+        _stats.syncSearches++;
+    }
+
+    return QPoint(instruction.x, instruction.y) + (rect.topLeft() - target.rect.topLeft());
+}
+
+
+bool TargetResolver::waitForStableTarget(int instructionInd, int stableMs, int timeoutMs, ReplayScheduler &scheduler)
+{
+    const ReplayPlan::Target &target = _plan->target(_plan->instructions()[instructionInd].targetInd);
+    QRect region(target.cropOrg, target.crop.image().size());
+    ReplayTrace::Scope waitSpan("Ready wait", instructionInd);
+    QElapsedTimer waitTimer;
+    waitTimer.start();
+
+    QImage before = captureScreen(instructionInd);
+    bool stable = false;
+    while (!stable && waitTimer.elapsed() < timeoutMs) {
+        if (!scheduler.sleepFor(stableMs * 1000000LL)) return false;
+        QImage after = captureScreen(instructionInd);
+        stable = isUnchanged(before, after, region);
+        before = after;
+    }
+
+    QMutexLocker resolveLocker(&_resolveMutex);
+    _stats.readyWaits++;
+    _stats.readyTimeouts += stable ? 0 : 1;
+    _stats.readyWaitNs += waitTimer.nsecsElapsed();
+    return true;
+}
+
+
+TargetResolver::Stats TargetResolver::stats() const
+{
+    QMutexLocker resolveLocker(&_resolveMutex);
+    return _stats;
+}
+
+
+QString TargetResolver::statsSummary(const Stats &stats)
+{
+    return QString("%1 speculative hits, %2 stale, %3 in line, %4 ms searching, %5 ms waited, "
+                   "%6 readiness waits (%7 timed out, %8 ms)")
+            .arg(stats.speculativeHits)
+            .arg(stats.staleFallbacks)
+            .arg(stats.syncSearches)
+            .arg(stats.searchNs / 1000000)
+            .arg(stats.waitNs / 1000000)
+            .arg(stats.readyWaits)
+            .arg(stats.readyTimeouts)
+            .arg(stats.readyWaitNs / 1000000);
+}
+
+
+void TargetResolver::searchAhead(int instructionInd)
+{
+    {
+        QMutexLocker resolveLocker(&_resolveMutex);
+        if (!_resolutions.contains(instructionInd)) return; // Dropped while queued.
+    }
+
+    QImage screenshot;
+    QRect rect;
+    try {
+        screenshot = captureScreen(instructionInd);
+        rect = search(instructionInd, screenshot);
+    }
+    catch (std::exception &e) {
+        // A null screenshot never validates, so the search is retried in line (where errors stop the Macro).
+        qDebug() << "Error: look-ahead target search failed: " << e.what();
+        screenshot = QImage();
+    }
+
+    QMutexLocker resolveLocker(&_resolveMutex);
+    if (_resolutions.contains(instructionInd)) {
+        Resolution &resolution = _resolutions[instructionInd];
+        resolution.done = true;
+        resolution.rect = rect;
+        resolution.screenshot = screenshot;
+    }
+    _resolveDone.wakeAll();
+}
+
+
+QRect TargetResolver::search(int instructionInd, const QImage &screenshot)
+{
+    const ReplayPlan::Target &target = _plan->target(_plan->instructions()[instructionInd].targetInd);
+    ReplayTrace::Scope searchSpan("Search", instructionInd);
+    QElapsedTimer searchTimer;
+    searchTimer.start();
+    QRect rect = RecordImageUtil::findTargetImg(target.crop.image(), target.cropOrg, target.rect, screenshot);
+
+    QMutexLocker resolveLocker(&_resolveMutex);
+    _stats.searchNs += searchTimer.nsecsElapsed();
+    return rect;
+}
+
+
+QImage TargetResolver::captureScreen(int instructionInd)
+{
+    ReplayTrace::Scope captureSpan("Capture", instructionInd);
+    #ifdef TEST_TARGET_RESOLVER
+        if (!_testScreen.isNull()) return _testScreen;
+    #endif
+    return RecordImageUtil::takeScreenshot();
+}
+
+
+bool TargetResolver::isUnchanged(const QImage &before, const QImage &after, const QRect &rect)
+{
+    if (   before.isNull()
+        || before.size() != after.size()
+        || before.format() != after.format())
+    {
+        return false;
+    }
+
+    // Screenshots are taken in screen pixels, so screen coordinates are image coordinates.
+    QRect region = rect.intersected(before.rect());
+    if (region.isEmpty()) return false;
+
+    int bytesPerPixel = before.depth() / 8;
+    for (int y = region.top(); y <= region.bottom(); y++) {
+        if (memcmp(before.constScanLine(y) + region.left() * bytesPerPixel,
+                   after.constScanLine(y) + region.left() * bytesPerPixel,
+                   region.width() * bytesPerPixel) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+void TargetResolver::targetResolverTest()
+{
+    #ifdef TEST_TARGET_RESOLVER
+        // Only once, and not for the resolver that the test itself makes.
+        static QAtomicInt tested(0);
+        if (!tested.testAndSetRelaxed(0, 1)) return;
+
+        qDebug() << "\n\nTARGET RESOLVER TEST OUTPUT\n";
+
+        // Color screens of the real screen's size (findTargetImg() scales screenshots to it), with the same noisy
+        // background so that the target only matches where it is painted.
+        QSize screenSize = QApplication::desktop()->screenGeometry().size();
+        QImage recordedScreen(screenSize, QImage::Format_RGB32);
+        qsrand(1);
+        for (int y = 0; y < recordedScreen.height(); y++) {
+            QRgb *line = reinterpret_cast<QRgb*>(recordedScreen.scanLine(y));
+            for (int x = 0; x < recordedScreen.width(); x++) {
+                line[x] = qRgb(qrand() % 256, qrand() % 256, qrand() % 256);
+            }
+        }
+        QImage screen = recordedScreen.copy();
+
+        // The target was recorded at targetRect, and has since moved by targetShift.
+        QRect targetRect(100, 100, 40, 24);
+        QPoint targetShift(60, 30);
+        for (int y = 0; y < targetRect.height(); y++) {
+            for (int x = 0; x < targetRect.width(); x++) {
+                QRgb color = qRgb((x * 37) % 256, (y * 53) % 256, 200);
+                recordedScreen.setPixel(targetRect.topLeft() + QPoint(x, y), color);
+                screen.setPixel(targetRect.topLeft() + targetShift + QPoint(x, y), color);
+            }
+        }
+
+        // Recorded crops have an alpha channel, while screenshots do not.
+        QRect cropRect = targetRect.adjusted(-20, -20, 20, 20);
+        MacroEvent macroEvent;
+        macroEvent.type = MouseEvent;
+        macroEvent.mouseEvent.type = LeftClick;
+        macroEvent.mouseEvent.loc = targetRect.center();
+        macroEvent.mouseEvent.screenshot = ScreenshotHandle::fromImage(recordedScreen.copy(cropRect)
+                                                                       .convertToFormat(QImage::Format_ARGB32));
+        macroEvent.mouseEvent.screenshotOrg = cropRect.topLeft();
+        macroEvent.mouseEvent.screenshotRect = targetRect;
+        macroEvent.mouseEvent.autoCorrect = true;
+        QList<MacroEvent> macroEvents;
+        macroEvents.append(macroEvent);
+
+        TargetResolver resolver;
+        resolver.start(ReplayPlan::compile(macroEvents));
+        _testScreen = screen;
+        QPoint expectedPos = macroEvent.mouseEvent.loc + targetShift;
+        QPoint resolvedPos(-1, -1);
+        try {
+            resolvedPos = resolver.resolve(0);
+        }
+        catch (std::exception &e) {
+            qDebug() << "    Threw: " << e.what();
+        }
+        _testScreen = QImage();
+        resolver.stop();
+
+        bool pass = (resolvedPos == expectedPos);
+        qDebug().noquote() << (pass ? "PASS: " : "FAIL: ") + QString("resolve() of a color target in a color screenshot");
+        if (!pass) {
+            qDebug() << "    Expected: " << expectedPos << " Resolved: " << resolvedPos;
+        }
+    #endif // TEST_TARGET_RESOLVER
+}
@@ -0,0 +1,213 @@
+#ifndef TARGETRESOLVER_H
+#define TARGETRESOLVER_H
+
+
+#include "model/ReplayPlan.h"
+#include "ReplayScheduler.h"
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QHash>
+#include <QImage>
+#include <QPoint>
+#include <QRect>
+
+
+/**
+ * @brief The TargetResolver class
+ * Finds where the targets of the auto corrected mouse events of a running Macro are on the screen now. The next few
+ * targets are searched for ahead of time on a worker thread while the current event delays and executes, so the
+ * search overlaps with the recorded delays instead of adding to them. A speculative result is reused when the screen
+ * under the found target has not changed since it was searched; otherwise the target is searched for again, in line.
+ */
+class TargetResolver
+{
+public:
+
+    /**
+     * @brief LOOK_AHEAD
+     * The number of auto corrected mouse events that are searched for ahead of the current event.
+     */
+    const static int LOOK_AHEAD;
+
+    /**
+     * @brief The Stats struct
+     * How the targets of an activation were resolved.
+     */
+    typedef struct Stats
+    {
+        int speculativeHits;    // Reused a look-ahead search.
+        int staleFallbacks;     // Searched again because the screen changed after the look-ahead search.
+        int syncSearches;       // Searched in line because no look-ahead search was queued.
+        qint64 searchNs;        // Time spent searching, on either thread.
+        qint64 waitNs;          // Time the activation waited on a resolution.
+        int readyWaits;         // Readiness waits (see waitForStableTarget()).
+        int readyTimeouts;      // Readiness waits that gave up before the target area was stable.
+        qint64 readyWaitNs;     // Time spent in readiness waits.
+    } Stats;
+
+    explicit TargetResolver();
+    ~TargetResolver();
+
+    /**
+     * @brief start
+     * Starts resolving the targets of a plan that is about to run. Drops everything left over from a previous plan.
+     * @param plan The plan.
+     */
+    void start(const QSharedPointer<const ReplayPlan> &plan);
+
+    /**
+     * @brief stop
+     * Drops queued searches and waits for a running one to finish.
+     */
+    void stop();
+
+    /**
+     * @brief lookAhead
+     * Queues the targets of the next LOOK_AHEAD auto corrected mouse events, starting at an instruction, to be searched
+     * for on the worker thread. Results of instructions before it are dropped.
+     * @param instructionInd The index of the instruction that is about to run.
+     */
+    void lookAhead(int instructionInd);
+
+    /**
+     * @brief resolve
+     * Gets the position to move the mouse to for an auto corrected mouse event: the recorded position, shifted by
+     * however far its target has moved on the screen.
+     * @param instructionInd The index of the instruction.
+     * @return The position in screen coordinates.
+     */
+    QPoint resolve(int instructionInd);
+
+    /**
+     * @brief waitForStableTarget
+     * Waits until the recorded area of an instruction's target has stopped changing on the screen, which is when
+     * the UI is ready for the event. Gives up after a timeout and lets the event run anyway.
+     * @param instructionInd The index of the instruction (must have a target).
+     * @param stableMs How long the area must stay unchanged.
+     * @param timeoutMs How long to wait at most.
+     * @param scheduler The scheduler of the running activation, which the wait sleeps on.
+     * @return false if the activation was stopped during the wait, true otherwise.
+     */
+    bool waitForStableTarget(int instructionInd, int stableMs, int timeoutMs, ReplayScheduler &scheduler);
+
+    /**
+     * @brief stats
+     * @return How the targets of the activation have been resolved so far.
+     */
+    Stats stats() const;
+
+    /**
+     * @brief statsSummary
+     * Describes resolution stats in one line.
+     * @param stats The stats.
+     * @return The description.
+     */
+    static QString statsSummary(const Stats &stats);
+
+private:
+
+    /**
+     * @brief The Resolution struct
+     * A look-ahead search of an instruction's target.
+     */
+    typedef struct Resolution
+    {
+        bool done;
+        QRect rect;             // Where the target was found, in screen coordinates.
+        QImage screenshot;      // The screenshot that it was found in.
+    } Resolution;
+
+    /**
+     * @brief _plan
+     * The plan of the running Macro.
+     */
+    QSharedPointer<const ReplayPlan> _plan;
+
+    /**
+     * @brief _pool
+     * The single worker thread that searches ahead.
+     */
+    QThreadPool _pool;
+
+    /**
+     * @brief _resolutions
+     * The queued and finished look-ahead searches, keyed by instruction index.
+     */
+    QHash<int, Resolution> _resolutions;
+
+    /**
+     * @brief _lookAheadInd
+     * One past the last instruction that has been queued for look-ahead.
+     */
+    int _lookAheadInd;
+
+    /**
+     * @brief _stats
+     * How the targets have been resolved so far.
+     */
+    Stats _stats;
+
+    /**
+     * @brief _resolveMutex
+     * Guards _resolutions and _stats.
+     */
+    mutable QMutex _resolveMutex;
+
+    /**
+     * @brief _resolveDone
+     * Woken whenever a look-ahead search finishes.
+     */
+    QWaitCondition _resolveDone;
+
+    /**
+     * @brief searchAhead
+     * Runs on the worker thread. Searches for the target of an instruction in a fresh screenshot.
+     * @param instructionInd The index of the instruction.
+     */
+    void searchAhead(int instructionInd);
+
+    /**
+     * @brief search
+     * Searches for the target of an instruction in a screenshot.
+     * @param instructionInd The index of the instruction.
+     * @param screenshot The screenshot.
+     * @return Where the target was found, in screen coordinates.
+     */
+    QRect search(int instructionInd, const QImage &screenshot);
+
+    /**
+     * @brief captureScreen
+     * Takes a screenshot for an instruction's target.
+     * @param instructionInd The index of the instruction (only used for tracing).
+     * @return The screenshot.
+     */
+    static QImage captureScreen(int instructionInd);
+
+    /**
+     * @brief isUnchanged
+     * Checks if a region of the screen looks the same in two screenshots.
+     * @param before The earlier screenshot.
+     * @param after The later screenshot.
+     * @param rect The region in screen coordinates.
+     * @return true if unchanged, false otherwise.
+     */
+    static bool isUnchanged(const QImage &before, const QImage &after, const QRect &rect);
+
+    /**
+     * @brief targetResolverTest
+     * Resolves a color target that has moved in a color screenshot, end to end, and prints whether it was found where
+     * it moved to. Runs once, for the first resolver, when TEST_TARGET_RESOLVER is defined (debug builds).
+     */
+    static void targetResolverTest();
+
+    /**
+     * @brief _testScreen
+     * Stands in for the screen while targetResolverTest() runs (null otherwise).
+     */
+    static QImage _testScreen;
+};
+
+
+#endif // TARGETRESOLVER_H
@@ -10,8 +10,13 @@ int main(int argc, char *argv[])
 
     DBUtil::init(); // Make sure database entities are initialized!
 
-    MacroMenuController mainController;
-    mainController.assumeControlFromParent(); // Activate main controller (which will initialize proper Main Menu view)!
+    int exitCode;
+    {
+        MacroMenuController mainController;
+        mainController.assumeControlFromParent(); // Activate main controller (which will initialize proper Main Menu view)!
 
-    return a.exec();
+        exitCode = a.exec();
+    } // Destroying the main controller finishes the writes still queued on its DB service.
+    DBUtil::shutdown(); // Stop background DB maintenance and fold the WAL back into the database file.
+    return exitCode;
 }
@@ -0,0 +1,197 @@
+#include "DBMaintenanceThread.h"
+#include "DBUtil.h"
+#include "MacroEventModel.h"
+#include "ScreenshotStore.h"
+#include "ScreenshotThumbnails.h"
+#include "ReplayPlan.h"
+#include <QElapsedTimer>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QDebug>
+
+
+const int DBMaintenanceThread::IDLE_POLL_MS = 1000;
+const int DBMaintenanceThread::IDLE_THRESHOLD_MS = 2000;
+std::atomic<qint64> DBMaintenanceThread::_lastWriteMs(0);
+std::atomic<bool> DBMaintenanceThread::_walDirty(false);
+std::atomic<bool> DBMaintenanceThread::_sweepPending(true); // Sweeps anything left over from the last session.
+QSet<int> DBMaintenanceThread::_rebalanceMacroIds;
+QMutex DBMaintenanceThread::_rebalanceLock;
+QSet<int> DBMaintenanceThread::_replayPlanMacroIds;
+QMutex DBMaintenanceThread::_replayPlanLock;
+
+namespace {
+QElapsedTimer startedClock()
+{
+    QElapsedTimer clock;
+    clock.start();
+    return clock;
+}
+
+// Monotonic, so that wall clock changes can neither stall nor trigger the idle time maintenance.
+const QElapsedTimer writeClock = startedClock();
+}
+
+
+DBMaintenanceThread::DBMaintenanceThread()
+    : _run(true),
+      _runLock(),
+      _pollWaitCondition()
+{}
+
+
+DBMaintenanceThread::~DBMaintenanceThread()
+{
+    stop();
+}
+
+
+void DBMaintenanceThread::stop()
+{
+    _runLock.lock();
+    _run = false;
+    _pollWaitCondition.wakeAll();
+    _runLock.unlock();
+    wait();
+}
+
+
+void DBMaintenanceThread::notifyWrite()
+{
+    _lastWriteMs = writeClock.elapsed();
+    _walDirty = true;
+}
+
+
+void DBMaintenanceThread::requestEventOrderRebalance(int macroId)
+{
+    _rebalanceLock.lock();
+    _rebalanceMacroIds.insert(macroId);
+    _rebalanceLock.unlock();
+}
+
+
+void DBMaintenanceThread::requestScreenshotSweep()
+{
+    _sweepPending = true;
+}
+
+
+void DBMaintenanceThread::requestReplayPlan(int macroId)
+{
+    _replayPlanLock.lock();
+    _replayPlanMacroIds.insert(macroId);
+    _replayPlanLock.unlock();
+}
+
+
+void DBMaintenanceThread::run()
+{
+    // The checkpoint connection stays open, while the model opens and closes its own connection per operation.
+    QSqlDatabase db = DBUtil::threadConnection();
+    MacroEventModel *macroEventModel = new MacroEventModel(DBUtil::threadConnection("Model"));
+
+    while (waitForNextPoll()) {
+        compileReplayPlans(*macroEventModel);
+        if (isIdle()) {
+            rebalanceEventOrders(*macroEventModel);
+        }
+        if (_sweepPending && isIdle()) {
+            // Clear first so that a request made during the sweep is not lost.
+            _sweepPending = false;
+            int removedCount = ScreenshotStore::sweep(db);
+            if (removedCount < 0) {
+                _sweepPending = true;
+            }
+            else if (removedCount > 0) {
+                _walDirty = true;
+            }
+        }
+        if (isIdle() && ScreenshotThumbnails::persistPending(db) > 0) {
+            _walDirty = true;
+        }
+        if (isIdle() && ScreenshotStore::needsCompaction() && ScreenshotStore::compact(db)) {
+            _walDirty = true;
+        }
+        if (_walDirty && isIdle()) {
+            // Clear first so that a write committed during the checkpoint marks the WAL dirty again.
+            _walDirty = false;
+            if (!checkpoint(db, "PASSIVE")) {
+                _walDirty = true;
+            }
+        }
+    }
+
+    // Save the thumbnails that are still queued, then fold everything back into the database file and reset the WAL
+    // before exiting.
+    ScreenshotThumbnails::persistPending(db);
+    checkpoint(db, "TRUNCATE");
+    delete macroEventModel;
+    db = QSqlDatabase();
+    DBUtil::removeThreadConnection("Model");
+    DBUtil::removeThreadConnection();
+}
+
+
+bool DBMaintenanceThread::waitForNextPoll()
+{
+    _runLock.lock();
+    if (_run) {
+        _pollWaitCondition.wait(&_runLock, IDLE_POLL_MS);
+    }
+    bool run = _run;
+    _runLock.unlock();
+    return run;
+}
+
+
+bool DBMaintenanceThread::isIdle() const
+{
+    return (writeClock.elapsed() - _lastWriteMs) >= IDLE_THRESHOLD_MS;
+}
+
+
+void DBMaintenanceThread::rebalanceEventOrders(MacroEventModel &macroEventModel)
+{
+    _rebalanceLock.lock();
+    QSet<int> macroIds = _rebalanceMacroIds;
+    _rebalanceMacroIds.clear();
+    _rebalanceLock.unlock();
+
+    // Each Macro gets its own short transaction so a save never waits long on the write lock.
+    foreach (int macroId, macroIds) {
+        macroEventModel.rebalanceEventOrder(macroId);
+    }
+}
+
+
+void DBMaintenanceThread::compileReplayPlans(MacroEventModel &macroEventModel)
+{
+    _replayPlanLock.lock();
+    QSet<int> macroIds = _replayPlanMacroIds;
+    _replayPlanMacroIds.clear();
+    _replayPlanLock.unlock();
+
+    foreach (int macroId, macroIds) {
+        macroEventModel.setActiveMacro(macroId);
+        macroEventModel.getReplayPlan();
+    }
+}
+
+
+bool DBMaintenanceThread::checkpoint(QSqlDatabase &db, const QString &mode)
+{
+    QSqlQuery query(db);
+    if (!query.exec("PRAGMA wal_checkpoint(" + mode + ");") || !query.next()) {
+        QSqlError sqlErr = query.lastError();
+        qDebug() << "Error: WAL checkpoint (" << mode << ") failed!";
+        qDebug() << "SQLite Error: " << sqlErr.text() << "       SQLite Error Code: " << sqlErr.number();
+        return false;
+    }
+
+    // Result row is (busy, WAL frames, checkpointed frames).
+    bool busy = (query.value(0).toInt() != 0);
+    int walFrames = query.value(1).toInt();
+    int checkpointedFrames = query.value(2).toInt();
+    return (!busy && checkpointedFrames >= walFrames);
+}
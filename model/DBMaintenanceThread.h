@@ -0,0 +1,190 @@
+#ifndef DBMAINTENANCETHREAD_H
+#define DBMAINTENANCETHREAD_H
+
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSqlDatabase>
+#include <QSet>
+#include <atomic>
+
+
+class MacroEventModel;
+
+
+/**
+ * @brief The DBMaintenanceThread class
+ * Background thread that performs database maintenance while the application is idle. It owns its own
+ * database connections and, once no writes have been committed for a while, rebalances crowded Macro Event
+ * ordering keys, sweeps unreferenced screenshots, saves queued screenshot thumbnails, compacts the screenshot pack,
+ * and checkpoints the write-ahead log, so that this work never lands on a save or a paint. It also compiles the replay plans of saved Macros ahead of their
+ * activation.
+ */
+class DBMaintenanceThread : public QThread
+{
+
+    Q_OBJECT
+
+public:
+
+    /**
+     * @brief IDLE_POLL_MS
+     * How often (in milliseconds) the thread wakes up to check if maintenance should be performed.
+     */
+    const static int IDLE_POLL_MS;
+    /**
+     * @brief IDLE_THRESHOLD_MS
+     * How long (in milliseconds) the database must go without a committed write before it is considered idle.
+     */
+    const static int IDLE_THRESHOLD_MS;
+
+    explicit DBMaintenanceThread();
+    ~DBMaintenanceThread();
+
+    /**
+     * @brief stop
+     * Stops the maintenance thread and waits for it to finish. A final full checkpoint is performed before
+     * the thread finishes.
+     */
+    void stop();
+
+    /**
+     * @brief notifyWrite
+     * Notifies the maintenance thread that a write has been committed. Safe to call from any thread.
+     */
+    static void notifyWrite();
+
+    /**
+     * @brief requestEventOrderRebalance
+     * Queues a Macro to have its Macro Event ordering keys rebalanced the next time the database is idle.
+     * Safe to call from any thread.
+     * @param macroId The ID of the Macro to rebalance.
+     */
+    static void requestEventOrderRebalance(int macroId);
+
+    /**
+     * @brief requestScreenshotSweep
+     * Requests that screenshots which are no longer referenced be removed the next time the database is idle.
+     * Safe to call from any thread.
+     */
+    static void requestScreenshotSweep();
+
+    /**
+     * @brief requestReplayPlan
+     * Queues a Macro to have its replay plan compiled and cached (see ReplayPlan) at the next poll. Compiling only
+     * reads, so it does not wait for the database to go idle. Safe to call from any thread.
+     * @param macroId The ID of the Macro.
+     */
+    static void requestReplayPlan(int macroId);
+
+protected:
+
+    /**
+     * @brief run
+     * Maintenance loop.
+     */
+    void run() override;
+
+private:
+
+    /**
+     * @brief waitForNextPoll
+     * Blocks until the next poll interval or until stop() is called.
+     * @return true if the thread should keep running, false if it has been stopped.
+     */
+    bool waitForNextPoll();
+
+    /**
+     * @brief isIdle
+     * Checks if the database has gone long enough without a write to be considered idle.
+     * @return true if idle, false otherwise.
+     */
+    bool isIdle() const;
+
+    /**
+     * @brief checkpoint
+     * Checkpoints the write-ahead log.
+     * @param db The maintenance thread's database connection.
+     * @param mode The checkpoint mode (PASSIVE, FULL, RESTART, or TRUNCATE).
+     * @return true if every frame in the WAL was checkpointed, false if the checkpoint was partial or failed.
+     */
+    bool checkpoint(QSqlDatabase &db, const QString &mode);
+
+    /**
+     * @brief rebalanceEventOrders
+     * Rebalances the ordering keys of all Macros queued by requestEventOrderRebalance().
+     * @param macroEventModel The maintenance thread's Macro Event model.
+     */
+    void rebalanceEventOrders(MacroEventModel &macroEventModel);
+
+    /**
+     * @brief compileReplayPlans
+     * Compiles the replay plans of all Macros queued by requestReplayPlan().
+     * @param macroEventModel The maintenance thread's Macro Event model.
+     */
+    void compileReplayPlans(MacroEventModel &macroEventModel);
+
+    /**
+     * @brief _run
+     * Flag that is set false when the thread should stop.
+     */
+    bool _run;
+
+    /**
+     * @brief _runLock
+     * Lock guarding the _run flag.
+     */
+    QMutex _runLock;
+
+    /**
+     * @brief _pollWaitCondition
+     * Wait condition used to sleep between polls, and woken early by stop().
+     */
+    QWaitCondition _pollWaitCondition;
+
+    /**
+     * @brief _lastWriteMs
+     * Monotonic timestamp (ms since the write clock started) of the last committed write.
+     */
+    static std::atomic<qint64> _lastWriteMs;
+
+    /**
+     * @brief _walDirty
+     * Set when writes have been committed that have not been checkpointed yet.
+     */
+    static std::atomic<bool> _walDirty;
+
+    /**
+     * @brief _sweepPending
+     * Set when screenshots may have become unreferenced since the last sweep.
+     */
+    static std::atomic<bool> _sweepPending;
+
+    /**
+     * @brief _rebalanceMacroIds
+     * IDs of the Macros queued for an ordering key rebalance.
+     */
+    static QSet<int> _rebalanceMacroIds;
+
+    /**
+     * @brief _rebalanceLock
+     * Lock guarding _rebalanceMacroIds.
+     */
+    static QMutex _rebalanceLock;
+
+    /**
+     * @brief _replayPlanMacroIds
+     * IDs of the Macros queued to have their replay plans compiled.
+     */
+    static QSet<int> _replayPlanMacroIds;
+
+    /**
+     * @brief _replayPlanLock
+     * Lock guarding _replayPlanMacroIds.
+     */
+    static QMutex _replayPlanLock;
+};
+
+
+#endif // DBMAINTENANCETHREAD_H
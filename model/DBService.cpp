@@ -0,0 +1,257 @@
+#include "DBService.h"
+#include "DBUtil.h"
+#include "MacroEventModel.h"
+#include "MacroMetaModel.h"
+#include "proxy/MacroEventEditProxy.h"
+#include <QDebug>
+
+
+const int DBService::NO_SUPERSEDE_KEY = -1;
+
+
+DBService::DBService()
+    : _run(true),
+      _queueLock(),
+      _queueWaitCondition(),
+      _writesWaitCondition(),
+      _queue(),
+      _nextRequestId(0),
+      _runningRequestId(-1),
+      _runningType(LoadMacroMetadata),
+      _runningSupersedeKey(NO_SUPERSEDE_KEY),
+      _runningCancelled(false),
+      _cancelledRequestIds(),
+      _pendingWriteCount(0),
+      _results()
+{}
+
+
+DBService::~DBService()
+{
+    stop();
+}
+
+
+DBService::Request DBService::newRequest(RequestType type)
+{
+    Request request;
+    request.requestId = -1;
+    request.type = type;
+    request.supersedeKey = NO_SUPERSEDE_KEY;
+    request.hasAfter = false;
+    request.limit = -1;
+    request.sortOrder = ID_ASC;
+    return request;
+}
+
+
+void DBService::stop()
+{
+    _queueLock.lock();
+    _run = false;
+    _queueWaitCondition.wakeAll();
+    _queueLock.unlock();
+    wait();
+}
+
+
+int DBService::enqueue(Request request)
+{
+    _queueLock.lock();
+    request.requestId = _nextRequestId++;
+
+    if (isWrite(request.type)) {
+        _pendingWriteCount++;
+    }
+    else if (request.supersedeKey != NO_SUPERSEDE_KEY) {
+        // Superseded reads that are still queued are finished as cancelled by the worker, so that
+        // requestFinished() is always emitted from the worker thread.
+        foreach (const Request &queuedRequest, _queue) {
+            if (!isWrite(queuedRequest.type) && queuedRequest.supersedeKey == request.supersedeKey) {
+                _cancelledRequestIds.insert(queuedRequest.requestId);
+            }
+        }
+        if (_runningSupersedeKey == request.supersedeKey) {
+            _runningCancelled = true;
+        }
+    }
+
+    _queue.append(request);
+    _queueWaitCondition.wakeAll();
+    _queueLock.unlock();
+    return request.requestId;
+}
+
+
+bool DBService::takeResult(int requestId, Result &result)
+{
+    _queueLock.lock();
+    bool hasResult = _results.contains(requestId);
+    if (hasResult) {
+        result = _results.take(requestId);
+    }
+    _queueLock.unlock();
+    return hasResult;
+}
+
+
+void DBService::waitForWrites()
+{
+    _queueLock.lock();
+    while (_pendingWriteCount > 0) {
+        _writesWaitCondition.wait(&_queueLock);
+    }
+    _queueLock.unlock();
+}
+
+
+void DBService::run()
+{
+    // Like the GUI thread's models, the worker's models open and close their shared connection per operation.
+    MacroEventModel *macroEventModel = new MacroEventModel(DBUtil::threadConnection("Service"));
+    MacroMetaModel *macroMetaModel = new MacroMetaModel(*macroEventModel, DBUtil::threadConnection("Service"));
+
+    Request request;
+    bool cancelled;
+    while (takeNextRequest(request, cancelled)) {
+        Result result = { request.requestId, request.type, false, QList<MacroMetadata>(), QList<MacroEvent>() };
+
+        switch (request.type) {
+        case LoadMacroMetadata:
+            if (!cancelled) {
+                result.macroMetadata = macroMetaModel->getMacroMetadata(request.nameOrIdFilter,
+                                                                        request.hasAfter ? &request.after : nullptr,
+                                                                        request.limit, request.sortOrder);
+            }
+            break;
+        case LoadMacroEvents:
+            if (!cancelled) {
+                macroEventModel->setActiveMacros(request.macroIds);
+                result.macroEvents = macroEventModel->getUniformEvents();
+            }
+            break;
+        case RenameMacro:
+            macroMetaModel->setMacroName(request.macroIds.first(), request.macroName);
+            break;
+        case RemoveMacros:
+            macroMetaModel->removeMacros(request.macroIds);
+            break;
+        case CopyMacros:
+            result.macroMetadata = runCopyMacros(request, *macroMetaModel);
+            break;
+        case SaveEvents:
+            runSaveEvents(request, *macroEventModel);
+            break;
+        default:
+            qDebug() << "Error: Invalid request type in DBService::run(): " << request.type;
+            break;
+        }
+
+        finishRequest(result);
+    }
+
+    delete macroMetaModel;
+    delete macroEventModel;
+    DBUtil::removeThreadConnection("Service");
+}
+
+
+bool DBService::takeNextRequest(Request &request, bool &cancelled)
+{
+    _queueLock.lock();
+    while (_run && _queue.isEmpty()) {
+        _queueWaitCondition.wait(&_queueLock);
+    }
+
+    // Once stopped, only the queued writes are still run so that no edits are lost.
+    if (!_run) {
+        for (int i = _queue.size() - 1; i >= 0; i--) {
+            if (!isWrite(_queue.at(i).type)) {
+                _queue.removeAt(i);
+            }
+        }
+    }
+
+    bool hasRequest = !_queue.isEmpty();
+    if (hasRequest) {
+        request = _queue.takeFirst();
+        cancelled = _cancelledRequestIds.remove(request.requestId);
+        _runningRequestId = request.requestId;
+        _runningType = request.type;
+        _runningSupersedeKey = isWrite(request.type) ? NO_SUPERSEDE_KEY : request.supersedeKey;
+        _runningCancelled = cancelled;
+    }
+    _queueLock.unlock();
+    return hasRequest;
+}
+
+
+void DBService::finishRequest(Result &result)
+{
+    _queueLock.lock();
+    // A read may have been superseded while it was running.
+    result.cancelled = _runningCancelled;
+    if (result.cancelled) {
+        result.macroMetadata.clear();
+        result.macroEvents.clear();
+    }
+    if (isWrite(result.type)) {
+        _pendingWriteCount--;
+        _writesWaitCondition.wakeAll();
+    }
+    _runningRequestId = -1;
+    _runningSupersedeKey = NO_SUPERSEDE_KEY;
+    _runningCancelled = false;
+    _results.insert(result.requestId, result);
+    _queueLock.unlock();
+
+    emit requestFinished(result.requestId);
+}
+
+
+void DBService::reportProgress(int requestId, int doneCount, int totalCount)
+{
+    if (doneCount == totalCount || (doneCount * 100 / totalCount) != ((doneCount - 1) * 100 / totalCount)) {
+        emit requestProgress(requestId, doneCount, totalCount);
+    }
+}
+
+
+QList<MacroMetadata> DBService::runCopyMacros(const Request &request, MacroMetaModel &macroMetaModel)
+{
+    QList<MacroMetadata> copyResultList;
+    int totalCount = request.macroIds.size();
+
+    // Atomic operation like MacroMetaModel::copyMacros(), but one Macro at a time so that progress can be reported.
+    macroMetaModel.safeOpenAndBegin("Error: DB open and BEGIN TRANSACTION failed in DBService::runCopyMacros()");
+    for (int i = 0; i < totalCount; i++) {
+        copyResultList.append(macroMetaModel.copyMacro(request.macroIds.at(i)));
+        reportProgress(request.requestId, i + 1, totalCount);
+    }
+    macroMetaModel.safeCommitAndClose("Error: DB COMMIT failed in DBService::runCopyMacros()");
+    return copyResultList;
+}
+
+
+void DBService::runSaveEvents(const Request &request, MacroEventModel &macroEventModel)
+{
+    // Saved changes that have been undone since are reverted before the new changes are committed.
+    QList<MacroEventEdit> edits = request.revertEdits + request.edits;
+    int totalCount = edits.size();
+    macroEventModel.setActiveMacros(request.macroIds);
+
+    // Begin large all or nothing transaction when saving all events (also makes much more efficient).
+    macroEventModel.safeOpenAndBegin("Error: DB open and BEGIN TRANSACTION failed in DBService::runSaveEvents()");
+    for (int i = 0; i < totalCount; i++) {
+        MacroEventEditProxy::commitEdit(macroEventModel, edits, i, request.revertEdits.size(), request.macroEvents);
+        reportProgress(request.requestId, i + 1, totalCount);
+    }
+    macroEventModel.safeCommitAndClose("Error: DB COMMIT failed in DBService::runSaveEvents()");
+    macroEventModel.requestReplayPlans();
+}
+
+
+bool DBService::isWrite(RequestType type)
+{
+    return type != LoadMacroMetadata && type != LoadMacroEvents;
+}
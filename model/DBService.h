@@ -0,0 +1,287 @@
+#ifndef DBSERVICE_H
+#define DBSERVICE_H
+
+
+#include "MacroMetadata.h"
+#include "MacroEvent.h"
+#include "proxy/MacroEventEdit.h"
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QList>
+#include <QHash>
+#include <QSet>
+#include <QString>
+
+
+class MacroEventModel;
+class MacroMetaModel;
+
+
+/**
+ * @brief The DBService class
+ * Runs the database work requested from the GUI (Macro metadata and Macro Event reads, Macro renaming, removal and
+ * copying, and saving edited Macro Events) on a dedicated worker thread with its own connection, so that the GUI thread never waits on the
+ * database. Requests run one at a time in the order that they were queued, so a read always sees the writes that
+ * were queued before it. A read may be given a supersede key, and queueing another read with the same key cancels
+ * it (e.g. a search for text that the user has since typed over). Writes cannot be cancelled, and report their
+ * progress as they go. Every request leaves a result behind that must be taken with takeResult() once
+ * requestFinished() is emitted for it.
+ */
+class DBService : public QThread
+{
+
+    Q_OBJECT
+
+public:
+
+    /**
+     * @brief The RequestType enum
+     * The operations that the service can run. LoadMacroMetadata and LoadMacroEvents are reads, the rest are writes.
+     */
+    typedef enum RequestType {
+        LoadMacroMetadata, LoadMacroEvents, RenameMacro, RemoveMacros, CopyMacros, SaveEvents
+    } RequestType;
+
+    /**
+     * @brief The Request struct
+     * A queued operation. Only the members used by its type need to be set (see newRequest()).
+     */
+    typedef struct Request {
+        int requestId;                      // Assigned by enqueue().
+        RequestType type;
+        int supersedeKey;                   // Reads with the same key cancel each other. -1 for none.
+        QList<int> macroIds;                // RenameMacro (the one Macro), LoadMacroEvents, RemoveMacros, CopyMacros,
+                                            // and SaveEvents.
+        QString macroName;                  // RenameMacro
+        QString nameOrIdFilter;             // LoadMacroMetadata
+        bool hasAfter;                      // LoadMacroMetadata: continue from after instead of the beginning.
+        MacroMetadata after;                // LoadMacroMetadata
+        int limit;                          // LoadMacroMetadata: -1 for no limit.
+        MacroMetadataSortOrder sortOrder;   // LoadMacroMetadata
+        QList<MacroEventEdit> revertEdits;  // SaveEvents: saved change log entries since undone, to revert first.
+        QList<MacroEventEdit> edits;        // SaveEvents: the change log entries to save, in order.
+        QList<MacroEvent> macroEvents;      // SaveEvents: the latest Macro Events being edited.
+    } Request;
+
+    /**
+     * @brief The Result struct
+     * The outcome of a request.
+     */
+    typedef struct Result {
+        int requestId;
+        RequestType type;
+        bool cancelled;                     // Set if the read was cancelled, in which case there is no data.
+        QList<MacroMetadata> macroMetadata; // LoadMacroMetadata, and CopyMacros (the copies).
+        QList<MacroEvent> macroEvents;      // LoadMacroEvents: the uniform events of the Macros.
+    } Result;
+
+    /**
+     * @brief NO_SUPERSEDE_KEY
+     * The supersede key of requests that are never superseded.
+     */
+    const static int NO_SUPERSEDE_KEY;
+
+    explicit DBService();
+    ~DBService();
+
+    /**
+     * @brief newRequest
+     * Creates a request of a given type with every other member set to its default.
+     * @param type The request type.
+     * @return The request.
+     */
+    static Request newRequest(RequestType type);
+
+    /**
+     * @brief stop
+     * Stops the service and waits for it to finish. Queued writes are run before the thread finishes, while queued
+     * reads are dropped.
+     */
+    void stop();
+
+    /**
+     * @brief enqueue
+     * Queues a request to be run after all previously queued requests. If it is a read with a supersede key, any
+     * queued or running read with the same key is cancelled.
+     * @param request The request.
+     * @return The ID of the request.
+     */
+    int enqueue(Request request);
+
+    /**
+     * @brief takeResult
+     * Takes the result of a finished request. Each result can only be taken once.
+     * @param requestId The ID of the request.
+     * @param result Set to the result on success.
+     * @return true if the request had finished and its result had not been taken yet, false otherwise.
+     */
+    bool takeResult(int requestId, Result &result);
+
+    /**
+     * @brief waitForWrites
+     * Blocks until every queued write has been committed. Must be called before reading or writing through
+     * models on other connections that depend on the queued writes (reads queued on the service need not wait).
+     */
+    void waitForWrites();
+
+signals:
+
+    /**
+     * @brief requestProgress
+     * Emitted from the worker thread as a write makes progress.
+     * @param requestId The ID of the write.
+     * @param doneCount The number of items (Macros or changes) done so far.
+     * @param totalCount The total number of items.
+     */
+    void requestProgress(int requestId, int doneCount, int totalCount);
+
+    /**
+     * @brief requestFinished
+     * Emitted from the worker thread when a request has finished or was cancelled. Its result can then be taken.
+     * @param requestId The ID of the request.
+     */
+    void requestFinished(int requestId);
+
+protected:
+
+    /**
+     * @brief run
+     * Request loop.
+     */
+    void run() override;
+
+private:
+
+    /**
+     * @brief takeNextRequest
+     * Blocks until a request is queued or until stop() is called, and takes the next request off of the queue.
+     * @param request Set to the next request.
+     * @param cancelled Set true if the request is a read that was cancelled while it was queued.
+     * @return true if there is a request to run, false if the thread should finish.
+     */
+    bool takeNextRequest(Request &request, bool &cancelled);
+
+    /**
+     * @brief finishRequest
+     * Stores the result of the running request, and emits requestFinished().
+     * @param result The result.
+     */
+    void finishRequest(Result &result);
+
+    /**
+     * @brief reportProgress
+     * Emits requestProgress() for a write, but only when its whole percentage changes or it is done, so that large
+     * writes do not flood the GUI thread with a signal per item.
+     * @param requestId The ID of the write.
+     * @param doneCount The number of items done so far.
+     * @param totalCount The total number of items.
+     */
+    void reportProgress(int requestId, int doneCount, int totalCount);
+
+    /**
+     * @brief runCopyMacros
+     * Copies Macros one by one in a single transaction, reporting progress as it goes.
+     * @param request The CopyMacros request.
+     * @param macroMetaModel The worker thread's Macro metadata model.
+     * @return The metadata of the copies.
+     */
+    QList<MacroMetadata> runCopyMacros(const Request &request, MacroMetaModel &macroMetaModel);
+
+    /**
+     * @brief runSaveEvents
+     * Commits the change log entries one by one in a single transaction, reporting progress as it goes.
+     * @param request The SaveEvents request.
+     * @param macroEventModel The worker thread's Macro Event model.
+     */
+    void runSaveEvents(const Request &request, MacroEventModel &macroEventModel);
+
+    /**
+     * @brief isWrite
+     * Checks if a request type writes to the database.
+     * @param type The request type.
+     * @return true for writes, false for reads.
+     */
+    static bool isWrite(RequestType type);
+
+    /**
+     * @brief _run
+     * Flag that is set false when the thread should stop.
+     */
+    bool _run;
+
+    /**
+     * @brief _queueLock
+     * Lock guarding _run and all of the members below.
+     */
+    QMutex _queueLock;
+
+    /**
+     * @brief _queueWaitCondition
+     * Woken when a request is queued or when stop() is called.
+     */
+    QWaitCondition _queueWaitCondition;
+
+    /**
+     * @brief _writesWaitCondition
+     * Woken whenever a write finishes.
+     */
+    QWaitCondition _writesWaitCondition;
+
+    /**
+     * @brief _queue
+     * The requests that have not started running yet, in order.
+     */
+    QList<Request> _queue;
+
+    /**
+     * @brief _nextRequestId
+     * The ID given to the next queued request.
+     */
+    int _nextRequestId;
+
+    /**
+     * @brief _runningRequestId
+     * The ID of the running request. -1 if none.
+     */
+    int _runningRequestId;
+
+    /**
+     * @brief _runningType
+     * The type of the running request.
+     */
+    RequestType _runningType;
+
+    /**
+     * @brief _runningSupersedeKey
+     * The supersede key of the running request.
+     */
+    int _runningSupersedeKey;
+
+    /**
+     * @brief _runningCancelled
+     * Set when the running read is superseded. Its result is dropped once it finishes.
+     */
+    bool _runningCancelled;
+
+    /**
+     * @brief _cancelledRequestIds
+     * The IDs of the queued reads that have been superseded.
+     */
+    QSet<int> _cancelledRequestIds;
+
+    /**
+     * @brief _pendingWriteCount
+     * The number of queued and running writes.
+     */
+    int _pendingWriteCount;
+
+    /**
+     * @brief _results
+     * The results that have not been taken yet, by request ID.
+     */
+    QHash<int, Result> _results;
+};
+
+
+#endif // DBSERVICE_H
@@ -1,10 +1,24 @@
 //#define RECREATE_DB
 
 #include "DBUtil.h"
+#include "DBMaintenanceThread.h"
+#include "MacroEventModel.h"
+#include "ScreenshotStore.h"
+#include "ScreenshotThumbnails.h"
 #include <QDebug>
 #include <QFile>
 #include <QDir>
 #include <QSqlError>
+#include <QThread>
+#include <QVariantList>
+#include <QStringList>
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+#include <Windows.h>
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 
 const QString DBUtil::DB_PATH = "QT_DYNA_MACROS";
@@ -13,9 +27,18 @@ const QString DBUtil::MACRO_EVENTS_TABLE_NAME = "MacroEvents";
 const QString DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME = "MacroMouseEvents";
 const QString DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME = "MacroKeyboardEvents";
 const QString DBUtil::SCREENSHOT_TABLE_NAME = "Screenshots";
+const QString DBUtil::SCREENSHOT_BLOB_TABLE_NAME = "ScreenshotBlobs";
+const QString DBUtil::SCREENSHOT_PACK_TABLE_NAME = "ScreenshotPack";
+const QString DBUtil::SCREENSHOT_THUMBNAIL_TABLE_NAME = "ScreenshotThumbnails";
 const QString DBUtil::SCREENSHOT_DIR_PATH = "./screenshots/";
 const QString DBUtil::DB_CONNECTION_NAME = "MACROS_CONNECTION";
+const QString DBUtil::MACRO_EVENT_ORDER_TEMP_TABLE_NAME = "MacroEventOrder";
+const QString DBUtil::MACRO_EVENT_ID_REMAP_TEMP_TABLE_NAME = "MacroEventIdRemap";
+const QString DBUtil::MACRO_NAME_SEARCH_TABLE_NAME = "MacroNameSearch";
+const int DBUtil::SCHEMA_VERSION = 9;
 QSqlDatabase DBUtil::_db;
+DBMaintenanceThread *DBUtil::_maintenanceThread = nullptr;
+bool DBUtil::_nameSearchIndex = false;
 
 
 void DBUtil::init()
@@ -30,10 +53,115 @@ void DBUtil::init()
         qDebug() << "Error: Connection with database " << DB_PATH << " failed!";
         exit(1);
     }
-    initTables();
+    initJournalMode();
+    applyConnectionPragmas(_db);
+
+    // Databases that predate the current schema must be migrated, while new ones get the latest schema right away.
+    bool isNewDb = !tableExists(MACROS_TABLE_NAME);
     initScreenshotDir();
+    if (!isNewDb) migrateTables(getSchemaVersion());
+    initTables();
+    if (isNewDb) setSchemaVersion(SCHEMA_VERSION);
+    ScreenshotStore::init(_db);
+
     printMacroInfo();
     _db.close();
+
+    // Start idle time checkpointing. Its connection stays open for the life of the application, which also
+    // keeps SQLite from checkpointing and deleting the WAL every time a model closes its connection.
+    _maintenanceThread = new DBMaintenanceThread();
+    _maintenanceThread->start(QThread::LowPriority);
+}
+
+
+void DBUtil::shutdown()
+{
+    if (_maintenanceThread != nullptr) {
+        _maintenanceThread->stop();
+        delete _maintenanceThread;
+        _maintenanceThread = nullptr;
+    }
+    ScreenshotThumbnails::shutdown();
+    ScreenshotStore::shutdown();
+}
+
+
+bool DBUtil::applyConnectionPragmas(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+    bool success = true;
+
+    // In WAL mode NORMAL only syncs at checkpoints; a power loss may roll back the last commits but never corrupts.
+    success &= query.exec("PRAGMA synchronous = NORMAL");
+    // Negative cache size is in KiB (16 MiB page cache).
+    success &= query.exec("PRAGMA cache_size = -16384");
+    // Read pages straight out of the OS page cache instead of copying them into our own buffers.
+    success &= query.exec("PRAGMA mmap_size = 268435456");
+    // Keep temp tables and sort/group-by scratch space in memory.
+    success &= query.exec("PRAGMA temp_store = MEMORY");
+    // Wait on a competing writer (e.g. a checkpoint) instead of failing right away with SQLITE_BUSY.
+    success &= query.exec("PRAGMA busy_timeout = 5000");
+    // Truncate the WAL back down after checkpoints so it does not stay at its high water mark.
+    success &= query.exec("PRAGMA journal_size_limit = 67108864");
+
+    if (!success) {
+        QSqlError sqlErr = query.lastError();
+        qDebug() << "Error: Failed to apply connection pragmas for database " << DB_PATH;
+        qDebug() << "SQLite Error: " << sqlErr.text() << "       SQLite Error Code: " << sqlErr.number();
+    }
+    return success;
+}
+
+
+QSqlDatabase DBUtil::threadConnection(const QString &connectionTag)
+{
+    QString connectionName = threadConnectionName(connectionTag);
+    if (QSqlDatabase::contains(connectionName)) {
+        return QSqlDatabase::database(connectionName);
+    }
+
+    QSqlDatabase db = QSqlDatabase::addDatabase("QSQLITE", connectionName);
+    db.setDatabaseName(DB_PATH);
+    if (!db.open()) {
+        qDebug() << "Error: Thread connection with database " << DB_PATH << " failed!";
+        exit(1);
+    }
+    applyConnectionPragmas(db);
+    QSqlQuery query(db);
+    query.exec("PRAGMA foreign_keys = ON");
+    return db;
+}
+
+
+void DBUtil::removeThreadConnection(const QString &connectionTag)
+{
+    QString connectionName = threadConnectionName(connectionTag);
+    if (QSqlDatabase::contains(connectionName)) {
+        {
+            QSqlDatabase db = QSqlDatabase::database(connectionName, false);
+            db.close();
+        } // db handle must be out of scope before removal!
+        QSqlDatabase::removeDatabase(connectionName);
+    }
+}
+
+
+QString DBUtil::threadConnectionName(const QString &connectionTag)
+{
+    return DB_CONNECTION_NAME + "_" + QString::number((quintptr)QThread::currentThreadId()) + connectionTag;
+}
+
+
+void DBUtil::initJournalMode()
+{
+    QSqlQuery query(_db);
+    query.prepare("PRAGMA journal_mode = WAL;");
+    safeExec(query, "Error: Switching " + DB_PATH + " to WAL journal mode failed!");
+
+    // SQLite reports the resulting mode, which stays as the old mode if WAL could not be enabled (e.g. network drives).
+    if (query.next() && query.value(0).toString().toLower() != "wal") {
+        qDebug() << "Warning: WAL journal mode unavailable, using mode: " << query.value(0).toString();
+    }
 }
 
 
@@ -53,31 +181,52 @@ void DBUtil::initTables()
 
     // Create Sceenshots Table.
     query.prepare("CREATE TABLE IF NOT EXISTS " + SCREENSHOT_TABLE_NAME + " ( \n"
-                                                                          "   screenshotId INTEGER PRIMARY KEY, \n" // This is screenshot file name!
+                                                                          "   screenshotId INTEGER PRIMARY KEY, \n"
                                                                           "   screenshotX INTEGER, \n"
                                                                           "   screenshotY INTEGER, \n"
                                                                           "   screenshotW INTEGER, \n"
                                                                           "   screenshotH INTEGER, \n"
                                                                           "   targetImgType INTEGER, \n"
-                                                                          "   cursorType INTEGER \n"
+                                                                          "   cursorType INTEGER, \n"
+                                                                          "   blobHash BLOB, \n" // Target crop image in the screenshot pack (see ScreenshotStore)!
+                                                                          "   cropX INTEGER, \n" // Screen coordinates of the target crop.
+                                                                          "   cropY INTEGER, \n"
+                                                                          "   contextBlobHash BLOB, \n" // Downscaled full screen context image (optional).
+                                                                          "   contextScale REAL, \n"
+                                                                          "   refCount INTEGER NOT NULL DEFAULT 0, \n" // Referencing Macro Mouse Events, maintained by triggers!
+                                                                          "   FOREIGN KEY (blobHash) REFERENCES " + SCREENSHOT_BLOB_TABLE_NAME + "(blobHash), \n"
+                                                                          "   FOREIGN KEY (contextBlobHash) REFERENCES " + SCREENSHOT_BLOB_TABLE_NAME + "(blobHash) \n"
                                                                           " );");
     safeExec(query, "Error: " + SCREENSHOT_TABLE_NAME + " table create failed with query: \n" + query.lastQuery());
+    // Lets the blob reference check be answered from the index alone.
+    query.prepare("CREATE INDEX IF NOT EXISTS screenshotBlobHashIndex ON " + SCREENSHOT_TABLE_NAME + " (blobHash);");
+    safeExec(query, "Error: Creation of Index on " + SCREENSHOT_TABLE_NAME + ".blobHash failed!");
+    query.prepare("CREATE INDEX IF NOT EXISTS screenshotContextBlobHashIndex ON " + SCREENSHOT_TABLE_NAME + " (contextBlobHash);");
+    safeExec(query, "Error: Creation of Index on " + SCREENSHOT_TABLE_NAME + ".contextBlobHash failed!");
+    // Only holds the screenshots waiting to be swept (see ScreenshotStore::sweep()).
+    query.prepare("CREATE INDEX IF NOT EXISTS screenshotUnreferencedIndex ON " + SCREENSHOT_TABLE_NAME + " (screenshotId) \n"
+                  "WHERE refCount=0;");
+    safeExec(query, "Error: Creation of partial Index on " + SCREENSHOT_TABLE_NAME + ".refCount failed!");
+    ScreenshotStore::initTables(_db);
+    ScreenshotThumbnails::initTables(_db);
 
     // Create MacroEvents Table.
     query.prepare("CREATE TABLE IF NOT EXISTS " + MACRO_EVENTS_TABLE_NAME + " ( \n"
                                                                             "   macroEventId INTEGER PRIMARY KEY AUTOINCREMENT, \n"
                                                                             "   macroId INTEGER NOT NULL, \n"
-                                                                            "   macroEventInd INTEGER NOT NULL, \n"
+                                                                            "   macroEventOrd INTEGER NOT NULL, \n" // Sparse ordering key (see MacroEventModel::EVENT_ORDER_GAP)!
                                                                             "   macroEventType INTEGER, \n"
                                                                             "   delayMs INTEGER, \n"
                                                                             "   durationMs INTEGER, \n"
                                                                             "   nRepeats INTEGER, \n"
                                                                             "   targetPID VARCHAR(50), \n"
+                                                                            "   eventHash INTEGER, \n" // See MacroEventModel::computeEventHash()!
                                                                             "   FOREIGN KEY (macroId) REFERENCES " + MACROS_TABLE_NAME + "(macroId) \n"
                                                                             ");");
     safeExec(query, "Error: " + MACRO_EVENTS_TABLE_NAME + " table create failed with query: \n" + query.lastQuery());
-    query.prepare("CREATE INDEX IF NOT EXISTS macroIdIndex ON " + MACRO_EVENTS_TABLE_NAME + " (macroId);");
-    safeExec(query, "Error: Creation of Index on " + MACRO_EVENTS_TABLE_NAME + ".macroId failed!");
+    // Covers reading a Macro's event order together with the event identity hashes.
+    query.prepare("CREATE INDEX IF NOT EXISTS macroEventOrdIndex ON " + MACRO_EVENTS_TABLE_NAME + " (macroId, macroEventOrd, eventHash);");
+    safeExec(query, "Error: Creation of Index on " + MACRO_EVENTS_TABLE_NAME + "(macroId, macroEventOrd, eventHash) failed!");
 
     // Create MacroMouseEvents Table.
     query.prepare("CREATE TABLE IF NOT EXISTS " + MACRO_MOUSE_EVENTS_TABLE_NAME + " ( \n"
@@ -92,8 +241,9 @@ void DBUtil::initTables()
                                                                                   "   FOREIGN KEY (screenshotId) REFERENCES " + SCREENSHOT_TABLE_NAME + "(screenshotId) \n"
                                                                                   ");");
     safeExec(query, "Error: " + MACRO_MOUSE_EVENTS_TABLE_NAME + " table create failed with query: \n" + query.lastQuery());
-    query.prepare("CREATE INDEX IF NOT EXISTS screenshotIdIndex ON " + SCREENSHOT_TABLE_NAME + " (screenshotId);");
-    safeExec(query, "Error: Creation of Index on " + MACRO_MOUSE_EVENTS_TABLE_NAME + ".screenshotFile failed!");
+    // Lets the screenshot reference check be answered from the index alone.
+    query.prepare("CREATE INDEX IF NOT EXISTS mouseEventScreenshotIdIndex ON " + MACRO_MOUSE_EVENTS_TABLE_NAME + " (screenshotId);");
+    safeExec(query, "Error: Creation of Index on " + MACRO_MOUSE_EVENTS_TABLE_NAME + ".screenshotId failed!");
 
     // Create MacroKeyboardEvents Table.
     query.prepare("CREATE TABLE IF NOT EXISTS " + MACRO_KEYBOARD_EVENTS_TABLE_NAME + " ( \n"
@@ -108,6 +258,472 @@ void DBUtil::initTables()
                                                                                      "   FOREIGN KEY (macroEventId) REFERENCES " + MACRO_EVENTS_TABLE_NAME + "(macroEventId) ON DELETE CASCADE \n"
                                                                                      ");");
     safeExec(query, "Error: " + MACRO_KEYBOARD_EVENTS_TABLE_NAME + " table create failed with query: \n" + query.lastQuery());
+
+    initRefCountTriggers();
+    initNameSearchIndex();
+}
+
+
+void DBUtil::initNameSearchIndex()
+{
+    QSqlQuery query(_db);
+    bool isNewIndex = !tableExists(MACRO_NAME_SEARCH_TABLE_NAME);
+
+    // External content table, so the names are not stored twice. Trigram tokens match any substring of 3+ chars.
+    query.prepare("CREATE VIRTUAL TABLE IF NOT EXISTS " + MACRO_NAME_SEARCH_TABLE_NAME + " USING fts5( \n"
+                  "   macroName, \n"
+                  "   content='" + MACROS_TABLE_NAME + "', \n"
+                  "   content_rowid='macroId', \n"
+                  "   tokenize='trigram' \n"
+                  ");");
+    if (!query.exec()) {
+        qDebug() << "Warning: Macro name search index unavailable, falling back to LIKE scans: " << query.lastError().text();
+        _nameSearchIndex = false;
+        return;
+    }
+
+    query.prepare("CREATE TRIGGER IF NOT EXISTS macroNameSearchInsert AFTER INSERT ON " + MACROS_TABLE_NAME + " BEGIN \n"
+                  "   INSERT INTO " + MACRO_NAME_SEARCH_TABLE_NAME + " (rowid, macroName) VALUES (NEW.macroId, NEW.macroName); \n"
+                  "END;");
+    safeExec(query, "Error: Trigger macroNameSearchInsert create failed with query: \n" + query.lastQuery());
+    query.prepare("CREATE TRIGGER IF NOT EXISTS macroNameSearchDelete AFTER DELETE ON " + MACROS_TABLE_NAME + " BEGIN \n"
+                  "   INSERT INTO " + MACRO_NAME_SEARCH_TABLE_NAME + " (" + MACRO_NAME_SEARCH_TABLE_NAME + ", rowid, macroName) \n"
+                  "   VALUES ('delete', OLD.macroId, OLD.macroName); \n"
+                  "END;");
+    safeExec(query, "Error: Trigger macroNameSearchDelete create failed with query: \n" + query.lastQuery());
+    query.prepare("CREATE TRIGGER IF NOT EXISTS macroNameSearchUpdate AFTER UPDATE OF macroName ON " + MACROS_TABLE_NAME + " BEGIN \n"
+                  "   INSERT INTO " + MACRO_NAME_SEARCH_TABLE_NAME + " (" + MACRO_NAME_SEARCH_TABLE_NAME + ", rowid, macroName) \n"
+                  "   VALUES ('delete', OLD.macroId, OLD.macroName); \n"
+                  "   INSERT INTO " + MACRO_NAME_SEARCH_TABLE_NAME + " (rowid, macroName) VALUES (NEW.macroId, NEW.macroName); \n"
+                  "END;");
+    safeExec(query, "Error: Trigger macroNameSearchUpdate create failed with query: \n" + query.lastQuery());
+
+    if (isNewIndex) {
+        qDebug() << "Building Macro name search index";
+        query.prepare("INSERT INTO " + MACRO_NAME_SEARCH_TABLE_NAME + " (" + MACRO_NAME_SEARCH_TABLE_NAME + ") VALUES ('rebuild');");
+        safeExec(query, "Error: Building the Macro name search index failed!");
+    }
+    _nameSearchIndex = true;
+}
+
+
+bool DBUtil::hasNameSearchIndex()
+{
+    return _nameSearchIndex;
+}
+
+
+void DBUtil::initRefCountTriggers()
+{
+    QSqlQuery query(_db);
+
+    // Macro Mouse Events reference Screenshots (deletes of Macro Events cascade down to them).
+    query.prepare("CREATE TRIGGER IF NOT EXISTS mouseEventScreenshotRefInsert AFTER INSERT ON " + MACRO_MOUSE_EVENTS_TABLE_NAME + " \n"
+                  "WHEN NEW.screenshotId IS NOT NULL BEGIN \n"
+                  "   UPDATE " + SCREENSHOT_TABLE_NAME + " SET refCount=refCount+1 WHERE screenshotId=NEW.screenshotId; \n"
+                  "END;");
+    safeExec(query, "Error: Trigger mouseEventScreenshotRefInsert create failed with query: \n" + query.lastQuery());
+    query.prepare("CREATE TRIGGER IF NOT EXISTS mouseEventScreenshotRefDelete AFTER DELETE ON " + MACRO_MOUSE_EVENTS_TABLE_NAME + " \n"
+                  "WHEN OLD.screenshotId IS NOT NULL BEGIN \n"
+                  "   UPDATE " + SCREENSHOT_TABLE_NAME + " SET refCount=refCount-1 WHERE screenshotId=OLD.screenshotId; \n"
+                  "END;");
+    safeExec(query, "Error: Trigger mouseEventScreenshotRefDelete create failed with query: \n" + query.lastQuery());
+    query.prepare("CREATE TRIGGER IF NOT EXISTS mouseEventScreenshotRefUpdate AFTER UPDATE OF screenshotId ON " + MACRO_MOUSE_EVENTS_TABLE_NAME + " \n"
+                  "WHEN OLD.screenshotId IS NOT NEW.screenshotId BEGIN \n"
+                  "   UPDATE " + SCREENSHOT_TABLE_NAME + " SET refCount=refCount-1 WHERE screenshotId=OLD.screenshotId; \n"
+                  "   UPDATE " + SCREENSHOT_TABLE_NAME + " SET refCount=refCount+1 WHERE screenshotId=NEW.screenshotId; \n"
+                  "END;");
+    safeExec(query, "Error: Trigger mouseEventScreenshotRefUpdate create failed with query: \n" + query.lastQuery());
+
+    // Screenshots reference their target crop and context blobs.
+    query.prepare("CREATE TRIGGER IF NOT EXISTS screenshotBlobRefInsert AFTER INSERT ON " + SCREENSHOT_TABLE_NAME + " BEGIN \n"
+                  "   UPDATE " + SCREENSHOT_BLOB_TABLE_NAME + " SET refCount=refCount+1 WHERE blobHash=NEW.blobHash; \n"
+                  "   UPDATE " + SCREENSHOT_BLOB_TABLE_NAME + " SET refCount=refCount+1 WHERE blobHash=NEW.contextBlobHash; \n"
+                  "END;");
+    safeExec(query, "Error: Trigger screenshotBlobRefInsert create failed with query: \n" + query.lastQuery());
+    query.prepare("CREATE TRIGGER IF NOT EXISTS screenshotBlobRefDelete AFTER DELETE ON " + SCREENSHOT_TABLE_NAME + " BEGIN \n"
+                  "   UPDATE " + SCREENSHOT_BLOB_TABLE_NAME + " SET refCount=refCount-1 WHERE blobHash=OLD.blobHash; \n"
+                  "   UPDATE " + SCREENSHOT_BLOB_TABLE_NAME + " SET refCount=refCount-1 WHERE blobHash=OLD.contextBlobHash; \n"
+                  "END;");
+    safeExec(query, "Error: Trigger screenshotBlobRefDelete create failed with query: \n" + query.lastQuery());
+    query.prepare("CREATE TRIGGER IF NOT EXISTS screenshotBlobRefUpdate AFTER UPDATE OF blobHash, contextBlobHash ON " + SCREENSHOT_TABLE_NAME + " BEGIN \n"
+                  "   UPDATE " + SCREENSHOT_BLOB_TABLE_NAME + " SET refCount=refCount-1 WHERE blobHash=OLD.blobHash; \n"
+                  "   UPDATE " + SCREENSHOT_BLOB_TABLE_NAME + " SET refCount=refCount-1 WHERE blobHash=OLD.contextBlobHash; \n"
+                  "   UPDATE " + SCREENSHOT_BLOB_TABLE_NAME + " SET refCount=refCount+1 WHERE blobHash=NEW.blobHash; \n"
+                  "   UPDATE " + SCREENSHOT_BLOB_TABLE_NAME + " SET refCount=refCount+1 WHERE blobHash=NEW.contextBlobHash; \n"
+                  "END;");
+    safeExec(query, "Error: Trigger screenshotBlobRefUpdate create failed with query: \n" + query.lastQuery());
+
+    // Deltas reference their keyframe blobs.
+    query.prepare("CREATE TRIGGER IF NOT EXISTS keyframeBlobRefInsert AFTER INSERT ON " + SCREENSHOT_BLOB_TABLE_NAME + " \n"
+                  "WHEN NEW.keyframeBlobHash IS NOT NULL BEGIN \n"
+                  "   UPDATE " + SCREENSHOT_BLOB_TABLE_NAME + " SET refCount=refCount+1 WHERE blobHash=NEW.keyframeBlobHash; \n"
+                  "END;");
+    safeExec(query, "Error: Trigger keyframeBlobRefInsert create failed with query: \n" + query.lastQuery());
+    query.prepare("CREATE TRIGGER IF NOT EXISTS keyframeBlobRefDelete AFTER DELETE ON " + SCREENSHOT_BLOB_TABLE_NAME + " \n"
+                  "WHEN OLD.keyframeBlobHash IS NOT NULL BEGIN \n"
+                  "   UPDATE " + SCREENSHOT_BLOB_TABLE_NAME + " SET refCount=refCount-1 WHERE blobHash=OLD.keyframeBlobHash; \n"
+                  "END;");
+    safeExec(query, "Error: Trigger keyframeBlobRefDelete create failed with query: \n" + query.lastQuery());
+}
+
+
+void DBUtil::migrateTables(int fromVersion)
+{
+    if (fromVersion < 1) {
+        qDebug() << "Migrating database " << DB_PATH << " to schema version 1 (sparse Macro Event ordering keys)";
+        migrateToEventOrderKeys();
+        setSchemaVersion(1);
+    }
+    if (fromVersion < 2) {
+        // The old screenshot index was on the Screenshots primary key instead of MacroMouseEvents.screenshotId.
+        // Its replacement is created by initTables().
+        qDebug() << "Migrating database " << DB_PATH << " to schema version 2 (screenshot reference index)";
+        QSqlQuery query(_db);
+        query.prepare("DROP INDEX IF EXISTS screenshotIdIndex;");
+        safeExec(query, "Error: Drop of index screenshotIdIndex failed!");
+        setSchemaVersion(2);
+    }
+    if (fromVersion < 3) {
+        qDebug() << "Migrating database " << DB_PATH << " to schema version 3 (Macro Event identity hashes)";
+        migrateToEventHashes();
+        setSchemaVersion(3);
+    }
+    if (fromVersion < 4) {
+        qDebug() << "Migrating database " << DB_PATH << " to schema version 4 (screenshot pack store)";
+        migrateToScreenshotStore();
+        setSchemaVersion(4);
+    }
+    if (fromVersion < 5) {
+        // Existing screenshots are exactly the target crop without a margin, and have no context.
+        qDebug() << "Migrating database " << DB_PATH << " to schema version 5 (screenshot target crops and contexts)";
+        QSqlQuery query(_db);
+        query.prepare("ALTER TABLE " + SCREENSHOT_TABLE_NAME + " ADD COLUMN cropX INTEGER;");
+        safeExec(query, "Error: Adding cropX column to " + SCREENSHOT_TABLE_NAME + " failed!");
+        query.prepare("ALTER TABLE " + SCREENSHOT_TABLE_NAME + " ADD COLUMN cropY INTEGER;");
+        safeExec(query, "Error: Adding cropY column to " + SCREENSHOT_TABLE_NAME + " failed!");
+        query.prepare("ALTER TABLE " + SCREENSHOT_TABLE_NAME + " ADD COLUMN contextBlobHash BLOB REFERENCES " + SCREENSHOT_BLOB_TABLE_NAME + "(blobHash);");
+        safeExec(query, "Error: Adding contextBlobHash column to " + SCREENSHOT_TABLE_NAME + " failed!");
+        query.prepare("ALTER TABLE " + SCREENSHOT_TABLE_NAME + " ADD COLUMN contextScale REAL;");
+        safeExec(query, "Error: Adding contextScale column to " + SCREENSHOT_TABLE_NAME + " failed!");
+        query.prepare("UPDATE " + SCREENSHOT_TABLE_NAME + " SET cropX=screenshotX, cropY=screenshotY;");
+        safeExec(query, "Error: Filling in " + SCREENSHOT_TABLE_NAME + " crop origins failed!");
+        setSchemaVersion(5);
+    }
+    if (fromVersion < 6) {
+        // Existing blobs are all PNG. Databases migrated from before version 4 got the codec column on creation.
+        qDebug() << "Migrating database " << DB_PATH << " to schema version 6 (screenshot blob codecs)";
+        if (!columnExists(SCREENSHOT_BLOB_TABLE_NAME, "codec")) {
+            QSqlQuery query(_db);
+            query.prepare("ALTER TABLE " + SCREENSHOT_BLOB_TABLE_NAME + " ADD COLUMN codec INTEGER NOT NULL DEFAULT "
+                          + QString::number(ScreenshotCodec::PNG) + ";");
+            safeExec(query, "Error: Adding codec column to " + SCREENSHOT_BLOB_TABLE_NAME + " failed!");
+        }
+        setSchemaVersion(6);
+    }
+    if (fromVersion < 7) {
+        // Existing blobs are all keyframes. Its index is created by initTables().
+        qDebug() << "Migrating database " << DB_PATH << " to schema version 7 (screenshot tile deltas)";
+        if (!columnExists(SCREENSHOT_BLOB_TABLE_NAME, "keyframeBlobHash")) {
+            QSqlQuery query(_db);
+            query.prepare("ALTER TABLE " + SCREENSHOT_BLOB_TABLE_NAME + " ADD COLUMN keyframeBlobHash BLOB REFERENCES "
+                          + SCREENSHOT_BLOB_TABLE_NAME + "(blobHash);");
+            safeExec(query, "Error: Adding keyframeBlobHash column to " + SCREENSHOT_BLOB_TABLE_NAME + " failed!");
+        }
+        setSchemaVersion(7);
+    }
+    if (fromVersion < 8) {
+        qDebug() << "Migrating database " << DB_PATH << " to schema version 8 (screenshot reference counts)";
+        migrateToRefCounts();
+        setSchemaVersion(8);
+    }
+    if (fromVersion < 9) {
+        // The thumbnail table starts out empty and is created by initTables().
+        qDebug() << "Migrating database " << DB_PATH << " to schema version 9 (screenshot thumbnails)";
+        setSchemaVersion(9);
+    }
+}
+
+
+void DBUtil::migrateToEventOrderKeys()
+{
+    QSqlQuery query(_db);
+    QString migrateTableName = MACRO_EVENTS_TABLE_NAME + "Migrate";
+
+    // SQLite cannot drop or retype columns in place, so rebuild the table. Foreign keys are not enforced on this
+    // connection, so dropping the old table will not cascade into the mouse and keyboard event tables.
+    if (!_db.transaction()) {
+        qDebug() << "Error: BEGIN TRANSACTION failed in migrateToEventOrderKeys()";
+        exit(1);
+    }
+    query.prepare("CREATE TABLE " + migrateTableName + " ( \n"
+                  "   macroEventId INTEGER PRIMARY KEY AUTOINCREMENT, \n"
+                  "   macroId INTEGER NOT NULL, \n"
+                  "   macroEventOrd INTEGER NOT NULL, \n"
+                  "   macroEventType INTEGER, \n"
+                  "   delayMs INTEGER, \n"
+                  "   durationMs INTEGER, \n"
+                  "   nRepeats INTEGER, \n"
+                  "   targetPID VARCHAR(50), \n"
+                  "   FOREIGN KEY (macroId) REFERENCES " + MACROS_TABLE_NAME + "(macroId) \n"
+                  ");");
+    safeExec(query, "Error: " + migrateTableName + " table create failed with query: \n" + query.lastQuery());
+
+    // Old dense indexes become evenly spaced ordering keys.
+    query.prepare("INSERT INTO " + migrateTableName + " \n"
+                  "   (macroEventId, macroId, macroEventOrd, macroEventType, delayMs, durationMs, nRepeats, targetPID) \n"
+                  "SELECT macroEventId, macroId, (macroEventInd + 1) * " + QString::number(MacroEventModel::EVENT_ORDER_GAP) + ", \n"
+                  "       macroEventType, delayMs, durationMs, nRepeats, targetPID \n"
+                  "FROM " + MACRO_EVENTS_TABLE_NAME + ";");
+    safeExec(query, "Error: Copy into " + migrateTableName + " failed with query: \n" + query.lastQuery());
+
+    query.prepare("DROP TABLE " + MACRO_EVENTS_TABLE_NAME + ";");
+    safeExec(query, "Error: Drop of old " + MACRO_EVENTS_TABLE_NAME + " table failed!");
+    query.prepare("ALTER TABLE " + migrateTableName + " RENAME TO " + MACRO_EVENTS_TABLE_NAME + ";");
+    safeExec(query, "Error: Rename of " + migrateTableName + " table failed!");
+    query.prepare("CREATE INDEX IF NOT EXISTS macroEventOrdIndex ON " + MACRO_EVENTS_TABLE_NAME + " (macroId, macroEventOrd);");
+    safeExec(query, "Error: Creation of Index on " + MACRO_EVENTS_TABLE_NAME + "(macroId, macroEventOrd) failed!");
+
+    if (!_db.commit()) {
+        qDebug() << "Error: COMMIT failed in migrateToEventOrderKeys()";
+        exit(1);
+    }
+}
+
+
+void DBUtil::migrateToEventHashes()
+{
+    QSqlQuery query(_db);
+
+    if (!_db.transaction()) {
+        qDebug() << "Error: BEGIN TRANSACTION failed in migrateToEventHashes()";
+        exit(1);
+    }
+    query.prepare("ALTER TABLE " + MACRO_EVENTS_TABLE_NAME + " ADD COLUMN eventHash INTEGER;");
+    safeExec(query, "Error: Adding eventHash column to " + MACRO_EVENTS_TABLE_NAME + " failed!");
+
+    // The hash is computed in C++, so read back each event's identity fields and write its hash.
+    query.prepare("SELECT \n"
+                  "   " + MACRO_EVENTS_TABLE_NAME + ".macroEventId, macroEventType, nRepeats, targetPID, \n"
+                  "   macroMouseEventType, xLoc, yLoc, wheelDelta, screenshotId, \n"
+                  "   macrokeyboardEventType, keyCode, mod1, mod2, capsLock, numLock, keyString \n"
+                  "FROM " + MACRO_EVENTS_TABLE_NAME + " \n"
+                  "LEFT JOIN " + MACRO_MOUSE_EVENTS_TABLE_NAME + " \n"
+                  "   ON " + MACRO_EVENTS_TABLE_NAME + ".macroEventId = " + MACRO_MOUSE_EVENTS_TABLE_NAME + ".macroEventId \n"
+                  "LEFT JOIN " + MACRO_KEYBOARD_EVENTS_TABLE_NAME + " \n"
+                  "   ON " + MACRO_EVENTS_TABLE_NAME + ".macroEventId = " + MACRO_KEYBOARD_EVENTS_TABLE_NAME + ".macroEventId;");
+    safeExec(query, "Error: Reading Macro Event identities failed with query: \n" + query.lastQuery());
+
+    QVariantList eventHashes,
+                 macroEventIds;
+    while (query.next()) {
+        MacroEvent event;
+        event.type = (MacroEventType)query.value("macroEventType").toInt();
+        event.nRepeats = query.value("nRepeats").toInt();
+        event.targetPID = query.value("targetPID").toString();
+        event.mouseEvent.type = (MacroMouseEventType)query.value("macroMouseEventType").toInt();
+        event.mouseEvent.loc = QPoint(query.value("xLoc").toInt(), query.value("yLoc").toInt());
+        event.mouseEvent.wheelDelta = query.value("wheelDelta").toInt();
+        event.mouseEvent.screenshotId = query.value("screenshotId").isNull() ? -1 : query.value("screenshotId").toInt();
+        event.keyboardEvent.type = (MacroKeyboardEventType)query.value("macrokeyboardEventType").toInt();
+        event.keyboardEvent.keyCode = query.value("keyCode").toInt();
+        event.keyboardEvent.mod1 = query.value("mod1").toInt();
+        event.keyboardEvent.mod2 = query.value("mod2").toInt();
+        event.keyboardEvent.capsLock = (query.value("capsLock").toInt() == 1);
+        event.keyboardEvent.numLock = (query.value("numLock").toInt() == 1);
+        event.keyboardEvent.keyString = query.value("keyString").toString();
+
+        eventHashes.append(MacroEventModel::computeEventHash(event));
+        macroEventIds.append(query.value("macroEventId").toInt());
+    }
+
+    query.prepare("UPDATE " + MACRO_EVENTS_TABLE_NAME + " SET eventHash=? WHERE macroEventId=?;");
+    query.addBindValue(eventHashes);
+    query.addBindValue(macroEventIds);
+    if (!query.execBatch()) {
+        qDebug() << "Error: Writing Macro Event identity hashes failed: " << query.lastError().text();
+        exit(1);
+    }
+
+    // Rebuild the ordering index so it also covers the hashes.
+    query.prepare("DROP INDEX IF EXISTS macroEventOrdIndex;");
+    safeExec(query, "Error: Drop of index macroEventOrdIndex failed!");
+    query.prepare("CREATE INDEX macroEventOrdIndex ON " + MACRO_EVENTS_TABLE_NAME + " (macroId, macroEventOrd, eventHash);");
+    safeExec(query, "Error: Creation of Index on " + MACRO_EVENTS_TABLE_NAME + "(macroId, macroEventOrd, eventHash) failed!");
+
+    if (!_db.commit()) {
+        qDebug() << "Error: COMMIT failed in migrateToEventHashes()";
+        exit(1);
+    }
+}
+
+
+void DBUtil::migrateToScreenshotStore()
+{
+    QSqlQuery query(_db);
+    QStringList importedFiles;
+
+    if (!_db.transaction()) {
+        qDebug() << "Error: BEGIN TRANSACTION failed in migrateToScreenshotStore()";
+        exit(1);
+    }
+    ScreenshotStore::initTables(_db);
+    query.prepare("ALTER TABLE " + SCREENSHOT_TABLE_NAME + " ADD COLUMN blobHash BLOB REFERENCES " + SCREENSHOT_BLOB_TABLE_NAME + "(blobHash);");
+    safeExec(query, "Error: Adding blobHash column to " + SCREENSHOT_TABLE_NAME + " failed!");
+    ScreenshotStore::init(_db);
+
+    // The PNG files go into the pack as is, without being decoded and re-encoded.
+    query.prepare("SELECT screenshotId FROM " + SCREENSHOT_TABLE_NAME + ";");
+    safeExec(query, "Error: Reading screenshot IDs failed with query: \n" + query.lastQuery());
+    QVariantList blobHashes,
+                 screenshotIds;
+    while (query.next()) {
+        int screenshotId = query.value("screenshotId").toInt();
+        QString screenshotPath = SCREENSHOT_DIR_PATH + QString::number(screenshotId) + ".png";
+        QFile screenshotFile(screenshotPath);
+        if (!screenshotFile.open(QIODevice::ReadOnly)) {
+            qDebug() << "Warning: Missing screenshot file during migration: " << screenshotPath;
+            continue;
+        }
+        blobHashes.append(ScreenshotStore::put(_db, ScreenshotStore::fromEncoded(screenshotFile.readAll(), ScreenshotCodec::PNG)));
+        screenshotIds.append(screenshotId);
+        importedFiles.append(screenshotPath);
+    }
+
+    if (!screenshotIds.isEmpty()) {
+        query.prepare("UPDATE " + SCREENSHOT_TABLE_NAME + " SET blobHash=? WHERE screenshotId=?;");
+        query.addBindValue(blobHashes);
+        query.addBindValue(screenshotIds);
+        if (!query.execBatch()) {
+            qDebug() << "Error: Writing screenshot blob hashes failed: " << query.lastError().text();
+            exit(1);
+        }
+    }
+
+    // The files are removed once committed, so the pack and the commit itself must be on disk first (synchronous
+    // NORMAL would only sync the commit at the next checkpoint).
+    if (!ScreenshotStore::syncStaged(_db) || !DBUtil::syncDir(SCREENSHOT_DIR_PATH)) {
+        qDebug() << "Error: Syncing the screenshot pack failed in migrateToScreenshotStore()";
+        exit(1);
+    }
+    query.exec("PRAGMA synchronous = FULL");
+    if (!_db.commit()) {
+        qDebug() << "Error: COMMIT failed in migrateToScreenshotStore()";
+        exit(1);
+    }
+    query.exec("PRAGMA synchronous = NORMAL");
+    ScreenshotStore::publishStaged(_db);
+
+    // Only remove the files once the pack index is committed.
+    foreach (const QString &screenshotPath, importedFiles) {
+        QFile::remove(screenshotPath);
+    }
+    qDebug() << "Moved " << importedFiles.size() << " screenshot files into the screenshot pack";
+}
+
+
+bool DBUtil::syncFile(QFile &file)
+{
+    if (!file.flush()) return false;
+    #if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+        return FlushFileBuffers((HANDLE)_get_osfhandle(file.handle())) != 0;
+    #else
+        return fsync(file.handle()) == 0;
+    #endif
+}
+
+
+bool DBUtil::syncDir(const QString &dirPath)
+{
+    #if defined(WIN32) || defined(_WIN32) || defined(__WIN32) && !defined(__CYGWIN__)
+        Q_UNUSED(dirPath);
+        return true;
+    #else
+        int dirFd = ::open(QFile::encodeName(dirPath).constData(), O_RDONLY);
+        if (dirFd < 0) return false;
+        bool success = (fsync(dirFd) == 0);
+        ::close(dirFd);
+        return success;
+    #endif
+}
+
+
+int DBUtil::getSchemaVersion()
+{
+    QSqlQuery query(_db);
+    query.prepare("PRAGMA user_version;");
+    safeExec(query, "Error: Failed to read schema version of database " + DB_PATH);
+    return query.next() ? query.value(0).toInt() : 0;
+}
+
+
+void DBUtil::setSchemaVersion(int version)
+{
+    // PRAGMA arguments cannot be bound.
+    QSqlQuery query(_db);
+    query.prepare("PRAGMA user_version = " + QString::number(version) + ";");
+    safeExec(query, "Error: Failed to set schema version of database " + DB_PATH);
+}
+
+
+void DBUtil::migrateToRefCounts()
+{
+    QSqlQuery query(_db);
+    if (!query.exec("BEGIN TRANSACTION;")) {
+        qDebug() << "Error: BEGIN TRANSACTION failed in migrateToRefCounts()";
+        exit(1);
+    }
+
+    if (!columnExists(SCREENSHOT_TABLE_NAME, "refCount")) {
+        query.prepare("ALTER TABLE " + SCREENSHOT_TABLE_NAME + " ADD COLUMN refCount INTEGER NOT NULL DEFAULT 0;");
+        safeExec(query, "Error: Adding refCount column to " + SCREENSHOT_TABLE_NAME + " failed!");
+    }
+    if (!columnExists(SCREENSHOT_BLOB_TABLE_NAME, "refCount")) {
+        query.prepare("ALTER TABLE " + SCREENSHOT_BLOB_TABLE_NAME + " ADD COLUMN refCount INTEGER NOT NULL DEFAULT 0;");
+        safeExec(query, "Error: Adding refCount column to " + SCREENSHOT_BLOB_TABLE_NAME + " failed!");
+    }
+
+    // Count the existing references once; the triggers created by initTables() keep the counts up to date from here on.
+    query.prepare("UPDATE " + SCREENSHOT_TABLE_NAME + " SET refCount=( \n"
+                  "   SELECT COUNT(*) FROM " + MACRO_MOUSE_EVENTS_TABLE_NAME + " \n"
+                  "   WHERE " + MACRO_MOUSE_EVENTS_TABLE_NAME + ".screenshotId=" + SCREENSHOT_TABLE_NAME + ".screenshotId \n"
+                  ");");
+    safeExec(query, "Error: Counting " + SCREENSHOT_TABLE_NAME + " references failed with query: \n" + query.lastQuery());
+    query.prepare("UPDATE " + SCREENSHOT_BLOB_TABLE_NAME + " SET refCount=( \n"
+                  "   SELECT COUNT(*) FROM " + SCREENSHOT_TABLE_NAME + " WHERE blobHash=" + SCREENSHOT_BLOB_TABLE_NAME + ".blobHash \n"
+                  ") + ( \n"
+                  "   SELECT COUNT(*) FROM " + SCREENSHOT_TABLE_NAME + " WHERE contextBlobHash=" + SCREENSHOT_BLOB_TABLE_NAME + ".blobHash \n"
+                  ") + ( \n"
+                  "   SELECT COUNT(*) FROM " + SCREENSHOT_BLOB_TABLE_NAME + " AS delta WHERE delta.keyframeBlobHash=" + SCREENSHOT_BLOB_TABLE_NAME + ".blobHash \n"
+                  ");");
+    safeExec(query, "Error: Counting " + SCREENSHOT_BLOB_TABLE_NAME + " references failed with query: \n" + query.lastQuery());
+
+    if (!query.exec("COMMIT;")) {
+        qDebug() << "Error: COMMIT failed in migrateToRefCounts()";
+        exit(1);
+    }
+}
+
+
+bool DBUtil::tableExists(const QString &tableName)
+{
+    QSqlQuery query(_db);
+    query.prepare("SELECT 1 FROM sqlite_master WHERE type='table' AND name=:tableName;");
+    query.bindValue(":tableName", tableName);
+    safeExec(query, "Error: Failed to look up table " + tableName + " in sqlite_master!");
+    return query.next();
+}
+
+
+bool DBUtil::columnExists(const QString &tableName, const QString &columnName)
+{
+    QSqlQuery query(_db);
+    query.prepare("PRAGMA table_info(" + tableName + ");");
+    safeExec(query, "Error: Failed to look up the columns of table " + tableName + "!");
+    while (query.next()) {
+        if (query.value("name").toString() == columnName) return true;
+    }
+    return false;
 }
 
 
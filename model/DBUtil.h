@@ -3,6 +3,7 @@
 
 
 #include <QSqlDatabase>
+#include <QFile>
 #include <QSqlQuery>
 #include <QPoint>
 #include <QList>
@@ -12,6 +13,9 @@
 #include "MacroEvent.h"
 
 
+class DBMaintenanceThread;
+
+
 /**
  * @brief The DBUtil class
  *  Utility for initialization and general information pertaining to database.
@@ -27,8 +31,15 @@ public:
     const static QString MACRO_MOUSE_EVENTS_TABLE_NAME;
     const static QString MACRO_KEYBOARD_EVENTS_TABLE_NAME;
     const static QString SCREENSHOT_TABLE_NAME;
+    const static QString SCREENSHOT_BLOB_TABLE_NAME;
+    const static QString SCREENSHOT_PACK_TABLE_NAME;
+    const static QString SCREENSHOT_THUMBNAIL_TABLE_NAME;
     const static QString SCREENSHOT_DIR_PATH;
     const static QString DB_CONNECTION_NAME;
+    const static QString MACRO_EVENT_ORDER_TEMP_TABLE_NAME;
+    const static QString MACRO_EVENT_ID_REMAP_TEMP_TABLE_NAME;
+    const static QString MACRO_NAME_SEARCH_TABLE_NAME;
+    const static int SCHEMA_VERSION;
 
     /**
      * @brief init
@@ -36,6 +47,68 @@ public:
      */
     static void init();
 
+    /**
+     * @brief shutdown
+     * Stops background database maintenance and folds the write-ahead log back into the database file.
+     * Should be called once before the application exits.
+     */
+    static void shutdown();
+
+    /**
+     * @brief applyConnectionPragmas
+     * Applies the per connection tuning pragmas (synchronous level, cache size, mmap size, temp store, and busy timeout).
+     * SQLite does not persist these, so they must be applied every time a connection is opened.
+     * @param db The opened database connection to tune.
+     * @return A success flag of true if all pragmas were applied, false otherwise.
+     */
+    static bool applyConnectionPragmas(QSqlDatabase &db);
+
+    /**
+     * @brief threadConnection
+     * Gets (and creates if necessary) an opened and tuned database connection that is owned by the calling thread.
+     * Qt database connections may only be used by the thread that created them, so background threads must
+     * use this instead of the main DB_CONNECTION_NAME connection. In WAL mode, reads on these connections
+     * can run concurrently with a write on any other connection.
+     * @param connectionTag (OPTIONAL) Tag that distinguishes multiple connections owned by the same thread.
+     * @return The calling thread's database connection.
+     */
+    static QSqlDatabase threadConnection(const QString &connectionTag=QString());
+
+    /**
+     * @brief removeThreadConnection
+     * Closes and removes the calling thread's database connection (see threadConnection()).
+     * Should be called by a background thread before it finishes.
+     * @param connectionTag (OPTIONAL) See threadConnection().
+     */
+    static void removeThreadConnection(const QString &connectionTag=QString());
+
+    /**
+     * @brief hasNameSearchIndex
+     * Checks if the trigram full-text index of Macro names (MACRO_NAME_SEARCH_TABLE_NAME) is available. It needs
+     * an SQLite build with FTS5 and the trigram tokenizer; without it, name searches fall back to LIKE scans.
+     * @return true if available, false otherwise.
+     */
+    static bool hasNameSearchIndex();
+
+    /**
+     * @brief syncFile
+     * Flushes the data written to a file all the way to the disk, not just to the OS (fsync / FlushFileBuffers).
+     * Files that database rows point into must be synced before those rows are committed.
+     * @param file The file, opened for writing.
+     * @return A success flag of true if the file was synced, false otherwise.
+     */
+    static bool syncFile(QFile &file);
+
+    /**
+     * @brief syncDir
+     * Flushes the entries of a directory (e.g. a newly created file) to the disk, so that the new file survives a
+     * power loss before the file that it replaces is removed. Windows cannot flush a directory, and NTFS journals
+     * its directory changes instead, so this does nothing there.
+     * @param dirPath The path of the directory.
+     * @return A success flag of true if the directory was synced, false otherwise.
+     */
+    static bool syncDir(const QString &dirPath);
+
 private:
 
     /**
@@ -48,6 +121,82 @@ private:
      * Initializes the tables within the database.
      */
     static void initTables();
+    /**
+     * @brief initRefCountTriggers
+     * Creates the triggers that keep the Screenshots and ScreenshotBlobs reference counts up to date.
+     */
+    static void initRefCountTriggers();
+    /**
+     * @brief initNameSearchIndex
+     * Creates the trigram full-text index of Macro names and the triggers that keep it in sync, if SQLite supports it.
+     * A newly created index is filled in from the existing Macros.
+     */
+    static void initNameSearchIndex();
+    /**
+     * @brief migrateTables
+     * Brings the tables of a database created by an older version of the application up to SCHEMA_VERSION.
+     * @param fromVersion The schema version stored in the database (PRAGMA user_version).
+     */
+    static void migrateTables(int fromVersion);
+    /**
+     * @brief migrateToEventOrderKeys
+     * Schema version 1: replaces the dense MacroEvents.macroEventInd column with the sparse macroEventOrd ordering key.
+     */
+    static void migrateToEventOrderKeys();
+    /**
+     * @brief migrateToEventHashes
+     * Schema version 3: adds the MacroEvents.eventHash identity hash column and fills it in for existing events.
+     */
+    static void migrateToEventHashes();
+    /**
+     * @brief migrateToScreenshotStore
+     * Schema version 4: moves the per screenshot PNG files into the screenshot pack store (see ScreenshotStore).
+     */
+    static void migrateToScreenshotStore();
+    /**
+     * @brief migrateToRefCounts
+     * Schema version 8: adds the Screenshots and ScreenshotBlobs reference counts and counts existing references.
+     */
+    static void migrateToRefCounts();
+    /**
+     * @brief getSchemaVersion
+     * Gets the schema version stored in the database.
+     * @return The schema version (0 for databases that predate schema versioning).
+     */
+    static int getSchemaVersion();
+    /**
+     * @brief setSchemaVersion
+     * Stores the schema version in the database.
+     * @param version The schema version.
+     */
+    static void setSchemaVersion(int version);
+    /**
+     * @brief tableExists
+     * Checks if a table exists in the database.
+     * @param tableName The name of the table.
+     * @return true if it exists, false otherwise.
+     */
+    static bool tableExists(const QString &tableName);
+    /**
+     * @brief columnExists
+     * Checks if a column exists in a table of the database.
+     * @param tableName The name of the table.
+     * @param columnName The name of the column.
+     * @return true if it exists, false otherwise.
+     */
+    static bool columnExists(const QString &tableName, const QString &columnName);
+    /**
+     * @brief threadConnectionName
+     * Generates the connection name of the calling thread's connection.
+     * @param connectionTag See threadConnection().
+     * @return The connection name.
+     */
+    static QString threadConnectionName(const QString &connectionTag);
+    /**
+     * @brief initJournalMode
+     * Switches the database into write-ahead log journaling mode. This setting is persisted in the database file.
+     */
+    static void initJournalMode();
     /**
      * @brief initScreenshotDir
      * Creates the screenshot directory if it does not exist.
@@ -84,12 +233,24 @@ private:
      */
     static void printMacroInfo();
 
+    /**
+     * @brief _nameSearchIndex
+     * Set by init() if the Macro name search index is available (see hasNameSearchIndex()).
+     */
+    static bool _nameSearchIndex;
+
     /**
      * @brief _db
      * The database connection.
      */
     static QSqlDatabase _db;
 
+    /**
+     * @brief _maintenanceThread
+     * Background thread that performs idle time database maintenance (e.g. WAL checkpointing).
+     */
+    static DBMaintenanceThread *_maintenanceThread;
+
     // Static utility class; no constructors, no copies!
     DBUtil();
     DBUtil(const DBUtil &copyFrom){}
@@ -16,6 +16,8 @@ MacroEvent::MacroEvent()
     mouseEvent.loc = QPoint(0, 0);
     mouseEvent.wheelDelta = 0;
     mouseEvent.screenshotId = -1;
+    mouseEvent.screenshotOrg = QPoint(0, 0);
+    mouseEvent.contextScale = 0;
     mouseEvent.screenshotRect = QRect(0, 0, 0, 0);
     mouseEvent.autoCorrect = true;
 
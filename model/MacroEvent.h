@@ -7,6 +7,7 @@
 #include <QRect>
 #include <QList>
 #include <QImage>
+#include "ScreenshotHandle.h"
 
 
 enum MacroMouseEventType {
@@ -62,7 +63,10 @@ typedef struct MacroMouseEvent
     QPoint loc;
     int wheelDelta;
     int screenshotId;
-    QImage screenshotImg;
+    ScreenshotHandle screenshot;            // Full resolution crop of the target plus a margin around it.
+    QPoint screenshotOrg;                   // Screen coordinates of the crop's top left corner.
+    ScreenshotHandle contextScreenshot;     // Downscaled full screen context (may be null).
+    double contextScale;                    // Scale of the context relative to the screen.
     QRect screenshotRect;
     TargetImgType targetImgType;
     CursorType cursorType;
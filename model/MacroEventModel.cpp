@@ -4,24 +4,55 @@
 #define TEST_MACRO_EVENT_GET
 #define TEST_MACRO_EVENT_SET
 #define PRINT_ALL
+#ifndef QT_NO_DEBUG
+#define TEST_QUERY_PLANS
+#define TEST_SCREENSHOT_SWEEP_HOLD
+#endif
 
 #include "MacroEventModel.h"
 #include "DBUtil.h"
-#include <QFile>
-#include <QFileInfo>
+#include "DBMaintenanceThread.h"
+#include "SqlIdSet.h"
+#include "ScreenshotStore.h"
+#include "ReplayPlan.h"
+#include <QVariantList>
+#include <QStringList>
+#include <QSqlRecord>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QtConcurrent/QtConcurrent>
 #include <QDebug>
 #include <algorithm>
 
 
+const qint64 MacroEventModel::EVENT_ORDER_GAP = 1048576; // 2^20
+const qint64 MacroEventModel::EVENT_ORDER_CROWDED_GAP = 1024;
+const int MacroEventModel::MAX_DELTA_KEYFRAMES = 8;
+
+
 MacroEventModel::MacroEventModel() :
     Model(QSqlDatabase::database(DBUtil::DB_CONNECTION_NAME)),
-    _activeMacroIds()
+    _activeMacroIds(),
+    _eventOrders(),
+    _eventOrdersOpenCount(0),
+    _deltaKeyframes(),
+    _encodedScreenshots()
 {
     _db.setDatabaseName(DBUtil::DB_PATH);
     macroEventTest();
 }
 
 
+MacroEventModel::MacroEventModel(QSqlDatabase db) :
+    Model(db),
+    _activeMacroIds(),
+    _eventOrders(),
+    _eventOrdersOpenCount(0),
+    _deltaKeyframes(),
+    _encodedScreenshots()
+{}
+
+
 void MacroEventModel::setActiveMacro(int activeMacroId)
 {
     QList<int> activeMacroIds;
@@ -69,10 +100,19 @@ void MacroEventModel::addEvent(const MacroEvent &event)
 
 void MacroEventModel::addEvents(QList<MacroEvent> &events)
 {
-    int index,
+    int eventInd,
         macroEventId;
+    qint64 orderKey;
     bool append = (events.size() > 0 && events.first().index < 0); // Append if event.index < 0.
 
+    // Insert in increasing index order so each event ends up at its own index once all events are added.
+    // Only the new rows are written; existing events keep their ordering keys. Also sorted before encoding, so that
+    // screenshots are delta encoded against their predecessors in the Macro.
+    if (!append) std::sort(events.begin(), events.end());
+
+    // Encode new screenshots before opening the transaction; encoding is far slower than the inserts.
+    encodeNewScreenshots(events);
+
     // Determine if we do not have pre-established database connection from caller.
     bool isPartOfLargerTransaction = _db.isOpen();
     if (!isPartOfLargerTransaction) {
@@ -80,48 +120,56 @@ void MacroEventModel::addEvents(QList<MacroEvent> &events)
     }
     QSqlQuery macroEventsQuery(_db);
 
-    // If append, get number of events in Macro for insert index.
-    // Else, make sure we make room for Macro Event insertions.
-    if (append) index = _getNumEventsForMacro(_activeMacroIds.first()) - 1; // Sub 1 here b/c increments right away in foreach below.
-    else        correctEventIndexesBeforeAdd(events);
-
     // Must perform INSERT query foreach new Macro Event.
     foreach (MacroEvent event, events) {
-        // If append, just increment index which was set first above.
-        // Else get insert index from the event.
-        append ? index++
-               : index = event.index;
-
         // Build query for insert into MacroEvents table.
         QString macroEventsQueryStr =
             "INSERT INTO " + DBUtil::MACRO_EVENTS_TABLE_NAME + str("(\n\t") +
                 "macroId,        \n\t"
-                "macroEventInd,  \n\t"
+                "macroEventOrd,  \n\t"
                 "macroEventType, \n\t"
                 "delayMs,        \n\t"
                 "durationMs,     \n\t"
                 "nRepeats,       \n\t"
-                "targetPID       \n"
+                "targetPID,      \n\t"
+                "eventHash       \n"
             ") \n"
             "VALUES ( \n\t"
-                ":macroId,                      \n\t" +
-                str(index)                 + ", \n\t" +
+                ":macroId,                      \n\t"
+                ":macroEventOrd,                \n\t" +
                 str(event.type)            + ", \n\t" +
                 str(event.delayMs)         + ", \n\t" +
                 str(event.durationMs)      + ", \n\t" +
-                str(event.nRepeats)        + ", \n\t" +
-                str("'") + event.targetPID + "' \n"
+                str(event.nRepeats)        + ", \n\t"
+                ":targetPID,                    \n\t"
+                ":eventHash                     \n"
             ");";
         macroEventsQuery.prepare(macroEventsQueryStr);
+        qint64 eventHash = computeEventHash(event);
+        macroEventsQuery.bindValue(":targetPID", event.targetPID);
+        macroEventsQuery.bindValue(":eventHash", eventHash);
 
         // Must perform INSERT query foreach active Macro.
         foreach (int macroId, _activeMacroIds) {
+            // If append, insert after the last event of each Macro. Else get insert index from the event.
+            int numEvents = getEventOrder(macroId).size();
+            eventInd = (append || event.index < 0 || event.index > numEvents) ? numEvents : event.index;
+            orderKey = allocateOrderKey(macroId, eventInd);
+
             // Execute INSERT query for specific active Macro.
             macroEventsQuery.bindValue(":macroId", macroId);
+            macroEventsQuery.bindValue(":macroEventOrd", orderKey);
             safeExec(macroEventsQuery, "Error: INSERT failed in addEvents() with query: \n" + macroEventsQueryStr);
 
-            // Only add to correct table based off of Event Type.
+            // Keep the cached event order in sync.
             macroEventId = macroEventsQuery.lastInsertId().toInt();
+            EventOrderEntry orderEntry;
+            orderEntry.macroEventId = macroEventId;
+            orderEntry.orderKey = orderKey;
+            orderEntry.eventHash = eventHash;
+            getEventOrder(macroId).insert(eventInd, orderEntry);
+
+            // Only add to correct table based off of Event Type.
             if (event.type == MacroEventType::MouseEvent) {
                 addMouseEvent(event.mouseEvent, macroEventId);
             }
@@ -135,6 +183,84 @@ void MacroEventModel::addEvents(QList<MacroEvent> &events)
     if (!isPartOfLargerTransaction) {
         safeCommitAndClose("Error: DB COMMIT failed in addEvents()");
     }
+    _encodedScreenshots.clear();
+    ReplayPlan::invalidate(_activeMacroIds);
+}
+
+
+void MacroEventModel::copyEvents(int srcMacroId)
+{
+    bool isPartOfLargerTransaction = _db.isOpen();
+    if (!isPartOfLargerTransaction) {
+        safeOpenAndBegin("Error: DB open and BEGIN TRANSACTION failed in copyEvents()");
+    }
+    QSqlQuery query(_db);
+    fillEventIdRemapTable(srcMacroId);
+
+    foreach (int macroId, _activeMacroIds) {
+        // Copies get fresh IDs above every ID ever used (AUTOINCREMENT never reuses IDs), in source event order.
+        QString queryStr = "SELECT MAX(COALESCE((SELECT seq FROM sqlite_sequence WHERE name=:tableName), 0), \n"
+                           "           COALESCE((SELECT MAX(macroEventId) FROM " + DBUtil::MACRO_EVENTS_TABLE_NAME + "), 0));";
+        query.prepare(queryStr);
+        query.bindValue(":tableName", DBUtil::MACRO_EVENTS_TABLE_NAME);
+        safeExec(query, "Error: SELECT failed in copyEvents() with query: \n" + queryStr);
+        safeExec(query.next(), "Error: Base Macro Event ID not found in copyEvents()");
+        qint64 baseId = query.value(0).toLongLong();
+
+        // Append after the last event of the destination Macro. Source ordering keys are kept relative to it.
+        QList<EventOrderEntry> &order = getEventOrder(macroId);
+        qint64 orderKeyOffset = order.isEmpty() ? 0 : order.last().orderKey;
+
+        queryStr = "INSERT INTO " + DBUtil::MACRO_EVENTS_TABLE_NAME + " ( \n\t"
+                       "macroEventId, macroId, macroEventOrd, macroEventType, delayMs, durationMs, nRepeats, targetPID, eventHash \n"
+                   ") \n"
+                   "SELECT \n\t"
+                       ":baseId + Remap.remapInd, :macroId, :orderKeyOffset + Src.macroEventOrd, Src.macroEventType, \n\t"
+                       "Src.delayMs, Src.durationMs, Src.nRepeats, Src.targetPID, Src.eventHash \n"
+                   "FROM temp." + DBUtil::MACRO_EVENT_ID_REMAP_TEMP_TABLE_NAME + " AS Remap \n"
+                   "INNER JOIN " + DBUtil::MACRO_EVENTS_TABLE_NAME + " AS Src \n\t"
+                       "ON Src.macroEventId = Remap.srcMacroEventId;";
+        query.prepare(queryStr);
+        query.bindValue(":baseId", baseId);
+        query.bindValue(":macroId", macroId);
+        query.bindValue(":orderKeyOffset", orderKeyOffset);
+        safeExec(query, "Error: INSERT failed in copyEvents() with query: \n" + queryStr);
+
+        // Screenshots are shared by ID; the reference count triggers count the new references.
+        queryStr = "INSERT INTO " + DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME + " ( \n\t"
+                       "macroEventId, macroMouseEventType, xLoc, yLoc, wheelDelta, screenshotId, autoCorrect \n"
+                   ") \n"
+                   "SELECT \n\t"
+                       ":baseId + Remap.remapInd, Src.macroMouseEventType, Src.xLoc, Src.yLoc, Src.wheelDelta, \n\t"
+                       "Src.screenshotId, Src.autoCorrect \n"
+                   "FROM temp." + DBUtil::MACRO_EVENT_ID_REMAP_TEMP_TABLE_NAME + " AS Remap \n"
+                   "INNER JOIN " + DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME + " AS Src \n\t"
+                       "ON Src.macroEventId = Remap.srcMacroEventId;";
+        query.prepare(queryStr);
+        query.bindValue(":baseId", baseId);
+        safeExec(query, "Error: INSERT failed in copyEvents() with query: \n" + queryStr);
+
+        queryStr = "INSERT INTO " + DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME + " ( \n\t"
+                       "macroEventId, macrokeyboardEventType, keyCode, mod1, mod2, capsLock, numLock, keyString \n"
+                   ") \n"
+                   "SELECT \n\t"
+                       ":baseId + Remap.remapInd, Src.macrokeyboardEventType, Src.keyCode, Src.mod1, Src.mod2, \n\t"
+                       "Src.capsLock, Src.numLock, Src.keyString \n"
+                   "FROM temp." + DBUtil::MACRO_EVENT_ID_REMAP_TEMP_TABLE_NAME + " AS Remap \n"
+                   "INNER JOIN " + DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME + " AS Src \n\t"
+                       "ON Src.macroEventId = Remap.srcMacroEventId;";
+        query.prepare(queryStr);
+        query.bindValue(":baseId", baseId);
+        safeExec(query, "Error: INSERT failed in copyEvents() with query: \n" + queryStr);
+
+        // The cached event order is reloaded on next use.
+        _eventOrders.remove(macroId);
+    }
+
+    if (!isPartOfLargerTransaction) {
+        safeCommitAndClose("Error: DB COMMIT failed in copyEvents()");
+    }
+    ReplayPlan::invalidate(_activeMacroIds);
 }
 
 
@@ -146,78 +272,42 @@ QList<MacroEvent> MacroEventModel::getUniformEvents()
         safeOpen("Error: DB open failed in getUniformEvents()");
     }
 
-    QString delayMsCol = DBUtil::MACRO_EVENTS_TABLE_NAME + ".delayMs";
-    QString durationMsCol = DBUtil::MACRO_EVENTS_TABLE_NAME + ".durationMs";
-    QString autoCorrectCol = DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME + ".autoCorrect";
+    // An event index is uniform if every active Macro has an event there with the same identity hash.
+    // The hashes come along with the (cached) event orders, so this needs no per-column comparison in SQL.
+    QVariantList matchedEventIds,
+                 matchedEventInds;
+    int numEvents = 0;
+    if (_activeMacroIds.size() != 0) {
+        numEvents = getEventOrder(_activeMacroIds.first()).size();
+        foreach (int macroId, _activeMacroIds) {
+            numEvents = qMin(numEvents, getEventOrder(macroId).size());
+        }
+    }
+    for (int i = 0; i < numEvents; i++) {
+        qint64 eventHash = getEventOrder(_activeMacroIds.first()).at(i).eventHash;
+        bool isUniform = true;
+        foreach (int macroId, _activeMacroIds) {
+            isUniform &= (getEventOrder(macroId).at(i).eventHash == eventHash);
+        }
+        if (isUniform) {
+            foreach (int macroId, _activeMacroIds) {
+                matchedEventIds.append(getEventOrder(macroId).at(i).macroEventId);
+                matchedEventInds.append(i);
+            }
+        }
+    }
 
-    QString groupByClause = DBUtil::MACRO_EVENTS_TABLE_NAME          + ".macroEventInd,          \n\t" +
-                            DBUtil::MACRO_EVENTS_TABLE_NAME          + ".macroEventType,         \n\t" +
-                            DBUtil::MACRO_EVENTS_TABLE_NAME          + ".nRepeats,               \n\t" +
-                            DBUtil::MACRO_EVENTS_TABLE_NAME          + ".targetPID,              \n\t" +
-                            DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME    + ".macroMouseEventType,    \n\t" +
-                            DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME    + ".xLoc,                   \n\t" +
-                            DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME    + ".yLoc,                   \n\t" +
-                            DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME    + ".wheelDelta,             \n\t" +
-                            DBUtil::SCREENSHOT_TABLE_NAME            + ".screenshotId,           \n\t" +
-                            DBUtil::SCREENSHOT_TABLE_NAME            + ".screenshotX,            \n\t" +
-                            DBUtil::SCREENSHOT_TABLE_NAME            + ".screenshotY,            \n\t" +
-                            DBUtil::SCREENSHOT_TABLE_NAME            + ".screenshotW,            \n\t" +
-                            DBUtil::SCREENSHOT_TABLE_NAME            + ".screenshotH,            \n\t" +
-                            DBUtil::SCREENSHOT_TABLE_NAME            + ".targetImgType,          \n\t" +
-                            DBUtil::SCREENSHOT_TABLE_NAME            + ".cursorType,             \n\t" +
-                            DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME + ".macrokeyboardEventType, \n\t" +
-                            DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME + ".keyCode,                \n\t" +
-                            DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME + ".mod1,                   \n\t" +
-                            DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME + ".mod2,                   \n\t" +
-                            DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME + ".capsLock,               \n\t" +
-                            DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME + ".numLock,                \n\t" +
-                            DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME + ".keyString ";
-
-    QString selectClause = "COUNT(*) AS cnt, \n\t"
-                           // Still want to get back events that don't have uniform delay, duration, or auto correct.
-                           // In these cases, we will make these NULL for empty.
-                           "CASE \n\t"
-                           "    WHEN MAX(" + delayMsCol + ") - MIN(" + delayMsCol + ") = 0 THEN MAX(" + delayMsCol + ") \n\t"
-                           "    ELSE NULL \n\t"
-                           "END AS delayMs, \n\t"
-                           "CASE \n\t"
-                           "    WHEN MAX(" + durationMsCol + ") - MIN(" + durationMsCol + ") = 0 THEN MAX(" + durationMsCol + ") \n\t"
-                           "    ELSE NULL \n\t"
-                           "END AS durationMs, \n\t"
-                           "CASE \n\t"
-                           "    WHEN MAX(" + autoCorrectCol + ") - MIN(" + autoCorrectCol + ") = 0 THEN MAX(" + autoCorrectCol + ") \n\t"
-                           "    ELSE NULL \n\t"
-                           "END AS autoCorrect, \n\t" +
-                           groupByClause;
-
-    QString queryStr = "SELECT \n\t" +
-                            selectClause + "\n"
-                       "FROM "      + DBUtil::MACRO_EVENTS_TABLE_NAME + "\n"
-                       "LEFT JOIN " + DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME + "\n\t"
-                                      "ON " + DBUtil::MACRO_EVENTS_TABLE_NAME       + ".macroEventId = "
-                                            + DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME + ".macroEventId \n"
-                       "LEFT JOIN " + DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME + "\n\t"
-                                      "ON " + DBUtil::MACRO_EVENTS_TABLE_NAME          + ".macroEventId = "
-                                            + DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME + ".macroEventId \n"
-                       "LEFT JOIN " + DBUtil::SCREENSHOT_TABLE_NAME + "\n\t"
-                                      "ON " + DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME + ".screenshotId = "
-                                            + DBUtil::SCREENSHOT_TABLE_NAME         + ".screenshotId \n"
-                       "WHERE \n\t" +
-                            buildMacroIdWhereClause() + "\n"
-                       "GROUP BY \n\t" +
-                            groupByClause + "\n"
-                       "ORDER BY \n\t"
-                            "macroEventInd ASC;";
+    // Only the matched events are read, and only one representative per index is fetched in full.
+    fillEventOrderTable(matchedEventIds, matchedEventInds);
 
+    QString queryStr = buildUniformEventsQuery();
     QSqlQuery query(_db);
     query.prepare(queryStr);
     safeExec(query, "Error: SELECT failed in getUniformEvents() with query: \n" + queryStr);
     while(query.next()) {
-        if (query.value("cnt").toInt() == _activeMacroIds.size()) {
-            MacroEvent event;
-            fillMacroEvent(event, query);
-            events.append(event);
-        }
+        MacroEvent event;
+        fillMacroEvent(event, query);
+        events.append(event);
     }
 
     if (!dbOpenOutsideMethod) {
@@ -227,6 +317,30 @@ QList<MacroEvent> MacroEventModel::getUniformEvents()
 }
 
 
+QSharedPointer<const ReplayPlan> MacroEventModel::getReplayPlan()
+{
+    int macroId = _activeMacroIds.first();
+    QSharedPointer<const ReplayPlan> plan = ReplayPlan::cached(macroId);
+    if (plan.isNull()) {
+        // Read the generation first, so that a plan compiled from events that change meanwhile is not cached.
+        quint64 generation = ReplayPlan::generation(macroId);
+        plan = ReplayPlan::compile(getUniformEvents());
+        ReplayPlan::cache(macroId, generation, plan);
+    }
+    return plan;
+}
+
+
+void MacroEventModel::requestReplayPlans()
+{
+    // Also invalidates here, since the changes may have been committed by an outer transaction after our writes.
+    ReplayPlan::invalidate(_activeMacroIds);
+    foreach (int macroId, _activeMacroIds) {
+        DBMaintenanceThread::requestReplayPlan(macroId);
+    }
+}
+
+
 void MacroEventModel::setEvent(const MacroEvent &event)
 {
     // Check if this is part of a larger transaction.
@@ -235,7 +349,19 @@ void MacroEventModel::setEvent(const MacroEvent &event)
         safeOpenAndBegin("Error: DB open and BEGIN TRANSACTION failed in setEvent()");
     }
 
-    QString macroEventIdWhere = buildEventIdWhereClause(event.index);
+    QList<int> eventInds;
+    eventInds.append(event.index);
+    QList<int> macroEventIds = getMacroEventIds(eventInds);
+
+    // Nothing to update if no active Macro has an event at the index.
+    if (macroEventIds.size() == 0) {
+        if (!partOfLargerTransaction) {
+            safeCommitAndClose("Error: DB COMMIT failed in setEvent()");
+        }
+        return;
+    }
+    SqlIdSet macroEventIdSet("macroEventId", macroEventIds);
+    safeExec(macroEventIdSet.prepare(_db), "Error: Macro Event ID set prepare failed in setEvent()");
 
     QString queryStr = "UPDATE " + DBUtil::MACRO_EVENTS_TABLE_NAME + " \n"
                        "SET \n\t"
@@ -243,26 +369,40 @@ void MacroEventModel::setEvent(const MacroEvent &event)
                             " delayMs="             + str(event.delayMs)         + ", \n\t"
                             " durationMs="          + str(event.durationMs)      + ", \n\t"
                             " nRepeats="            + str(event.nRepeats)        + ", \n\t"
-                            " targetPID="           + str("'") + event.targetPID + "' \n"
+                            " targetPID=:targetPID, \n\t"
+                            " eventHash=:eventHash  \n"
                        "WHERE \n\t" +
-                            macroEventIdWhere + ";";
+                            macroEventIdSet.inClause() + ";";
 
+    qint64 eventHash = computeEventHash(event);
     QSqlQuery query(_db);
     query.prepare(queryStr);
+    query.bindValue(":targetPID", event.targetPID);
+    query.bindValue(":eventHash", eventHash);
+    macroEventIdSet.bindValues(query);
     safeExec(query, "Error: UPDATE failed in setEvent() with query: \n" + queryStr);
 
     // Update corresponding event based off of Event Type (should never be able to modify event type).
     if (event.type == MacroEventType::MouseEvent) {
-        setMouseEvent(event.mouseEvent, macroEventIdWhere);
+        setMouseEvent(event.mouseEvent, macroEventIdSet);
     }
     else { // (event.type == MacroEventType::KeyboardEvent)
-        setKeyboardEvent(event.keyboardEvent, macroEventIdWhere);
+        setKeyboardEvent(event.keyboardEvent, macroEventIdSet);
+    }
+
+    // Keep the cached identity hashes in sync.
+    foreach (int macroId, _activeMacroIds) {
+        QList<EventOrderEntry> &order = getEventOrder(macroId);
+        if (event.index >= 0 && event.index < order.size()) {
+            order[event.index].eventHash = eventHash;
+        }
     }
 
     // Make sure we do not close a DB connection if it was started outside this method!
     if (!partOfLargerTransaction) {
         safeCommitAndClose("Error: DB COMMIT failed in setEvent()");
     }
+    ReplayPlan::invalidate(_activeMacroIds);
 }
 
 
@@ -282,57 +422,184 @@ void MacroEventModel::removeEvents(QList<int> &eventInds)
         safeOpenAndBegin("Error: DB open and BEGIN TRANSACTION failed in removeEvents()");
     }
 
-    // Get screenshot filenames associated with the events we are going to remove.
-    // After delete, we can see what filenames are no longer referenced to see which screenshot files to delete.
-    QList<int> screenshotIds = getscreenshotIdsForEvents(eventInds);
+    // Are we limiting to specific events, or removing all events for each active Macro?
+    bool removeAll = (eventInds.size() == 0);
+    QList<int> macroEventIds = removeAll ? QList<int>()
+                                         : getMacroEventIds(eventInds);
+
+    if (removeAll || macroEventIds.size() != 0) {
+        // Do the delete.
+        SqlIdSet deleteIdSet = removeAll ? SqlIdSet("macroId", _activeMacroIds)
+                                         : SqlIdSet("macroEventId", macroEventIds);
+        safeExec(deleteIdSet.prepare(_db), "Error: ID set prepare failed in removeEvents()");
+        QString queryStr = "DELETE FROM " + DBUtil::MACRO_EVENTS_TABLE_NAME + " \n"
+                           "WHERE \n\t" +
+                                deleteIdSet.inClause() + ";";
+
+        QSqlQuery query(_db);
+        query.prepare(queryStr);
+        deleteIdSet.bindValues(query);
+        safeExec(query, "Error: DELETE failed in removeEvents() with query: \n" + queryStr);
 
-    // Do the delete.
-    QString queryStr = "DELETE FROM " + DBUtil::MACRO_EVENTS_TABLE_NAME + " \n"
-                       "WHERE \n\t" +
-                            buildMacroIdWhereClause() + " \n";
+        // The delete cascades to the Macro Mouse Events, whose triggers release their screenshots. Screenshots that
+        // are no longer referenced at all are removed in the background.
+        DBMaintenanceThread::requestScreenshotSweep();
 
-    // Are we limiting to specific events, or removing all events for each active Macro?
-    QString eventIndWhere = eventInds.size() != 0 ? "  AND \n" + buildEventIndWhereClause(eventInds) + ";"
-                                                  : "";
-    queryStr += eventIndWhere;
+        // Remaining events keep their ordering keys, so only the cached orders need adjusting.
+        QList<int> sortedEventInds = eventInds;
+        std::sort(sortedEventInds.begin(), sortedEventInds.end());
+        sortedEventInds.erase(std::unique(sortedEventInds.begin(), sortedEventInds.end()), sortedEventInds.end());
+        foreach (int macroId, _activeMacroIds) {
+            QList<EventOrderEntry> &order = getEventOrder(macroId);
+            if (removeAll) {
+                order.clear();
+                continue;
+            }
+            // Descending so earlier removals do not shift later positions.
+            for (int i = sortedEventInds.size() - 1; i >= 0; i--) {
+                if (sortedEventInds.at(i) >= 0 && sortedEventInds.at(i) < order.size()) {
+                    order.removeAt(sortedEventInds.at(i));
+                }
+            }
+        }
+    }
+
+    if (!partOfLargerTransaction) {
+        safeCommitAndClose("Error: DB COMMIT failed in removeEvents()");
+    }
+    ReplayPlan::invalidate(_activeMacroIds);
+}
+
+
+void MacroEventModel::moveEvents(QList<int> &eventInds, int destEventInd)
+{
+    // Check if this is part of a larger transaction.
+    bool partOfLargerTransaction = _db.isOpen();
+    if (!partOfLargerTransaction) {
+        safeOpenAndBegin("Error: DB open and BEGIN TRANSACTION failed in moveEvents()");
+    }
 
+    std::sort(eventInds.begin(), eventInds.end());
+    eventInds.erase(std::unique(eventInds.begin(), eventInds.end()), eventInds.end());
+
+    QString queryStr = "UPDATE " + DBUtil::MACRO_EVENTS_TABLE_NAME + " \n"
+                       "SET macroEventOrd=:macroEventOrd \n"
+                       "WHERE macroEventId=:macroEventId;";
     QSqlQuery query(_db);
     query.prepare(queryStr);
-    safeExec(query, "Error: DELETE failed in removeEvents() with query: \n" + queryStr);
 
-    // Delete screenshots and associate screenshot filenames that are no longer referenced.
-    deleteScreenshotsIfNotReferenced(screenshotIds);
+    foreach (int macroId, _activeMacroIds) {
+        QList<EventOrderEntry> &order = getEventOrder(macroId);
+
+        // Take the moved entries out of the order (descending so positions stay valid).
+        QList<EventOrderEntry> movedEntries;
+        for (int i = eventInds.size() - 1; i >= 0; i--) {
+            if (eventInds.at(i) >= 0 && eventInds.at(i) < order.size()) {
+                movedEntries.prepend(order.takeAt(eventInds.at(i)));
+            }
+        }
+        if (movedEntries.size() == 0) continue;
+
+        // Spread the moved events evenly between their new neighbors' ordering keys.
+        int destInd = qBound(0, destEventInd, order.size());
+        qint64 lowerKey = (destInd > 0) ? order.at(destInd - 1).orderKey : 0;
+        qint64 upperKey = (destInd < order.size()) ? order.at(destInd).orderKey
+                                                   : lowerKey + (movedEntries.size() + 1) * EVENT_ORDER_GAP;
+        qint64 step = (upperKey - lowerKey) / (movedEntries.size() + 1);
+        for (int i = 0; i < movedEntries.size(); i++) {
+            order.insert(destInd + i, movedEntries.at(i));
+        }
+
+        // Not enough room between the neighbors, so renumber the whole Macro in its new order (rare).
+        if (step < 1) {
+            rebalanceEventOrder(macroId);
+            continue;
+        }
 
-    // Make sure we adjust Event Indexes to keep contiguous ordering of Macro Events.
-    correctEventIndexesAfterDelete(eventInds);
+        for (int i = 0; i < movedEntries.size(); i++) {
+            EventOrderEntry &orderEntry = order[destInd + i];
+            orderEntry.orderKey = lowerKey + (i + 1) * step;
+            query.bindValue(":macroEventOrd", orderEntry.orderKey);
+            query.bindValue(":macroEventId", orderEntry.macroEventId);
+            safeExec(query, "Error: UPDATE failed in moveEvents() with query: \n" + queryStr);
+        }
+        if (step < EVENT_ORDER_CROWDED_GAP) {
+            DBMaintenanceThread::requestEventOrderRebalance(macroId);
+        }
+    }
 
     if (!partOfLargerTransaction) {
-        safeCommitAndClose("Error: DB COMMIT failed in removeEvents()");
+        safeCommitAndClose("Error: DB COMMIT failed in moveEvents()");
     }
+    ReplayPlan::invalidate(_activeMacroIds);
 }
 
 
-int MacroEventModel::generateNewScreenshotId()
+void MacroEventModel::rebalanceEventOrder(int macroId)
 {
-    int screenshotId;
-    QString screenshotPath;
-    QFileInfo checkFileExist;
+    // Check if this is part of a larger transaction.
+    bool partOfLargerTransaction = _db.isOpen();
+    if (!partOfLargerTransaction) {
+        safeOpenAndBegin("Error: DB open and BEGIN TRANSACTION failed in rebalanceEventOrder()");
+    }
+
+    QVariantList orderKeys,
+                 macroEventIds;
+    QList<EventOrderEntry> &order = getEventOrder(macroId);
+    for (int i = 0; i < order.size(); i++) {
+        order[i].orderKey = (i + 1) * EVENT_ORDER_GAP;
+        orderKeys.append(order.at(i).orderKey);
+        macroEventIds.append(order.at(i).macroEventId);
+    }
+
+    QString queryStr = "UPDATE " + DBUtil::MACRO_EVENTS_TABLE_NAME + " \n"
+                       "SET macroEventOrd=? \n"
+                       "WHERE macroEventId=?;";
+    QSqlQuery query(_db);
+    query.prepare(queryStr);
+    query.addBindValue(orderKeys);
+    query.addBindValue(macroEventIds);
+    safeExec(query.execBatch(), "Error: UPDATE failed in rebalanceEventOrder() with query: \n" + queryStr);
+    qDebug() << "Rebalanced ordering keys of " << order.size() << " events in Macro " << macroId;
 
-    // Keep generating random file name until we get one that does not exist!
-    do {
-        screenshotId = qrand();
-        screenshotPath = DBUtil::SCREENSHOT_DIR_PATH + QString::number(screenshotId) + ".png";
-        checkFileExist.setFile(screenshotPath);
+    if (!partOfLargerTransaction) {
+        safeCommitAndClose("Error: DB COMMIT failed in rebalanceEventOrder()");
     }
-    while (checkFileExist.exists());
+}
+
 
-    return screenshotId;
+int MacroEventModel::generateNewScreenshotId()
+{
+    return ScreenshotStore::generateNewScreenshotId();
 }
 
 
-QString MacroEventModel::generateScreenshotPathFromId(int screenshotId)
+qint64 MacroEventModel::computeEventHash(const MacroEvent &event)
 {
-    return (DBUtil::SCREENSHOT_DIR_PATH + QString::number(screenshotId) + ".png");
+    // Canonical serialization of the identity fields. Timing (delay, duration) and auto correct are left out since
+    // events that only differ in these are still shown as one uniform event. Screenshot attributes are implied by
+    // the screenshot ID.
+    QByteArray identity;
+    QDataStream stream(&identity, QIODevice::WriteOnly);
+    stream << (qint32)event.type << (qint32)event.nRepeats << event.targetPID;
+    if (event.type == MacroEventType::MouseEvent) {
+        const MacroMouseEvent &mEvent = event.mouseEvent;
+        stream << (qint32)mEvent.type << (qint32)mEvent.loc.x() << (qint32)mEvent.loc.y() << (qint32)mEvent.wheelDelta
+               << (qint32)(mEvent.screenshotId >= 0 ? mEvent.screenshotId : -1);
+    }
+    else {
+        const MacroKeyboardEvent &kEvent = event.keyboardEvent;
+        stream << (qint32)kEvent.type << (qint32)kEvent.keyCode << (qint32)kEvent.mod1 << (qint32)kEvent.mod2
+               << kEvent.capsLock << kEvent.numLock << kEvent.keyString;
+    }
+
+    // First 64 bits of the digest.
+    QByteArray digest = QCryptographicHash::hash(identity, QCryptographicHash::Sha1);
+    qint64 eventHash = 0;
+    for (int i = 0; i < 8; i++) {
+        eventHash = (eventHash << 8) | (quint8)digest.at(i);
+    }
+    return eventHash;
 }
 
 
@@ -388,9 +655,15 @@ void MacroEventModel::addScreenshotIfNotExist(const MacroMouseEvent &mEvent)
 
         // Will not get an entry in result set if it does NOT exists already.
         if (!query.next()) {
-            // Save the screenshot to the filesystem first.
-            QString screenshotPath = MacroEventModel::generateScreenshotPathFromId(mEvent.screenshotId);
-            mEvent.screenshotImg.save(screenshotPath);
+            // Add the screenshot images to the pack store first (shared with any identical images already stored).
+            QByteArray blobHash = putScreenshot(mEvent.screenshot);
+            QByteArray contextBlobHash = putScreenshot(mEvent.contextScreenshot);
+            // A screenshot that can no longer be loaded (e.g. swept while the editor still referenced it) must not be
+            // saved without its image.
+            if (blobHash.isEmpty() && !mEvent.screenshot.isNull()) {
+                safeExec(false, "Error: Image of screenshot " + str(mEvent.screenshotId)
+                                + " could not be loaded in addScreenshotIfNotExist()");
+            }
 
             // Next, make a record for it in the Screenshots table.
             queryStr = "INSERT INTO " + DBUtil::SCREENSHOT_TABLE_NAME + " ( \n\t" +
@@ -400,7 +673,12 @@ void MacroEventModel::addScreenshotIfNotExist(const MacroMouseEvent &mEvent)
                            "screenshotW,   \n\t"
                            "screenshotH,   \n\t"
                            "targetImgType, \n\t"
-                           "cursorType     \n"
+                           "cursorType,    \n\t"
+                           "blobHash,      \n\t"
+                           "cropX,         \n\t"
+                           "cropY,         \n\t"
+                           "contextBlobHash, \n\t"
+                           "contextScale   \n"
                        ") \n"
                        "VALUES ( \n\t" +
                            str(mEvent.screenshotId)            + ", \n\t" +
@@ -409,15 +687,135 @@ void MacroEventModel::addScreenshotIfNotExist(const MacroMouseEvent &mEvent)
                            str(mEvent.screenshotRect.width())  + ", \n\t" +
                            str(mEvent.screenshotRect.height()) + ", \n\t" +
                            str(mEvent.targetImgType)           + ", \n\t" +
-                           str(mEvent.cursorType)              + "  \n"
+                           str(mEvent.cursorType)              + ", \n\t"
+                           ":blobHash, \n\t"
+                           ":cropX, \n\t"
+                           ":cropY, \n\t"
+                           ":contextBlobHash, \n\t"
+                           ":contextScale \n"
                        ");";
             query.prepare(queryStr);
+            query.bindValue(":blobHash", blobHash.isEmpty() ? QVariant(QVariant::ByteArray) : QVariant(blobHash));
+            query.bindValue(":cropX", mEvent.screenshotOrg.x());
+            query.bindValue(":cropY", mEvent.screenshotOrg.y());
+            query.bindValue(":contextBlobHash", contextBlobHash.isEmpty() ? QVariant(QVariant::ByteArray) : QVariant(contextBlobHash));
+            query.bindValue(":contextScale", contextBlobHash.isEmpty() ? 0.0 : mEvent.contextScale);
             safeExec(query, "Error: INSERT failed in addScreenshotIfNotExist() with query: \n" + queryStr);
         }
     }
 }
 
 
+void MacroEventModel::encodeNewScreenshots(const QList<MacroEvent> &events)
+{
+    QList<ScreenshotEncodeJob> keyframeJobs,
+                               deltaJobs;
+    QHash<DeltaKeyframeKey, int> newKeyframeJobs; // Keyframe job of each Macro and size started in this batch.
+    // The screenshots are shared by all active Macros, so they are delta encoded within the first one.
+    int macroId = _activeMacroIds.isEmpty() ? -1 : _activeMacroIds.first();
+
+    foreach (const MacroEvent &event, events) {
+        if (event.type != MacroEventType::MouseEvent || event.mouseEvent.screenshotId < 0) continue;
+
+        // Stored screenshots (e.g. of copied events) already have a blob.
+        QList<ScreenshotHandle> handles;
+        handles << event.mouseEvent.screenshot << event.mouseEvent.contextScreenshot;
+        foreach (const ScreenshotHandle &handle, handles) {
+            if (handle.isNull() || handle.isStored()) continue;
+
+            ScreenshotEncodeJob job;
+            job.image = handle.image();
+            job.keyframeJob = -1;
+            DeltaKeyframeKey key = deltaKeyframeKey(macroId, job.image);
+
+            // Delta encode against the keyframe of the same Macro and size, as long as it is still stored.
+            if (_deltaKeyframes.contains(key)) {
+                DeltaKeyframe &keyframe = _deltaKeyframes[key];
+                bool isKeyframeValid = (keyframe.blobHash.isEmpty() || ScreenshotStore::contains(keyframe.blobHash));
+                if (isKeyframeValid && keyframe.deltaCount < ScreenshotDelta::KEYFRAME_INTERVAL) {
+                    job.changedTiles = ScreenshotDelta::changedTiles(job.image, keyframe.image);
+                    if (ScreenshotDelta::isWorthDelta(job.image, job.changedTiles)) {
+                        job.keyframeBlobHash = keyframe.blobHash;
+                        if (keyframe.blobHash.isEmpty()) job.keyframeJob = newKeyframeJobs.value(key);
+                        keyframe.deltaCount++;
+                        deltaJobs.append(job);
+                        continue;
+                    }
+                }
+            }
+
+            // Otherwise it becomes the new keyframe of its Macro and size.
+            if (!_deltaKeyframes.contains(key) && _deltaKeyframes.size() >= MAX_DELTA_KEYFRAMES) {
+                _deltaKeyframes.clear();
+            }
+            DeltaKeyframe keyframe;
+            keyframe.image = job.image;
+            keyframe.deltaCount = 0;
+            _deltaKeyframes.insert(key, keyframe);
+            newKeyframeJobs.insert(key, keyframeJobs.size());
+            job.changedTiles.clear();
+            keyframeJobs.append(job);
+        }
+    }
+    if (keyframeJobs.isEmpty() && deltaJobs.isEmpty()) return;
+
+    // Deltas need the blob hashes of their keyframes, so encode the keyframes first.
+    QList<ScreenshotStore::EncodedScreenshot> encodedKeyframes =
+        QtConcurrent::blockingMapped<QList<ScreenshotStore::EncodedScreenshot>>(keyframeJobs, encodeScreenshotJob);
+    for (int i = 0; i < keyframeJobs.size(); i++) {
+        _encodedScreenshots.insert(keyframeJobs[i].image.cacheKey(), encodedKeyframes[i]);
+    }
+    for (QHash<DeltaKeyframeKey, int>::const_iterator it = newKeyframeJobs.constBegin(); it != newKeyframeJobs.constEnd(); ++it) {
+        if (_deltaKeyframes.contains(it.key()) && _deltaKeyframes[it.key()].blobHash.isEmpty()) {
+            _deltaKeyframes[it.key()].blobHash = encodedKeyframes[it.value()].blobHash;
+        }
+    }
+    for (int i = 0; i < deltaJobs.size(); i++) {
+        if (deltaJobs[i].keyframeJob >= 0) {
+            deltaJobs[i].keyframeBlobHash = encodedKeyframes[deltaJobs[i].keyframeJob].blobHash;
+        }
+    }
+
+    QList<ScreenshotStore::EncodedScreenshot> encodedDeltas =
+        QtConcurrent::blockingMapped<QList<ScreenshotStore::EncodedScreenshot>>(deltaJobs, encodeScreenshotJob);
+    for (int i = 0; i < deltaJobs.size(); i++) {
+        _encodedScreenshots.insert(deltaJobs[i].image.cacheKey(), encodedDeltas[i]);
+    }
+}
+
+
+QByteArray MacroEventModel::putScreenshot(const ScreenshotHandle &screenshot)
+{
+    QImage image = screenshot.image();
+    if (image.isNull()) return QByteArray();
+
+    // A delta is refused if its keyframe was not stored after all (e.g. if its screenshot was already in the
+    // database), or has been swept since.
+    if (_encodedScreenshots.contains(image.cacheKey())) {
+        QByteArray blobHash = ScreenshotStore::put(_db, _encodedScreenshots.value(image.cacheKey()));
+        if (!blobHash.isEmpty()) return blobHash;
+    }
+
+    // Fall back to encoding a keyframe here for screenshots that encodeNewScreenshots() did not get to.
+    return ScreenshotStore::put(_db, ScreenshotStore::encode(image));
+}
+
+
+ScreenshotStore::EncodedScreenshot MacroEventModel::encodeScreenshotJob(const ScreenshotEncodeJob &job)
+{
+    if (job.keyframeBlobHash.isEmpty()) {
+        return ScreenshotStore::encode(job.image);
+    }
+    return ScreenshotStore::encodeDelta(job.image, job.changedTiles, job.keyframeBlobHash);
+}
+
+
+MacroEventModel::DeltaKeyframeKey MacroEventModel::deltaKeyframeKey(int macroId, const QImage &image)
+{
+    return DeltaKeyframeKey(macroId, ((qint64)image.width() << 32) | (quint32)image.height());
+}
+
+
 void MacroEventModel::addKeyboardEvent(const MacroKeyboardEvent &kEvent, int macroEventId)
 {
     QSqlQuery keyboardEventsQuery(_db);
@@ -442,15 +840,16 @@ void MacroEventModel::addKeyboardEvent(const MacroKeyboardEvent &kEvent, int mac
             str(kEvent.mod2)                 + ", \n\t" +
             str(kEvent.capsLock ? "1" : "0") + ", \n\t" +
             str(kEvent.numLock  ? "1" : "0") + ", \n\t"
-            "'" + kEvent.keyString           + "' \n"
+            ":keyString \n"
         ");";
     keyboardEventsQuery.prepare(keyboardEventsQueryStr);
+    keyboardEventsQuery.bindValue(":keyString", kEvent.keyString);
 
     safeExec(keyboardEventsQuery, "Error: INSERT failed in addKeyboardEvent() with query: \n" + keyboardEventsQueryStr);
 }
 
 
-void MacroEventModel::setMouseEvent(const MacroMouseEvent &mEvent, const QString &macroEventIdWhereClause)
+void MacroEventModel::setMouseEvent(const MacroMouseEvent &mEvent, const SqlIdSet &macroEventIdSet)
 {
     QString queryStr = "UPDATE " + DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME + " \n"
                        "SET \n\t"
@@ -460,15 +859,16 @@ void MacroEventModel::setMouseEvent(const MacroMouseEvent &mEvent, const QString
                             "wheelDelta="          + str(mEvent.wheelDelta)              + ", \n\t"
                             "autoCorrect="         + str(mEvent.autoCorrect ? 1 : 0)     + "  \n\t"
                        "WHERE \n\t" +
-                            macroEventIdWhereClause + ";";
+                            macroEventIdSet.inClause() + ";";
 
     QSqlQuery query(_db);
     query.prepare(queryStr);
+    macroEventIdSet.bindValues(query);
     safeExec(query, "Error: UPDATE failed in setMouseEvent() with query: \n" + queryStr);
 }
 
 
-void MacroEventModel::setKeyboardEvent(const MacroKeyboardEvent &kEvent, const QString &macroEventIdWhereClause)
+void MacroEventModel::setKeyboardEvent(const MacroKeyboardEvent &kEvent, const SqlIdSet &macroEventIdSet)
 {
     QString queryStr = "UPDATE " + DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME + " \n"
                        "SET "
@@ -478,268 +878,237 @@ void MacroEventModel::setKeyboardEvent(const MacroKeyboardEvent &kEvent, const Q
                             "mod2="                    + str(kEvent.mod2)                 + ", \n\t"
                             "capsLock="                + str(kEvent.capsLock ? "1" : "0") + ", \n\t"
                             "numLock="                 + str(kEvent.numLock  ? "1" : "0") + ", \n\t"
-                            "keyString='"              + kEvent.keyString                 + "' \n"
+                            "keyString=:keyString \n"
                        "WHERE \n\t" +
-                            macroEventIdWhereClause + ";";
+                            macroEventIdSet.inClause() + ";";
 
     QSqlQuery query(_db);
     query.prepare(queryStr);
+    query.bindValue(":keyString", kEvent.keyString);
+    macroEventIdSet.bindValues(query);
     safeExec(query, "Error: UPDATE failed in setKeyboardEvent() with query: \n" + queryStr);
 }
 
 
-QList<int> MacroEventModel::getscreenshotIdsForEvents(QList<int> eventInds)
+int MacroEventModel::_getNumEventsForMacro(int id)
 {
-    QList<int> screenshotIds;
-
-    QString queryStr = "SELECT screenshotId \n"
-                       "FROM " + DBUtil::MACRO_EVENTS_TABLE_NAME + " \n"
-                       "INNER JOIN " + DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME + " \n\t"
-                            "ON " + DBUtil::MACRO_EVENTS_TABLE_NAME + ".macroEventId="
-                                  + DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME + ".macroEventId \n"
-                       "WHERE \n\t" +
-                            buildMacroIdWhereClause() + "\n"
-                       "  AND screenshotId >= 0 \n";
-
-    // Are we getting screenshot IDs for all events of active Macros or certain given ones?
-    QString eventIndsWhereClause = eventInds.size() != 0 ? "   AND \n\t" + buildEventIndWhereClause(eventInds) + "\n"
-                                                         : "";
-    queryStr += eventIndsWhereClause +
-                "GROUP BY screenshotId;";
-
+    QString queryStr = buildEventCountQuery();
     QSqlQuery query(_db);
     query.prepare(queryStr);
-    safeExec(query, "Error: SELECT failed in getScreenshotIdsForEvents() with query: \n" + queryStr);
-
-    while (query.next()) {
-        screenshotIds.append(query.value("screenshotId").toInt());
-    }
-    return screenshotIds;
-
+    query.bindValue(":macroId", id);
+    safeExec(query, "Error: SELECT failed in _getNumEventsForMacro() with query: \n" + queryStr);
+    safeExec(query.next(), "Error: Macro Events not found for Macro with ID: " + str(id));
+    return query.value(0).toInt();
 }
 
 
-void MacroEventModel::deleteScreenshotsIfNotReferenced(const QList<int> &screenshotIds)
+QList<MacroEventModel::EventOrderEntry>& MacroEventModel::getEventOrder(int macroId)
 {
-    QList<int> deleteScreenshotIds;
-    QString fileName,
-            selectQueryStr,
-            deleteQueryStr,
-            screenshotPath;
-
-    qDebug() << "Possible delete count: " << screenshotIds.size();
-    foreach (int screenshotId, screenshotIds) {
-        qDebug() << "ID: " << screenshotId;
+    // Drop the cache if the connection has been reopened since it was loaded.
+    if (_eventOrdersOpenCount != getConnectionOpenCount()) {
+        _eventOrders.clear();
+        _eventOrdersOpenCount = getConnectionOpenCount();
     }
 
-    // Stop right away if we don't have any possible deletes!
-    if (screenshotIds.size() == 0) return;
+    if (!_eventOrders.contains(macroId)) {
+        QList<EventOrderEntry> &order = _eventOrders[macroId];
 
-    QSqlQuery query(_db);
-
-    // Should take log(N) ^ 2 time ideally.
-    // Select all Screenshots that are no longer refrenced in the MacroMouseEvents table.
-    selectQueryStr = "SELECT screenshotId \n"
-                     "FROM " + DBUtil::SCREENSHOT_TABLE_NAME + " \n"
-                     "WHERE " + buildscreenshotIdWhereClause(screenshotIds) + " \n"
-                     "  AND NOT EXISTS ( \n" +
-                     "                   SELECT 1 \n"
-                     "                   FROM " +  DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME + " \n"
-                     "                   WHERE " + DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME + ".screenshotId=" +
-                                                   DBUtil::SCREENSHOT_TABLE_NAME + ".screenshotId \n"
-                     "                 );";
-    query.prepare(selectQueryStr);
-    safeExec(query, "Error: SELECT failed in deleteScreenshotsIfNotReferenced() with query: \n" + selectQueryStr);
-
-    // Delete screenshots from filesystem and prepare screenshotIds list for delte from Screenshots table.
-    while (query.next()) {
-        fileName = str(query.value("screenshotId").toInt());
-        screenshotPath = DBUtil::SCREENSHOT_DIR_PATH + fileName + ".png";
-        QFile file(screenshotPath);
-        // Check if it exists first to ensure user did not manually delete it perviously!
-        if (file.exists()) {
-            safeExec(file.remove(), "Error: Filesystem remove failed in deleteSceenshotsIfNotReferenced() for file: " + fileName);
-            deleteScreenshotIds.append(query.value("screenshotId").toInt());
+        QString queryStr = buildEventOrderQuery();
+        QSqlQuery query(_db);
+        query.prepare(queryStr);
+        query.bindValue(":macroId", macroId);
+        safeExec(query, "Error: SELECT failed in getEventOrder() with query: \n" + queryStr);
+
+        while (query.next()) {
+            EventOrderEntry orderEntry;
+            orderEntry.macroEventId = query.value(0).toInt();
+            orderEntry.orderKey = query.value(1).toLongLong();
+            orderEntry.eventHash = query.value(2).toLongLong();
+            order.append(orderEntry);
         }
+        return order;
     }
-
-    if (deleteScreenshotIds.size() != 0) {
-        // Delete Screenshot table rows.
-        deleteQueryStr = "DELETE FROM " + DBUtil::SCREENSHOT_TABLE_NAME + " \n"
-                         "WHERE " + buildscreenshotIdWhereClause(deleteScreenshotIds) + ";";
-        query.prepare(deleteQueryStr);
-        safeExec(query, "Error: DELETE failed in deleteScreenshotsIfNotReferenced() with query: \n" + deleteQueryStr);
-    }
-}
-
-
-int MacroEventModel::_getNumEventsForMacro(int id)
-{
-    QString queryStr = "SELECT COUNT(*) \n"
-                       "FROM " + DBUtil::MACRO_EVENTS_TABLE_NAME + " \n"
-                       "WHERE \n\t"  +
-                            buildMacroIdWhereClause(id) + ";";
-    QSqlQuery query(_db);
-    query.prepare(queryStr);
-    safeExec(query, "Error: SELECT failed in _getNumEventsForMacro() with query: \n" + queryStr);
-    safeExec(query.next(), "Error: Macro Events not found for Macro with ID: " + str(id));
-    return query.value(0).toInt();
+    return _eventOrders[macroId];
 }
 
 
-void MacroEventModel::correctEventIndexesBeforeAdd(QList<MacroEvent> &addMacroEvents)
+qint64 MacroEventModel::allocateOrderKey(int macroId, int eventInd)
 {
-    int amtToMove,
-        iEndContiguousChunk,
-        baseContiguousAddInds,
-        endContiguousAddInds,
-        indexToCorrectFrom = 0,
-        indexToCorrectTo;
-    QString queryStr;
-    QSqlQuery query(_db);
-
-    // Must sort Macro Events by event indexes in increasing order. The add event indexes will be used to
-    // determine how much to move current indexes that already fall in their place by to make room.
-    std::sort(addMacroEvents.begin(), addMacroEvents.end());
-
-    for (int i = addMacroEvents.size() - 1; i >= 0; i--) {
-        // Move by the number of addMacroEvents excluding the contiguous chunks that have already been encountered.
-        amtToMove = (i + 1);
-
-        // This is the end of the chunk of contiguous macro event indexes of events to be added.
-        endContiguousAddInds = addMacroEvents.at(i).index;
-        iEndContiguousChunk = i;
+    QList<EventOrderEntry> &order = getEventOrder(macroId);
+    qint64 lowerKey = (eventInd > 0) ? order.at(eventInd - 1).orderKey : 0;
 
-        // Find the beginning of the chunk of contiguous macro event indexes of events to be added (moving backwards).
-        while ((i - 1) >= 0 && addMacroEvents.at(i - 1).index == addMacroEvents.at(i).index - 1)
-        { i--; }
-        baseContiguousAddInds = addMacroEvents.at(i).index;
-
-        // Set the index to correct to to be the previous index that we were correcting from.
-        // This will simply be the beginning of the next chunk of contiguous add indexes.
-        indexToCorrectTo = (indexToCorrectFrom > 0) ? (indexToCorrectFrom - 1) : 1000000000;
-        // Set the index to correct from to be the base of the current contiguous add indexes.
-        indexToCorrectFrom = baseContiguousAddInds;
+    // Appending always has room.
+    if (eventInd >= order.size()) {
+        return lowerKey + EVENT_ORDER_GAP;
+    }
 
-        qDebug() << "Moving indexes " << indexToCorrectFrom << " to " << indexToCorrectTo << " forward by " << amtToMove;
+    // No room left between the neighbors, so spread the whole Macro back out first (rare).
+    qint64 upperKey = order.at(eventInd).orderKey;
+    if (upperKey - lowerKey < 2) {
+        rebalanceEventOrder(macroId);
+        lowerKey = (eventInd > 0) ? order.at(eventInd - 1).orderKey : 0;
+        upperKey = order.at(eventInd).orderKey;
+    }
 
-        // Do the update.
-        queryStr = "UPDATE " + DBUtil::MACRO_EVENTS_TABLE_NAME + " \n"
-                   "SET macroEventInd = macroEventInd + " + str(amtToMove) + " \n"
-                   "WHERE "  + buildMacroIdWhereClause() + " AND macroEventInd >= " + str(indexToCorrectFrom)
-                                                         + " AND macroEventInd <= " + str(indexToCorrectTo) + ";";
-        query.prepare(queryStr);
-        safeExec(query, "Error: UPDATE failed in correctEventIndexesBeforeAdd() with query: \n" + queryStr);
+    // Getting tight, so have the Macro rebalanced the next time the database is idle.
+    qint64 halfGap = (upperKey - lowerKey) / 2;
+    if (halfGap < EVENT_ORDER_CROWDED_GAP) {
+        DBMaintenanceThread::requestEventOrderRebalance(macroId);
     }
+    return lowerKey + halfGap;
 }
 
 
-void MacroEventModel::correctEventIndexesAfterDelete(QList<int> &deletedMacroEventInds)
+QList<int> MacroEventModel::getMacroEventIds(const QList<int> &eventInds)
 {
-    int amtToMove = 0,
-        baseContiguousDeleteInds,
-        endContiguousDeleteInds,
-        indexToCorrectFrom,
-        indexToCorrectTo;
-    QString queryStr;
-    QSqlQuery query(_db);
-
-    // Algorithm expects the indicies to be in sorted order since we are looking for incremental gaps between
-    // the indexes to be deleted. We will be moving the non deleted elements that fall in these gaps back by
-    // the total number of deleted elements encountered before them.
-    std::sort(deletedMacroEventInds.begin(), deletedMacroEventInds.end());
-
-    for (int i = 0; i < deletedMacroEventInds.length(); i++) {
-        // The beginning of a chunk of macro indexes to be deleted.
-        baseContiguousDeleteInds = deletedMacroEventInds.at(i);
-
-        // Find the end of the chunk of macro indexes to be deleted.
-        while (   (i + 1) < deletedMacroEventInds.length()
-               && deletedMacroEventInds.at(i + 1) == deletedMacroEventInds.at(i) + 1)
-        { i++; }
-        endContiguousDeleteInds = deletedMacroEventInds.at(i);
-
-        // This is the index immediately after the contiguous chunk of delete indexes (that must be moved back).
-        indexToCorrectFrom = endContiguousDeleteInds + 1;
-        // This is the index that falls immediately before the next contiguous chunk of delete indexes (that must be moved back).
-        indexToCorrectTo = ((i + 1) < deletedMacroEventInds.length() ? deletedMacroEventInds.at(i + 1) - 1 : 1000000000);
-        // This is the amount to shift all indexes within range indexToCorrectFrom to indexToCorrecTo back by (inclusive).
-        amtToMove += (indexToCorrectFrom - baseContiguousDeleteInds);
-
-        qDebug() << "Moving indexes " << indexToCorrectFrom << " to " << indexToCorrectTo << " back by " << amtToMove;
-
-        // Do the update.
-        queryStr = "UPDATE " + DBUtil::MACRO_EVENTS_TABLE_NAME + " \n"
-                   "SET macroEventInd = macroEventInd - " + str(amtToMove) + " \n"
-                   "WHERE "  + buildMacroIdWhereClause() + " AND macroEventInd >= " + str(indexToCorrectFrom)
-                                                         + " AND macroEventInd <= " + str(indexToCorrectTo) + ";";
-        query.prepare(queryStr);
-        safeExec(query, "Error: UPDATE failed in correctEventIndexesAfterDelete() with query: \n" + queryStr);
+    QList<int> macroEventIds;
+    foreach (int macroId, _activeMacroIds) {
+        const QList<EventOrderEntry> &order = getEventOrder(macroId);
+        foreach (int eventInd, eventInds) {
+            if (eventInd >= 0 && eventInd < order.size()) {
+                macroEventIds.append(order.at(eventInd).macroEventId);
+            }
+        }
     }
+    return macroEventIds;
 }
 
 
-QString MacroEventModel::buildMacroIdWhereClause(int id) const
+void MacroEventModel::fillEventOrderTable(const QVariantList &macroEventIds, const QVariantList &macroEventInds)
 {
-    QList<int> ids;
-    ids.append(id);
-    return buildMacroIdWhereClause(ids);
-}
+    QSqlQuery query(_db);
+    QString queryStr = "CREATE TEMP TABLE IF NOT EXISTS " + DBUtil::MACRO_EVENT_ORDER_TEMP_TABLE_NAME + " ( \n\t"
+                           "macroEventId INTEGER PRIMARY KEY, \n\t"
+                           "macroEventInd INTEGER NOT NULL \n"
+                       ");";
+    query.prepare(queryStr);
+    safeExec(query, "Error: CREATE failed in fillEventOrderTable() with query: \n" + queryStr);
 
+    queryStr = "DELETE FROM temp." + DBUtil::MACRO_EVENT_ORDER_TEMP_TABLE_NAME + ";";
+    query.prepare(queryStr);
+    safeExec(query, "Error: DELETE failed in fillEventOrderTable() with query: \n" + queryStr);
 
-QString MacroEventModel::buildMacroIdWhereClause(const QList<int> &ids) const
-{
-    const QList<int> &buildIds = (ids.size() == 0) ? _activeMacroIds : ids;
-    QString idWhere = " (";
-    foreach (int id, buildIds) {
-        idWhere += "macroId=" + str(id) + " OR ";
-    }
-    return idWhere.left(idWhere.size() - 4) + ") ";
+    if (macroEventIds.size() == 0) return;
+    queryStr = "INSERT INTO temp." + DBUtil::MACRO_EVENT_ORDER_TEMP_TABLE_NAME + " (macroEventId, macroEventInd) \n"
+               "VALUES (?, ?);";
+    query.prepare(queryStr);
+    query.addBindValue(macroEventIds);
+    query.addBindValue(macroEventInds);
+    safeExec(query.execBatch(), "Error: INSERT failed in fillEventOrderTable() with query: \n" + queryStr);
 }
 
 
-QString MacroEventModel::buildEventIndWhereClause(int eventInd) const
+void MacroEventModel::fillEventIdRemapTable(int macroId)
 {
-    QList<int> eventInds;
-    eventInds.append(eventInd);
-    return buildEventIndWhereClause(eventInds);
+    QSqlQuery query(_db);
+    QString queryStr = "CREATE TEMP TABLE IF NOT EXISTS " + DBUtil::MACRO_EVENT_ID_REMAP_TEMP_TABLE_NAME + " ( \n\t"
+                           "remapInd INTEGER PRIMARY KEY, \n\t"
+                           "srcMacroEventId INTEGER NOT NULL \n"
+                       ");";
+    query.prepare(queryStr);
+    safeExec(query, "Error: CREATE failed in fillEventIdRemapTable() with query: \n" + queryStr);
+
+    // Emptied, so remapInd numbering restarts from 1.
+    queryStr = "DELETE FROM temp." + DBUtil::MACRO_EVENT_ID_REMAP_TEMP_TABLE_NAME + ";";
+    query.prepare(queryStr);
+    safeExec(query, "Error: DELETE failed in fillEventIdRemapTable() with query: \n" + queryStr);
+
+    queryStr = "INSERT INTO temp." + DBUtil::MACRO_EVENT_ID_REMAP_TEMP_TABLE_NAME + " (srcMacroEventId) \n"
+               "SELECT macroEventId FROM " + DBUtil::MACRO_EVENTS_TABLE_NAME + " \n"
+               "WHERE macroId=:macroId \n"
+               "ORDER BY macroEventOrd;";
+    query.prepare(queryStr);
+    query.bindValue(":macroId", macroId);
+    safeExec(query, "Error: INSERT failed in fillEventIdRemapTable() with query: \n" + queryStr);
 }
 
 
-QString MacroEventModel::buildEventIndWhereClause(const QList<int> &eventInds) const
+QString MacroEventModel::buildUniformEventsQuery() const
 {
-    QString indWhere = " (";
-    foreach (int ind, eventInds) {
-        indWhere += "macroEventInd=" + str(ind) + " OR ";
-    }
-    return indWhere.left(indWhere.size() - 4) + ") ";
+    QString delayMsCol = DBUtil::MACRO_EVENTS_TABLE_NAME + ".delayMs";
+    QString durationMsCol = DBUtil::MACRO_EVENTS_TABLE_NAME + ".durationMs";
+    QString autoCorrectCol = DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME + ".autoCorrect";
+
+    // Matched events only differ in delay, duration, and auto correct. These are NULL (empty) when not uniform.
+    QString uniformEventsQueryStr =
+        "SELECT \n\t"
+            + DBUtil::MACRO_EVENT_ORDER_TEMP_TABLE_NAME + ".macroEventInd, \n\t"
+            "MIN(" + DBUtil::MACRO_EVENTS_TABLE_NAME + ".macroEventId) AS macroEventId, \n\t"
+            "CASE WHEN MAX(" + delayMsCol + ") = MIN(" + delayMsCol + ") THEN MAX(" + delayMsCol + ") END AS delayMs, \n\t"
+            "CASE WHEN MAX(" + durationMsCol + ") = MIN(" + durationMsCol + ") THEN MAX(" + durationMsCol + ") END AS durationMs, \n\t"
+            "CASE WHEN MAX(" + autoCorrectCol + ") = MIN(" + autoCorrectCol + ") THEN MAX(" + autoCorrectCol + ") END AS autoCorrect \n"
+        "FROM temp." + DBUtil::MACRO_EVENT_ORDER_TEMP_TABLE_NAME + " \n"
+        "INNER JOIN " + DBUtil::MACRO_EVENTS_TABLE_NAME + " \n\t"
+            "ON " + DBUtil::MACRO_EVENTS_TABLE_NAME           + ".macroEventId = "
+                  + DBUtil::MACRO_EVENT_ORDER_TEMP_TABLE_NAME + ".macroEventId \n"
+        "LEFT JOIN " + DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME + " \n\t"
+            "ON " + DBUtil::MACRO_EVENTS_TABLE_NAME       + ".macroEventId = "
+                  + DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME + ".macroEventId \n"
+        "GROUP BY " + DBUtil::MACRO_EVENT_ORDER_TEMP_TABLE_NAME + ".macroEventInd";
+
+    return "SELECT \n\t"
+               "UniformEvents.macroEventInd, \n\t"
+               "UniformEvents.delayMs, \n\t"
+               "UniformEvents.durationMs, \n\t"
+               "UniformEvents.autoCorrect, \n\t"
+               + DBUtil::MACRO_EVENTS_TABLE_NAME          + ".macroEventType,         \n\t"
+               + DBUtil::MACRO_EVENTS_TABLE_NAME          + ".nRepeats,               \n\t"
+               + DBUtil::MACRO_EVENTS_TABLE_NAME          + ".targetPID,              \n\t"
+               + DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME    + ".macroMouseEventType,    \n\t"
+               + DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME    + ".xLoc,                   \n\t"
+               + DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME    + ".yLoc,                   \n\t"
+               + DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME    + ".wheelDelta,             \n\t"
+               + DBUtil::SCREENSHOT_TABLE_NAME            + ".screenshotId,           \n\t"
+               + DBUtil::SCREENSHOT_TABLE_NAME            + ".screenshotX,            \n\t"
+               + DBUtil::SCREENSHOT_TABLE_NAME            + ".screenshotY,            \n\t"
+               + DBUtil::SCREENSHOT_TABLE_NAME            + ".screenshotW,            \n\t"
+               + DBUtil::SCREENSHOT_TABLE_NAME            + ".screenshotH,            \n\t"
+               + DBUtil::SCREENSHOT_TABLE_NAME            + ".targetImgType,          \n\t"
+               + DBUtil::SCREENSHOT_TABLE_NAME            + ".cursorType,             \n\t"
+               + DBUtil::SCREENSHOT_TABLE_NAME            + ".blobHash,               \n\t"
+               + DBUtil::SCREENSHOT_TABLE_NAME            + ".cropX,                  \n\t"
+               + DBUtil::SCREENSHOT_TABLE_NAME            + ".cropY,                  \n\t"
+               + DBUtil::SCREENSHOT_TABLE_NAME            + ".contextBlobHash,        \n\t"
+               + DBUtil::SCREENSHOT_TABLE_NAME            + ".contextScale,           \n\t"
+               + DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME + ".macrokeyboardEventType, \n\t"
+               + DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME + ".keyCode,                \n\t"
+               + DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME + ".mod1,                   \n\t"
+               + DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME + ".mod2,                   \n\t"
+               + DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME + ".capsLock,               \n\t"
+               + DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME + ".numLock,                \n\t"
+               + DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME + ".keyString               \n"
+           "FROM ( \n" + uniformEventsQueryStr + "\n) AS UniformEvents \n"
+           "INNER JOIN " + DBUtil::MACRO_EVENTS_TABLE_NAME + " \n\t"
+               "ON " + DBUtil::MACRO_EVENTS_TABLE_NAME + ".macroEventId = UniformEvents.macroEventId \n"
+           "LEFT JOIN " + DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME + " \n\t"
+               "ON " + DBUtil::MACRO_EVENTS_TABLE_NAME       + ".macroEventId = "
+                     + DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME + ".macroEventId \n"
+           "LEFT JOIN " + DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME + " \n\t"
+               "ON " + DBUtil::MACRO_EVENTS_TABLE_NAME          + ".macroEventId = "
+                     + DBUtil::MACRO_KEYBOARD_EVENTS_TABLE_NAME + ".macroEventId \n"
+           "LEFT JOIN " + DBUtil::SCREENSHOT_TABLE_NAME + " \n\t"
+               "ON " + DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME + ".screenshotId = "
+                     + DBUtil::SCREENSHOT_TABLE_NAME         + ".screenshotId \n"
+           "ORDER BY UniformEvents.macroEventInd ASC;";
 }
 
 
-QString MacroEventModel::buildEventIdWhereClause(int eventInd)
+QString MacroEventModel::buildEventOrderQuery() const
 {
-    QString queryStr = "SELECT macroEventId \n"
-                       "FROM " + DBUtil::MACRO_EVENTS_TABLE_NAME + " \n"
-                       "WHERE " + buildMacroIdWhereClause() + " AND " + buildEventIndWhereClause(eventInd) + ";";
-    QSqlQuery query(_db);
-    query.prepare(queryStr);
-    safeExec(query, "Error: SELECT failed in buildEventIdWhereClause() with query: \n" + queryStr);
-
-    QString macroEventIdWhere = "(";
-    while (query.next()) {
-        macroEventIdWhere += "macroEventId=" + query.value("macroEventId").toString() + " OR ";
-    }
-    return macroEventIdWhere.left(macroEventIdWhere.size() - 4) + ")";
+    // Served entirely from macroEventOrdIndex (macroEventId is the rowid, so the index covers it). The ORDER BY must
+    // follow the index columns exactly, since skipping eventHash would sort the ties in a temp B-tree.
+    return "SELECT macroEventId, macroEventOrd, eventHash \n"
+           "FROM " + DBUtil::MACRO_EVENTS_TABLE_NAME + " \n"
+           "WHERE macroId=:macroId \n"
+           "ORDER BY macroEventOrd ASC, eventHash ASC, macroEventId ASC;";
 }
 
 
-QString MacroEventModel::buildscreenshotIdWhereClause(const QList<int> &screenshotIds) const
+QString MacroEventModel::buildEventCountQuery() const
 {
-    QString screenshotIdWhere = "(";
-    foreach (int screenshotId, screenshotIds) {
-        screenshotIdWhere += "screenshotId=" + str(screenshotId) + " OR ";
-    }
-    return screenshotIdWhere.left(screenshotIdWhere.size() - 4) + ")";
+    return "SELECT COUNT(*) \n"
+           "FROM " + DBUtil::MACRO_EVENTS_TABLE_NAME + " \n"
+           "WHERE macroId=:macroId;";
 }
 
 
@@ -769,11 +1138,12 @@ void MacroEventModel::fillMacroEvent(MacroEvent &macroEvent, const QSqlQuery &qu
     mouseEvent.targetImgType = (TargetImgType)query.value("targetImgType").toInt();
     mouseEvent.cursorType = (CursorType)query.value("cursorType").toInt();
     mouseEvent.autoCorrect = (query.value("autoCorrect").toInt() == 1);
-    // If we have a screenshot.
-    if (mouseEvent.screenshotId >= 0) {
-        mouseEvent.screenshotImg.load(generateScreenshotPathFromId(mouseEvent.screenshotId));
-        mouseEvent.screenshotImg.convertToFormat(QImage::Format_Indexed8);
-    }
+    // Screenshots are only decoded once they are needed (shared by all events that reference the same one).
+    mouseEvent.screenshot = ScreenshotHandle::fromBlob(query.value("blobHash").toByteArray());
+    mouseEvent.screenshotOrg.setX(query.value("cropX").toInt());
+    mouseEvent.screenshotOrg.setY(query.value("cropY").toInt());
+    mouseEvent.contextScreenshot = ScreenshotHandle::fromBlob(query.value("contextBlobHash").toByteArray());
+    mouseEvent.contextScale = query.value("contextScale").toDouble();
 
     MacroKeyboardEvent &keyboardEvent = macroEvent.keyboardEvent;
     keyboardEvent.type = (MacroKeyboardEventType)query.value("macrokeyboardEventType").toInt();
@@ -817,6 +1187,12 @@ void MacroEventModel::macroEventTest()
             printAllMacroEvents();
         #endif
     #endif // TEST_MACRO_EVENT
+    #ifdef TEST_QUERY_PLANS
+        queryPlanTest();
+    #endif
+    #ifdef TEST_SCREENSHOT_SWEEP_HOLD
+        screenshotSweepHoldTest();
+    #endif
 }
 
 
@@ -944,7 +1320,8 @@ void MacroEventModel::macroEventTest()
                                "LEFT JOIN " + DBUtil::SCREENSHOT_TABLE_NAME + "\n\t"
                                             "ON " + DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME + ".screenshotId = "
                                                   + DBUtil::SCREENSHOT_TABLE_NAME         + ".screenshotId \n"
-                               "ORDER BY " + DBUtil::MACRO_EVENTS_TABLE_NAME + ".macroEventInd ASC;";
+                               "ORDER BY " + DBUtil::MACRO_EVENTS_TABLE_NAME + ".macroId ASC, "
+                                           + DBUtil::MACRO_EVENTS_TABLE_NAME + ".macroEventOrd ASC;";
 
             QSqlQuery query(_db);
             query.prepare(queryStr);
@@ -962,3 +1339,199 @@ void MacroEventModel::macroEventTest()
     #endif
 
 #endif // TEST_MACRO_EVENT
+
+
+#ifdef TEST_QUERY_PLANS
+
+    void MacroEventModel::queryPlanTest()
+    {
+        qDebug() << "\n\nMACRO EVENT QUERY PLAN TEST OUTPUT\n";
+        const int NUM_MACROS = 20, NUM_EVENTS_PER_MACRO = 200;
+
+        // The planner costs plans by table size, so plans over empty tables say little about real ones. Seed
+        // representative rows and ANALYZE them, all in a transaction that is rolled back once the plans are checked.
+        safeOpenAndBegin("Error: DB open and BEGIN TRANSACTION failed in queryPlanTest()");
+        QSqlQuery query(_db);
+        query.prepare("SELECT IFNULL(MAX(macroId), 0) FROM " + DBUtil::MACROS_TABLE_NAME + ";");
+        safeExec(query, "Error: SELECT failed in queryPlanTest() with query: \n" + query.lastQuery());
+        int lastRealMacroId = query.next() ? query.value(0).toInt() : 0;
+        query.prepare("SELECT IFNULL(MAX(screenshotId), 0) FROM " + DBUtil::SCREENSHOT_TABLE_NAME + ";");
+        safeExec(query, "Error: SELECT failed in queryPlanTest() with query: \n" + query.lastQuery());
+        qint64 lastRealScreenshotId = query.next() ? query.value(0).toLongLong() : 0;
+        query.prepare("SELECT IFNULL(MAX(macroEventId), 0) FROM " + DBUtil::MACRO_EVENTS_TABLE_NAME + ";");
+        safeExec(query, "Error: SELECT failed in queryPlanTest() with query: \n" + query.lastQuery());
+        int lastRealEventId = query.next() ? query.value(0).toInt() : 0;
+
+        QString seqStr = "WITH RECURSIVE seq(n) AS (SELECT 1 UNION ALL SELECT n+1 FROM seq WHERE n < :count) \n";
+        query.prepare(seqStr + "INSERT INTO " + DBUtil::MACROS_TABLE_NAME + " (macroName) \n"
+                      "SELECT 'Query plan test ' || n FROM seq;");
+        query.bindValue(":count", NUM_MACROS);
+        safeExec(query, "Error: INSERT failed in queryPlanTest() with query: \n" + query.lastQuery());
+        query.prepare(seqStr + "INSERT INTO " + DBUtil::MACRO_EVENTS_TABLE_NAME + " \n\t"
+                          "(macroId, macroEventOrd, macroEventType, delayMs, durationMs, nRepeats, eventHash) \n"
+                      "SELECT macroId, n * :gap, :eventType, 100, 0, 1, (macroId << 16) + n \n"
+                      "FROM " + DBUtil::MACROS_TABLE_NAME + " CROSS JOIN seq WHERE macroId > :lastMacroId \n"
+                      "ORDER BY macroId, n;");
+        query.bindValue(":count", NUM_EVENTS_PER_MACRO);
+        query.bindValue(":gap", EVENT_ORDER_GAP);
+        query.bindValue(":eventType", (int)MouseEvent);
+        query.bindValue(":lastMacroId", lastRealMacroId);
+        safeExec(query, "Error: INSERT failed in queryPlanTest() with query: \n" + query.lastQuery());
+        // Every event gets a screenshot, and every tenth screenshot is left unreferenced, waiting for a sweep.
+        query.prepare("INSERT INTO " + DBUtil::SCREENSHOT_TABLE_NAME + " \n\t"
+                          "(screenshotId, screenshotX, screenshotY, screenshotW, screenshotH, targetImgType, cursorType) \n"
+                      "SELECT :lastScreenshotId + macroEventId, 0, 0, 64, 32, 0, 0 \n"
+                      "FROM " + DBUtil::MACRO_EVENTS_TABLE_NAME + " WHERE macroEventId > :lastEventId;");
+        query.bindValue(":lastScreenshotId", lastRealScreenshotId);
+        query.bindValue(":lastEventId", lastRealEventId);
+        safeExec(query, "Error: INSERT failed in queryPlanTest() with query: \n" + query.lastQuery());
+        query.prepare("INSERT INTO " + DBUtil::MACRO_MOUSE_EVENTS_TABLE_NAME + " \n\t"
+                          "(macroEventId, macroMouseEventType, xLoc, yLoc, wheelDelta, screenshotId, autoCorrect) \n"
+                      "SELECT macroEventId, :mouseEventType, 32, 16, 0, \n\t"
+                          "CASE WHEN macroEventId % 10 = 0 THEN NULL ELSE :lastScreenshotId + macroEventId END, 1 \n"
+                      "FROM " + DBUtil::MACRO_EVENTS_TABLE_NAME + " WHERE macroEventId > :lastEventId;");
+        query.bindValue(":mouseEventType", (int)LeftClick);
+        query.bindValue(":lastScreenshotId", lastRealScreenshotId);
+        query.bindValue(":lastEventId", lastRealEventId);
+        safeExec(query, "Error: INSERT failed in queryPlanTest() with query: \n" + query.lastQuery());
+
+        // The order table holds the events of one Macro that is open in the editor.
+        int macroId = lastRealMacroId + 1;
+        QVariantList macroEventIds, macroEventInds;
+        query.prepare("SELECT macroEventId FROM " + DBUtil::MACRO_EVENTS_TABLE_NAME + " WHERE macroId=:macroId \n"
+                      "ORDER BY macroEventOrd;");
+        query.bindValue(":macroId", macroId);
+        safeExec(query, "Error: SELECT failed in queryPlanTest() with query: \n" + query.lastQuery());
+        while (query.next()) {
+            macroEventInds.append(macroEventIds.size());
+            macroEventIds.append(query.value(0));
+        }
+        fillEventOrderTable(macroEventIds, macroEventInds);
+
+        query.prepare("ANALYZE;");
+        safeExec(query, "Error: ANALYZE failed in queryPlanTest()");
+
+        query.prepare("EXPLAIN QUERY PLAN " + buildEventOrderQuery());
+        query.bindValue(":macroId", macroId);
+        checkQueryPlan(query, "getEventOrder()", "USING COVERING INDEX macroEventOrdIndex (macroId=?)");
+
+        query.prepare("EXPLAIN QUERY PLAN " + buildEventCountQuery());
+        query.bindValue(":macroId", macroId);
+        checkQueryPlan(query, "_getNumEventsForMacro()", "USING COVERING INDEX macroEventOrdIndex (macroId=?)");
+
+        query.prepare("EXPLAIN QUERY PLAN " + buildUniformEventsQuery());
+        checkQueryPlan(query, "getUniformEvents()", "USING INTEGER PRIMARY KEY (rowid=?)");
+
+        // The background screenshot sweep (see ScreenshotStore::sweep()) only visits unreferenced screenshots.
+        query.prepare("EXPLAIN QUERY PLAN SELECT screenshotId FROM " + DBUtil::SCREENSHOT_TABLE_NAME + " WHERE refCount=0;");
+        checkQueryPlan(query, "ScreenshotStore::sweep()", "USING INDEX screenshotUnreferencedIndex");
+
+        // Also rolls back the statistics, so that the planner goes back to those of the real rows.
+        query.finish();
+        safeExec(_db.rollback(), "Error: ROLLBACK failed in queryPlanTest()");
+        _db.close();
+    }
+
+
+    bool MacroEventModel::checkQueryPlan(QSqlQuery &query, const QString &queryDesc, const QString &expectedStep)
+    {
+        safeExec(query, "Error: EXPLAIN QUERY PLAN failed in checkQueryPlan() for " + queryDesc);
+
+        // The detail column is the last one. Older SQLite versions say "SEARCH TABLE x" instead of "SEARCH x",
+        // so only the access path part of a step is compared.
+        QStringList planSteps;
+        while (query.next()) {
+            planSteps.append(query.value(query.record().count() - 1).toString());
+        }
+        bool pass = false;
+        foreach (QString planStep, planSteps) {
+            pass |= planStep.contains(expectedStep);
+        }
+
+        qDebug().noquote() << (pass ? "PASS: " : "FAIL: ") + queryDesc;
+        if (!pass) {
+            qDebug().noquote() << "    Expected step: " + expectedStep;
+            qDebug().noquote() << "    Actual plan:   " + planSteps.join("\n                   ");
+        }
+        return pass;
+    }
+
+#endif // TEST_QUERY_PLANS
+
+
+#ifdef TEST_SCREENSHOT_SWEEP_HOLD
+
+    void MacroEventModel::screenshotSweepHoldTest()
+    {
+        qDebug() << "\n\nSCREENSHOT SWEEP HOLD TEST OUTPUT\n";
+        QList<int> prevActiveMacroIds = _activeMacroIds;
+
+        // A Macro of its own, so that no real Macro is touched.
+        safeOpenAndBegin("Error: DB open and BEGIN TRANSACTION failed in screenshotSweepHoldTest()");
+        QSqlQuery query(_db);
+        query.prepare("INSERT INTO " + DBUtil::MACROS_TABLE_NAME + " (macroName) VALUES ('Screenshot sweep hold test');");
+        safeExec(query, "Error: INSERT failed in screenshotSweepHoldTest() with query: \n" + query.lastQuery());
+        int macroId = query.lastInsertId().toInt();
+        safeCommitAndClose("Error: DB COMMIT failed in screenshotSweepHoldTest()");
+        setActiveMacro(macroId);
+
+        // A saved click with a screenshot of its own.
+        QImage image(48, 32, QImage::Format_RGB32);
+        for (int y = 0; y < image.height(); y++) {
+            for (int x = 0; x < image.width(); x++) {
+                image.setPixel(x, y, qRgb(x * 5, y * 7, macroId % 256));
+            }
+        }
+        MacroEvent event;
+        event.type = MouseEvent;
+        event.mouseEvent.type = LeftClick;
+        event.mouseEvent.loc = QPoint(24, 16);
+        event.mouseEvent.screenshotId = ScreenshotStore::generateNewScreenshotId();
+        event.mouseEvent.screenshot = ScreenshotHandle::fromImage(image);
+        event.mouseEvent.screenshotRect = QRect(8, 8, 32, 16);
+        QList<MacroEvent> events;
+        events.append(event);
+        addEvents(events);
+
+        // The editor opens, which holds the sweep, and keeps lazy handles to the events that it never decodes.
+        ScreenshotStore::holdSweep();
+        QList<MacroEvent> editorEvents = getUniformEvents();
+
+        // Delete -> save -> sweep -> undo -> save.
+        QList<int> eventInds;
+        eventInds.append(0);
+        removeEvents(eventInds);
+        safeOpen("Error: DB open failed in screenshotSweepHoldTest()");
+        int sweepResult = ScreenshotStore::sweep(_db);
+        _db.close();
+        addEvents(editorEvents);
+
+        // The screenshot must still have its image.
+        safeOpen("Error: DB open failed in screenshotSweepHoldTest()");
+        QSqlQuery blobQuery(_db);
+        blobQuery.prepare("SELECT blobHash FROM " + DBUtil::SCREENSHOT_TABLE_NAME + " WHERE screenshotId=:screenshotId;");
+        blobQuery.bindValue(":screenshotId", event.mouseEvent.screenshotId);
+        safeExec(blobQuery, "Error: SELECT failed in screenshotSweepHoldTest() with query: \n" + blobQuery.lastQuery());
+        QByteArray blobHash = blobQuery.next() ? blobQuery.value("blobHash").toByteArray() : QByteArray();
+        _db.close();
+        ScreenshotStore::releaseSweep();
+
+        bool pass = (sweepResult < 0 && !blobHash.isEmpty() && !ScreenshotStore::load(blobHash).isNull());
+        qDebug().noquote() << (pass ? "PASS: " : "FAIL: ") + QString("Undo of a saved delete after a held sweep");
+        if (!pass) {
+            qDebug() << "    Sweep result: " << sweepResult << " Blob hash: " << blobHash.toHex();
+        }
+
+        // Clean up. The screenshot is swept along with anything else that is unreferenced.
+        QList<int> allEventInds;
+        removeEvents(allEventInds);
+        safeOpenAndBegin("Error: DB open and BEGIN TRANSACTION failed in screenshotSweepHoldTest()");
+        QSqlQuery cleanupQuery(_db);
+        cleanupQuery.prepare("DELETE FROM " + DBUtil::MACROS_TABLE_NAME + " WHERE macroId=:macroId;");
+        cleanupQuery.bindValue(":macroId", macroId);
+        safeExec(cleanupQuery, "Error: DELETE failed in screenshotSweepHoldTest() with query: \n" + cleanupQuery.lastQuery());
+        safeCommitAndClose("Error: DB COMMIT failed in screenshotSweepHoldTest()");
+        setActiveMacros(prevActiveMacroIds);
+    }
+
+#endif // TEST_SCREENSHOT_SWEEP_HOLD
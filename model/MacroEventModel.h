@@ -4,7 +4,14 @@
 
 #include "Model.h"
 #include "MacroEvent.h"
+#include "SqlIdSet.h"
+#include "ScreenshotStore.h"
+#include "ReplayPlan.h"
 #include <QList>
+#include <QHash>
+#include <QPair>
+#include <QVariantList>
+#include <QSharedPointer>
 
 
 /**
@@ -15,8 +22,35 @@ class MacroEventModel : public Model
 {
 public:
 
+    /**
+     * @brief EVENT_ORDER_GAP
+     * Spacing between the sparse ordering keys (MacroEvents.macroEventOrd) of consecutive Macro Events when a
+     * Macro is appended to or rebalanced. Inserts take the midpoint between their neighbors' keys, so roughly
+     * log2(EVENT_ORDER_GAP) inserts can land at the same spot before any other row has to be renumbered.
+     */
+    const static qint64 EVENT_ORDER_GAP;
+    /**
+     * @brief EVENT_ORDER_CROWDED_GAP
+     * Once an insert leaves less than this much room between neighboring ordering keys, the Macro is queued
+     * for a background rebalance (see DBMaintenanceThread).
+     */
+    const static qint64 EVENT_ORDER_CROWDED_GAP;
+    /**
+     * @brief MAX_DELTA_KEYFRAMES
+     * The maximum number of Macro and screenshot size pairs that a delta keyframe is kept for (see _deltaKeyframes).
+     */
+    const static int MAX_DELTA_KEYFRAMES;
+
     explicit MacroEventModel();
 
+    /**
+     * @brief MacroEventModel
+     * Constructor for a model that uses a connection other than the main DBUtil::DB_CONNECTION_NAME connection
+     * (e.g. a background thread's connection from DBUtil::threadConnection()).
+     * @param db The database connection that the model will use.
+     */
+    explicit MacroEventModel(QSqlDatabase db);
+
     /**
      * @brief setActiveMacro
      * Sets the active Macro. Active Macros are the Macros that Macro Events will be read and written to.
@@ -77,6 +111,15 @@ public:
      */
     void addEvents(QList<MacroEvent> &events);
 
+    /**
+     * @brief copyEvents
+     * Appends copies of all Macro Events of a Macro to the active Macro(s). The copy is done entirely inside the
+     * database, and the copied mouse events share the source Macro's screenshots.
+     * @param srcMacroId
+     * The ID of the Macro to copy the events of.
+     */
+    void copyEvents(int srcMacroId);
+
 
     /**
      * @brief getUniformEvents
@@ -86,6 +129,21 @@ public:
      */
     QList<MacroEvent> getUniformEvents();
 
+    /**
+     * @brief getReplayPlan
+     * Gets the compiled replay plan of the active Macro, compiling and caching it first if it is not cached yet.
+     * @return
+     * The replay plan of the first active Macro.
+     */
+    QSharedPointer<const ReplayPlan> getReplayPlan();
+
+    /**
+     * @brief requestReplayPlans
+     * Queues the active Macros to have their replay plans compiled in the background. Call once changes to the
+     * active Macros' events have been committed, so that the plans are ready before the Macros are activated.
+     */
+    void requestReplayPlans();
+
     /**
      * @brief setEvent
      * Sets the Macro Event for the active Macro(s) at a specific event index.
@@ -95,6 +153,27 @@ public:
     void setEvent(const MacroEvent &event);
 
 
+    /**
+     * @brief moveEvents
+     * Moves events within the active Macros. Only the ordering keys of the moved events are rewritten.
+     * @param eventInds
+     * The event indexes of the events to move.
+     * @param destEventInd
+     * The index that the first moved event will have once the moved events have been taken out of their old positions.
+     * The moved events keep their relative order.
+     */
+    void moveEvents(QList<int> &eventInds, int destEventInd);
+
+
+    /**
+     * @brief rebalanceEventOrder
+     * Spreads the ordering keys of a Macro's events back out to EVENT_ORDER_GAP increments.
+     * @param macroId
+     * The ID of the Macro to rebalance.
+     */
+    void rebalanceEventOrder(int macroId);
+
+
     /**
      * @brief removeEvent
      * Removes an event from the active Macros at the specified event index.
@@ -116,32 +195,154 @@ public:
     /**
      * @brief generateNewScreenshotId
      * Generates a new screenshot ID. The screenshot ID will be used to locate screenshot information
-     * in the database Screenshot table, and will be used as the name of the screenshot image file
-     * in the file system.
+     * in the database Screenshot table.
      * @return
-     * The randomly generated screenshot ID.
+     * The generated screenshot ID.
      */
     static int generateNewScreenshotId();
 
     /**
-     * @brief generateScreenshotPathFromId
-     * Generates a screenshot path and filename based off of a given screenshot ID.
-     * @param screenshotId
-     * The given screenshot ID to generate the screenshot path off of.
+     * @brief computeEventHash
+     * Computes the canonical hash of a Macro Event's identity fields (everything but its index, delay, duration,
+     * and auto correct setting). It is stored in MacroEvents.eventHash, and Macro Events with equal hashes are
+     * treated as the same event by getUniformEvents().
+     * @param event
+     * The Macro Event to hash.
      * @return
-     * The screenshot path and file name.
+     * The identity hash.
      */
-    static QString generateScreenshotPathFromId(int screenshotId);
+    static qint64 computeEventHash(const MacroEvent &event);
 
 
 private:
 
+    /**
+     * @brief The EventOrderEntry struct
+     * A Macro Event ID, its sparse ordering key, and its identity hash. A Macro's entries sorted by ordering key
+     * give the Macro Event at each (dense) event index.
+     */
+    struct EventOrderEntry
+    {
+        int macroEventId;
+        qint64 orderKey;
+        qint64 eventHash;
+    };
+
     /**
      * @brief _activeMacroIds
      * List of the active Macro's IDs.
      */
     QList<int> _activeMacroIds;
 
+    /**
+     * @brief _eventOrders
+     * Cache of each Macro's Macro Event order keyed by Macro ID. Loaded lazily and kept in sync with our own writes
+     * until the connection is reopened (background maintenance may rebalance while it is closed).
+     */
+    QHash<int, QList<EventOrderEntry>> _eventOrders;
+
+    /**
+     * @brief _eventOrdersOpenCount
+     * The connection open count (see Model::getConnectionOpenCount()) that _eventOrders was loaded under.
+     */
+    quint64 _eventOrdersOpenCount;
+
+    /**
+     * @brief The DeltaKeyframe struct
+     * The latest keyframe screenshot of a given Macro and size, that new screenshots of the same Macro and size are
+     * delta encoded against.
+     */
+    struct DeltaKeyframe
+    {
+        QImage image;
+        QByteArray blobHash; // Empty until it is encoded.
+        int deltaCount;
+    };
+
+    /**
+     * @brief The ScreenshotEncodeJob struct
+     * A screenshot to encode, either as a keyframe or as a delta against a keyframe.
+     */
+    struct ScreenshotEncodeJob
+    {
+        QImage image;
+        QList<int> changedTiles;
+        QByteArray keyframeBlobHash; // Empty for a keyframe.
+        int keyframeJob;             // The keyframe job of a delta against a keyframe that is being encoded as well.
+    };
+
+    /**
+     * @brief DeltaKeyframeKey
+     * The Macro ID and screenshot size (see deltaKeyframeKey()) that a delta keyframe belongs to.
+     */
+    typedef QPair<int, qint64> DeltaKeyframeKey;
+
+    /**
+     * @brief _deltaKeyframes
+     * The delta keyframes of recently added screenshots keyed by Macro and screenshot size.
+     */
+    QHash<DeltaKeyframeKey, DeltaKeyframe> _deltaKeyframes;
+
+    /**
+     * @brief _encodedScreenshots
+     * Screenshots of the events being added that were encoded ahead of the transaction, keyed by QImage::cacheKey().
+     */
+    QHash<qint64, ScreenshotStore::EncodedScreenshot> _encodedScreenshots;
+
+
+    /**
+     * @brief getEventOrder
+     * Gets the (cached) Macro Event order of a Macro.
+     * @param macroId
+     * The ID of the Macro.
+     * @return
+     * The Macro's event order entries sorted by ordering key, so list position is the event index.
+     */
+    QList<EventOrderEntry>& getEventOrder(int macroId);
+
+    /**
+     * @brief allocateOrderKey
+     * Allocates an ordering key for a new Macro Event at a given event index. The Macro is rebalanced first
+     * if there is no room left between the neighboring keys.
+     * @param macroId
+     * The ID of the Macro the event will be inserted into.
+     * @param eventInd
+     * The event index the new event will have.
+     * @return
+     * The ordering key.
+     */
+    qint64 allocateOrderKey(int macroId, int eventInd);
+
+    /**
+     * @brief getMacroEventIds
+     * Gets the IDs of the Macro Events at given event indexes in all active Macros.
+     * @param eventInds
+     * The event indexes.
+     * @return
+     * The Macro Event IDs.
+     */
+    QList<int> getMacroEventIds(const QList<int> &eventInds);
+
+    /**
+     * @brief fillEventOrderTable
+     * Fills the temporary MacroEventOrder table with the (dense) event indexes of given Macro Events,
+     * so queries can join on event index.
+     * @param macroEventIds
+     * The Macro Event IDs.
+     * @param macroEventInds
+     * The event index of each Macro Event.
+     */
+    void fillEventOrderTable(const QVariantList &macroEventIds, const QVariantList &macroEventInds);
+
+    /**
+     * @brief fillEventIdRemapTable
+     * Fills the temporary MacroEventIdRemap table with the Macro Event IDs of a Macro in event order, numbered
+     * from 1 (remapInd). A copy of the Macro Events gets the IDs base + remapInd for an unused base ID.
+     * @param macroId
+     * The ID of the Macro.
+     */
+    void fillEventIdRemapTable(int macroId);
+
 
     /**
      * @brief addMouseEvent
@@ -161,6 +362,49 @@ private:
      */
     void addScreenshotIfNotExist(const MacroMouseEvent &mEvent);
 
+    /**
+     * @brief encodeNewScreenshots
+     * Encodes the screenshots of events that are not in the ScreenshotStore yet, in parallel, into
+     * _encodedScreenshots. Screenshots that mostly match the delta keyframe of their size are encoded as tile
+     * deltas against it (see ScreenshotDelta), others become the new keyframe of their size. Should be called
+     * before the transaction that adds the events, so that it is not held open while encoding.
+     * @param events
+     * The events about to be added.
+     */
+    void encodeNewScreenshots(const QList<MacroEvent> &events);
+
+    /**
+     * @brief putScreenshot
+     * Adds a screenshot image to the ScreenshotStore, using its encoding from _encodedScreenshots if there is one.
+     * @param screenshot
+     * The screenshot to add.
+     * @return
+     * The blob hash (empty if there is no screenshot).
+     */
+    QByteArray putScreenshot(const ScreenshotHandle &screenshot);
+
+    /**
+     * @brief encodeScreenshotJob
+     * Encodes a screenshot as a keyframe or delta. Safe to call from any thread.
+     * @param job
+     * The screenshot to encode (keyframeBlobHash must be filled in for a delta).
+     * @return
+     * The encoded screenshot.
+     */
+    static ScreenshotStore::EncodedScreenshot encodeScreenshotJob(const ScreenshotEncodeJob &job);
+
+    /**
+     * @brief deltaKeyframeKey
+     * Generates the key of a Macro and screenshot size in _deltaKeyframes.
+     * @param macroId
+     * The ID of the Macro that the screenshot is added to.
+     * @param image
+     * The screenshot.
+     * @return
+     * The key.
+     */
+    static DeltaKeyframeKey deltaKeyframeKey(int macroId, const QImage &image);
+
     /**
      * @brief addKeyboardEvent
      * Adds a MacroKeyboardEvent to the MacroKeyboardEvents table without committing or closing the database connection.
@@ -177,43 +421,20 @@ private:
      * Sets a MacroMouseEvent to the MacroMouseEvents table without committing or closing the database connection.
      * @param mEvent
      * The MacroMouseEvent to set.
-     * @param macroEventIdWhereClause
-     * The where clause filter by macroEventIds.
+     * @param macroEventIdSet
+     * The IDs of the Macro Events to set (already prepared on the connection).
      */
-    void setMouseEvent(const MacroMouseEvent &mEvent, const QString &macroEventIdWhereClause);
+    void setMouseEvent(const MacroMouseEvent &mEvent, const SqlIdSet &macroEventIdSet);
 
     /**
      * @brief setKeyboardEvent
      * Sets a MacroKeyboardEvent to the MacroKeyboardEvents table without committing or closing the database connection.
      * @param kEvent
      * The MacroKeyboardEvent to set.
-     * @param macroEventIdWhereClause
-     * The where clause filter by macroEventIds.
-     */
-    void setKeyboardEvent(const MacroKeyboardEvent &kEvent, const QString &macroEventIdWhereClause);
-
-
-    /**
-     * @brief getscreenshotIdsForEvents
-     * Gets the keys of screenshot table entries associated with a given list of Macro Events. Basically,
-     * if the list contains Macro Events that are location sensitive mouse events, they will have screenshot
-     * table entries associated with them.
-     * @param eventInds
-     * The indexes of Macro Events to get associated screenshot keys of.
-     * @return
-     * A list of associated screenshot keys.
+     * @param macroEventIdSet
+     * The IDs of the Macro Events to set (already prepared on the connection).
      */
-    QList<int> getscreenshotIdsForEvents(QList<int> eventInds);
-
-
-    /**
-     * @brief deleteScreenshotsIfNotReferenced
-     * Deletes screenshots listed in a given screenshots list if they are no longer referenced by any Macro Event.
-     * This entails deleting the screenshot from the filesystem and the Screenshots table.
-     * @param screenshotIds
-     * The list of keys of possible screenshots to be delted (if no longer referenced).
-     */
-    void deleteScreenshotsIfNotReferenced(const QList<int> &screenshotIds);
+    void setKeyboardEvent(const MacroKeyboardEvent &kEvent, const SqlIdSet &macroEventIdSet);
 
 
     /**
@@ -227,81 +448,29 @@ private:
 
 
     /**
-     * @brief correctEventIndexesBeforeAdd
-     * Corrects the Macro Event indexes for all active Macros before a Macro Event Add operation occurs.
-     * @param addedMacroEvents
-     * The Macro Events to be added.
-     */
-    void correctEventIndexesBeforeAdd(QList<MacroEvent> &addMacroEvents);
-
-    /**
-     * @brief correctEventIndexesAfterDelete
-     * Corrects the Macro Event indexes for all active Macros after a Macro Event Delete operation occurs.
-     * @param deletedMacroEventInds
-     * The indexes of the deleted Macro Events.
-     */
-    void correctEventIndexesAfterDelete(QList<int> &deletedMacroEventInds);
-
-
-    /**
-     * @brief buildMacroIdWhereClause
-     * Builds the Macro ID WHERE clause component based off of a given Macro ID.
-     * @param id
-     * The Macro ID to include in the WHERE clause.
-     * @return
-     * The Macro ID WHERE clause string.
-     */
-    QString buildMacroIdWhereClause(int id) const;
-
-    /**
-     * @brief buildMacroIdWhereClause
-     * Builds the Macro ID WHERE clause component based off of the given Macro IDs.
-     * @param ids (OPTIONAL)
-     * A list of IDs to build the where clause from. Default is the Active Macro IDs.
-     * @return
-     * The Macro ID WHERE clause in format: "id=<id1> OR id=<id2> OR id=<id3> ... OR id=<idN>".
-     */
-    QString buildMacroIdWhereClause(const QList<int> &ids=QList<int>()) const;
-
-    /**
-     * @brief buildEventIndWhereClause
-     * Builds the event indicies part of the where clause based off of a supplied event index.
-     * @param eventInd
-     * The event index to include in the where clause.
-     * @return
-     * The event index where clause string.
-     */
-    QString buildEventIndWhereClause(int eventInd) const;
-
-    /**
-     * @brief buildEventIndWhereClause
-     * Builds the event indicies part of the where clause based off of a supplied list of event indicies.
-     * @param eventInds
-     * A list of the event indicies to include in the where clause.
+     * @brief buildUniformEventsQuery
+     * Builds the query that gets one full representative row per event index of the Macro Events in the temporary
+     * MacroEventOrder table, with delay, duration, and auto correct NULL where they are not uniform.
      * @return
-     * The event indicies where clause string.
+     * The query string.
      */
-    QString buildEventIndWhereClause(const QList<int> &eventInds) const;
+    QString buildUniformEventsQuery() const;
 
     /**
-     * @brief buildEventIdWhereClause
-     * Biulds the event ID part of the where clause based off of an event index and the current active Macro IDs.
-     * @param eventInd
-     * The event index to use to fetch event IDs.
+     * @brief buildEventOrderQuery
+     * Builds the query that gets the Macro Event IDs and ordering keys of a Macro (bind :macroId).
      * @return
-     * The event ID where clause string.
+     * The query string.
      */
-    QString buildEventIdWhereClause(int eventInd);
+    QString buildEventOrderQuery() const;
 
     /**
-     * @brief buildscreenshotIdWhereClause
-     * Builds the screenshot key part of the where clause based off of a supplied list of screenshot keys.
-     * @param screenshotIds
-     * The list of screenshot keys to include in the where clause.
+     * @brief buildEventCountQuery
+     * Builds the query that counts the Macro Events of a Macro (bind :macroId).
      * @return
-     * The screenshot keys where clause string.
+     * The query string.
      */
-    QString buildscreenshotIdWhereClause(const QList<int> &screenshotIds) const;
+    QString buildEventCountQuery() const;
 
 
     /**
@@ -391,6 +560,42 @@ private:
     #endif
 
 #endif // TEST_MACRO_EVENT
+
+#ifdef TEST_QUERY_PLANS
+
+    /**
+     * @brief queryPlanTest
+     * Checks that the hot Macro Event queries are still answered through the expected indexes, once the planner
+     * has statistics for tables of a representative size. The seeded rows are rolled back.
+     */
+    void queryPlanTest();
+
+    /**
+     * @brief checkQueryPlan
+     * Executes a prepared EXPLAIN QUERY PLAN query and checks that one of the plan steps uses an expected access path.
+     * @param query
+     * The prepared and bound EXPLAIN QUERY PLAN query.
+     * @param queryDesc
+     * Description of the query for the test output.
+     * @param expectedStep
+     * The access path (e.g. "USING COVERING INDEX x (y=?)") that one of the plan steps must contain.
+     * @return
+     * true if the plan is as expected, false otherwise.
+     */
+    bool checkQueryPlan(QSqlQuery &query, const QString &queryDesc, const QString &expectedStep);
+
+#endif // TEST_QUERY_PLANS
+
+#ifdef TEST_SCREENSHOT_SWEEP_HOLD
+
+    /**
+     * @brief screenshotSweepHoldTest
+     * Deletes a saved event with a screenshot, sweeps while the sweep is held (as it is while the Macro Editor is
+     * open), then adds the event back from an undecoded handle, and checks that its screenshot still has its image.
+     */
+    void screenshotSweepHoldTest();
+
+#endif // TEST_SCREENSHOT_SWEEP_HOLD
 };
 
 
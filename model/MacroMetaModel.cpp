@@ -3,9 +3,15 @@
 
 #include "MacroMetaModel.h"
 #include "DBUtil.h"
+#include "SqlIdSet.h"
+#include <QStringList>
+#include <QSqlError>
 #include <QDebug>
 
 
+const int MacroMetaModel::NAME_SEARCH_MIN_CHARS = 3;
+
+
 MacroMetaModel::MacroMetaModel(MacroEventModel &macroEventModel) :
     Model(QSqlDatabase::database(DBUtil::DB_CONNECTION_NAME)),
     NAME_REGEX("^[a-zA-Z0-9 ]*$"),
@@ -39,6 +45,14 @@ MacroMetaModel::MacroMetaModel(MacroEventModel &macroEventModel) :
 }
 
 
+MacroMetaModel::MacroMetaModel(MacroEventModel &macroEventModel, QSqlDatabase db) :
+    Model(db),
+    NAME_REGEX("^[a-zA-Z0-9 ]*$"),
+    _macroEventModel(macroEventModel),
+    _lastAddedId(-1)
+{}
+
+
 int MacroMetaModel::addMacro(const QString &name, bool matchRegex)
 {
     if (!matchRegex || NAME_REGEX.exactMatch(name)) {
@@ -87,13 +101,9 @@ QList<MacroMetadata> MacroMetaModel::copyMacros(const QList<int> &ids)
         copyResult.name = getMacroName(id);
         copyResult.id = addMacro(copyResult.name, false); // false for ignore match regex requirement.
 
-        // Get the Macro Events for the copy source Macro.
-        _macroEventModel.setActiveMacro(id);
-        QList<MacroEvent> copyEvents = _macroEventModel.getUniformEvents();
-
-        // Add the Macro Events to the destination Macro.
+        // Copy the Macro Events of the copy source Macro into the destination Macro.
         _macroEventModel.setActiveMacro(copyResult.id);
-        _macroEventModel.addEvents(copyEvents);
+        _macroEventModel.copyEvents(id);
 
         copyResultList.append(copyResult);
     }
@@ -127,10 +137,13 @@ void MacroMetaModel::removeMacros(const QList<int> &ids)
     _macroEventModel.removeEvents();
 
     // Delete Macro Metadata.
+    SqlIdSet macroIdSet("macroId", ids);
+    safeExec(macroIdSet.prepare(_db), "Error: Macro ID set prepare failed in removeMacros()");
     QSqlQuery query(_db);
     QString queryStr = "DELETE FROM " + DBUtil::MACROS_TABLE_NAME + " \n"
-                       "WHERE " + buildMacroIdWhereClause(ids) + ";";
+                       "WHERE " + macroIdSet.inClause() + ";";
     query.prepare(queryStr);
+    macroIdSet.bindValues(query);
     safeExec(query, "Error: DELETE failed in removeMacros() using query: \n" + queryStr);
 
     if (!isPartOfLargerTransaction) {
@@ -201,64 +214,110 @@ QRegExp MacroMetaModel::getMacroNameRegex() const
 }
 
 
-QList<MacroMetadata> MacroMetaModel::getMacroMetadata(const QString &nameOrIdFilter, int offset, int limit,
-                                                      MacroMetadataSortOrder sortOrder)
+QList<MacroMetadata> MacroMetaModel::getMacroMetadata(const QString &nameOrIdFilter, const MacroMetadata *after,
+                                                      int limit, MacroMetadataSortOrder sortOrder)
 {
-    QList<MacroMetadata> macroMetaList;
     bool dbOpenOutsideMethod = _db.isOpen();
     if (!dbOpenOutsideMethod) {
         safeOpen("Error: DB open failed in getMacroMetadata()");
     }
-    QString whereClause, limitClause, offsetClause, sortClause = "";
 
-    // Check inputs for SELECT filters.
-    if (nameOrIdFilter != "") {
-        bool isNum;
-        nameOrIdFilter.toInt(&isNum);
-        if (isNum) {
-            whereClause = "WHERE macroId = " + nameOrIdFilter;
-        }
-        else {
-            whereClause = "WHERE macroName LIKE '%" + nameOrIdFilter + "%'";
-        }
+    bool ok;
+    QList<MacroMetadata> macroMetaList = queryMacroMetadata(_db, ok, nameOrIdFilter, after, limit, sortOrder);
+    if (!ok) exit(1);
+
+    // Don't close DB if it was opened outside of this method call!
+    if (!dbOpenOutsideMethod) {
+        _db.close();
     }
-    if (limit != -1 || offset != 0) {
-        limitClause = "LIMIT :lim";
-        offsetClause = "OFFSET :off";
+    return macroMetaList;
+}
+
+
+QList<MacroMetadata> MacroMetaModel::queryMacroMetadata(QSqlDatabase &db, bool &ok, const QString &nameOrIdFilter,
+                                                        const MacroMetadata *after, int limit,
+                                                        MacroMetadataSortOrder sortOrder)
+{
+    QList<MacroMetadata> macroMetaList;
+    QStringList conditions;
+    bool isNameOrder = (sortOrder == NAME_ASC || sortOrder == NAME_DESC),
+         isDescending = (sortOrder == ID_DESC || sortOrder == NAME_DESC);
+    QString direction = isDescending ? "DESC" : "ASC",
+            afterOp = isDescending ? "<" : ">";
+
+    // Check inputs for SELECT filters. Every value is bound, never spliced into the query.
+    bool isNum;
+    nameOrIdFilter.toInt(&isNum);
+    bool isIdFilter = (nameOrIdFilter != "" && isNum),
+         isIndexedNameFilter = (nameOrIdFilter != "" && !isNum && DBUtil::hasNameSearchIndex()
+                                && nameOrIdFilter.size() >= NAME_SEARCH_MIN_CHARS),
+         isScannedNameFilter = (nameOrIdFilter != "" && !isNum && !isIndexedNameFilter);
+    if (isIdFilter) {
+        conditions << "macroId = :filterId";
     }
-    sortClause = "ORDER BY ";
-    switch (sortOrder) {
-    case ID_DESC:   sortClause += "macroId DESC";    break;
-    case NAME_ASC:  sortClause += "macroName ASC";   break;
-    case NAME_DESC: sortClause += "macroName DESC";  break;
-    default:        sortClause += "macroId ASC";     break;
+    else if (isIndexedNameFilter) {
+        conditions << "macroId IN (SELECT rowid FROM " + DBUtil::MACRO_NAME_SEARCH_TABLE_NAME + " WHERE macroName MATCH :match)";
+    }
+    else if (isScannedNameFilter) {
+        conditions << "macroName LIKE :pattern ESCAPE '\\'";
     }
 
+    // Continue after the last Macro of the previous page. Served by the primary key or by macroNameIndex,
+    // which holds (macroName, macroId).
+    if (after != nullptr) {
+        conditions << (isNameOrder ? "(macroName, macroId) " + afterOp + " (:afterName, :afterId)"
+                                   : "macroId " + afterOp + " :afterId");
+    }
+
+    QString queryStr = "SELECT macroId, macroName FROM " + DBUtil::MACROS_TABLE_NAME + " \n";
+    if (conditions.size() > 0) {
+        queryStr += "WHERE " + conditions.join(" AND ") + " \n";
+    }
+    queryStr += isNameOrder ? "ORDER BY macroName " + direction + ", macroId " + direction + " \n"
+                            : "ORDER BY macroId " + direction + " \n";
+    if (limit != -1) {
+        queryStr += "LIMIT :lim";
+    }
+    queryStr += ";";
+
     // Prepare query and bind values.
-    QSqlQuery query(_db);
-    QString queryStr = "SELECT macroId, macroName FROM " + DBUtil::MACROS_TABLE_NAME + " " + whereClause + " " +
-                       sortClause + " " + limitClause + " " + offsetClause + ";";
+    QSqlQuery query(db);
     query.prepare(queryStr);
-    if (limitClause != "") {
-        query.bindValue(":lim", limit);
+    if (isIdFilter) {
+        query.bindValue(":filterId", nameOrIdFilter.toInt());
     }
-    if (offsetClause != "") {
-        query.bindValue(":off", offset);
+    else if (isIndexedNameFilter) {
+        // A quoted FTS5 string, so the filter is matched as a plain substring.
+        query.bindValue(":match", "\"" + QString(nameOrIdFilter).replace("\"", "\"\"") + "\"");
+    }
+    else if (isScannedNameFilter) {
+        QString escapedFilter = nameOrIdFilter;
+        escapedFilter.replace("\\", "\\\\").replace("%", "\\%").replace("_", "\\_");
+        query.bindValue(":pattern", "%" + escapedFilter + "%");
+    }
+    if (after != nullptr) {
+        query.bindValue(":afterId", after->id);
+        if (isNameOrder) {
+            query.bindValue(":afterName", after->name);
+        }
+    }
+    if (limit != -1) {
+        query.bindValue(":lim", limit);
     }
 
     // Execute and fill return list with resulting data.
-    safeExec(query, "Error: " + DBUtil::MACROS_TABLE_NAME + " SELECT failed in getMacroMetadata() with query: " + queryStr);
+    ok = query.exec();
+    if (!ok) {
+        qDebug() << "Error: " + DBUtil::MACROS_TABLE_NAME + " SELECT failed in queryMacroMetadata() with query: " + queryStr;
+        qDebug() << "SQLite Error: " << query.lastError().text();
+        return macroMetaList;
+    }
     while(query.next()) {
         MacroMetadata macroMeta;
         macroMeta.id = query.value("macroId").toInt();
         macroMeta.name = query.value("macroName").toString();
         macroMetaList.append(macroMeta);
     }
-
-    // Don't close DB if it was opened outside of this method call!
-    if (!dbOpenOutsideMethod) {
-        _db.close();
-    }
     return macroMetaList;
 }
 
@@ -281,11 +340,12 @@ QString MacroMetaModel::generateMacroCopyName(const QString &srcName)
     // Get the latest copy of the Macro from the database to find out what copy this is.
     QString queryStr = "SELECT macroName \n"
                        "FROM " + DBUtil::MACROS_TABLE_NAME + "\n"
-                       "WHERE macroName like '" + baseSrcName + "%' \n"
+                       "WHERE macroName LIKE :baseSrcName || '%' \n"
                        "ORDER BY macroName DESC \n"
                        "LIMIT 1;";
     QSqlQuery query(_db);
     query.prepare(queryStr);
+    query.bindValue(":baseSrcName", baseSrcName);
     safeExec(query, "Error: SELECT failed in generateMacroCopyName() with query: \n" + queryStr);
 
     if(query.next()) {
@@ -302,12 +362,3 @@ QString MacroMetaModel::generateMacroCopyName(const QString &srcName)
     return baseSrcName + "(" + QString::number(copyNum) + ")";
 }
 
-
-QString MacroMetaModel::buildMacroIdWhereClause(const QList<int> &ids) const
-{
-    QString idWhere = " (";
-    foreach (int id, ids) {
-        idWhere += "macroId=" + QString::number(id) + " OR ";
-    }
-    return idWhere.left(idWhere.size() - 4) + ") ";
-}
@@ -21,6 +21,15 @@ public:
 
     MacroMetaModel(MacroEventModel &macroEventModel);
 
+    /**
+     * @brief MacroMetaModel
+     * Constructor for a model that uses a given connection, e.g. the connection of a background thread
+     * (see DBUtil::threadConnection()).
+     * @param macroEventModel The Macro Event model for the Macros' events. Should use the same connection.
+     * @param db The SQL database connection that the model will use.
+     */
+    MacroMetaModel(MacroEventModel &macroEventModel, QSqlDatabase db);
+
 
     /**
      * @brief addMacro
@@ -110,20 +119,23 @@ public:
 
     /**
      * @brief getMacroMetadata
-     * Gets Macro metadata with optional filter values.
+     * Gets Macro metadata with optional filter values. Pages are continued from the last Macro of the previous page
+     * (keyset pagination), so deep pages cost the same as the first one.
      * @param nameOrIdFilter (OPTIONAL)
      * The macro id or name to filter by. Default is empty string for no filter.
-     * @param offset (OPTIONAL)
-     * The offset of the start point macro metadata records to be retrieved. Default is 0 for no offset.
+     * @param after (OPTIONAL)
+     * The last Macro of the previous page, which the retrieved Macros come after in the sort order. Default is null
+     * to start from the beginning.
      * @param limit (OPTIONAL)
      * The limit on the number of macro metadata records to be retrieved. Default is -1 for no limit (request all).
      * @param sortOrder (OPTIONAL)
      * The order by which Macro metadata records will be sorted in. Default is sorting by ID number in ascending order.
+     * Name orders are broken by ID, so the order is total.
      * @return
      * A list of the Macro metadata that was retrieved.
      */
-    QList<MacroMetadata> getMacroMetadata(const QString &nameOrIdFilter = "", int offset = 0, int limit = -1,
-                                          MacroMetadataSortOrder sortOrder = ID_ASC);
+    QList<MacroMetadata> getMacroMetadata(const QString &nameOrIdFilter = "", const MacroMetadata *after = nullptr,
+                                          int limit = -1, MacroMetadataSortOrder sortOrder = ID_ASC);
 
 private:
 
@@ -133,6 +145,12 @@ private:
      */
     const QRegExp NAME_REGEX;
 
+    /**
+     * @brief NAME_SEARCH_MIN_CHARS
+     * The minimum length of a name filter that the name search index can answer (one trigram).
+     */
+    const static int NAME_SEARCH_MIN_CHARS;
+
 
     /**
      * @brief _macroEventModel
@@ -159,14 +177,17 @@ private:
     QString generateMacroCopyName(const QString &srcName);
 
     /**
-     * @brief buildMacroIdWhereClause
-     * Builds the Macro ID component of a where clause based off of a list of Macro IDs.
-     * @param ids
-     * The list of Macro IDs.
+     * @brief queryMacroMetadata
+     * Runs the Macro metadata query of getMacroMetadata() on a given connection.
+     * @param db
+     * The opened database connection.
+     * @param ok
+     * Set to false if the query failed, true otherwise.
      * @return
-     * The Macro ID where clause component.
+     * A list of the Macro metadata that was retrieved.
      */
-    QString buildMacroIdWhereClause(const QList<int> &ids) const;
+    static QList<MacroMetadata> queryMacroMetadata(QSqlDatabase &db, bool &ok, const QString &nameOrIdFilter,
+                                                   const MacroMetadata *after, int limit, MacroMetadataSortOrder sortOrder);
 };
 
 
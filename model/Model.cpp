@@ -1,8 +1,15 @@
 #include "Model.h"
+#include "DBUtil.h"
+#include "DBMaintenanceThread.h"
+#include "ScreenshotStore.h"
 #include <QDebug>
 #include <QSqlError>
 
 
+QHash<QString, quint64> Model::_connectionOpenCounts;
+QMutex Model::_connectionOpenCountsLock;
+
+
 Model::Model(QSqlDatabase db) :
     _db(db)
 {
@@ -28,6 +35,11 @@ bool Model::safeOpen(const QString &errMsg, bool exit)
         if (success) {
             QSqlQuery query(_db);
             success = safeExec(query.exec("PRAGMA foreign_keys = ON"), errMsg);
+            DBUtil::applyConnectionPragmas(_db);
+
+            _connectionOpenCountsLock.lock();
+            _connectionOpenCounts[_db.connectionName()]++;
+            _connectionOpenCountsLock.unlock();
         }
     }
     return success;
@@ -38,7 +50,9 @@ bool Model::safeOpenAndBegin(const QString &errMsg, bool exit)
 {
     bool success = safeOpen(errMsg, exit);
     if (success) {
-        success = safeExec(_db.transaction(), errMsg, exit);
+        // Same as _db.transaction(), except IMMEDIATE takes the write lock up front (commit() still ends it).
+        QSqlQuery query(_db);
+        success = safeExec(query.exec("BEGIN IMMEDIATE"), errMsg, exit);
     }
     return success;
 }
@@ -46,12 +60,33 @@ bool Model::safeOpenAndBegin(const QString &errMsg, bool exit)
 
 bool Model::safeCommitAndClose(const QString &errMsg, bool exit)
 {
-    bool success = safeExec(_db.commit(), errMsg, exit);
+    // Screenshot blobs added in the transaction must be on disk before the index rows that point at them commit.
+    bool success = safeExec(ScreenshotStore::syncStaged(_db) && _db.commit(), errMsg, exit);
+    // Screenshot blobs added in the transaction only become visible once it is committed.
+    if (success) {
+        ScreenshotStore::publishStaged(_db);
+    }
+    else {
+        ScreenshotStore::discardStaged(_db);
+    }
     _db.close();
+    // Let the background checkpointer know there are new WAL frames to fold back in once things go idle.
+    if (success) {
+        DBMaintenanceThread::notifyWrite();
+    }
     return success;
 }
 
 
+quint64 Model::getConnectionOpenCount() const
+{
+    _connectionOpenCountsLock.lock();
+    quint64 openCount = _connectionOpenCounts.value(_db.connectionName(), 0);
+    _connectionOpenCountsLock.unlock();
+    return openCount;
+}
+
+
 bool Model::safeExec(QSqlQuery &query, const QString &errMsg, bool exit) const
 {
     bool result = query.exec();
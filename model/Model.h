@@ -5,6 +5,8 @@
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QString>
+#include <QHash>
+#include <QMutex>
 
 
 /**
@@ -30,7 +32,7 @@ public:
      * @param db The SQL database connection that the model will use.
      */
     explicit Model(QSqlDatabase db);
-    ~Model();
+    virtual ~Model();
 
     /**
      * @brief safeOpen
@@ -44,6 +46,8 @@ public:
     /**
      * @brief safeOpenAndBegin
      * Safely opens the SQL database connection so that queries can be performed. Also, safely begins a transaction in the database.
+     * The transaction takes the write lock right away, so it can never fail halfway through because a background
+     * connection committed a write after this transaction started reading.
      * @param errMsg See safeOpen()
      * @param exit See safeOpen()
      * @return See safeOpen()
@@ -62,6 +66,15 @@ public:
 
 protected:
 
+    /**
+     * @brief getConnectionOpenCount
+     * Gets how many times the model's database connection has been opened by any of the models sharing it.
+     * Derived models can compare this against a saved count to tell if state they cached from the database
+     * may be stale, since other connections may have written to the database while this one was closed.
+     * @return The open count of the model's database connection.
+     */
+    quint64 getConnectionOpenCount() const;
+
     /**
      * @brief safeExec
      * Checks the evaluation result of the execution of SQL Database queries.
@@ -81,6 +94,21 @@ protected:
      * @return See safeOpen()
      */
     bool safeExec(bool result, const QString &errMsg, bool exit=true) const;
+
+
+private:
+
+    /**
+     * @brief _connectionOpenCounts
+     * The number of times each database connection (keyed by connection name) has been opened by safeOpen().
+     */
+    static QHash<QString, quint64> _connectionOpenCounts;
+
+    /**
+     * @brief _connectionOpenCountsLock
+     * Lock guarding _connectionOpenCounts, since models on different threads use different connections.
+     */
+    static QMutex _connectionOpenCountsLock;
 };
 
 
@@ -0,0 +1,146 @@
+#include "ReplayPlan.h"
+#include <QMutexLocker>
+#include <cstring>
+
+
+const int ReplayPlan::MAX_CACHED_PLANS = 16;
+QMutex ReplayPlan::_cacheMutex;
+QCache<int, QSharedPointer<const ReplayPlan>> ReplayPlan::_cache(ReplayPlan::MAX_CACHED_PLANS);
+QHash<int, quint64> ReplayPlan::_generations;
+
+
+ReplayPlan::ReplayPlan()
+    : _instructions(),
+      _keyStrings(),
+      _eventInfos(),
+      _targets()
+{}
+
+
+QSharedPointer<const ReplayPlan> ReplayPlan::compile(const QList<MacroEvent> &macroEvents)
+{
+    QSharedPointer<ReplayPlan> plan(new ReplayPlan());
+    plan->_instructions.reserve(macroEvents.size());
+    plan->_eventInfos.reserve(macroEvents.size());
+
+    foreach (const MacroEvent &event, macroEvents) {
+        if (event.type == MacroEventType::DummyEvent) continue;
+
+        Instruction instruction;
+        memset(&instruction, 0, sizeof(Instruction));
+        instruction.type = event.type;
+        instruction.eventInd = plan->_eventInfos.size();
+        // Non-uniform timing (-1) only shows up when editing several Macros at once.
+        instruction.delayMs = qMax(event.delayMs, 0);
+        instruction.nRepeats = qMax(event.nRepeats, 0);
+        instruction.repeatDelayMs = qMax(event.durationMs, 0) / (instruction.nRepeats + 1);
+        instruction.keyStringInd = -1;
+        instruction.targetInd = -1;
+
+        if (event.type == MacroEventType::MouseEvent) {
+            const MacroMouseEvent &mEvent = event.mouseEvent;
+            instruction.action = mEvent.type;
+            instruction.moveToTarget = (mEvent.type != ScrollUp && mEvent.type != ScrollDown);
+            instruction.x = mEvent.loc.x();
+            instruction.y = mEvent.loc.y();
+            if (!mEvent.screenshot.isNull()) {
+                Target target;
+                target.crop = mEvent.screenshot;
+                target.cropOrg = mEvent.screenshotOrg;
+                target.rect = mEvent.screenshotRect;
+                instruction.targetInd = plan->_targets.size();
+                instruction.autoCorrect = instruction.moveToTarget && mEvent.autoCorrect && !target.rect.isEmpty();
+                plan->_targets.append(target);
+                mEvent.screenshot.prefetch();
+            }
+            plan->_eventInfos.append(getMacroMouseEventInfoStr(mEvent));
+        }
+        else {
+            const MacroKeyboardEvent &kEvent = event.keyboardEvent;
+            instruction.action = kEvent.type;
+            if (kEvent.type == KeyString) {
+                // Key strings are typed out in one go, so they have no duration to fill.
+                instruction.repeatDelayMs = 0;
+                instruction.keyStringInd = plan->_keyStrings.size();
+                plan->_keyStrings.append(kEvent.keyString);
+            }
+            else {
+                instruction.keyStroke.keyCode = kEvent.keyCode;
+                instruction.keyStroke.mod1 = kEvent.mod1;
+                instruction.keyStroke.mod2 = kEvent.mod2;
+                instruction.keyStroke.capsLock = kEvent.capsLock;
+                instruction.keyStroke.numLock = kEvent.numLock;
+                instruction.keyStroke.numpadOff = isKeyCodeAssocWithNumpadOff(kEvent.keyCode);
+            }
+            plan->_eventInfos.append(getMacroKeyboardEventInfoStr(kEvent));
+        }
+        plan->_instructions.append(instruction);
+    }
+    return plan;
+}
+
+
+int ReplayPlan::size() const
+{
+    return _instructions.size();
+}
+
+
+const ReplayPlan::Instruction* ReplayPlan::instructions() const
+{
+    return _instructions.constData();
+}
+
+
+const QString& ReplayPlan::keyString(int keyStringInd) const
+{
+    return _keyStrings.at(keyStringInd);
+}
+
+
+const QString& ReplayPlan::eventInfo(int eventInd) const
+{
+    return _eventInfos.at(eventInd);
+}
+
+
+const ReplayPlan::Target& ReplayPlan::target(int targetInd) const
+{
+    return _targets.at(targetInd);
+}
+
+
+QSharedPointer<const ReplayPlan> ReplayPlan::cached(int macroId)
+{
+    QMutexLocker cacheLocker(&_cacheMutex);
+    QSharedPointer<const ReplayPlan> *plan = _cache.object(macroId);
+    return (plan != nullptr) ? *plan : QSharedPointer<const ReplayPlan>();
+}
+
+
+quint64 ReplayPlan::generation(int macroId)
+{
+    QMutexLocker cacheLocker(&_cacheMutex);
+    return _generations.value(macroId, 0);
+}
+
+
+bool ReplayPlan::cache(int macroId, quint64 generation, const QSharedPointer<const ReplayPlan> &plan)
+{
+    QMutexLocker cacheLocker(&_cacheMutex);
+    // The Macro changed while its events were being loaded or compiled.
+    if (_generations.value(macroId, 0) != generation) return false;
+
+    _cache.insert(macroId, new QSharedPointer<const ReplayPlan>(plan));
+    return true;
+}
+
+
+void ReplayPlan::invalidate(const QList<int> &macroIds)
+{
+    QMutexLocker cacheLocker(&_cacheMutex);
+    foreach (int macroId, macroIds) {
+        _cache.remove(macroId);
+        _generations[macroId]++;
+    }
+}
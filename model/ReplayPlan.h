@@ -0,0 +1,212 @@
+#ifndef REPLAYPLAN_H
+#define REPLAYPLAN_H
+
+
+#include "MacroEvent.h"
+#include "ScreenshotHandle.h"
+#include <QVector>
+#include <QString>
+#include <QPoint>
+#include <QRect>
+#include <QList>
+#include <QHash>
+#include <QCache>
+#include <QMutex>
+#include <QSharedPointer>
+
+
+/**
+ * @brief The ReplayPlan class
+ * A Macro compiled for activation. Each Macro Event becomes a small flat instruction with its timing already
+ * resolved, while the variable sized parts (key strings, display info, target screenshots) live in side tables
+ * that the instructions index into. Plans are immutable once compiled, so one plan can be shared between the
+ * activator and the cache. Compiled plans are cached per Macro, and a Macro's cached plan is invalidated whenever
+ * its events are changed.
+ */
+class ReplayPlan
+{
+public:
+
+    /**
+     * @brief MAX_CACHED_PLANS
+     * The maximum number of compiled plans kept in the cache.
+     */
+    const static int MAX_CACHED_PLANS;
+
+    /**
+     * @brief The KeyStroke struct
+     * A key and the modifier state that it is pressed or released with.
+     */
+    typedef struct KeyStroke
+    {
+        int keyCode;
+        int mod1;           // -1 if none.
+        int mod2;           // -1 if none.
+        bool capsLock;
+        bool numLock;
+        bool numpadOff;     // Key only works with NUM LOCK off (see isKeyCodeAssocWithNumpadOff()).
+    } KeyStroke;
+
+    /**
+     * @brief The Instruction struct
+     * A single compiled Macro Event.
+     */
+    typedef struct Instruction
+    {
+        MacroEventType type;    // MouseEvent or KeyboardEvent.
+        int action;             // The MacroMouseEventType or MacroKeyboardEventType.
+        int eventInd;           // Index of the source Macro Event (see eventInfo()).
+        int delayMs;            // Delay before the event, measured from the end of the previous event.
+        int repeatDelayMs;      // Sleep after each repetition, so the repetitions fill the event's duration.
+        int nRepeats;
+        bool moveToTarget;      // Set for location sensitive mouse events; the mouse is moved to (x, y) first.
+        bool autoCorrect;       // Search the screen for the target and move to where it is now (needs a target).
+        int x;
+        int y;
+        KeyStroke keyStroke;    // Key press, release, and type events only.
+        int keyStringInd;       // Index of the text to type (see keyString()), or -1 if not a key string event.
+        int targetInd;          // Index of the target screenshot (see target()), or -1 if there is none.
+    } Instruction;
+
+    /**
+     * @brief The Target struct
+     * The recorded target of a location sensitive mouse event, which is searched for on the screen at activation.
+     */
+    typedef struct Target
+    {
+        ScreenshotHandle crop;  // Full resolution crop of the target plus a margin around it.
+        QPoint cropOrg;         // Screen coordinates of the crop's top left corner.
+        QRect rect;             // The target within the crop, in screen coordinates.
+    } Target;
+
+    /**
+     * @brief compile
+     * Compiles the events of a Macro into a replay plan. Also queues the target screenshots to be decoded in the
+     * background, so that they are ready by the time the plan is activated.
+     * @param macroEvents The Macro Events in activation order.
+     * @return The compiled plan.
+     */
+    static QSharedPointer<const ReplayPlan> compile(const QList<MacroEvent> &macroEvents);
+
+    /**
+     * @brief size
+     * Gets the number of instructions in the plan.
+     * @return The number of instructions.
+     */
+    int size() const;
+
+    /**
+     * @brief instructions
+     * Gets the flat instruction array.
+     * @return Pointer to the first of size() instructions.
+     */
+    const Instruction* instructions() const;
+
+    /**
+     * @brief keyString
+     * Gets the text of a key string instruction.
+     * @param keyStringInd The instruction's keyStringInd.
+     * @return The text to type.
+     */
+    const QString& keyString(int keyStringInd) const;
+
+    /**
+     * @brief eventInfo
+     * Gets the display info of the Macro Event that an instruction was compiled from.
+     * @param eventInd The instruction's eventInd.
+     * @return The info string (see getMacroEventInfoStr()).
+     */
+    const QString& eventInfo(int eventInd) const;
+
+    /**
+     * @brief target
+     * Gets the target of a mouse instruction.
+     * @param targetInd The instruction's targetInd.
+     * @return The target.
+     */
+    const Target& target(int targetInd) const;
+
+    /**
+     * @brief cached
+     * Gets the cached plan of a Macro. Safe to call from any thread.
+     * @param macroId The ID of the Macro.
+     * @return The plan, or null if the Macro has no (valid) cached plan.
+     */
+    static QSharedPointer<const ReplayPlan> cached(int macroId);
+
+    /**
+     * @brief generation
+     * Gets a Macro's plan generation, which changes every time the Macro's plan is invalidated. Read it before
+     * loading the events to compile, and pass it to cache(). Safe to call from any thread.
+     * @param macroId The ID of the Macro.
+     * @return The generation.
+     */
+    static quint64 generation(int macroId);
+
+    /**
+     * @brief cache
+     * Caches the plan of a Macro, unless the Macro has been invalidated since its events were loaded.
+     * Safe to call from any thread.
+     * @param macroId The ID of the Macro.
+     * @param generation The generation (see generation()) read before the Macro's events were loaded.
+     * @param plan The plan compiled from the Macro's events.
+     * @return true if cached, false if the plan is already stale.
+     */
+    static bool cache(int macroId, quint64 generation, const QSharedPointer<const ReplayPlan> &plan);
+
+    /**
+     * @brief invalidate
+     * Drops the cached plans of Macros whose events have changed. Safe to call from any thread.
+     * @param macroIds The IDs of the Macros.
+     */
+    static void invalidate(const QList<int> &macroIds);
+
+private:
+
+    explicit ReplayPlan();
+
+    /**
+     * @brief _instructions
+     * The compiled instructions in activation order.
+     */
+    QVector<Instruction> _instructions;
+
+    /**
+     * @brief _keyStrings
+     * The text of the key string instructions.
+     */
+    QVector<QString> _keyStrings;
+
+    /**
+     * @brief _eventInfos
+     * The display info of each source Macro Event.
+     */
+    QVector<QString> _eventInfos;
+
+    /**
+     * @brief _targets
+     * The targets of the mouse instructions.
+     */
+    QVector<Target> _targets;
+
+    /**
+     * @brief _cacheMutex
+     * Guards _cache and _generations.
+     */
+    static QMutex _cacheMutex;
+
+    /**
+     * @brief _cache
+     * The compiled plans keyed by Macro ID.
+     */
+    static QCache<int, QSharedPointer<const ReplayPlan>> _cache;
+
+    /**
+     * @brief _generations
+     * The plan generation of every Macro that has been invalidated, keyed by Macro ID (0 if not present).
+     */
+    static QHash<int, quint64> _generations;
+};
+
+
+#endif // REPLAYPLAN_H
@@ -0,0 +1,384 @@
+#include "ScreenshotCodec.h"
+#include <QBuffer>
+#include <QImageWriter>
+#include <QtEndian>
+#include <cstring>
+
+
+namespace {
+
+/**
+ * @brief The PngCodec class
+ * Qt's PNG codec at default compression. Small, but slow to encode.
+ */
+class PngCodec : public ScreenshotCodec
+{
+public:
+
+    CodecId id() const override { return PNG; }
+    QString name() const override { return "PNG"; }
+
+    QByteArray encode(const QImage &image) const override
+    {
+        QByteArray encoded;
+        QBuffer buffer(&encoded);
+        buffer.open(QIODevice::WriteOnly);
+        if (!image.save(&buffer, "PNG")) return QByteArray();
+        return encoded;
+    }
+
+    QImage decode(const uchar *data, int size) const override
+    {
+        return QImage::fromData(data, size, "PNG");
+    }
+};
+
+
+/**
+ * @brief The QoiCodec class
+ * The Quite OK Image format (https://qoiformat.org/qoi-specification.pdf). Encodes each pixel as a run, a
+ * reference into a small table of recent colors, a small difference from the previous pixel, or a literal.
+ */
+class QoiCodec : public ScreenshotCodec
+{
+public:
+
+    CodecId id() const override { return QOI; }
+    QString name() const override { return "QOI"; }
+
+    QByteArray encode(const QImage &image) const override
+    {
+        bool hasAlpha = image.hasAlphaChannel();
+        QImage src = image.convertToFormat(hasAlpha ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+        int width = src.width(),
+            height = src.height();
+
+        // Sized for the worst case of every pixel being a literal, then truncated.
+        QByteArray encoded;
+        encoded.resize(HEADER_SIZE + width * height * 5 + PADDING_SIZE);
+        uchar *out = (uchar*)encoded.data();
+        memcpy(out, "qoif", 4);
+        qToBigEndian<quint32>(width, out + 4);
+        qToBigEndian<quint32>(height, out + 8);
+        out[12] = hasAlpha ? 4 : 3;
+        out[13] = 0; // sRGB with linear alpha.
+        int pos = HEADER_SIZE;
+
+        QRgb index[64] = {0};
+        QRgb prev = qRgba(0, 0, 0, 255);
+        int run = 0;
+        for (int y = 0; y < height; y++) {
+            const QRgb *line = (const QRgb*)src.constScanLine(y);
+            for (int x = 0; x < width; x++) {
+                QRgb px = hasAlpha ? line[x] : (line[x] | 0xff000000);
+                if (px == prev) {
+                    if (++run == 62) {
+                        out[pos++] = OP_RUN | (run - 1);
+                        run = 0;
+                    }
+                    continue;
+                }
+                if (run > 0) {
+                    out[pos++] = OP_RUN | (run - 1);
+                    run = 0;
+                }
+
+                int hash = colorHash(px);
+                if (index[hash] == px) {
+                    out[pos++] = OP_INDEX | hash;
+                }
+                else {
+                    index[hash] = px;
+                    if (qAlpha(px) == qAlpha(prev)) {
+                        signed char vr = (signed char)(qRed(px) - qRed(prev)),
+                                    vg = (signed char)(qGreen(px) - qGreen(prev)),
+                                    vb = (signed char)(qBlue(px) - qBlue(prev));
+                        signed char vgr = vr - vg,
+                                    vgb = vb - vg;
+                        if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2) {
+                            out[pos++] = OP_DIFF | ((vr + 2) << 4) | ((vg + 2) << 2) | (vb + 2);
+                        }
+                        else if (vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8) {
+                            out[pos++] = OP_LUMA | (vg + 32);
+                            out[pos++] = ((vgr + 8) << 4) | (vgb + 8);
+                        }
+                        else {
+                            out[pos++] = OP_RGB;
+                            out[pos++] = qRed(px);
+                            out[pos++] = qGreen(px);
+                            out[pos++] = qBlue(px);
+                        }
+                    }
+                    else {
+                        out[pos++] = OP_RGBA;
+                        out[pos++] = qRed(px);
+                        out[pos++] = qGreen(px);
+                        out[pos++] = qBlue(px);
+                        out[pos++] = qAlpha(px);
+                    }
+                }
+                prev = px;
+            }
+        }
+        if (run > 0) {
+            out[pos++] = OP_RUN | (run - 1);
+        }
+
+        // End marker is 7 zero bytes followed by a one.
+        memset(out + pos, 0, PADDING_SIZE - 1);
+        pos += PADDING_SIZE - 1;
+        out[pos++] = 1;
+        encoded.truncate(pos);
+        return encoded;
+    }
+
+    QImage decode(const uchar *data, int size) const override
+    {
+        if (size < HEADER_SIZE + PADDING_SIZE || memcmp(data, "qoif", 4) != 0) return QImage();
+        quint32 width = qFromBigEndian<quint32>(data + 4),
+                height = qFromBigEndian<quint32>(data + 8);
+        int channels = data[12];
+        if (width == 0 || height == 0 || width > 32767 || height > 32767 || (channels != 3 && channels != 4)) {
+            return QImage();
+        }
+
+        QImage image(width, height, (channels == 4) ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+        if (image.isNull()) return QImage();
+
+        // The padding guarantees that no op reads past the end, so only the op start needs checking.
+        int pos = HEADER_SIZE,
+            chunksEnd = size - PADDING_SIZE;
+        QRgb index[64] = {0};
+        QRgb px = qRgba(0, 0, 0, 255);
+        int run = 0;
+        for (quint32 y = 0; y < height; y++) {
+            QRgb *line = (QRgb*)image.scanLine(y);
+            for (quint32 x = 0; x < width; x++) {
+                if (run > 0) {
+                    run--;
+                }
+                else if (pos < chunksEnd) {
+                    int b1 = data[pos++];
+                    if (b1 == OP_RGB) {
+                        px = qRgba(data[pos], data[pos + 1], data[pos + 2], qAlpha(px));
+                        pos += 3;
+                    }
+                    else if (b1 == OP_RGBA) {
+                        px = qRgba(data[pos], data[pos + 1], data[pos + 2], data[pos + 3]);
+                        pos += 4;
+                    }
+                    else if ((b1 & OP_MASK) == OP_INDEX) {
+                        px = index[b1];
+                    }
+                    else if ((b1 & OP_MASK) == OP_DIFF) {
+                        px = qRgba((qRed(px) + ((b1 >> 4) & 0x03) - 2) & 0xff,
+                                   (qGreen(px) + ((b1 >> 2) & 0x03) - 2) & 0xff,
+                                   (qBlue(px) + (b1 & 0x03) - 2) & 0xff,
+                                   qAlpha(px));
+                    }
+                    else if ((b1 & OP_MASK) == OP_LUMA) {
+                        int b2 = data[pos++];
+                        int vg = (b1 & 0x3f) - 32;
+                        px = qRgba((qRed(px) + vg - 8 + ((b2 >> 4) & 0x0f)) & 0xff,
+                                   (qGreen(px) + vg) & 0xff,
+                                   (qBlue(px) + vg - 8 + (b2 & 0x0f)) & 0xff,
+                                   qAlpha(px));
+                    }
+                    else {
+                        run = b1 & 0x3f;
+                    }
+                    index[colorHash(px)] = px;
+                }
+                line[x] = px;
+            }
+        }
+        return image;
+    }
+
+private:
+
+    const static int HEADER_SIZE = 14;
+    const static int PADDING_SIZE = 8;
+    const static uchar OP_INDEX = 0x00;
+    const static uchar OP_DIFF = 0x40;
+    const static uchar OP_LUMA = 0x80;
+    const static uchar OP_RUN = 0xc0;
+    const static uchar OP_RGB = 0xfe;
+    const static uchar OP_RGBA = 0xff;
+    const static uchar OP_MASK = 0xc0;
+
+    static int colorHash(QRgb px)
+    {
+        return (qRed(px) * 3 + qGreen(px) * 5 + qBlue(px) * 7 + qAlpha(px) * 11) % 64;
+    }
+};
+
+
+/**
+ * @brief The RawPlanesCodec class
+ * Splits the image into its color planes, replaces each sample with its difference from the sample to its left,
+ * and compresses the result with zlib at its fastest level. Flat UI regions become long runs of zeros.
+ */
+class RawPlanesCodec : public ScreenshotCodec
+{
+public:
+
+    CodecId id() const override { return RAW_PLANES_ZLIB; }
+    QString name() const override { return "Raw planes (zlib)"; }
+
+    QByteArray encode(const QImage &image) const override
+    {
+        int planes = (image.format() == QImage::Format_Grayscale8) ? 1 : (image.hasAlphaChannel() ? 4 : 3);
+        QImage src = (planes == 1) ? image
+                                   : image.convertToFormat((planes == 4) ? QImage::Format_ARGB32 : QImage::Format_RGB32);
+        int width = src.width(),
+            height = src.height();
+
+        QByteArray filtered;
+        filtered.resize(width * height * planes);
+        uchar *out = (uchar*)filtered.data();
+        for (int plane = 0; plane < planes; plane++) {
+            for (int y = 0; y < height; y++) {
+                uchar left = 0;
+                if (planes == 1) {
+                    const uchar *line = src.constScanLine(y);
+                    for (int x = 0; x < width; x++) {
+                        *out++ = line[x] - left;
+                        left = line[x];
+                    }
+                }
+                else {
+                    const QRgb *line = (const QRgb*)src.constScanLine(y);
+                    for (int x = 0; x < width; x++) {
+                        uchar sample = (line[x] >> PLANE_SHIFTS[plane]) & 0xff;
+                        *out++ = sample - left;
+                        left = sample;
+                    }
+                }
+            }
+        }
+
+        QByteArray encoded(HEADER_SIZE, '\0');
+        uchar *header = (uchar*)encoded.data();
+        memcpy(header, "RAWP", 4);
+        qToBigEndian<quint32>(width, header + 4);
+        qToBigEndian<quint32>(height, header + 8);
+        header[12] = planes;
+        encoded.append(qCompress(filtered, ZLIB_LEVEL));
+        return encoded;
+    }
+
+    QImage decode(const uchar *data, int size) const override
+    {
+        if (size < HEADER_SIZE || memcmp(data, "RAWP", 4) != 0) return QImage();
+        quint32 width = qFromBigEndian<quint32>(data + 4),
+                height = qFromBigEndian<quint32>(data + 8);
+        int planes = data[12];
+        if (width == 0 || height == 0 || width > 32767 || height > 32767 || (planes != 1 && planes != 3 && planes != 4)) {
+            return QImage();
+        }
+
+        QByteArray filtered = qUncompress(data + HEADER_SIZE, size - HEADER_SIZE);
+        if ((quint64)filtered.size() != (quint64)width * height * planes) return QImage();
+        const uchar *in = (const uchar*)filtered.constData();
+
+        QImage image(width, height, (planes == 1) ? QImage::Format_Grayscale8
+                                  : ((planes == 4) ? QImage::Format_ARGB32 : QImage::Format_RGB32));
+        if (image.isNull()) return QImage();
+        if (planes == 3) image.fill(qRgba(0, 0, 0, 255));
+        else if (planes == 4) image.fill(qRgba(0, 0, 0, 0));
+
+        for (int plane = 0; plane < planes; plane++) {
+            for (quint32 y = 0; y < height; y++) {
+                uchar sample = 0;
+                if (planes == 1) {
+                    uchar *line = image.scanLine(y);
+                    for (quint32 x = 0; x < width; x++) {
+                        sample += *in++;
+                        line[x] = sample;
+                    }
+                }
+                else {
+                    QRgb *line = (QRgb*)image.scanLine(y);
+                    for (quint32 x = 0; x < width; x++) {
+                        sample += *in++;
+                        line[x] |= (QRgb)sample << PLANE_SHIFTS[plane];
+                    }
+                }
+            }
+        }
+        return image;
+    }
+
+private:
+
+    const static int HEADER_SIZE = 13;
+    const static int ZLIB_LEVEL = 1;
+    // Red, green, blue, then alpha within a QRgb (0xAARRGGBB).
+    const static int PLANE_SHIFTS[4];
+};
+
+const int RawPlanesCodec::PLANE_SHIFTS[4] = { 16, 8, 0, 24 };
+
+
+/**
+ * @brief The WebpLosslessCodec class
+ * Lossless WebP through Qt's WebP image plugin (which encodes losslessly at quality 100).
+ */
+class WebpLosslessCodec : public ScreenshotCodec
+{
+public:
+
+    CodecId id() const override { return WEBP_LOSSLESS; }
+    QString name() const override { return "WebP lossless"; }
+
+    bool isAvailable() const override
+    {
+        return QImageWriter::supportedImageFormats().contains("webp");
+    }
+
+    QByteArray encode(const QImage &image) const override
+    {
+        QByteArray encoded;
+        QBuffer buffer(&encoded);
+        buffer.open(QIODevice::WriteOnly);
+        QImageWriter writer(&buffer, "webp");
+        writer.setQuality(100);
+        if (!writer.write(image)) return QByteArray();
+        return encoded;
+    }
+
+    QImage decode(const uchar *data, int size) const override
+    {
+        return QImage::fromData(data, size, "WEBP");
+    }
+};
+
+
+// Constructed before main(), so lookups need no locking.
+const PngCodec PNG_CODEC;
+const QoiCodec QOI_CODEC;
+const RawPlanesCodec RAW_PLANES_CODEC;
+const WebpLosslessCodec WEBP_LOSSLESS_CODEC;
+
+}
+
+
+const ScreenshotCodec* ScreenshotCodec::get(int id)
+{
+    switch (id) {
+    case PNG:               return &PNG_CODEC;
+    case QOI:               return &QOI_CODEC;
+    case RAW_PLANES_ZLIB:   return &RAW_PLANES_CODEC;
+    case WEBP_LOSSLESS:     return &WEBP_LOSSLESS_CODEC;
+    default:                return nullptr;
+    }
+}
+
+
+QList<const ScreenshotCodec*> ScreenshotCodec::all()
+{
+    QList<const ScreenshotCodec*> codecs;
+    codecs << &PNG_CODEC << &QOI_CODEC << &RAW_PLANES_CODEC << &WEBP_LOSSLESS_CODEC;
+    return codecs;
+}
@@ -0,0 +1,86 @@
+#ifndef SCREENSHOTCODEC_H
+#define SCREENSHOTCODEC_H
+
+
+#include <QImage>
+#include <QByteArray>
+#include <QString>
+#include <QList>
+
+
+/**
+ * @brief The ScreenshotCodec class
+ * Interface of a lossless image codec that screenshots can be stored with. Each codec has a fixed ID that is
+ * recorded alongside every stored screenshot, so screenshots stored with one codec can still be decoded after the
+ * configured codec changes. Codecs are stateless and safe to use from any thread.
+ */
+class ScreenshotCodec
+{
+public:
+
+    /**
+     * @brief The CodecId enum
+     * The stored codec IDs. Never renumber these, since they are persisted in the database.
+     */
+    enum CodecId {
+        PNG = 0,            // Default for screenshots stored before codecs were recorded.
+        QOI = 1,            // Quite OK Image format: single pass, several times faster than PNG at similar size.
+        RAW_PLANES_ZLIB = 2,// Left-delta filtered color planes, compressed with fast zlib.
+        WEBP_LOSSLESS = 3   // Smallest output, but slowest; only available if Qt's WebP image plugin is installed.
+    };
+
+    virtual ~ScreenshotCodec() {}
+
+    /**
+     * @brief id
+     * @return The stored ID of the codec.
+     */
+    virtual CodecId id() const = 0;
+
+    /**
+     * @brief name
+     * @return A readable name of the codec.
+     */
+    virtual QString name() const = 0;
+
+    /**
+     * @brief isAvailable
+     * Checks if the codec can be used in this build (e.g. its image plugin is installed).
+     * @return true if it is available, false otherwise.
+     */
+    virtual bool isAvailable() const { return true; }
+
+    /**
+     * @brief encode
+     * Losslessly encodes an image.
+     * @param image The (non-null) image to encode.
+     * @return The encoded bytes, or an empty byte array if the encode failed.
+     */
+    virtual QByteArray encode(const QImage &image) const = 0;
+
+    /**
+     * @brief decode
+     * Decodes an image encoded by this codec.
+     * @param data The encoded bytes.
+     * @param size The number of encoded bytes.
+     * @return The image, or a null image if the data is not valid.
+     */
+    virtual QImage decode(const uchar *data, int size) const = 0;
+
+    /**
+     * @brief get
+     * Gets a codec by its stored ID.
+     * @param id The stored codec ID.
+     * @return The codec, or nullptr if the ID is unknown.
+     */
+    static const ScreenshotCodec* get(int id);
+
+    /**
+     * @brief all
+     * @return All known codecs, whether available or not.
+     */
+    static QList<const ScreenshotCodec*> all();
+};
+
+
+#endif // SCREENSHOTCODEC_H
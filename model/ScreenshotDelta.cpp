@@ -0,0 +1,130 @@
+#include "ScreenshotDelta.h"
+#include <QtEndian>
+#include <cstring>
+
+
+const int ScreenshotDelta::TILE_SIZE = 32;
+const int ScreenshotDelta::MIN_TILES = 4;
+const double ScreenshotDelta::MAX_CHANGED_RATIO = 0.5;
+const int ScreenshotDelta::KEYFRAME_INTERVAL = 30;
+
+namespace {
+// Magic, width, height, and changed tile count, followed by the changed tile indices.
+const int HEADER_SIZE = 16;
+}
+
+
+QList<int> ScreenshotDelta::changedTiles(const QImage &image, const QImage &keyframe)
+{
+    QList<int> changed;
+    int columns = (image.width() + TILE_SIZE - 1) / TILE_SIZE,
+        rows = (image.height() + TILE_SIZE - 1) / TILE_SIZE;
+
+    // Every tile differs from a keyframe of another size.
+    if (image.size() != keyframe.size()) {
+        for (int tile = 0; tile < columns * rows; tile++) {
+            changed.append(tile);
+        }
+        return changed;
+    }
+
+    QImage::Format format = tileFormat(image);
+    QImage src = image.convertToFormat(format),
+           key = keyframe.convertToFormat(format);
+    for (int tile = 0; tile < columns * rows; tile++) {
+        QRect rect = tileRect(src, tile);
+        for (int y = rect.top(); y <= rect.bottom(); y++) {
+            if (memcmp(src.constScanLine(y) + rect.x() * 4, key.constScanLine(y) + rect.x() * 4, rect.width() * 4) != 0) {
+                changed.append(tile);
+                break;
+            }
+        }
+    }
+    return changed;
+}
+
+
+bool ScreenshotDelta::isWorthDelta(const QImage &image, const QList<int> &changedTiles)
+{
+    int tiles = ((image.width() + TILE_SIZE - 1) / TILE_SIZE) * ((image.height() + TILE_SIZE - 1) / TILE_SIZE);
+    return (tiles >= MIN_TILES && changedTiles.size() <= tiles * MAX_CHANGED_RATIO);
+}
+
+
+QByteArray ScreenshotDelta::encode(const QImage &image, const QList<int> &changedTiles, const ScreenshotCodec *codec)
+{
+    QByteArray encoded(HEADER_SIZE + changedTiles.size() * 4, '\0');
+    uchar *header = (uchar*)encoded.data();
+    memcpy(header, "TDLT", 4);
+    qToBigEndian<quint32>(image.width(), header + 4);
+    qToBigEndian<quint32>(image.height(), header + 8);
+    qToBigEndian<quint32>(changedTiles.size(), header + 12);
+    for (int i = 0; i < changedTiles.size(); i++) {
+        qToBigEndian<quint32>(changedTiles[i], header + HEADER_SIZE + i * 4);
+    }
+    if (changedTiles.isEmpty()) return encoded;
+
+    // Stack the changed tiles on top of each other, so they compress as one ordinary image.
+    QImage::Format format = tileFormat(image);
+    QImage src = image.convertToFormat(format);
+    QImage strip(TILE_SIZE, TILE_SIZE * changedTiles.size(), format);
+    strip.fill(0);
+    for (int i = 0; i < changedTiles.size(); i++) {
+        QRect rect = tileRect(src, changedTiles[i]);
+        for (int y = rect.top(); y <= rect.bottom(); y++) {
+            memcpy(strip.scanLine(i * TILE_SIZE + y - rect.top()), src.constScanLine(y) + rect.x() * 4, rect.width() * 4);
+        }
+    }
+
+    QByteArray encodedStrip = codec->encode(strip);
+    if (encodedStrip.isEmpty()) return QByteArray();
+    encoded.append(encodedStrip);
+    return encoded;
+}
+
+
+QImage ScreenshotDelta::decode(const uchar *data, int size, const ScreenshotCodec *codec, const QImage &keyframe)
+{
+    if (size < HEADER_SIZE || memcmp(data, "TDLT", 4) != 0 || keyframe.isNull()) return QImage();
+    int width = qFromBigEndian<quint32>(data + 4),
+        height = qFromBigEndian<quint32>(data + 8),
+        count = qFromBigEndian<quint32>(data + 12);
+    int tiles = ((width + TILE_SIZE - 1) / TILE_SIZE) * ((height + TILE_SIZE - 1) / TILE_SIZE);
+    if (keyframe.width() != width || keyframe.height() != height || count < 0 || count > tiles
+            || size < HEADER_SIZE + count * 4) {
+        return QImage();
+    }
+    if (count == 0) return keyframe;
+
+    int stripOffset = HEADER_SIZE + count * 4;
+    QImage strip = codec->decode(data + stripOffset, size - stripOffset);
+    if (strip.width() != TILE_SIZE || strip.height() != TILE_SIZE * count) return QImage();
+
+    QImage::Format format = tileFormat(strip);
+    strip = strip.convertToFormat(format);
+    QImage image = keyframe.convertToFormat(format);
+    for (int i = 0; i < count; i++) {
+        int tile = qFromBigEndian<quint32>(data + HEADER_SIZE + i * 4);
+        if (tile < 0 || tile >= tiles) return QImage();
+
+        QRect rect = tileRect(image, tile);
+        for (int y = rect.top(); y <= rect.bottom(); y++) {
+            memcpy(image.scanLine(y) + rect.x() * 4, strip.constScanLine(i * TILE_SIZE + y - rect.top()), rect.width() * 4);
+        }
+    }
+    return image;
+}
+
+
+QImage::Format ScreenshotDelta::tileFormat(const QImage &image)
+{
+    return image.hasAlphaChannel() ? QImage::Format_ARGB32 : QImage::Format_RGB32;
+}
+
+
+QRect ScreenshotDelta::tileRect(const QImage &image, int tile)
+{
+    int columns = (image.width() + TILE_SIZE - 1) / TILE_SIZE;
+    QRect rect((tile % columns) * TILE_SIZE, (tile / columns) * TILE_SIZE, TILE_SIZE, TILE_SIZE);
+    return rect.intersected(image.rect());
+}
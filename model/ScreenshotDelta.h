@@ -0,0 +1,109 @@
+#ifndef SCREENSHOTDELTA_H
+#define SCREENSHOTDELTA_H
+
+
+#include "ScreenshotCodec.h"
+#include <QImage>
+#include <QByteArray>
+#include <QList>
+#include <QRect>
+
+
+/**
+ * @brief The ScreenshotDelta class
+ * Tile based delta encoding of a screenshot against an earlier keyframe screenshot of the same size. Screenshots
+ * taken seconds apart usually differ in only a few widgets, so only the tiles that changed are stored (stacked
+ * into a single strip image that is encoded with a regular ScreenshotCodec), along with their tile indices.
+ * Deltas always reference a keyframe directly, so decoding one never takes more than two decodes.
+ */
+class ScreenshotDelta
+{
+public:
+
+    /**
+     * @brief TILE_SIZE
+     * The width and height of the tiles that are compared and stored.
+     */
+    const static int TILE_SIZE;
+    /**
+     * @brief MIN_TILES
+     * The minimum number of tiles that a screenshot must cover to be worth delta encoding.
+     */
+    const static int MIN_TILES;
+    /**
+     * @brief MAX_CHANGED_RATIO
+     * The maximum fraction of changed tiles for which a delta is stored instead of a new keyframe.
+     */
+    const static double MAX_CHANGED_RATIO;
+    /**
+     * @brief KEYFRAME_INTERVAL
+     * The maximum number of deltas stored against one keyframe before a new keyframe is started.
+     */
+    const static int KEYFRAME_INTERVAL;
+
+    /**
+     * @brief changedTiles
+     * Compares a screenshot against a keyframe tile by tile.
+     * @param image The screenshot.
+     * @param keyframe The keyframe (must be the same size as the screenshot).
+     * @return The indices (in row major order) of the tiles that differ.
+     */
+    static QList<int> changedTiles(const QImage &image, const QImage &keyframe);
+
+    /**
+     * @brief isWorthDelta
+     * Checks if a delta would be worth storing instead of a new keyframe.
+     * @param image The screenshot.
+     * @param changedTiles The tiles that differ from the keyframe (see changedTiles()).
+     * @return true if a delta should be stored, false if the screenshot should become a new keyframe.
+     */
+    static bool isWorthDelta(const QImage &image, const QList<int> &changedTiles);
+
+    /**
+     * @brief encode
+     * Encodes the changed tiles of a screenshot.
+     * @param image The screenshot.
+     * @param changedTiles The tiles that differ from the keyframe (see changedTiles()).
+     * @param codec The codec to encode the changed tiles with.
+     * @return The encoded delta, or an empty byte array if the encode failed.
+     */
+    static QByteArray encode(const QImage &image, const QList<int> &changedTiles, const ScreenshotCodec *codec);
+
+    /**
+     * @brief decode
+     * Reconstructs a screenshot from its keyframe and delta.
+     * @param data The encoded delta.
+     * @param size The number of encoded bytes.
+     * @param codec The codec that the changed tiles are encoded with.
+     * @param keyframe The decoded keyframe.
+     * @return The screenshot, or a null image if the delta is not valid for the keyframe.
+     */
+    static QImage decode(const uchar *data, int size, const ScreenshotCodec *codec, const QImage &keyframe);
+
+private:
+
+    /**
+     * @brief tileFormat
+     * Gets the format that a screenshot is compared and stored in.
+     * @param image The screenshot.
+     * @return ARGB32 for screenshots with an alpha channel, otherwise RGB32.
+     */
+    static QImage::Format tileFormat(const QImage &image);
+
+    /**
+     * @brief tileRect
+     * Gets the area of the image that a tile covers (tiles on the right and bottom edges may be partial).
+     * @param image The screenshot.
+     * @param tile The tile index.
+     * @return The tile area.
+     */
+    static QRect tileRect(const QImage &image, int tile);
+
+    // Static utility class; no constructors, no copies!
+    ScreenshotDelta();
+    ScreenshotDelta(const ScreenshotDelta &copyFrom){}
+    ScreenshotDelta& operator=(const ScreenshotDelta &rhs){}
+};
+
+
+#endif // SCREENSHOTDELTA_H
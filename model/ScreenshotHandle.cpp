@@ -0,0 +1,164 @@
+#include "ScreenshotHandle.h"
+#include "ScreenshotStore.h"
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThread>
+
+
+const int ScreenshotHandle::DECODE_THREADS = 2;
+
+QMutex ScreenshotHandle::_registryMutex;
+QHash<QByteArray, QWeakPointer<ScreenshotHandle::SharedScreenshot>> ScreenshotHandle::_registry;
+
+
+class ScreenshotHandle::DecodeTask : public QRunnable
+{
+public:
+
+    explicit DecodeTask(const QSharedPointer<SharedScreenshot> &shared) :
+        _shared(shared)
+    {}
+
+    void run() override
+    {
+        // Only hold the screenshot weakly while queued so that discarded events do not keep it alive.
+        QSharedPointer<SharedScreenshot> shared = _shared.toStrongRef();
+        if (!shared.isNull()) {
+            shared->decode();
+        }
+    }
+
+private:
+
+    QWeakPointer<SharedScreenshot> _shared;
+};
+
+
+ScreenshotHandle::ScreenshotHandle() :
+    _shared()
+{}
+
+
+ScreenshotHandle ScreenshotHandle::fromBlob(const QByteArray &blobHash)
+{
+    ScreenshotHandle handle;
+    if (blobHash.isEmpty()) return handle;
+
+    QMutexLocker locker(&_registryMutex);
+    handle._shared = _registry.value(blobHash).toStrongRef();
+    if (handle._shared.isNull()) {
+        handle._shared = QSharedPointer<SharedScreenshot>(new SharedScreenshot(blobHash));
+        _registry.insert(blobHash, handle._shared);
+    }
+    return handle;
+}
+
+
+ScreenshotHandle ScreenshotHandle::fromImage(const QImage &image)
+{
+    ScreenshotHandle handle;
+    if (image.isNull()) return handle;
+
+    handle._shared = QSharedPointer<SharedScreenshot>(new SharedScreenshot());
+    handle._shared->image = image;
+    handle._shared->state = SharedScreenshot::DECODED;
+    return handle;
+}
+
+
+bool ScreenshotHandle::isNull() const
+{
+    return _shared.isNull();
+}
+
+
+bool ScreenshotHandle::isStored() const
+{
+    return (!_shared.isNull() && !_shared->blobHash.isEmpty());
+}
+
+
+bool ScreenshotHandle::isDecoded() const
+{
+    if (_shared.isNull()) return true;
+
+    QMutexLocker locker(&_shared->mutex);
+    return (_shared->state == SharedScreenshot::DECODED);
+}
+
+
+void ScreenshotHandle::prefetch() const
+{
+    if (_shared.isNull()) return;
+
+    {
+        QMutexLocker locker(&_shared->mutex);
+        if (_shared->state != SharedScreenshot::UNDECODED) return;
+        _shared->state = SharedScreenshot::QUEUED;
+    }
+    decodePool()->start(new DecodeTask(_shared));
+}
+
+
+QImage ScreenshotHandle::image() const
+{
+    if (_shared.isNull()) return QImage();
+
+    // If still queued on the pool, then decode it here rather than wait for the pool to get to it.
+    _shared->decode();
+    QMutexLocker locker(&_shared->mutex);
+    return _shared->image;
+}
+
+
+QThreadPool* ScreenshotHandle::decodePool()
+{
+    static QThreadPool *pool = nullptr;
+    static QMutex poolMutex;
+
+    QMutexLocker locker(&poolMutex);
+    if (pool == nullptr) {
+        pool = new QThreadPool();
+        pool->setMaxThreadCount(qMax(1, qMin(DECODE_THREADS, QThread::idealThreadCount() - 1)));
+    }
+    return pool;
+}
+
+
+ScreenshotHandle::SharedScreenshot::SharedScreenshot(const QByteArray &blobHash) :
+    blobHash(blobHash),
+    state(UNDECODED),
+    image()
+{}
+
+
+ScreenshotHandle::SharedScreenshot::~SharedScreenshot()
+{
+    if (blobHash.isEmpty()) return;
+
+    // Drop our registry entry, unless a new handle to the same image has already been registered.
+    QMutexLocker locker(&_registryMutex);
+    if (_registry.contains(blobHash) && _registry.value(blobHash).isNull()) {
+        _registry.remove(blobHash);
+    }
+}
+
+
+void ScreenshotHandle::SharedScreenshot::decode()
+{
+    QMutexLocker locker(&mutex);
+    while (state == DECODING) {
+        decoded.wait(&mutex);
+    }
+    if (state == DECODED) return;
+    state = DECODING;
+    locker.unlock();
+
+    // Decode outside of the lock so that isDecoded() and prefetch() never wait on the decode.
+    QImage decodedImage = ScreenshotStore::load(blobHash);
+
+    locker.relock();
+    image = decodedImage;
+    state = DECODED;
+    decoded.wakeAll();
+}
@@ -0,0 +1,155 @@
+#ifndef SCREENSHOTHANDLE_H
+#define SCREENSHOTHANDLE_H
+
+
+#include <QImage>
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QSharedPointer>
+#include <QWeakPointer>
+#include <QThreadPool>
+
+
+/**
+ * @brief The ScreenshotHandle class
+ * A cheap to copy handle to a Macro Mouse Event's screenshot image. Handles to stored images are decoded lazily,
+ * either on the first call to image() or ahead of time on a background pool through prefetch(). All live handles
+ * that reference the same stored image (ScreenshotStore blob) share a single decoded image.
+ */
+class ScreenshotHandle
+{
+public:
+
+    /**
+     * @brief DECODE_THREADS
+     * The maximum number of background threads used to decode prefetched screenshots.
+     */
+    const static int DECODE_THREADS;
+
+    /**
+     * @brief ScreenshotHandle
+     * Constructs a null handle (no screenshot).
+     */
+    explicit ScreenshotHandle();
+
+    /**
+     * @brief fromBlob
+     * Gets a handle to a stored screenshot image. The image is not decoded until it is needed.
+     * @param blobHash The hash of the image in the ScreenshotStore (empty for a null handle).
+     * @return The handle, shared with any other live handle to the same image.
+     */
+    static ScreenshotHandle fromBlob(const QByteArray &blobHash);
+
+    /**
+     * @brief fromImage
+     * Gets a handle to an already decoded screenshot image (e.g. one that was just recorded).
+     * @param image The decoded image.
+     * @return The handle (null for a null image).
+     */
+    static ScreenshotHandle fromImage(const QImage &image);
+
+    /**
+     * @brief isNull
+     * Checks if the handle refers to a screenshot.
+     * @return true if there is no screenshot, false otherwise.
+     */
+    bool isNull() const;
+
+    /**
+     * @brief isStored
+     * Checks if the handle refers to an image in the ScreenshotStore, rather than one that has not been stored yet.
+     * @return true if it is stored, false otherwise (or if null).
+     */
+    bool isStored() const;
+
+    /**
+     * @brief isDecoded
+     * Checks if the screenshot has already been decoded, meaning that image() will not block.
+     * @return true if decoded (or null), false otherwise.
+     */
+    bool isDecoded() const;
+
+    /**
+     * @brief prefetch
+     * Queues the screenshot to be decoded on the background pool if it has not been decoded or queued already.
+     */
+    void prefetch() const;
+
+    /**
+     * @brief image
+     * Gets the decoded screenshot. Decodes it on the calling thread if a background decode has not started yet,
+     * or waits for a background decode that is already underway.
+     * @return The screenshot, or a null image if the handle is null or the screenshot could not be loaded.
+     */
+    QImage image() const;
+
+private:
+
+    /**
+     * @brief The SharedScreenshot class
+     * The decode state and image shared between all handles to one screenshot.
+     */
+    class SharedScreenshot
+    {
+    public:
+
+        enum DecodeState {
+            UNDECODED,
+            QUEUED,
+            DECODING,
+            DECODED
+        };
+
+        explicit SharedScreenshot(const QByteArray &blobHash=QByteArray());
+        ~SharedScreenshot();
+
+        /**
+         * @brief decode
+         * Decodes the screenshot unless it is already decoded. If another thread is decoding it, then waits for it.
+         */
+        void decode();
+
+        QByteArray blobHash;
+        QMutex mutex;
+        QWaitCondition decoded;
+        DecodeState state;
+        QImage image;
+    };
+
+    /**
+     * @brief The DecodeTask class
+     * Background pool task that decodes a prefetched screenshot (if it is still referenced by then).
+     */
+    class DecodeTask;
+
+    /**
+     * @brief _shared
+     * The shared screenshot state (null for a null handle).
+     */
+    QSharedPointer<SharedScreenshot> _shared;
+
+    /**
+     * @brief _registryMutex
+     * Guards _registry.
+     */
+    static QMutex _registryMutex;
+
+    /**
+     * @brief _registry
+     * Weak references to the shared state of every live stored image, keyed by blob hash.
+     */
+    static QHash<QByteArray, QWeakPointer<SharedScreenshot>> _registry;
+
+    /**
+     * @brief decodePool
+     * Gets the background pool that prefetched screenshots are decoded on.
+     * @return The decode pool.
+     */
+    static QThreadPool* decodePool();
+};
+
+
+#endif // SCREENSHOTHANDLE_H
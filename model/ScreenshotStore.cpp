@@ -0,0 +1,602 @@
+#include "ScreenshotStore.h"
+#include "DBUtil.h"
+#include <QCryptographicHash>
+#include <QDir>
+#include <QFileInfo>
+#include <QStringList>
+#include <QVariantList>
+#include <QMutexLocker>
+#include <QReadLocker>
+#include <QWriteLocker>
+#include <QSqlError>
+#include <QDebug>
+
+
+const qint64 ScreenshotStore::COMPACT_MIN_DEAD_BYTES = 16 * 1024 * 1024;
+const double ScreenshotStore::COMPACT_MIN_DEAD_RATIO = 0.25;
+const ScreenshotCodec::CodecId ScreenshotStore::ENCODE_CODEC = ScreenshotCodec::QOI;
+const int ScreenshotStore::KEYFRAME_CACHE_KB = 32 * 1024;
+QHash<QByteArray, ScreenshotStore::BlobLocation> ScreenshotStore::_index;
+QHash<QString, QHash<QByteArray, ScreenshotStore::BlobLocation>> ScreenshotStore::_stagedIndex;
+qint64 ScreenshotStore::_liveBytes = 0;
+int ScreenshotStore::_packGeneration = 0;
+QFile *ScreenshotStore::_packWriteFile = nullptr;
+QFile *ScreenshotStore::_packReadFile = nullptr;
+uchar *ScreenshotStore::_packMap = nullptr;
+qint64 ScreenshotStore::_mappedSize = 0;
+QReadWriteLock ScreenshotStore::_packLock;
+QMutex ScreenshotStore::_writeMutex;
+std::atomic<int> ScreenshotStore::_nextScreenshotId(0);
+std::atomic<int> ScreenshotStore::_sweepHolds(0);
+QCache<QByteArray, QImage> ScreenshotStore::_keyframeCache(KEYFRAME_CACHE_KB);
+QMutex ScreenshotStore::_keyframeCacheMutex;
+
+
+void ScreenshotStore::initTables(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+
+    // The blob hash is the primary key, so there is no need for a separate rowid b-tree.
+    query.prepare("CREATE TABLE IF NOT EXISTS " + DBUtil::SCREENSHOT_BLOB_TABLE_NAME + " ( \n"
+                  "   blobHash BLOB PRIMARY KEY, \n"
+                  "   packOffset INTEGER NOT NULL, \n"
+                  "   packSize INTEGER NOT NULL, \n"
+                  "   codec INTEGER NOT NULL DEFAULT " + QString::number(ScreenshotCodec::PNG) + ", \n"
+                  "   keyframeBlobHash BLOB REFERENCES " + DBUtil::SCREENSHOT_BLOB_TABLE_NAME + "(blobHash), \n"
+                  "   refCount INTEGER NOT NULL DEFAULT 0 \n" // Maintained by triggers (see DBUtil::initTables())!
+                  " ) WITHOUT ROWID;");
+    safeExec(query, "Error: " + DBUtil::SCREENSHOT_BLOB_TABLE_NAME + " table create failed with query: \n" + query.lastQuery());
+
+    // Serves the check for deltas that still reference a keyframe.
+    query.prepare("CREATE INDEX IF NOT EXISTS screenshotBlobKeyframeIndex ON " + DBUtil::SCREENSHOT_BLOB_TABLE_NAME + " (keyframeBlobHash);");
+    safeExec(query, "Error: Create index screenshotBlobKeyframeIndex failed!");
+    // Only holds the blobs waiting to be swept.
+    query.prepare("CREATE INDEX IF NOT EXISTS screenshotBlobUnreferencedIndex ON " + DBUtil::SCREENSHOT_BLOB_TABLE_NAME + " (blobHash) \n"
+                  "WHERE refCount=0;");
+    safeExec(query, "Error: Create index screenshotBlobUnreferencedIndex failed!");
+
+    // Single row holding the generation of the pack file that the blob offsets refer to.
+    query.prepare("CREATE TABLE IF NOT EXISTS " + DBUtil::SCREENSHOT_PACK_TABLE_NAME + " ( \n"
+                  "   packGeneration INTEGER NOT NULL \n"
+                  " );");
+    safeExec(query, "Error: " + DBUtil::SCREENSHOT_PACK_TABLE_NAME + " table create failed with query: \n" + query.lastQuery());
+}
+
+
+void ScreenshotStore::init(QSqlDatabase &db)
+{
+    QMutexLocker writeLocker(&_writeMutex);
+    if (_packWriteFile != nullptr) return;
+
+    initTables(db);
+    QSqlQuery query(db);
+
+    query.prepare("SELECT packGeneration FROM " + DBUtil::SCREENSHOT_PACK_TABLE_NAME + ";");
+    safeExec(query, "Error: Failed to read screenshot pack generation!");
+    if (query.next()) {
+        _packGeneration = query.value(0).toInt();
+    }
+    else {
+        _packGeneration = 0;
+        query.prepare("INSERT INTO " + DBUtil::SCREENSHOT_PACK_TABLE_NAME + " (packGeneration) VALUES (0);");
+        safeExec(query, "Error: Failed to initialize screenshot pack generation!");
+    }
+
+    QWriteLocker packLocker(&_packLock);
+    _index.clear();
+    _liveBytes = 0;
+    query.prepare("SELECT blobHash, packOffset, packSize, codec, keyframeBlobHash FROM " + DBUtil::SCREENSHOT_BLOB_TABLE_NAME + ";");
+    safeExec(query, "Error: Failed to load screenshot blob index with query: \n" + query.lastQuery());
+    while (query.next()) {
+        BlobLocation location;
+        location.offset = query.value("packOffset").toLongLong();
+        location.size = query.value("packSize").toLongLong();
+        location.codec = query.value("codec").toInt();
+        location.keyframeBlobHash = query.value("keyframeBlobHash").toByteArray();
+        _index.insert(query.value("blobHash").toByteArray(), location);
+        _liveBytes += location.size;
+    }
+
+    // IDs only need to be unique, so continue on from the largest one in use.
+    query.prepare("SELECT MAX(screenshotId) FROM " + DBUtil::SCREENSHOT_TABLE_NAME + ";");
+    safeExec(query, "Error: Failed to read the largest screenshot ID!");
+    _nextScreenshotId = (query.next() && !query.value(0).isNull()) ? query.value(0).toInt() + 1 : 0;
+
+    // Opening may have created the pack, whose directory entry must be on disk before any blob in it is committed.
+    if (!openPack(_packGeneration) || !DBUtil::syncDir(DBUtil::SCREENSHOT_DIR_PATH)) {
+        qDebug() << "Error: Failed to open screenshot pack: " << packFilePath(_packGeneration);
+        exit(1);
+    }
+    removeStalePacks();
+    qDebug() << "Screenshot store: " << _index.size() << " blobs, " << _liveBytes << " of "
+             << _packReadFile->size() << " pack bytes live";
+}
+
+
+void ScreenshotStore::shutdown()
+{
+    QMutexLocker writeLocker(&_writeMutex);
+    QWriteLocker packLocker(&_packLock);
+    closePack();
+}
+
+
+int ScreenshotStore::generateNewScreenshotId()
+{
+    return _nextScreenshotId++;
+}
+
+
+ScreenshotStore::EncodedScreenshot ScreenshotStore::encode(const QImage &image)
+{
+    const ScreenshotCodec *codec = encodeCodec();
+    QByteArray data = codec->encode(image);
+    if (data.isEmpty()) {
+        qDebug() << "Error: Failed to encode screenshot with codec: " << codec->name();
+        exit(1);
+    }
+    return fromEncoded(data, codec->id());
+}
+
+
+ScreenshotStore::EncodedScreenshot ScreenshotStore::encodeDelta(const QImage &image, const QList<int> &changedTiles,
+                                                                const QByteArray &keyframeBlobHash)
+{
+    const ScreenshotCodec *codec = encodeCodec();
+    QByteArray data = ScreenshotDelta::encode(image, changedTiles, codec);
+    if (data.isEmpty()) {
+        qDebug() << "Error: Failed to encode screenshot delta with codec: " << codec->name();
+        exit(1);
+    }
+
+    EncodedScreenshot encoded = fromEncoded(data, codec->id());
+    encoded.keyframeBlobHash = keyframeBlobHash;
+    return encoded;
+}
+
+
+ScreenshotStore::EncodedScreenshot ScreenshotStore::fromEncoded(const QByteArray &data, ScreenshotCodec::CodecId codec)
+{
+    EncodedScreenshot encoded;
+    encoded.data = data;
+    encoded.blobHash = QCryptographicHash::hash(data, QCryptographicHash::Sha1);
+    encoded.codec = codec;
+    encoded.keyframeBlobHash = QByteArray();
+    return encoded;
+}
+
+
+QByteArray ScreenshotStore::put(QSqlDatabase &db, const EncodedScreenshot &encoded)
+{
+    const QByteArray &blobHash = encoded.blobHash;
+    QMutexLocker writeLocker(&_writeMutex);
+    QSqlQuery query(db);
+
+    QHash<QByteArray, BlobLocation> &staged = _stagedIndex[db.connectionName()];
+
+    // The keyframe of a delta may have been swept since the delta was encoded (or added earlier in this transaction).
+    if (!encoded.keyframeBlobHash.isEmpty() && !staged.contains(encoded.keyframeBlobHash)) {
+        QReadLocker packLocker(&_packLock);
+        if (!_index.contains(encoded.keyframeBlobHash)) return QByteArray();
+    }
+
+    // Identical screenshots share one blob.
+    query.prepare("SELECT 1 FROM " + DBUtil::SCREENSHOT_BLOB_TABLE_NAME + " WHERE blobHash=:blobHash;");
+    query.bindValue(":blobHash", blobHash);
+    safeExec(query, "Error: SELECT failed in ScreenshotStore::put() with query: \n" + query.lastQuery());
+    if (query.next()) return blobHash;
+
+    // If the transaction is rolled back, then the appended bytes are simply dead space until the next compaction.
+    BlobLocation location;
+    location.offset = _packWriteFile->size();
+    location.size = encoded.data.size();
+    location.codec = encoded.codec;
+    location.keyframeBlobHash = encoded.keyframeBlobHash;
+    if (_packWriteFile->write(encoded.data) != encoded.data.size() || !_packWriteFile->flush()) {
+        qDebug() << "Error: Failed to append screenshot to pack: " << _packWriteFile->fileName();
+        exit(1);
+    }
+
+    query.prepare("INSERT INTO " + DBUtil::SCREENSHOT_BLOB_TABLE_NAME + " (blobHash, packOffset, packSize, codec, keyframeBlobHash) \n"
+                  "VALUES (:blobHash, :packOffset, :packSize, :codec, :keyframeBlobHash);");
+    query.bindValue(":blobHash", blobHash);
+    query.bindValue(":packOffset", location.offset);
+    query.bindValue(":packSize", location.size);
+    query.bindValue(":codec", location.codec);
+    query.bindValue(":keyframeBlobHash", location.keyframeBlobHash.isEmpty() ? QVariant(QVariant::ByteArray)
+                                                                             : QVariant(location.keyframeBlobHash));
+    safeExec(query, "Error: INSERT failed in ScreenshotStore::put() with query: \n" + query.lastQuery());
+
+    // Only published to the in memory index once the transaction commits (see publishStaged()).
+    staged.insert(blobHash, location);
+    return blobHash;
+}
+
+
+bool ScreenshotStore::syncStaged(const QSqlDatabase &db)
+{
+    QMutexLocker writeLocker(&_writeMutex);
+    if (_stagedIndex.value(db.connectionName()).isEmpty()) return true;
+    return DBUtil::syncFile(*_packWriteFile);
+}
+
+
+void ScreenshotStore::publishStaged(const QSqlDatabase &db)
+{
+    QMutexLocker writeLocker(&_writeMutex);
+    QHash<QByteArray, BlobLocation> staged = _stagedIndex.take(db.connectionName());
+    if (staged.isEmpty()) return;
+
+    QWriteLocker packLocker(&_packLock);
+    for (QHash<QByteArray, BlobLocation>::const_iterator it = staged.constBegin(); it != staged.constEnd(); ++it) {
+        _index.insert(it.key(), it.value());
+        _liveBytes += it.value().size;
+    }
+}
+
+
+void ScreenshotStore::discardStaged(const QSqlDatabase &db)
+{
+    // The appended bytes of the discarded blobs are dead space until the next compaction.
+    QMutexLocker writeLocker(&_writeMutex);
+    _stagedIndex.remove(db.connectionName());
+}
+
+
+bool ScreenshotStore::contains(const QByteArray &blobHash)
+{
+    QReadLocker packLocker(&_packLock);
+    return _index.contains(blobHash);
+}
+
+
+QImage ScreenshotStore::load(const QByteArray &blobHash)
+{
+    // Get the keyframe of a delta first, since decoding it takes the pack lock too.
+    QByteArray keyframeBlobHash;
+    {
+        QReadLocker packLocker(&_packLock);
+        keyframeBlobHash = _index.value(blobHash).keyframeBlobHash;
+    }
+    QImage keyframe;
+    if (!keyframeBlobHash.isEmpty()) {
+        keyframe = loadKeyframe(keyframeBlobHash);
+        if (keyframe.isNull()) return QImage();
+    }
+
+    QReadLocker packLocker(&_packLock);
+    if (!_index.contains(blobHash)) {
+        qDebug() << "Error: Screenshot blob not found: " << blobHash.toHex();
+        return QImage();
+    }
+
+    // Blobs appended since the last mapping are not mapped yet.
+    BlobLocation location = _index.value(blobHash);
+    if (location.offset + location.size > _mappedSize) {
+        packLocker.unlock();
+        {
+            QWriteLocker remapLocker(&_packLock);
+            if (location.offset + location.size > _mappedSize) {
+                remap();
+            }
+        }
+        packLocker.relock();
+        // The pack may have been compacted in between.
+        location = _index.value(blobHash);
+        if (_packMap == nullptr || location.offset + location.size > _mappedSize) {
+            qDebug() << "Error: Screenshot blob lies outside of the pack: " << blobHash.toHex();
+            return QImage();
+        }
+    }
+
+    const ScreenshotCodec *codec = ScreenshotCodec::get(location.codec);
+    if (codec == nullptr || !codec->isAvailable()) {
+        qDebug() << "Error: Screenshot blob has an unsupported codec (" << location.codec << "): " << blobHash.toHex();
+        return QImage();
+    }
+
+    // Decodes straight from the mapping without copying the encoded bytes.
+    if (!keyframeBlobHash.isEmpty()) {
+        return ScreenshotDelta::decode(_packMap + location.offset, (int)location.size, codec, keyframe);
+    }
+    return codec->decode(_packMap + location.offset, (int)location.size);
+}
+
+
+int ScreenshotStore::sweep(QSqlDatabase &db)
+{
+    // Stays pending until released. A hold only protects screenshots that were referenced when it was taken, and
+    // those can only lose their references through later writes, so checking once up front is enough.
+    if (_sweepHolds > 0) return -1;
+
+    QSqlQuery query(db);
+
+    // Check first, so that an idle database is not write locked for nothing. Served by the partial indexes.
+    query.prepare("SELECT 1 FROM " + DBUtil::SCREENSHOT_TABLE_NAME + " WHERE refCount=0 \n"
+                  "UNION ALL \n"
+                  "SELECT 1 FROM " + DBUtil::SCREENSHOT_BLOB_TABLE_NAME + " WHERE refCount=0 \n"
+                  "LIMIT 1;");
+    if (!safeExec(query, "Error: SELECT failed in ScreenshotStore::sweep() with query: \n" + query.lastQuery(), false)) return -1;
+    if (!query.next()) return 0;
+
+    // Take the database write lock before blocking appends, so that no writer can be waiting on us while holding it.
+    if (!query.exec("BEGIN IMMEDIATE;")) {
+        qDebug() << "Screenshot sweep postponed, database is busy";
+        return -1;
+    }
+    // Also keeps deltas from being added against keyframes that are about to be removed.
+    QMutexLocker writeLocker(&_writeMutex);
+
+    // Deleting a screenshot releases its blobs through the reference count triggers.
+    query.prepare("DELETE FROM " + DBUtil::SCREENSHOT_TABLE_NAME + " WHERE refCount=0;");
+    bool success = safeExec(query, "Error: DELETE failed in ScreenshotStore::sweep() with query: \n" + query.lastQuery(), false);
+    int screenshotCount = success ? query.numRowsAffected() : 0;
+
+    // Deleting a delta releases its keyframe, so repeat until no more blobs are released.
+    QList<QByteArray> removedHashes;
+    while (success) {
+        QVariantList releasedHashes;
+        query.prepare("SELECT blobHash FROM " + DBUtil::SCREENSHOT_BLOB_TABLE_NAME + " WHERE refCount=0;");
+        success = safeExec(query, "Error: SELECT failed in ScreenshotStore::sweep() with query: \n" + query.lastQuery(), false);
+        while (success && query.next()) {
+            releasedHashes.append(query.value("blobHash").toByteArray());
+        }
+        if (!success || releasedHashes.isEmpty()) break;
+
+        query.prepare("DELETE FROM " + DBUtil::SCREENSHOT_BLOB_TABLE_NAME + " WHERE blobHash=?;");
+        query.addBindValue(releasedHashes);
+        success = query.execBatch();
+        foreach (const QVariant &blobHash, releasedHashes) {
+            removedHashes.append(blobHash.toByteArray());
+        }
+    }
+
+    // The pack is only ever rewritten by compaction, so a crash anywhere in here leaves nothing worse than dead space.
+    success = success && query.exec("COMMIT;");
+    if (!success) {
+        QSqlError sqlErr = query.lastError();
+        qDebug() << "Error: Screenshot sweep failed";
+        qDebug() << "SQLite Error: " << sqlErr.text() << "       SQLite Error Code: " << sqlErr.number();
+        query.exec("ROLLBACK;");
+        return -1;
+    }
+
+    {
+        QWriteLocker packLocker(&_packLock);
+        foreach (const QByteArray &blobHash, removedHashes) {
+            _liveBytes -= _index.take(blobHash).size;
+        }
+    }
+    QMutexLocker cacheLocker(&_keyframeCacheMutex);
+    foreach (const QByteArray &blobHash, removedHashes) {
+        _keyframeCache.remove(blobHash);
+    }
+    qDebug() << "Swept " << screenshotCount << " screenshots and " << removedHashes.size() << " screenshot blobs";
+    return screenshotCount + removedHashes.size();
+}
+
+
+void ScreenshotStore::holdSweep()
+{
+    _sweepHolds++;
+}
+
+
+void ScreenshotStore::releaseSweep()
+{
+    _sweepHolds--;
+}
+
+
+bool ScreenshotStore::needsCompaction()
+{
+    QReadLocker packLocker(&_packLock);
+    if (_packReadFile == nullptr) return false;
+
+    qint64 packBytes = _packReadFile->size();
+    qint64 deadBytes = packBytes - _liveBytes;
+    return (deadBytes >= COMPACT_MIN_DEAD_BYTES && deadBytes >= packBytes * COMPACT_MIN_DEAD_RATIO);
+}
+
+
+bool ScreenshotStore::compact(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+
+    // Take the database write lock before blocking appends, so that no writer can be waiting on us while holding it.
+    if (!query.exec("BEGIN IMMEDIATE;")) {
+        qDebug() << "Screenshot pack compaction postponed, database is busy";
+        return false;
+    }
+    QMutexLocker writeLocker(&_writeMutex);
+
+    int newGeneration = _packGeneration + 1;
+    QString newPackPath = packFilePath(newGeneration);
+    QFile newPack(newPackPath);
+    bool success = newPack.open(QIODevice::WriteOnly | QIODevice::Truncate);
+
+    // Copy the live blobs in pack order, so the new pack keeps the order they were recorded in.
+    QHash<QByteArray, BlobLocation> newIndex;
+    QVariantList blobHashes,
+                 packOffsets;
+    qint64 newOffset = 0;
+    if (success) {
+        query.prepare("SELECT blobHash, packOffset, packSize, codec, keyframeBlobHash FROM " + DBUtil::SCREENSHOT_BLOB_TABLE_NAME + " \n"
+                      "ORDER BY packOffset ASC;");
+        success = safeExec(query, "Error: SELECT failed in ScreenshotStore::compact() with query: \n" + query.lastQuery(), false);
+    }
+    if (success) {
+        QWriteLocker remapLocker(&_packLock);
+        success = remap();
+    }
+    if (success) {
+        // Appends are blocked, so the mapping stays valid while decodes carry on alongside the copy.
+        QReadLocker packLocker(&_packLock);
+        while (success && query.next()) {
+            QByteArray blobHash = query.value("blobHash").toByteArray();
+            BlobLocation location;
+            location.offset = query.value("packOffset").toLongLong();
+            location.size = query.value("packSize").toLongLong();
+            location.codec = query.value("codec").toInt();
+            location.keyframeBlobHash = query.value("keyframeBlobHash").toByteArray();
+
+            success = (location.offset + location.size <= _mappedSize)
+                   && (newPack.write((const char*)_packMap + location.offset, location.size) == location.size);
+            location.offset = newOffset;
+            newOffset += location.size;
+            newIndex.insert(blobHash, location);
+            blobHashes.append(blobHash);
+            packOffsets.append(location.offset);
+        }
+    }
+    // The new pack and its directory entry must be on disk before the commit points the index at it, and the commit
+    // itself before the old pack is removed.
+    success = success && DBUtil::syncFile(newPack);
+    newPack.close();
+    success = success && DBUtil::syncDir(DBUtil::SCREENSHOT_DIR_PATH);
+
+    if (success && !blobHashes.isEmpty()) {
+        query.prepare("UPDATE " + DBUtil::SCREENSHOT_BLOB_TABLE_NAME + " SET packOffset=? WHERE blobHash=?;");
+        query.addBindValue(packOffsets);
+        query.addBindValue(blobHashes);
+        success = query.execBatch();
+    }
+    if (success) {
+        query.prepare("UPDATE " + DBUtil::SCREENSHOT_PACK_TABLE_NAME + " SET packGeneration=:packGeneration;");
+        query.bindValue(":packGeneration", newGeneration);
+        success = safeExec(query, "Error: UPDATE failed in ScreenshotStore::compact() with query: \n" + query.lastQuery(), false);
+    }
+    // The commit is what switches over to the new pack, so a crash before it leaves the old pack in use.
+    query.exec("PRAGMA synchronous = FULL;");
+    success = success && query.exec("COMMIT;");
+    QSqlQuery pragmaQuery(db);
+    pragmaQuery.exec("PRAGMA synchronous = NORMAL;");
+
+    if (!success) {
+        QSqlError sqlErr = query.lastError();
+        qDebug() << "Error: Screenshot pack compaction failed, keeping pack: " << packFilePath(_packGeneration);
+        qDebug() << "SQLite Error: " << sqlErr.text() << "       SQLite Error Code: " << sqlErr.number();
+        query.exec("ROLLBACK;");
+        QFile::remove(newPackPath);
+        return false;
+    }
+
+    QWriteLocker packLocker(&_packLock);
+    qint64 oldPackBytes = _packReadFile->size();
+    closePack();
+    QFile::remove(packFilePath(_packGeneration));
+    _packGeneration = newGeneration;
+    _index = newIndex;
+    _liveBytes = newOffset;
+    if (!openPack(_packGeneration)) {
+        qDebug() << "Error: Failed to open compacted screenshot pack: " << newPackPath;
+        exit(1);
+    }
+    qDebug() << "Compacted screenshot pack from " << oldPackBytes << " to " << newOffset << " bytes";
+    return true;
+}
+
+
+QImage ScreenshotStore::loadKeyframe(const QByteArray &blobHash)
+{
+    {
+        QMutexLocker cacheLocker(&_keyframeCacheMutex);
+        QImage *cached = _keyframeCache.object(blobHash);
+        if (cached != nullptr) return *cached;
+    }
+
+    // Decode outside of the cache lock, so decodes of different keyframes do not wait on each other.
+    QImage keyframe = load(blobHash);
+    if (!keyframe.isNull()) {
+        QMutexLocker cacheLocker(&_keyframeCacheMutex);
+        _keyframeCache.insert(blobHash, new QImage(keyframe), qMax(1, keyframe.byteCount() / 1024));
+    }
+    return keyframe;
+}
+
+
+const ScreenshotCodec* ScreenshotStore::encodeCodec()
+{
+    const ScreenshotCodec *codec = ScreenshotCodec::get(ENCODE_CODEC);
+    if (codec == nullptr || !codec->isAvailable()) {
+        codec = ScreenshotCodec::get(ScreenshotCodec::PNG);
+    }
+    return codec;
+}
+
+
+QString ScreenshotStore::packFilePath(int generation)
+{
+    return DBUtil::SCREENSHOT_DIR_PATH + "screenshots." + QString::number(generation) + ".pack";
+}
+
+
+bool ScreenshotStore::openPack(int generation)
+{
+    _packWriteFile = new QFile(packFilePath(generation));
+    _packReadFile = new QFile(packFilePath(generation));
+    bool success = _packWriteFile->open(QIODevice::WriteOnly | QIODevice::Append)
+                && _packReadFile->open(QIODevice::ReadOnly);
+    return success && remap();
+}
+
+
+void ScreenshotStore::closePack()
+{
+    if (_packMap != nullptr) {
+        _packReadFile->unmap(_packMap);
+        _packMap = nullptr;
+    }
+    _mappedSize = 0;
+    delete _packReadFile;
+    delete _packWriteFile;
+    _packReadFile = nullptr;
+    _packWriteFile = nullptr;
+}
+
+
+bool ScreenshotStore::remap()
+{
+    if (_packMap != nullptr) {
+        _packReadFile->unmap(_packMap);
+        _packMap = nullptr;
+    }
+
+    // Empty files cannot be mapped.
+    _mappedSize = _packReadFile->size();
+    if (_mappedSize == 0) return true;
+
+    _packMap = _packReadFile->map(0, _mappedSize);
+    if (_packMap == nullptr) {
+        qDebug() << "Error: Failed to map screenshot pack: " << _packReadFile->fileName() << " " << _packReadFile->errorString();
+        _mappedSize = 0;
+        return false;
+    }
+    return true;
+}
+
+
+void ScreenshotStore::removeStalePacks()
+{
+    QDir dir(DBUtil::SCREENSHOT_DIR_PATH);
+    QString currentPackName = QFileInfo(packFilePath(_packGeneration)).fileName();
+    foreach (const QString &packName, dir.entryList(QStringList("screenshots.*.pack"), QDir::Files)) {
+        if (packName != currentPackName) {
+            qDebug() << "Removing stale screenshot pack: " << packName;
+            dir.remove(packName);
+        }
+    }
+}
+
+
+bool ScreenshotStore::safeExec(QSqlQuery &query, const QString &errMsg, bool exit)
+{
+    if (!query.exec()) {
+        qDebug().noquote().nospace() << errMsg;
+        QSqlError sqlErr = query.lastError();
+        qDebug() << "SQLite Error: " << sqlErr.text() << "       SQLite Error Code: " << sqlErr.number();
+        if (exit) { ::exit(1); }
+        return false;
+    }
+    return true;
+}
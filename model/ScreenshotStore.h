@@ -0,0 +1,377 @@
+#ifndef SCREENSHOTSTORE_H
+#define SCREENSHOTSTORE_H
+
+
+#include "ScreenshotCodec.h"
+#include "ScreenshotDelta.h"
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QByteArray>
+#include <QString>
+#include <QImage>
+#include <QHash>
+#include <QCache>
+#include <QList>
+#include <QFile>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <atomic>
+
+
+/**
+ * @brief The ScreenshotStore class
+ * Stores the encoded screenshot images in a single append-only pack file instead of one file per screenshot.
+ * Each blob is keyed by the SHA-1 hash of its encoded bytes, so identical screenshots are only stored once.
+ * The ScreenshotBlobs table is the index (hash -> offset and size in the pack), and it is written in the same
+ * transaction as the Screenshots rows that reference it. Blobs are decoded straight out of a memory mapping of
+ * the pack. Space held by removed blobs is reclaimed by compaction, which writes the live blobs to a new pack
+ * generation and atomically switches the index over to it. New blobs are encoded with ENCODE_CODEC, and the codec
+ * of every blob is recorded in the index, so blobs stored with an earlier codec still decode. A blob may also be a
+ * tile delta against a keyframe blob (see ScreenshotDelta), in which case the index records its keyframe.
+ * Every blob has a reference count (from Screenshots rows and deltas) kept up to date by triggers, and blobs
+ * whose count drops to zero are removed in the background by sweep(), unless the sweep is held (see holdSweep()).
+ */
+class ScreenshotStore
+{
+public:
+
+    /**
+     * @brief COMPACT_MIN_DEAD_BYTES
+     * The minimum number of bytes held by removed blobs before the pack is worth compacting.
+     */
+    const static qint64 COMPACT_MIN_DEAD_BYTES;
+    /**
+     * @brief COMPACT_MIN_DEAD_RATIO
+     * The minimum fraction of the pack held by removed blobs before the pack is worth compacting.
+     */
+    const static double COMPACT_MIN_DEAD_RATIO;
+    /**
+     * @brief ENCODE_CODEC
+     * The codec that new screenshots are encoded with (falls back to PNG if it is not available).
+     */
+    const static ScreenshotCodec::CodecId ENCODE_CODEC;
+    /**
+     * @brief KEYFRAME_CACHE_KB
+     * The maximum size of the decoded keyframes kept around for decoding the deltas that reference them.
+     */
+    const static int KEYFRAME_CACHE_KB;
+
+    /**
+     * @brief The EncodedScreenshot struct
+     * An encoded screenshot, ready to be added to the store.
+     */
+    typedef struct EncodedScreenshot
+    {
+        QByteArray data;
+        QByteArray blobHash;
+        ScreenshotCodec::CodecId codec;
+        QByteArray keyframeBlobHash; // The keyframe of a delta (empty if not a delta).
+    } EncodedScreenshot;
+
+    /**
+     * @brief initTables
+     * Creates the screenshot blob index and pack generation tables if they do not exist.
+     * @param db The opened database connection.
+     */
+    static void initTables(QSqlDatabase &db);
+
+    /**
+     * @brief init
+     * Opens and maps the current pack file, loads the blob index, and removes packs left behind by an interrupted
+     * compaction. Does nothing if the store is already open.
+     * @param db The opened database connection.
+     */
+    static void init(QSqlDatabase &db);
+
+    /**
+     * @brief shutdown
+     * Unmaps and closes the pack file.
+     */
+    static void shutdown();
+
+    /**
+     * @brief generateNewScreenshotId
+     * Generates a new unique screenshot ID. Safe to call from any thread.
+     * @return The screenshot ID.
+     */
+    static int generateNewScreenshotId();
+
+    /**
+     * @brief encode
+     * Encodes a screenshot with ENCODE_CODEC. Does not touch the store, so it is safe to call from any thread
+     * and should be called before the transaction that adds the screenshot.
+     * @param image The (non-null) screenshot.
+     * @return The encoded screenshot.
+     */
+    static EncodedScreenshot encode(const QImage &image);
+
+    /**
+     * @brief encodeDelta
+     * Encodes a screenshot as a tile delta against a keyframe with ENCODE_CODEC. Like encode(), safe to call from
+     * any thread. The keyframe must be added to the store before the delta.
+     * @param image The (non-null) screenshot.
+     * @param changedTiles The tiles that differ from the keyframe (see ScreenshotDelta::changedTiles()).
+     * @param keyframeBlobHash The blob hash of the keyframe.
+     * @return The encoded screenshot.
+     */
+    static EncodedScreenshot encodeDelta(const QImage &image, const QList<int> &changedTiles,
+                                         const QByteArray &keyframeBlobHash);
+
+    /**
+     * @brief fromEncoded
+     * Wraps already encoded screenshot bytes so that they can be added to the store.
+     * @param data The encoded screenshot.
+     * @param codec The codec that the screenshot is encoded with.
+     * @return The encoded screenshot.
+     */
+    static EncodedScreenshot fromEncoded(const QByteArray &data, ScreenshotCodec::CodecId codec);
+
+    /**
+     * @brief put
+     * Adds an encoded screenshot to the store unless an identical one is already stored.
+     * Should be called within the transaction that inserts the Screenshots row referencing the blob. A new blob is
+     * only staged, and becomes visible to load() and contains() once publishStaged() is called after the COMMIT.
+     * @param db The opened database connection.
+     * @param encoded The encoded screenshot.
+     * @return The blob hash, or an empty byte array if it is a delta against a keyframe that is not stored.
+     */
+    static QByteArray put(QSqlDatabase &db, const EncodedScreenshot &encoded);
+
+    /**
+     * @brief syncStaged
+     * Syncs the pack to the disk if blobs were staged on a connection, so that the index rows of the blobs never
+     * outlive their bytes in a power loss. Must be called before the transaction that staged them is committed.
+     * @param db The database connection.
+     * @return A success flag of true if synced (or nothing was staged), false otherwise.
+     */
+    static bool syncStaged(const QSqlDatabase &db);
+
+    /**
+     * @brief publishStaged
+     * Publishes the blobs staged by put() on a connection to the in memory index. Must be called once the
+     * transaction that added them has been committed.
+     * @param db The database connection.
+     */
+    static void publishStaged(const QSqlDatabase &db);
+
+    /**
+     * @brief discardStaged
+     * Drops the blobs staged by put() on a connection. Must be called if the transaction that added them has been
+     * rolled back.
+     * @param db The database connection.
+     */
+    static void discardStaged(const QSqlDatabase &db);
+
+    /**
+     * @brief contains
+     * Checks if a blob is in the store. Safe to call from any thread.
+     * @param blobHash The blob hash.
+     * @return true if it is stored, false otherwise.
+     */
+    static bool contains(const QByteArray &blobHash);
+
+    /**
+     * @brief load
+     * Decodes a stored screenshot. Safe to call from any thread.
+     * @param blobHash The blob hash.
+     * @return The screenshot, or a null image if it is not stored.
+     */
+    static QImage load(const QByteArray &blobHash);
+
+    /**
+     * @brief sweep
+     * Removes the Screenshots rows that are no longer referenced by any Macro Mouse Event, then the blobs that are
+     * no longer referenced by any screenshot or delta, all in one transaction. The space the blobs take up in the
+     * pack is reclaimed by the next compaction. Blocks new blobs from being added until done, so should only be
+     * called while the database is idle.
+     * @param db The opened database connection (must not be in a transaction).
+     * @return The number of screenshots and blobs removed, or -1 if the sweep failed, the database was busy, or the
+     * sweep is held.
+     */
+    static int sweep(QSqlDatabase &db);
+
+    /**
+     * @brief holdSweep
+     * Keeps sweep() from removing anything until the hold is released. Taken while the Macro Editor is open, since
+     * its undo log can reference unreferenced screenshots again (e.g. undoing a saved delete), and its lazy handles
+     * to them are only decoded when they are saved back. Holds nest. Safe to call from any thread.
+     */
+    static void holdSweep();
+
+    /**
+     * @brief releaseSweep
+     * Releases a hold taken with holdSweep(). Safe to call from any thread.
+     */
+    static void releaseSweep();
+
+    /**
+     * @brief needsCompaction
+     * Checks if enough of the pack is held by removed blobs to be worth compacting.
+     * @return true if it should be compacted, false otherwise.
+     */
+    static bool needsCompaction();
+
+    /**
+     * @brief compact
+     * Copies the live blobs to a new pack generation and switches over to it. Blocks new blobs from being added
+     * until done, so should only be called while the database is idle.
+     * @param db The opened database connection (must not be in a transaction).
+     * @return A success flag of true if the pack was compacted, false otherwise.
+     */
+    static bool compact(QSqlDatabase &db);
+
+private:
+
+    /**
+     * @brief The BlobLocation struct
+     * The location of a blob within the pack file, the codec it is encoded with, and its keyframe if it is a delta.
+     */
+    typedef struct BlobLocation
+    {
+        qint64 offset;
+        qint64 size;
+        int codec;
+        QByteArray keyframeBlobHash;
+    } BlobLocation;
+
+    /**
+     * @brief _index
+     * In memory copy of the blob index, used to locate blobs without a database connection.
+     */
+    static QHash<QByteArray, BlobLocation> _index;
+    /**
+     * @brief _stagedIndex
+     * The blobs added by the uncommitted transaction of each connection, keyed by connection name. Guarded by
+     * _writeMutex.
+     */
+    static QHash<QString, QHash<QByteArray, BlobLocation>> _stagedIndex;
+    /**
+     * @brief _liveBytes
+     * The total size of all blobs in the index.
+     */
+    static qint64 _liveBytes;
+    /**
+     * @brief _packGeneration
+     * The generation number of the current pack file.
+     */
+    static int _packGeneration;
+    /**
+     * @brief _packWriteFile
+     * The current pack file opened for appends.
+     */
+    static QFile *_packWriteFile;
+    /**
+     * @brief _packReadFile
+     * The current pack file opened for the memory mapping.
+     */
+    static QFile *_packReadFile;
+    /**
+     * @brief _packMap
+     * The memory mapping of the current pack file (nullptr if the pack is empty).
+     */
+    static uchar *_packMap;
+    /**
+     * @brief _mappedSize
+     * The number of bytes of the pack file that are mapped. Blobs appended since are mapped on first access.
+     */
+    static qint64 _mappedSize;
+    /**
+     * @brief _packLock
+     * Guards the mapping and the in memory index. Decodes hold it for reading, remaps and switches for writing.
+     */
+    static QReadWriteLock _packLock;
+    /**
+     * @brief _writeMutex
+     * Serializes appends to the pack and compaction.
+     */
+    static QMutex _writeMutex;
+    /**
+     * @brief _nextScreenshotId
+     * The next screenshot ID to hand out.
+     */
+    static std::atomic<int> _nextScreenshotId;
+    /**
+     * @brief _sweepHolds
+     * The number of holds on sweep() (see holdSweep()).
+     */
+    static std::atomic<int> _sweepHolds;
+    /**
+     * @brief _keyframeCache
+     * Recently decoded keyframes keyed by blob hash, with a cost in KB.
+     */
+    static QCache<QByteArray, QImage> _keyframeCache;
+    /**
+     * @brief _keyframeCacheMutex
+     * Guards _keyframeCache.
+     */
+    static QMutex _keyframeCacheMutex;
+
+    /**
+     * @brief loadKeyframe
+     * Decodes a keyframe, or gets it from the keyframe cache.
+     * @param blobHash The blob hash of the keyframe.
+     * @return The keyframe, or a null image if it is not stored.
+     */
+    static QImage loadKeyframe(const QByteArray &blobHash);
+
+    /**
+     * @brief encodeCodec
+     * Gets the codec to encode new blobs with.
+     * @return ENCODE_CODEC, or PNG if it is not available.
+     */
+    static const ScreenshotCodec* encodeCodec();
+
+    /**
+     * @brief packFilePath
+     * Generates the path of a pack file.
+     * @param generation The pack generation.
+     * @return The pack file path.
+     */
+    static QString packFilePath(int generation);
+
+    /**
+     * @brief openPack
+     * Opens the pack file of a given generation for appends and mapping (creates it if it does not exist).
+     * @param generation The pack generation.
+     * @return A success flag of true if the pack was opened, false otherwise.
+     */
+    static bool openPack(int generation);
+
+    /**
+     * @brief closePack
+     * Unmaps and closes the current pack file.
+     */
+    static void closePack();
+
+    /**
+     * @brief remap
+     * Maps the whole current pack file. Caller must hold _packLock for writing.
+     * @return A success flag of true if the pack was mapped, false otherwise.
+     */
+    static bool remap();
+
+    /**
+     * @brief removeStalePacks
+     * Removes any pack files that are not of the current generation.
+     */
+    static void removeStalePacks();
+
+    /**
+     * @brief safeExec
+     * Performs a safe execution of a QSqlite query. A safe execution will check for any error and output
+     * all detected error information.
+     * @param query The query to execute.
+     * @param errMsg A custom error message to display in addition to any sqlite specific error information.
+     * @param exit A flag to be set true if the program should terminate upon an error, false otherwise.
+     * @return A success flag of true if the query executed without error, false otherwise.
+     */
+    static bool safeExec(QSqlQuery &query, const QString &errMsg, bool exit=true);
+
+    // Static utility class; no constructors, no copies!
+    ScreenshotStore();
+    ScreenshotStore(const ScreenshotStore &copyFrom){}
+    ScreenshotStore& operator=(const ScreenshotStore &rhs){}
+};
+
+
+#endif // SCREENSHOTSTORE_H
@@ -0,0 +1,156 @@
+#include "ScreenshotThumbnails.h"
+#include "DBUtil.h"
+#include <QPixmapCache>
+#include <QByteArray>
+#include <QBuffer>
+#include <QSqlError>
+#include <QMutexLocker>
+#include <QDebug>
+
+
+const QString ScreenshotThumbnails::CONNECTION_TAG = "Thumbnails";
+QList<ScreenshotThumbnails::PendingThumbnail> ScreenshotThumbnails::_pendingThumbnails;
+QMutex ScreenshotThumbnails::_pendingLock;
+
+
+void ScreenshotThumbnails::initTables(QSqlDatabase &db)
+{
+    QSqlQuery query(db);
+
+    // The thumbnail key is the primary key, so there is no need for a separate rowid b-tree.
+    query.prepare("CREATE TABLE IF NOT EXISTS " + DBUtil::SCREENSHOT_THUMBNAIL_TABLE_NAME + " ( \n"
+                  "   screenshotId INTEGER NOT NULL, \n"
+                  "   xLoc INTEGER NOT NULL, \n"
+                  "   yLoc INTEGER NOT NULL, \n"
+                  "   thumbnailW INTEGER NOT NULL, \n"
+                  "   thumbnailH INTEGER NOT NULL, \n"
+                  "   thumbnail BLOB NOT NULL, \n" // PNG encoded.
+                  "   PRIMARY KEY (screenshotId, xLoc, yLoc, thumbnailW, thumbnailH) \n"
+                  " ) WITHOUT ROWID;");
+    safeExec(query, "Error: " + DBUtil::SCREENSHOT_THUMBNAIL_TABLE_NAME + " table create failed with query: \n" + query.lastQuery());
+
+    // Thumbnails go along with their screenshot when it is swept (see ScreenshotStore::sweep()).
+    query.prepare("CREATE TRIGGER IF NOT EXISTS screenshotThumbnailDelete AFTER DELETE ON " + DBUtil::SCREENSHOT_TABLE_NAME + " BEGIN \n"
+                  "   DELETE FROM " + DBUtil::SCREENSHOT_THUMBNAIL_TABLE_NAME + " WHERE screenshotId=OLD.screenshotId; \n"
+                  "END;");
+    safeExec(query, "Error: Trigger screenshotThumbnailDelete create failed with query: \n" + query.lastQuery());
+}
+
+
+QPixmap ScreenshotThumbnails::find(int screenshotId, const QPoint &loc, const QSize &size)
+{
+    QString key = cacheKey(screenshotId, loc, size);
+    QPixmap thumbnail;
+    if (QPixmapCache::find(key, &thumbnail)) return thumbnail;
+
+    QSqlQuery query(DBUtil::threadConnection(CONNECTION_TAG));
+    query.prepare("SELECT thumbnail FROM " + DBUtil::SCREENSHOT_THUMBNAIL_TABLE_NAME + " \n"
+                  "WHERE screenshotId=:screenshotId AND xLoc=:xLoc AND yLoc=:yLoc \n"
+                  "  AND thumbnailW=:thumbnailW AND thumbnailH=:thumbnailH;");
+    query.bindValue(":screenshotId", screenshotId);
+    query.bindValue(":xLoc", loc.x());
+    query.bindValue(":yLoc", loc.y());
+    query.bindValue(":thumbnailW", size.width());
+    query.bindValue(":thumbnailH", size.height());
+    if (   !safeExec(query, "Error: SELECT failed in ScreenshotThumbnails::find() with query: \n" + query.lastQuery(), false)
+        || !query.next())
+    {
+        return QPixmap();
+    }
+
+    if (thumbnail.loadFromData(query.value(0).toByteArray(), "PNG")) {
+        QPixmapCache::insert(key, thumbnail);
+    }
+    return thumbnail;
+}
+
+
+void ScreenshotThumbnails::insert(int screenshotId, const QPoint &loc, const QSize &size, const QPixmap &thumbnail,
+                                  bool persist)
+{
+    QPixmapCache::insert(cacheKey(screenshotId, loc, size), thumbnail);
+    if (!persist) return;
+
+    // Encoded and saved by the maintenance thread, so that painting never waits on the database write lock.
+    PendingThumbnail pendingThumbnail = { screenshotId, loc, size, thumbnail.toImage() };
+    QMutexLocker pendingLocker(&_pendingLock);
+    _pendingThumbnails.append(pendingThumbnail);
+}
+
+
+int ScreenshotThumbnails::persistPending(QSqlDatabase &db)
+{
+    _pendingLock.lock();
+    QList<PendingThumbnail> pendingThumbnails = _pendingThumbnails;
+    _pendingThumbnails.clear();
+    _pendingLock.unlock();
+    if (pendingThumbnails.isEmpty()) return 0;
+
+    QSqlQuery query(db);
+    if (!query.exec("BEGIN IMMEDIATE;")) {
+        qDebug() << "Screenshot thumbnail save postponed, database is busy";
+        QMutexLocker pendingLocker(&_pendingLock);
+        _pendingThumbnails = pendingThumbnails + _pendingThumbnails;
+        return -1;
+    }
+
+    // Skipped if the screenshot has been swept since (its thumbnails would never be removed), or if another
+    // editor saved the same thumbnail first.
+    query.prepare("INSERT OR IGNORE INTO " + DBUtil::SCREENSHOT_THUMBNAIL_TABLE_NAME + " \n"
+                  "(screenshotId, xLoc, yLoc, thumbnailW, thumbnailH, thumbnail) \n"
+                  "SELECT :screenshotId, :xLoc, :yLoc, :thumbnailW, :thumbnailH, :thumbnail \n"
+                  "WHERE EXISTS (SELECT 1 FROM " + DBUtil::SCREENSHOT_TABLE_NAME + " WHERE screenshotId=:storedScreenshotId);");
+    int persistedCount = 0;
+    foreach (const PendingThumbnail &pendingThumbnail, pendingThumbnails) {
+        QByteArray png;
+        QBuffer pngBuffer(&png);
+        pngBuffer.open(QIODevice::WriteOnly);
+        if (!pendingThumbnail.image.save(&pngBuffer, "PNG")) continue;
+
+        query.bindValue(":screenshotId", pendingThumbnail.screenshotId);
+        query.bindValue(":xLoc", pendingThumbnail.loc.x());
+        query.bindValue(":yLoc", pendingThumbnail.loc.y());
+        query.bindValue(":thumbnailW", pendingThumbnail.size.width());
+        query.bindValue(":thumbnailH", pendingThumbnail.size.height());
+        query.bindValue(":thumbnail", png);
+        query.bindValue(":storedScreenshotId", pendingThumbnail.screenshotId);
+        if (safeExec(query, "Error: INSERT failed in ScreenshotThumbnails::persistPending() with query: \n" + query.lastQuery(), false)) {
+            persistedCount += query.numRowsAffected();
+        }
+    }
+
+    if (!query.exec("COMMIT;")) {
+        QSqlError sqlErr = query.lastError();
+        qDebug() << "Error: COMMIT failed in ScreenshotThumbnails::persistPending()";
+        qDebug() << "SQLite Error: " << sqlErr.text() << "       SQLite Error Code: " << sqlErr.number();
+        query.exec("ROLLBACK;");
+        return -1;
+    }
+    return persistedCount;
+}
+
+
+void ScreenshotThumbnails::shutdown()
+{
+    DBUtil::removeThreadConnection(CONNECTION_TAG);
+}
+
+
+QString ScreenshotThumbnails::cacheKey(int screenshotId, const QPoint &loc, const QSize &size)
+{
+    return QString("thumb_%1_%2_%3_%4x%5").arg(screenshotId).arg(loc.x()).arg(loc.y())
+                                          .arg(size.width()).arg(size.height());
+}
+
+
+bool ScreenshotThumbnails::safeExec(QSqlQuery &query, const QString &errMsg, bool exit)
+{
+    if (!query.exec()) {
+        qDebug().noquote().nospace() << errMsg;
+        QSqlError sqlErr = query.lastError();
+        qDebug() << "SQLite Error: " << sqlErr.text() << "       SQLite Error Code: " << sqlErr.number();
+        if (exit) { ::exit(1); }
+        return false;
+    }
+    return true;
+}
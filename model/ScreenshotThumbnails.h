@@ -0,0 +1,133 @@
+#ifndef SCREENSHOTTHUMBNAILS_H
+#define SCREENSHOTTHUMBNAILS_H
+
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QPixmap>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <QPoint>
+#include <QSize>
+#include <QString>
+
+
+/**
+ * @brief The ScreenshotThumbnails class
+ * Keeps the small thumbnails that the Macro Editor shows for screenshots, so that showing a Macro does not require
+ * decoding its full size screenshots. A thumbnail is keyed by its screenshot ID, the event location that it is
+ * centered on, and its size. Thumbnails of stored screenshots are persisted as PNG in the ScreenshotThumbnails table
+ * by the maintenance thread (see persistPending()), and are removed along with their Screenshots row (by trigger).
+ * Recently used thumbnails are served straight out of QPixmapCache. Apart from initTables() and persistPending(),
+ * must only be used from the GUI thread.
+ */
+class ScreenshotThumbnails
+{
+public:
+
+    /**
+     * @brief CONNECTION_TAG
+     * The tag of the GUI thread database connection that thumbnails are read and written through.
+     */
+    const static QString CONNECTION_TAG;
+
+    /**
+     * @brief initTables
+     * Creates the thumbnail table and its cleanup trigger if they do not exist.
+     * @param db The opened database connection.
+     */
+    static void initTables(QSqlDatabase &db);
+
+    /**
+     * @brief find
+     * Finds a thumbnail in the pixmap cache, or else loads it from the database into the pixmap cache.
+     * @param screenshotId The screenshot ID.
+     * @param loc The event location that the thumbnail is centered on.
+     * @param size The thumbnail size.
+     * @return The thumbnail, or a null pixmap if there is none.
+     */
+    static QPixmap find(int screenshotId, const QPoint &loc, const QSize &size);
+
+    /**
+     * @brief insert
+     * Adds a thumbnail to the pixmap cache, and queues it to be saved to the database if its screenshot is stored.
+     * @param screenshotId The screenshot ID.
+     * @param loc The event location that the thumbnail is centered on.
+     * @param size The thumbnail size.
+     * @param thumbnail The (non-null) thumbnail.
+     * @param persist true if the screenshot is stored and the thumbnail should be saved along with it.
+     */
+    static void insert(int screenshotId, const QPoint &loc, const QSize &size, const QPixmap &thumbnail,
+                       bool persist);
+
+    /**
+     * @brief persistPending
+     * Saves the thumbnails queued by insert() in a single transaction, skipping those whose screenshot no longer
+     * exists. Called from the maintenance thread while the database is idle.
+     * @param db The opened database connection (must not be in a transaction).
+     * @return The number of thumbnails saved, or -1 if the database was busy or the save failed.
+     */
+    static int persistPending(QSqlDatabase &db);
+
+    /**
+     * @brief shutdown
+     * Closes the GUI thread database connection. Must be called from the GUI thread.
+     */
+    static void shutdown();
+
+private:
+
+    /**
+     * @brief The PendingThumbnail struct
+     * A thumbnail waiting to be saved.
+     */
+    typedef struct PendingThumbnail
+    {
+        int screenshotId;
+        QPoint loc;
+        QSize size;
+        QImage image;   // QPixmap may only be used on the GUI thread.
+    } PendingThumbnail;
+
+    /**
+     * @brief _pendingThumbnails
+     * The thumbnails queued by insert() that have not been saved yet.
+     */
+    static QList<PendingThumbnail> _pendingThumbnails;
+
+    /**
+     * @brief _pendingLock
+     * Guards _pendingThumbnails.
+     */
+    static QMutex _pendingLock;
+
+    /**
+     * @brief cacheKey
+     * Generates the pixmap cache key of a thumbnail.
+     * @param screenshotId The screenshot ID.
+     * @param loc The event location that the thumbnail is centered on.
+     * @param size The thumbnail size.
+     * @return The key.
+     */
+    static QString cacheKey(int screenshotId, const QPoint &loc, const QSize &size);
+
+    /**
+     * @brief safeExec
+     * Performs a safe execution of a QSqlite query. A safe execution will check for any error and output
+     * all detected error information.
+     * @param query The query to execute.
+     * @param errMsg A custom error message to display in addition to any sqlite specific error information.
+     * @param exit A flag to be set true if the program should terminate upon an error, false otherwise.
+     * @return A success flag of true if the query executed without error, false otherwise.
+     */
+    static bool safeExec(QSqlQuery &query, const QString &errMsg, bool exit=true);
+
+    // Static utility class; no constructors, no copies!
+    ScreenshotThumbnails();
+    ScreenshotThumbnails(const ScreenshotThumbnails &copyFrom){}
+    ScreenshotThumbnails& operator=(const ScreenshotThumbnails &rhs){}
+};
+
+
+#endif // SCREENSHOTTHUMBNAILS_H
@@ -0,0 +1,92 @@
+#include "SqlIdSet.h"
+#include <QVariantList>
+#include <QStringList>
+#include <QDebug>
+#include <QSqlError>
+
+
+const int SqlIdSet::MAX_BOUND_IDS = 64;
+
+
+SqlIdSet::SqlIdSet(const QString &column, const QList<int> &ids) :
+    _column(column),
+    _name(QString(column).replace('.', '_')),
+    _ids(ids)
+{}
+
+
+bool SqlIdSet::prepare(QSqlDatabase &db) const
+{
+    if (!usesTempTable()) return true;
+
+    // Temp tables only live as long as the connection, so (re)create on demand and clear out any previous set.
+    QSqlQuery query(db);
+    bool success = query.exec("CREATE TEMP TABLE IF NOT EXISTS " + tempTableName() + " (id INTEGER PRIMARY KEY);")
+                && query.exec("DELETE FROM temp." + tempTableName() + ";");
+
+    if (success) {
+        QVariantList ids;
+        foreach (int id, _ids) {
+            ids.append(id);
+        }
+        query.prepare("INSERT OR IGNORE INTO temp." + tempTableName() + " (id) VALUES (?);");
+        query.addBindValue(ids);
+        success = query.execBatch();
+    }
+
+    if (!success) {
+        QSqlError sqlErr = query.lastError();
+        qDebug() << "Error: Failed to load ID set temp table " << tempTableName() << " with query: " << query.lastQuery();
+        qDebug() << "SQLite Error: " << sqlErr.text() << "       SQLite Error Code: " << sqlErr.number();
+    }
+    return success;
+}
+
+
+QString SqlIdSet::inClause() const
+{
+    if (usesTempTable()) {
+        return _column + " IN (SELECT id FROM temp." + tempTableName() + ")";
+    }
+
+    QStringList placeholders;
+    for (int i = 0; i < _ids.size(); i++) {
+        placeholders.append(":" + _name + QString::number(i));
+    }
+    // SQLite accepts an empty IN list (matches nothing).
+    return _column + " IN (" + placeholders.join(", ") + ")";
+}
+
+
+void SqlIdSet::bindValues(QSqlQuery &query) const
+{
+    if (usesTempTable()) return;
+
+    for (int i = 0; i < _ids.size(); i++) {
+        query.bindValue(":" + _name + QString::number(i), _ids.at(i));
+    }
+}
+
+
+const QList<int>& SqlIdSet::getIds() const
+{
+    return _ids;
+}
+
+
+bool SqlIdSet::isEmpty() const
+{
+    return _ids.isEmpty();
+}
+
+
+bool SqlIdSet::usesTempTable() const
+{
+    return (_ids.size() > MAX_BOUND_IDS);
+}
+
+
+QString SqlIdSet::tempTableName() const
+{
+    return "IdSet_" + _name;
+}
@@ -0,0 +1,110 @@
+#ifndef SQLIDSET_H
+#define SQLIDSET_H
+
+
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QString>
+#include <QList>
+
+
+/**
+ * @brief The SqlIdSet class
+ * A set of integer IDs that a query filters a column on. Small sets become a bound IN list, and large sets are
+ * loaded into a temporary table that the IN clause selects from, so a statement never grows with the set size
+ * and SQLite can always look each ID up through an index instead of evaluating an OR chain row by row.
+ *
+ * Usage: prepare() the set on the connection, prepare the query containing inClause(), then bindValues().
+ */
+class SqlIdSet
+{
+public:
+
+    /**
+     * @brief MAX_BOUND_IDS
+     * The largest set that is bound directly as an IN list. Larger sets go through a temporary table.
+     */
+    const static int MAX_BOUND_IDS;
+
+    /**
+     * @brief SqlIdSet
+     * Constructor.
+     * @param column The (optionally table qualified) column to filter on. Also names the placeholders and temp table.
+     * @param ids The IDs in the set.
+     */
+    explicit SqlIdSet(const QString &column, const QList<int> &ids);
+
+    /**
+     * @brief prepare
+     * Loads the IDs into the set's temporary table if the set is too large to bind (otherwise does nothing).
+     * Must be called before preparing a query that contains inClause(), since the table must exist by then.
+     * @param db The opened database connection that the query will run on.
+     * @return A success flag of true if the operation is successful, false otherwise.
+     */
+    bool prepare(QSqlDatabase &db) const;
+
+    /**
+     * @brief inClause
+     * Gets the filter clause for the set.
+     * @return The filter clause in format "<column> IN (:<name>0, ..., :<name>N)" or "<column> IN (SELECT id FROM temp.<table>)".
+     */
+    QString inClause() const;
+
+    /**
+     * @brief bindValues
+     * Binds the IDs to the placeholders of inClause() (nothing to bind if the set went through a temporary table).
+     * @param query The prepared query containing inClause().
+     */
+    void bindValues(QSqlQuery &query) const;
+
+    /**
+     * @brief getIds
+     * Gets the IDs in the set.
+     * @return The IDs.
+     */
+    const QList<int>& getIds() const;
+
+    /**
+     * @brief isEmpty
+     * Checks if the set is empty.
+     * @return true if there are no IDs in the set, false otherwise.
+     */
+    bool isEmpty() const;
+
+private:
+
+    /**
+     * @brief _column
+     * The column that is filtered on.
+     */
+    QString _column;
+
+    /**
+     * @brief _name
+     * Identifier derived from the column that prefixes the placeholders and names the temporary table.
+     */
+    QString _name;
+
+    /**
+     * @brief _ids
+     * The IDs in the set.
+     */
+    QList<int> _ids;
+
+    /**
+     * @brief usesTempTable
+     * Checks if the set is too large to bind as an IN list.
+     * @return true if the set goes through a temporary table, false otherwise.
+     */
+    bool usesTempTable() const;
+
+    /**
+     * @brief tempTableName
+     * Gets the name of the set's temporary table.
+     * @return The temporary table name.
+     */
+    QString tempTableName() const;
+};
+
+
+#endif // SQLIDSET_H
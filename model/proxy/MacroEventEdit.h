@@ -19,6 +19,7 @@ enum MacroEventEditType
 {
     ADD,             // COPY falls under ADD event.
     DELETE,
+    MOVE,
     UPDATE_DELAY,
     UPDATE_DURATION,
     UPDATE_KEY_STRING,
@@ -48,6 +49,19 @@ struct MacroEventEdit
     QList<MacroEvent> addOrDeleteEvents;
 
 
+    /**
+     * @brief moveEventInds
+     * The (pre-move) indexes of the events moved by a MOVE edit type.
+     */
+    QList<int> moveEventInds;
+
+    /**
+     * @brief moveDestInd
+     * The index of the first moved event after a MOVE edit type (once the moved events were taken out of the list).
+     */
+    int moveDestInd;
+
+
     /**
      * @brief eventInd
      * The index of an event that an update edit type enacted on.
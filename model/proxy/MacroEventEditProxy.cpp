@@ -2,17 +2,19 @@
 #include <QDebug>
 
 
-MacroEventEditProxy::MacroEventEditProxy(MacroEventModel &macroEventModel)
-    : _macroEventModel(macroEventModel),
+MacroEventEditProxy::MacroEventEditProxy(MacroEventModel &macroEventModel, DBService &dbService, QObject *parent)
+    : QObject(parent),
+      _macroEventModel(macroEventModel),
+      _dbService(dbService),
       _macroEvents(),
       _changeLog()
 {}
 
 
-void MacroEventEditProxy::setEditMacros(const QList<int> &editMacroIds)
+void MacroEventEditProxy::setEditMacros(const QList<int> &editMacroIds, const QList<MacroEvent> &uniformEvents)
 {
     _macroEventModel.setActiveMacros(editMacroIds);
-    _macroEvents = _macroEventModel.getUniformEvents();
+    _macroEvents = uniformEvents;
     // Fill in gaps in the uniform events with dummy events. Could optimize this by using pointers and assigning null...
     for (int i = 0; i < _macroEvents.size() - 1; i++) {
         if (_macroEvents.at(i).index + 1 != _macroEvents.at(i + 1).index) {
@@ -33,7 +35,12 @@ QList<int> MacroEventEditProxy::getActiveMacroIds() const
 
 QList<MacroEvent> MacroEventEditProxy::getLatestMacroEvents() const
 {
-    return _macroEvents;
+    // Indexes are derived from list positions here so edits never have to renumber the list.
+    QList<MacroEvent> macroEvents = _macroEvents;
+    for (int i = 0; i < macroEvents.size(); i++) {
+        macroEvents[i].index = i;
+    }
+    return macroEvents;
 }
 
 
@@ -42,19 +49,24 @@ void MacroEventEditProxy::insertMacroEvents(const QList<MacroEvent> &macroEvents
     // Break out if we have no events to insert!
     if (macroEvents.size() == 0) return;
 
+    QList<MacroEvent> addedMacroEvents;
     int listInsertIndex = macroEvents.first().index;
-    incMacroEventIndexes(listInsertIndex, macroEvents.size());
+    if (listInsertIndex < 0 || listInsertIndex > _macroEvents.size()) {
+        listInsertIndex = _macroEvents.size();
+    }
 
-    // Insert the Macros.
-    foreach (const MacroEvent &macroEvent, macroEvents) {
+    // Place the Macros one after another.
+    foreach (MacroEvent macroEvent, macroEvents) {
         qDebug() << "Inserting macro event at index: " << listInsertIndex;
-        _macroEvents.insert(listInsertIndex++, macroEvent);
+        macroEvent.index = listInsertIndex++;
+        addedMacroEvents.append(macroEvent);
     }
 
-    // Update change log.
+    // Apply and update change log.
     MacroEventEdit changeLogEntry;
     changeLogEntry.editType = MacroEventEditType::ADD;
-    changeLogEntry.addOrDeleteEvents = macroEvents;
+    changeLogEntry.addOrDeleteEvents = addedMacroEvents;
+    applyEdit(changeLogEntry, false);
     _changeLog.addChange(changeLogEntry);
 }
 
@@ -62,34 +74,23 @@ void MacroEventEditProxy::insertMacroEvents(const QList<MacroEvent> &macroEvents
 void MacroEventEditProxy::copyMacroEvents(QList<int> &macroEventIndexes)
 {
     QList<MacroEvent> addedMacroEvents;
-    int copyEventInd,
-        listInsertInd = (_macroEvents.size() - 1),
-        lastListInsertInd = _macroEvents.size();
 
-    // Sort the Macro Event indexes so we can copy from largest to smallest.
+    // Sort the Macro Event indexes so we can copy from smallest to largest.
     std::sort(macroEventIndexes.begin(), macroEventIndexes.end());
 
-    for (int i = (macroEventIndexes.size() - 1); i >= 0; i--) {
-        copyEventInd = macroEventIndexes.at(i);
-        // Search through list backwards until we find Macro Event with correct Macro Event index.
-        while (_macroEvents.at(listInsertInd).index > copyEventInd) {
-            listInsertInd--;
-        }
-        // Increment Macro Event indexes of all events within range from our target copy event
-        // up to before the last target copy event (or end of list if this is first target copy event).
-        // Do this by the magnitude of the index we are on in our macroEventIndexes list iteration so we do not have to
-        // keep moving all indexes forward by one after each copy!
-        addedMacroEvents.append(_macroEvents.at(listInsertInd));
-        incMacroEventIndexes(listInsertInd, (i + 1), lastListInsertInd);
-        _macroEvents.insert(listInsertInd, _macroEvents.at(listInsertInd));
-        _macroEvents[listInsertInd].index--; // Decrement our copied Macro Event index since it was inserted before source of copy.
-        lastListInsertInd = listInsertInd;
+    for (int i = 0; i < macroEventIndexes.size(); i++) {
+        // Each copy goes immediately before its source, and each copy placed before it pushes it forward by one,
+        // so the copy's index is its final index.
+        MacroEvent copiedMacroEvent = _macroEvents.at(macroEventIndexes.at(i));
+        copiedMacroEvent.index = macroEventIndexes.at(i) + i;
+        addedMacroEvents.append(copiedMacroEvent);
     }
 
-    // Update change log.
+    // Apply and update change log.
     MacroEventEdit changeLogEntry;
     changeLogEntry.editType = MacroEventEditType::ADD;
     changeLogEntry.addOrDeleteEvents = addedMacroEvents;
+    applyEdit(changeLogEntry, false);
     _changeLog.addChange(changeLogEntry);
 }
 
@@ -97,93 +98,88 @@ void MacroEventEditProxy::copyMacroEvents(QList<int> &macroEventIndexes)
 void MacroEventEditProxy::deleteMacroEvents(QList<int> &macroEventIndexes)
 {
     QList<MacroEvent> deletedMacroEvents;
-    int delEventInd,
-        listDelInd = (_macroEvents.size() - 1),
-        lastListDelInd = _macroEvents.size();
 
-    // Sort the Macro Event indexes so we can delete from largest to smallest.
+    // Sort the Macro Event indexes so the deleted events are logged from smallest to largest.
     std::sort(macroEventIndexes.begin(), macroEventIndexes.end());
 
-    for (int i = (macroEventIndexes.size() - 1); i >= 0; i--) {
-        delEventInd = macroEventIndexes.at(i);
-        // Search through list backwards until we find Macro Event with correct Macro Event index.
-        while (_macroEvents.at(listDelInd).index > delEventInd) {
-            listDelInd--;
-        }
-        // Decrement Macro Event indexes of all events within range from our target delete event
-        // up to before the last target delete event (or end of list if this is first target delete event).
-        // Do this by the magnitude of the index we are on in our macroEventIndexes list iteration so we do not have to
-        // keep moving all indexes backwards by one after each delete!
-        incMacroEventIndexes((listDelInd + 1), -(i + 1), lastListDelInd);
-        deletedMacroEvents.append(_macroEvents.at(listDelInd));
-        _macroEvents.removeAt(listDelInd);
-        lastListDelInd = listDelInd--; // Make sure we decrement listDelInd or else we will have error!
+    foreach (int listDelInd, macroEventIndexes) {
+        MacroEvent deletedMacroEvent = _macroEvents.at(listDelInd);
+        deletedMacroEvent.index = listDelInd; // Index before the delete!
+        deletedMacroEvents.append(deletedMacroEvent);
     }
 
-    // Update change log.
+    // Apply and update change log.
     MacroEventEdit changeLogEntry;
     changeLogEntry.editType = MacroEventEditType::DELETE;
     changeLogEntry.addOrDeleteEvents = deletedMacroEvents;
+    applyEdit(changeLogEntry, false);
     _changeLog.addChange(changeLogEntry);
 }
 
 
-void MacroEventEditProxy::updateMacroEventDelay(int macroEventIndex, int delay)
+void MacroEventEditProxy::moveMacroEvents(QList<int> &macroEventIndexes, int destIndex)
 {
-    int oldDelay = _macroEvents.at(macroEventIndex).delayMs;
-    _macroEvents[macroEventIndex].delayMs = delay;
+    // Sort the Macro Event indexes so they keep their original relative order.
+    std::sort(macroEventIndexes.begin(), macroEventIndexes.end());
+
+    // Apply and update change log.
+    MacroEventEdit changeLogEntry;
+    changeLogEntry.editType = MacroEventEditType::MOVE;
+    changeLogEntry.moveEventInds = macroEventIndexes;
+    changeLogEntry.moveDestInd = destIndex;
+    applyEdit(changeLogEntry, false);
+    _changeLog.addChange(changeLogEntry);
+}
 
-    // Update change log.
+
+void MacroEventEditProxy::updateMacroEventDelay(int macroEventIndex, int delay)
+{
+    // Apply and update change log.
     MacroEventEdit changeLogEntry;
     changeLogEntry.editType = MacroEventEditType::UPDATE_DELAY;
     changeLogEntry.eventInd = macroEventIndex;
-    changeLogEntry.oldDelay = oldDelay;
+    changeLogEntry.oldDelay = _macroEvents.at(macroEventIndex).delayMs;
     changeLogEntry.newDelay = delay;
+    applyEdit(changeLogEntry, false);
     _changeLog.addChange(changeLogEntry);
 }
 
 
 void MacroEventEditProxy::updateMacroEventDuration(int macroEventIndex, int duration)
 {
-    int oldDuration = _macroEvents.at(macroEventIndex).durationMs;
-    _macroEvents[macroEventIndex].durationMs = duration;
-
-    // Update change log.
+    // Apply and update change log.
     MacroEventEdit changeLogEntry;
     changeLogEntry.editType = MacroEventEditType::UPDATE_DURATION;
     changeLogEntry.eventInd = macroEventIndex;
-    changeLogEntry.oldDuration = oldDuration;
+    changeLogEntry.oldDuration = _macroEvents.at(macroEventIndex).durationMs;
     changeLogEntry.newDuration = duration;
+    applyEdit(changeLogEntry, false);
     _changeLog.addChange(changeLogEntry);
 }
 
 
 void MacroEventEditProxy::updateMacroEventAutoCorrect(int macroEventIndex, bool autoCorrect)
 {
-    bool oldAutoCorrect = _macroEvents.at(macroEventIndex).mouseEvent.autoCorrect;
-    _macroEvents[macroEventIndex].mouseEvent.autoCorrect = autoCorrect;
-
-    // Update change log.
+    // Apply and update change log.
     MacroEventEdit changeLogEntry;
     changeLogEntry.editType = MacroEventEditType::UPDATE_AUTO_CORRECT;
     changeLogEntry.eventInd = macroEventIndex;
-    changeLogEntry.oldAutoCorrect = oldAutoCorrect;
+    changeLogEntry.oldAutoCorrect = _macroEvents.at(macroEventIndex).mouseEvent.autoCorrect;
     changeLogEntry.newAutoCorrect = autoCorrect;
+    applyEdit(changeLogEntry, false);
     _changeLog.addChange(changeLogEntry);
 }
 
 
 void MacroEventEditProxy::updateMacroEventKeyString(int macroEventIndex, const QString &keyString)
 {
-    const QString &oldKeyString = _macroEvents.at(macroEventIndex).keyboardEvent.keyString;
-    _macroEvents[macroEventIndex].keyboardEvent.keyString = keyString;
-
-    // Update change log.
+    // Apply and update change log.
     MacroEventEdit changeLogEntry;
     changeLogEntry.editType = MacroEventEditType::UPDATE_KEY_STRING;
     changeLogEntry.eventInd = macroEventIndex;
-    changeLogEntry.oldKeyString = oldKeyString;
+    changeLogEntry.oldKeyString = _macroEvents.at(macroEventIndex).keyboardEvent.keyString;
     changeLogEntry.newKeyString = keyString;
+    applyEdit(changeLogEntry, false);
     _changeLog.addChange(changeLogEntry);
 }
 
@@ -194,57 +190,84 @@ bool MacroEventEditProxy::hasUnsavedChanges()
 }
 
 
-void MacroEventEditProxy::saveEvents()
+int MacroEventEditProxy::saveEvents()
 {
-    // Begin large all or nothing transaction when saving all events (also makes much more efficient).
-    _macroEventModel.safeOpenAndBegin("Could not open DB conneciton and begin transaction in saveEvents()");
-
-    // Go through all changes in the change log and commit to underlying model.
-    QList<MacroEventEdit> changes = _changeLog.getSaveChanges();
-    for (int i = 0; i < changes.size(); i++) {
-        MacroEventEdit &change = changes[i];
-
-        switch (change.editType) {
-        case ADD:
-            _macroEventModel.addEvents(change.addOrDeleteEvents);
-            break;
-        case DELETE:
-        {
+    // The changes are committed on the DB service's thread, along with a snapshot of the Macro Events so that
+    // edits made while the save is queued do not leak into it.
+    DBService::Request request = DBService::newRequest(DBService::SaveEvents);
+    request.macroIds = _macroEventModel.getActiveMacroIds();
+    request.edits = _changeLog.getSaveChanges(request.revertEdits);
+    request.macroEvents = _macroEvents;
+    return _dbService.enqueue(request);
+}
+
+
+void MacroEventEditProxy::commitEdit(MacroEventModel &macroEventModel, const QList<MacroEventEdit> &edits, int editInd,
+                                     int revertCount, const QList<MacroEvent> &macroEvents)
+{
+    MacroEventEdit change = edits.at(editInd);
+    bool undo = (editInd < revertCount);
+
+    switch (change.editType) {
+    case ADD:
+    case DELETE:
+        // Reverting an add is a delete of the same events and vice versa.
+        if ((change.editType == ADD) != undo) {
+            macroEventModel.addEvents(change.addOrDeleteEvents);
+        }
+        else {
             QList<int> macroEventInds = getMacroEventIndexesFromMacroEvents(change.addOrDeleteEvents);
-            _macroEventModel.removeEvents(macroEventInds);
-            break;
+            macroEventModel.removeEvents(macroEventInds);
         }
-        case UPDATE_DELAY:
-        case UPDATE_DURATION:
-        case UPDATE_KEY_STRING:
-        case UPDATE_AUTO_CORRECT:
-        {
-            // For all Macro Event updates, just update entire event!
-            _macroEventModel.setEvent(_macroEvents.at(change.eventInd));
-            break;
+        break;
+    case MOVE:
+        if (undo) {
+            revertMove(macroEventModel, change);
         }
-        case UPDATE_IMAGE:
-            // TODO.
-            break;
-        default:
-            throw std::runtime_error("Error: invalid Change Log Edit Type in MacroEventEditProxy::saveEvents()");
+        else {
+            macroEventModel.moveEvents(change.moveEventInds, change.moveDestInd);
         }
-    }
+        break;
+    case UPDATE_DELAY:
+    case UPDATE_DURATION:
+    case UPDATE_KEY_STRING:
+    case UPDATE_AUTO_CORRECT:
+    {
+        // For all Macro Event updates, just update entire event! The latest Macro Events hold the result of every
+        // update, so the event is taken from where the rest of the edits leave it (unless they remove it).
+        int latestInd = change.eventInd;
+        for (int i = editInd + 1; i < edits.size() && latestInd >= 0; i++) {
+            latestInd = mapEventIndex(latestInd, edits.at(i), i < revertCount);
+        }
+        if (latestInd < 0 || latestInd >= macroEvents.size()) break;
 
-    // Commit all of our save changes now!
-    _macroEventModel.safeCommitAndClose("Could not commit transaction and close DB connection in saveEvents()");
+        MacroEvent updatedMacroEvent = macroEvents.at(latestInd);
+        updatedMacroEvent.index = change.eventInd;
+        macroEventModel.setEvent(updatedMacroEvent);
+        break;
+    }
+    case UPDATE_IMAGE:
+        // Nothing to commit; the Macro Editor has no way to replace a screenshot, so it never logs this edit.
+        break;
+    default:
+        throw std::runtime_error("Error: invalid Change Log Edit Type in MacroEventEditProxy::commitEdit()");
+    }
 }
 
 
 void MacroEventEditProxy::undoChange()
 {
-    _changeLog.undoChange();
+    if (_changeLog.hasUndoChange()) {
+        applyEdit(_changeLog.undoChange(), true);
+    }
 }
 
 
 void MacroEventEditProxy::redoChange()
 {
-    _changeLog.redoChange();
+    if (_changeLog.hasRedoChange()) {
+        applyEdit(_changeLog.redoChange(), false);
+    }
 }
 
 
@@ -254,7 +277,7 @@ void MacroEventEditProxy::refresh()
 }
 
 
-QList<int> MacroEventEditProxy::getMacroEventIndexesFromMacroEvents(const QList<MacroEvent> &events) const
+QList<int> MacroEventEditProxy::getMacroEventIndexesFromMacroEvents(const QList<MacroEvent> &events)
 {
     QList<int> eventInds;
     foreach (const MacroEvent &event, events) {
@@ -264,15 +287,188 @@ QList<int> MacroEventEditProxy::getMacroEventIndexesFromMacroEvents(const QList<
 }
 
 
-void MacroEventEditProxy::incMacroEventIndexes(int beginListIndex, int incAmt, int endListIndex)
+int MacroEventEditProxy::mapEventIndex(int eventInd, const MacroEventEdit &edit, bool undo)
+{
+    switch (edit.editType) {
+    case ADD:
+    case DELETE:
+    {
+        QList<int> eventInds = getMacroEventIndexesFromMacroEvents(edit.addOrDeleteEvents);
+        // Added indexes are the positions after the add, in ascending order.
+        if ((edit.editType == ADD) != undo) {
+            foreach (int addedInd, eventInds) {
+                if (addedInd <= eventInd) eventInd++;
+            }
+            return eventInd;
+        }
+        // Removed indexes are the positions before the remove.
+        if (eventInds.contains(eventInd)) return -1;
+        int removedBeforeCount = 0;
+        foreach (int removedInd, eventInds) {
+            if (removedInd < eventInd) removedBeforeCount++;
+        }
+        return eventInd - removedBeforeCount;
+    }
+    case MOVE:
+    {
+        int moveCount = edit.moveEventInds.size();
+        if (!undo) {
+            int movedInd = edit.moveEventInds.indexOf(eventInd);
+            if (movedInd >= 0) return edit.moveDestInd + movedInd;
+            int movedBeforeCount = 0;
+            foreach (int fromInd, edit.moveEventInds) {
+                if (fromInd < eventInd) movedBeforeCount++;
+            }
+            eventInd -= movedBeforeCount;
+            return (eventInd >= edit.moveDestInd) ? (eventInd + moveCount) : eventInd;
+        }
+        // Reversed, the moved events go from their destination back to where they were.
+        if (eventInd >= edit.moveDestInd && eventInd < edit.moveDestInd + moveCount) {
+            return edit.moveEventInds.at(eventInd - edit.moveDestInd);
+        }
+        if (eventInd >= edit.moveDestInd + moveCount) eventInd -= moveCount;
+        foreach (int fromInd, edit.moveEventInds) {
+            if (fromInd <= eventInd) eventInd++;
+        }
+        return eventInd;
+    }
+    default:
+        return eventInd;
+    }
+}
+
+
+void MacroEventEditProxy::revertMove(MacroEventModel &macroEventModel, const MacroEventEdit &edit)
+{
+    int moveCount = edit.moveEventInds.size();
+    if (moveCount == 0) return;
+
+    // The original index of the event at each position of the range touched by the move, as it is after the move.
+    int firstInd = qMin(edit.moveEventInds.first(), edit.moveDestInd);
+    int lastInd = qMax(edit.moveEventInds.last(), edit.moveDestInd + moveCount - 1);
+    QList<int> origInds;
+    for (int i = firstInd; i <= lastInd; i++) {
+        origInds.append(i);
+    }
+    for (int i = moveCount - 1; i >= 0; i--) {
+        origInds.removeAt(edit.moveEventInds.at(i) - firstInd);
+    }
+    for (int i = 0; i < moveCount; i++) {
+        origInds.insert(edit.moveDestInd - firstInd + i, edit.moveEventInds.at(i));
+    }
+
+    // The model moves events as one block, which cannot put them back where they were in general, so the range is
+    // restored one event at a time, front to back.
+    for (int i = 0; i < origInds.size(); i++) {
+        if (origInds.at(i) == firstInd + i) continue;
+        int fromInd = origInds.indexOf(firstInd + i, i);
+        origInds.move(fromInd, i);
+        QList<int> moveEventInds;
+        moveEventInds.append(firstInd + fromInd);
+        macroEventModel.moveEvents(moveEventInds, firstInd + i);
+    }
+}
+
+
+void MacroEventEditProxy::applyEdit(const MacroEventEdit &edit, bool undo)
+{
+    switch (edit.editType) {
+    case ADD:
+    case DELETE:
+        // Undoing an add is a delete of the same events and vice versa. Logged indexes are the inserted positions.
+        if ((edit.editType == ADD) != undo) {
+            insertEvents(edit.addOrDeleteEvents);
+        }
+        else {
+            removeEvents(getMacroEventIndexesFromMacroEvents(edit.addOrDeleteEvents));
+        }
+        break;
+    case MOVE:
+        applyMove(edit, undo);
+        break;
+    case UPDATE_DELAY:
+        _macroEvents[edit.eventInd].delayMs = (undo ? edit.oldDelay : edit.newDelay);
+        emitEventUpdated(edit.eventInd);
+        break;
+    case UPDATE_DURATION:
+        _macroEvents[edit.eventInd].durationMs = (undo ? edit.oldDuration : edit.newDuration);
+        emitEventUpdated(edit.eventInd);
+        break;
+    case UPDATE_KEY_STRING:
+        _macroEvents[edit.eventInd].keyboardEvent.keyString = (undo ? edit.oldKeyString : edit.newKeyString);
+        emitEventUpdated(edit.eventInd);
+        break;
+    case UPDATE_AUTO_CORRECT:
+        _macroEvents[edit.eventInd].mouseEvent.autoCorrect = (undo ? edit.oldAutoCorrect : edit.newAutoCorrect);
+        emitEventUpdated(edit.eventInd);
+        break;
+    case UPDATE_IMAGE:
+        // Nothing to apply; the Macro Editor has no way to replace a screenshot, so it never logs this edit.
+        break;
+    default:
+        throw std::runtime_error("Error: invalid Change Log Edit Type in MacroEventEditProxy::applyEdit()");
+    }
+}
+
+
+void MacroEventEditProxy::applyMove(const MacroEventEdit &edit, bool undo)
+{
+    int moveCount = edit.moveEventInds.size();
+    // The moved events end up together, at the destination as seen once they were taken out.
+    int destInd = qBound(0, edit.moveDestInd, _macroEvents.size() - moveCount);
+    QList<int> takeInds;
+    QList<MacroEvent> movedEvents;
+
+    for (int i = 0; i < moveCount; i++) {
+        int fromInd = undo ? (destInd + i) : edit.moveEventInds.at(i);
+        int toInd = undo ? edit.moveEventInds.at(i) : (destInd + i);
+        MacroEvent movedEvent = _macroEvents.at(fromInd);
+        movedEvent.index = toInd;
+        takeInds.append(fromInd);
+        movedEvents.append(movedEvent);
+    }
+
+    removeEvents(takeInds);
+    insertEvents(movedEvents);
+}
+
+
+void MacroEventEditProxy::insertEvents(const QList<MacroEvent> &events)
 {
-    // Set the end list index (to stop incrementing at).
-    if (endListIndex == -1 || endListIndex > _macroEvents.size()) {
-        endListIndex = _macroEvents.size();
+    int runStart = 0;
+    for (int i = 0; i < events.size(); i++) {
+        _macroEvents.insert(events.at(i).index, events.at(i));
+
+        // Emit once the end of a contiguous run of indexes is reached.
+        bool runEnds = (i == events.size() - 1) || (events.at(i + 1).index != events.at(i).index + 1);
+        if (runEnds) {
+            emit eventsInserted(events.at(runStart).index, events.mid(runStart, i - runStart + 1));
+            runStart = i + 1;
+        }
     }
+}
+
 
-    // Move all Macro Event indexes that are greater than the given beginListIndex and  by incAmt.
-    for (int i = beginListIndex; i < endListIndex; i++) {
-        _macroEvents[i].index += incAmt;
+void MacroEventEditProxy::removeEvents(const QList<int> &eventInds)
+{
+    // Remove from largest to smallest (keeps smaller indexes valid).
+    int runEnd = eventInds.size() - 1;
+    for (int i = (eventInds.size() - 1); i >= 0; i--) {
+        _macroEvents.removeAt(eventInds.at(i));
+
+        // Emit once the start of a contiguous run of indexes is reached.
+        bool runStarts = (i == 0) || (eventInds.at(i - 1) != eventInds.at(i) - 1);
+        if (runStarts) {
+            emit eventsRemoved(eventInds.at(i), runEnd - i + 1);
+            runEnd = i - 1;
+        }
     }
 }
+
+
+void MacroEventEditProxy::emitEventUpdated(int eventInd)
+{
+    MacroEvent updatedEvent = _macroEvents.at(eventInd);
+    updatedEvent.index = eventInd;
+    emit eventsUpdated(eventInd, QList<MacroEvent>() << updatedEvent);
+}
@@ -4,18 +4,24 @@
 
 #include "model/MacroEvent.h"
 #include "model/MacroEventModel.h"
+#include "model/DBService.h"
 #include "MacroEventEdit.h"
 #include "util/ChangeLog.hpp"
+#include <QObject>
 #include <QList>
 
 
 /**
  * @brief The MacroEventEditProxy class
  * Proxy for model involved in Macro Event Edit. Caches Macro Events being edited in memory.
- * Caches undo and redo events for the editor. Responsible for comitting saves/writes to underlying model.
+ * Caches undo and redo events for the editor. Responsible for comitting saves/writes to underlying model, which
+ * happens on the DB service's thread.
+ * Every edit, undo and redo is applied from its change log entry, which also reports the rows that it inserted,
+ * removed or updated, so a view only has to apply those rows.
  */
-class MacroEventEditProxy
+class MacroEventEditProxy : public QObject
 {
+    Q_OBJECT
 
 private:
 
@@ -25,6 +31,12 @@ private:
      */
     MacroEventModel &_macroEventModel;
 
+    /**
+     * @brief _dbService
+     * Service that commits saves off of the GUI thread.
+     */
+    DBService &_dbService;
+
     /**
      * @brief _uniformEventInds
      * The indexes of the uniform events i
@@ -35,6 +47,7 @@ private:
      * @brief _macroEvents
      * List of Macro Events being edited. Will hold all the latest effective edits.
      * Will be committed to the underlying database upon a save request from the user.
+     * An event's index is its position in this list; the stored index members are not kept up to date.
      */
     QList<MacroEvent> _macroEvents;
 
@@ -48,15 +61,17 @@ private:
 
 public:
 
-    explicit MacroEventEditProxy(MacroEventModel &macroEventModel);
+    explicit MacroEventEditProxy(MacroEventModel &macroEventModel, DBService &dbService, QObject *parent = nullptr);
 
     /**
      * @brief setEditMacros
      * Sets the Macros to be edited.
      * @param editMacroIds
      * The IDs of the Macros to be edited.
+     * @param uniformEvents
+     * The uniform events of the Macros, as loaded through the DB service (see MacroEventModel::getUniformEvents()).
      */
-    void setEditMacros(const QList<int> &editMacroIds);
+    void setEditMacros(const QList<int> &editMacroIds, const QList<MacroEvent> &uniformEvents);
 
 
     /**
@@ -105,6 +120,17 @@ public:
     void deleteMacroEvents(QList<int> &macroEventIndexes);
 
 
+    /**
+     * @brief moveMacroEvents
+     * Moves Macro Events with the given Macro Event indexes (e.g. a drag and drop reorder).
+     * @param macroEventIndexes
+     * The indexes of the Macro Events to move. This list will be sorted internally.
+     * @param destIndex
+     * The index of the first moved Macro Event once the moved events have been taken out of their old positions.
+     */
+    void moveMacroEvents(QList<int> &macroEventIndexes, int destIndex);
+
+
     /**
      * @brief updateMacroEventDelay
      * Updates the delay for a Macro Event.
@@ -160,21 +186,43 @@ public:
 
     /**
      * @brief saveEvents
-     * Commits the Macro Events to the underlying model with all of their updates up to the current change.
+     * Queues the Macro Events to be committed to the underlying model with all of their updates up to the current
+     * change. The DB service reports the progress and completion of the save.
+     * @return
+     * The DB service request ID of the save.
+     */
+    int saveEvents();
+
+
+    /**
+     * @brief commitEdit
+     * Commits (or reverts) a single change log entry of a save to a Macro Event model. Meant to be called for each
+     * entry in order, within a transaction that is opened on the model for the whole save.
+     * @param macroEventModel
+     * The Macro Event model, with the Macros being edited set active.
+     * @param edits
+     * All change log entries of the save: the ones to revert (see ChangeLog::getSaveChanges()), then the ones to commit.
+     * @param editInd
+     * The index of the entry to commit in edits.
+     * @param revertCount
+     * The number of entries at the front of edits that are reverted instead of committed.
+     * @param macroEvents
+     * The latest Macro Events being edited, which updated events are written from.
      */
-    void saveEvents();
+    static void commitEdit(MacroEventModel &macroEventModel, const QList<MacroEventEdit> &edits, int editInd,
+                           int revertCount, const QList<MacroEvent> &macroEvents);
 
 
     /**
      * @brief undoChange
-     * Performs an undo, reversing the latest Macro Event edit.
+     * Performs an undo, reversing the latest Macro Event edit. Does nothing if there is no edit to undo.
      */
     void undoChange();
 
 
     /**
      * @brief redoChange
-     * Performs a redo, re-instating the latest undone Macro Event.
+     * Performs a redo, re-instating the latest undone Macro Event. Does nothing if there is no edit to redo.
      */
     void redoChange();
 
@@ -187,8 +235,109 @@ public:
     void refresh();
 
 
+signals:
+
+    /**
+     * @brief eventsInserted
+     * Emitted whenever a contiguous range of Macro Events is inserted.
+     * @param firstIndex
+     * The index of the first inserted event.
+     * @param macroEvents
+     * The inserted events, with their indexes set.
+     */
+    void eventsInserted(int firstIndex, const QList<MacroEvent> &macroEvents);
+
+    /**
+     * @brief eventsRemoved
+     * Emitted whenever a contiguous range of Macro Events is removed.
+     * @param firstIndex
+     * The index of the first removed event.
+     * @param count
+     * The number of removed events.
+     */
+    void eventsRemoved(int firstIndex, int count);
+
+    /**
+     * @brief eventsUpdated
+     * Emitted whenever a contiguous range of Macro Events is updated in place.
+     * @param firstIndex
+     * The index of the first updated event.
+     * @param macroEvents
+     * The updated events, with their indexes set.
+     */
+    void eventsUpdated(int firstIndex, const QList<MacroEvent> &macroEvents);
+
+
 private:
 
+    /**
+     * @brief mapEventIndex
+     * Follows an event index through a change log entry.
+     * @param eventInd
+     * The index of the event before the entry is applied (or reversed).
+     * @param edit
+     * The change log entry.
+     * @param undo
+     * True if the entry is reversed, false if it is applied.
+     * @return
+     * The index of the event afterwards, or -1 if the entry removes the event.
+     */
+    static int mapEventIndex(int eventInd, const MacroEventEdit &edit, bool undo);
+
+    /**
+     * @brief revertMove
+     * Reverts a committed MOVE change log entry on a Macro Event model.
+     * @param macroEventModel
+     * The Macro Event model, with the Macros being edited set active.
+     * @param edit
+     * The MOVE change log entry.
+     */
+    static void revertMove(MacroEventModel &macroEventModel, const MacroEventEdit &edit);
+
+    /**
+     * @brief applyEdit
+     * Applies (or reverses) a change log entry on the Macro Events being edited, and emits the rows it changed.
+     * @param edit
+     * The change log entry.
+     * @param undo
+     * True to reverse the edit, false to apply it.
+     */
+    void applyEdit(const MacroEventEdit &edit, bool undo);
+
+    /**
+     * @brief applyMove
+     * Applies (or reverses) a MOVE change log entry. See applyEdit().
+     * @param edit
+     * The MOVE change log entry.
+     * @param undo
+     * True to reverse the move, false to apply it.
+     */
+    void applyMove(const MacroEventEdit &edit, bool undo);
+
+    /**
+     * @brief insertEvents
+     * Inserts Macro Events at their indexes, and emits each contiguous range that was inserted.
+     * @param events
+     * The events to insert, in ascending order of index. Each index is the event's position after the insert.
+     */
+    void insertEvents(const QList<MacroEvent> &events);
+
+    /**
+     * @brief removeEvents
+     * Removes the Macro Events at the given indexes, and emits each contiguous range that was removed.
+     * @param eventInds
+     * The indexes of the events to remove, in ascending order.
+     */
+    void removeEvents(const QList<int> &eventInds);
+
+    /**
+     * @brief emitEventUpdated
+     * Emits the update of a single Macro Event.
+     * @param eventInd
+     * The index of the updated event.
+     */
+    void emitEventUpdated(int eventInd);
+
     /**
      * @brief getMacroEventIndexesFromMacroEvents
      * Gets a list of the event indexes of the events in a given list of Macro Events.
@@ -197,20 +346,7 @@ private:
      * @return
      * A list of the Macro Events' indexes.
      */
-    QList<int> getMacroEventIndexesFromMacroEvents(const QList<MacroEvent> &events) const;
-
-    /**
-     * @brief incMacroEventIndexes
-     * Increments Macro Event indexes of Macro Events that fall within range of the arguments by a given amount.
-     * @param beginListIndex
-     * The list index from which we must increment all Macro Event indexes.
-     * @param incAmt
-     * The amount to increment the Macro Event indexes. If negative, a decrement will happen instead.
-     * @param endListIndex (OPTIONAL)
-     * The list index which we will stop incrementing at (won't increment at this index).
-     * Default is up to the last index in the list.
-     */
-    void incMacroEventIndexes(int beginListIndex, int incAmt, int endListIndex = -1);
+    static QList<int> getMacroEventIndexesFromMacroEvents(const QList<MacroEvent> &events);
 };
 
 
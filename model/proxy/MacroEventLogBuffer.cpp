@@ -115,12 +115,7 @@ bool MacroEventLogBuffer::processMouseEvent(MacroMouseEvent &mEvent, int timeSin
     if (isLeftClick(mEvent, timeSinceLastEventAddMs)) {
         _events.last().mouseEvent.type = MacroMouseEventType::LeftClick;
         if (areLastTwoEventsDoubleClick()) {
-            // Remove the second single click that composes the double click and its associated screenshot!
-            QString screenshotPath = MacroEventModel::generateScreenshotPathFromId(_events.last().mouseEvent.screenshotId);
-            QFile deleteScreenshot(screenshotPath);
-            if (deleteScreenshot.exists()) {
-                deleteScreenshot.remove();
-            }
+            // Remove the second single click that composes the double click (its screenshot was never stored)!
             _events.removeLast();
             _events.last().mouseEvent.type = MacroMouseEventType::DoubleClick;
         }
@@ -255,8 +250,8 @@ void MacroEventLogBuffer::takeScreenshotIfLocationSensitiveMouseEvent(MacroEvent
     if (isMouseEvent && isLocationSensitive) {
         // Generate new screenshot ID and use it for screenshot file name as well!
         mEvent.screenshotId = MacroEventModel::generateNewScreenshotId();
-        mEvent.screenshotImg = RecordImageUtil::takeScreenshot();
-        screenshotSize = mEvent.screenshotImg.size();
+        mEvent.screenshot = ScreenshotHandle::fromImage(RecordImageUtil::takeScreenshot());
+        screenshotSize = mEvent.screenshot.image().size();
     }
 }
 
@@ -266,8 +261,16 @@ void MacroEventLogBuffer::isolateTargetImgIfScreenshotTaken(MacroMouseEvent &mEv
     bool screenshotTaken = mEvent.screenshotId != -1;
     if (screenshotTaken) {
         // Take the screenshot and get the bounds of the event and various other info.
+        QImage screenshotImg = mEvent.screenshot.image();
+        QImage targetImg = screenshotImg;
         mEvent.screenshotRect = RecordImageUtil::isolateTargetImg(mEvent.targetImgType, mEvent.cursorType,
-                                                                  mEvent.screenshotImg, mEvent.loc);
+                                                                  targetImg, mEvent.loc);
+
+        // Only keep the full resolution target (plus a margin), and a downscaled copy of the rest of the screen.
+        mEvent.screenshot = ScreenshotHandle::fromImage(RecordImageUtil::cropTargetWithMargin(screenshotImg, mEvent.screenshotRect,
+                                                                                               mEvent.screenshotOrg));
+        mEvent.contextScreenshot = ScreenshotHandle::fromImage(RecordImageUtil::downscaleContext(screenshotImg));
+        mEvent.contextScale = mEvent.contextScreenshot.isNull() ? 0 : RecordImageUtil::CONTEXT_SCALE;
     }
 }
 
@@ -372,7 +375,6 @@ void MacroEventLogBuffer::formKeyStringsAndSetEventIndexes()
         }
         // Else if we are finishing the formation of a key string.
         else if (keyStringStartInd != KEY_STRING_START_UNDEF) {
-            escapeChars(_events[i - 1].keyboardEvent.keyString);
             keyStringStartInd = KEY_STRING_START_UNDEF;
         }
 
@@ -384,8 +386,3 @@ void MacroEventLogBuffer::formKeyStringsAndSetEventIndexes()
     }
 }
 
-
-void MacroEventLogBuffer::escapeChars(QString &keyStr)
-{
-    keyStr = keyStr.replace("'", "''");
-}
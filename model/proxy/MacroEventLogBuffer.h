@@ -205,10 +205,10 @@ private:
     /**
      * @brief takeScreenshotIfLocationSensitiveMouseEvent
      * Takes a screenshot if a given event is a location sensitive mouse event, and fills screenshotKey
-     * and screenshotImg data in the given Macro Event.
+     * and screenshot data in the given Macro Event.
      * A location sensitive mouse event is any click event. This excludes wheel/scroll events.
      * @param event (INPUT & OUTPUT)
-     * The Macro event to possibly generate a screenshot for and fill with screenshot data (screenshotKey and screenshotImg).
+     * The Macro event to possibly generate a screenshot for and fill with screenshot data (screenshotKey and screenshot).
      */
     void takeScreenshotIfLocationSensitiveMouseEvent(MacroEvent &event) const;
 
@@ -219,7 +219,8 @@ private:
      * method.
      * @param mEvent (INPUT & OUTPUT)
      * The mouse event to possibly isolate the target of the event for (if a screenshot has been taken for it).
-     * Will have its data members filled pertaining to the target of the event.
+     * Will have its data members filled pertaining to the target of the event, and its full screenshot replaced
+     * by a crop of the target plus a margin and a downscaled context.
      */
     void isolateTargetImgIfScreenshotTaken(MacroMouseEvent &mEvent) const;
 
@@ -263,14 +264,6 @@ private:
      * all keyboard events that belong in a character key string and set event indexes.
      */
     void formKeyStringsAndSetEventIndexes();
-
-    /**
-     * @brief escapeChars
-     * Escapes all characters that would mess up a SQL query. So, all quotes and back slashes are escaped.
-     * @param keyStr
-     * The string to escape.
-     */
-    void escapeChars(QString &keyStr);
 };
 
 
@@ -7,10 +7,16 @@
 #include <QThread>
 #include <exception>
 #include <QPainter>
+#include <QRectF>
 #include <cmath>
 #include <QDebug>
 
 
+const int RecordImageUtil::TARGET_CROP_MARGIN = 48;
+const double RecordImageUtil::CONTEXT_SCALE = 0.125;
+const bool RecordImageUtil::CONTEXT_GRAYSCALE = false;
+
+
 QImage RecordImageUtil::takeScreenshot()
 {
     return NativeImageUtil::takeScreenshot();
@@ -46,28 +52,89 @@ QRect RecordImageUtil::isolateTargetImg(TargetImgType &targetImgType,
     return qTargetRect;
 }
 
-QRect RecordImageUtil::findTargetImg(const QString &screenshotPath,
+QImage RecordImageUtil::cropTargetWithMargin(const QImage &screenshot,
+                                             const QRect &targetROI,
+                                             QPoint &cropOrg)
+{
+    QRect cropRect = targetROI.adjusted(-TARGET_CROP_MARGIN, -TARGET_CROP_MARGIN,
+                                         TARGET_CROP_MARGIN,  TARGET_CROP_MARGIN).intersected(screenshot.rect());
+    cropOrg = cropRect.topLeft();
+    return screenshot.copy(cropRect);
+}
+
+
+QImage RecordImageUtil::downscaleContext(const QImage &screenshot)
+{
+    if (CONTEXT_SCALE <= 0 || screenshot.isNull()) return QImage();
+
+    // Only used to show the surroundings of the target, so a smooth transform is not worth its cost.
+    QImage context = screenshot.scaled(qMax(1, (int)(screenshot.width() * CONTEXT_SCALE)),
+                                       qMax(1, (int)(screenshot.height() * CONTEXT_SCALE)),
+                                       Qt::IgnoreAspectRatio, Qt::FastTransformation);
+    if (CONTEXT_GRAYSCALE) {
+        context = context.convertToFormat(QImage::Format_Grayscale8);
+    }
+    return context;
+}
+
+
+QImage RecordImageUtil::composeScreenshotRegion(const QImage &targetCrop,
+                                                const QPoint &cropOrg,
+                                                const QImage &context,
+                                                double contextScale,
+                                                const QRect &region,
+                                                Qt::GlobalColor fillClr)
+{
+    QImage regionImg(region.size(), QImage::Format_RGB32);
+    regionImg.fill(fillClr);
+    QPainter painter(&regionImg);
+
+    // Blurry surroundings first, then the sharp target crop on top of them.
+    if (!context.isNull() && contextScale > 0) {
+        QRectF contextSrc(region.x() * contextScale, region.y() * contextScale,
+                          region.width() * contextScale, region.height() * contextScale);
+        painter.drawImage(QRectF(regionImg.rect()), context, contextSrc);
+    }
+    painter.drawImage(cropOrg - region.topLeft(), targetCrop);
+
+    return regionImg;
+}
+
+
+QRect RecordImageUtil::findTargetImg(const QImage &targetCrop,
+                                     const QPoint &cropOrg,
                                      const QRect &targetROI)
+{
+    QThread::msleep(100);
+    return findTargetImg(targetCrop, cropOrg, targetROI, NativeImageUtil::takeScreenshot());
+}
+
+
+QRect RecordImageUtil::findTargetImg(const QImage &targetCrop,
+                                     const QPoint &cropOrg,
+                                     const QRect &targetROI,
+                                     const QImage &screenshotImg)
 {
     cv::Point targetImgOrgUpdt,
               targetImgOrg;
     cv::Rect screenRect,
              cvTargetROI;
+    // The template match needs the target and the screenshot in the same single channel format, but recorded crops
+    // and screenshots can come in any color format, so both are brought to the same 3 channel format and then to gray.
+    QImage qScreenshot = screenshotImg.convertToFormat(QImage::Format_RGB888);
 
     NativeImageUtil::copyQRECTtoCvRect(cvTargetROI, targetROI);
     targetImgOrg = cvTargetROI.tl();
 
-    QThread::msleep(100);
-    QImage qScreenshot = NativeImageUtil::takeScreenshot();
-
-    QImage qTargetImg(screenshotPath);
+    // The target ROI is in screen coordinates, so move it into the crop's coordinates to cut the target out.
+    QImage qTargetImg = targetCrop.copy(targetROI.translated(-cropOrg)).convertToFormat(QImage::Format_RGB888);
     cv::Mat targetImg = ImageConverter::convertQImageToMat(qTargetImg);
-    targetImg = targetImg(cvTargetROI);
+    targetImg = ImageConverter::convertToGrayIfOtherFormat(targetImg);
 
     Mat screenshot = ImageConverter::convertQImageToMat(qScreenshot);
 	NativeImageUtil::getScreenBound(screenRect);
 	resize(screenshot, screenshot, screenRect.size());
-    screenshot = ImageConverter::convertRGBToGray(screenshot);
+    screenshot = ImageConverter::convertToGrayIfOtherFormat(screenshot);
 	targetImgOrgUpdt = ImageSearcher::templateMatchSearch(targetImg, screenshot, targetImgOrg, CV_TM_SQDIFF);
 	/*targetImgOrgUpdt = ImageSearcher::featureBasedSearch(targetImg, screenshot, targetImgOrg);
 	if(targetImgOrgUpdt.x < 0 ) { // If NO features could be extracted from a very basic/small image.
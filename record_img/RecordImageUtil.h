@@ -21,6 +21,22 @@ class RecordImageUtil {
 
 public:
 
+    /**
+     * @brief TARGET_CROP_MARGIN
+     * The margin (in pixels) kept around the target of a location sensitive mouse event when its screenshot is stored.
+     */
+    const static int TARGET_CROP_MARGIN;
+    /**
+     * @brief CONTEXT_SCALE
+     * The scale that the full screen context of a location sensitive mouse event is stored at (0 to not store it).
+     */
+    const static double CONTEXT_SCALE;
+    /**
+     * @brief CONTEXT_GRAYSCALE
+     * Set true to store the full screen context in grayscale.
+     */
+    const static bool CONTEXT_GRAYSCALE;
+
     /**
      * @brief takeScreenshotAndSave
      * Takes a screenshot.
@@ -53,20 +69,94 @@ public:
                                   QImage &screenshot,
                                   const QPoint &actionLoc);
 
+    /**
+     * @brief cropTargetWithMargin
+     * Crops the target of a location sensitive mouse event plus a margin of TARGET_CROP_MARGIN out of a screenshot.
+     * @param screenshot
+     * The full screenshot.
+     * @param targetROI
+     * The isolated region of interest (ROI) for the target (see isolateTargetImg()).
+     * @param cropOrg (OUTPUT)
+     * The X,Y origin of the crop in screen coordinates.
+     * @return
+     * The crop.
+     */
+    static QImage cropTargetWithMargin(const QImage &screenshot,
+                                       const QRect &targetROI,
+                                       QPoint &cropOrg);
+
+    /**
+     * @brief downscaleContext
+     * Downscales a full screenshot to CONTEXT_SCALE (and converts it to grayscale if CONTEXT_GRAYSCALE is set).
+     * @param screenshot
+     * The full screenshot.
+     * @return
+     * The downscaled context, or a null image if contexts are not stored.
+     */
+    static QImage downscaleContext(const QImage &screenshot);
+
+    /**
+     * @brief composeScreenshotRegion
+     * Rebuilds a region of the screen from a stored target crop and its downscaled context. The context is
+     * scaled back up to fill in everything around the full resolution crop.
+     * @param targetCrop
+     * The full resolution target crop (see cropTargetWithMargin()).
+     * @param cropOrg
+     * The X,Y origin of the target crop in screen coordinates.
+     * @param context
+     * The downscaled context (may be null, in which case fillClr is used outside of the crop).
+     * @param contextScale
+     * The scale of the context relative to the screen.
+     * @param region
+     * The region of the screen to rebuild, in screen coordinates.
+     * @param fillClr (OPTIONAL)
+     * The color to fill parts of the region that are not covered by the crop or the context with.
+     * @return
+     * The rebuilt region.
+     */
+    static QImage composeScreenshotRegion(const QImage &targetCrop,
+                                          const QPoint &cropOrg,
+                                          const QImage &context,
+                                          double contextScale,
+                                          const QRect &region,
+                                          Qt::GlobalColor fillClr = Qt::white);
+
     /**
      * @brief findTargetImg
-     * Finds the target image in a given screenshot associated with a location sensitive mouse event.
-     * @param screenshotFileName
-     * The full path and name of the sceenshot file. Used to search for the target in.
+     * Finds the target image of a location sensitive mouse event on the current screen.
+     * @param targetCrop
+     * The stored full resolution target crop (see cropTargetWithMargin()).
+     * @param cropOrg
+     * The X,Y origin of the target crop in screen coordinates.
      * @param targetROI
      * The isolated region of interest (ROI) for the target of a given location sensitive mouse event.
      * This is where we expect the event target to be contained within.
      * @return
      * The new targetROI. It should be equivalent to the input targetROI if the target has not moved.
      */
-    static QRect findTargetImg(const QString &screenshotPath,
+    static QRect findTargetImg(const QImage &targetCrop,
+                               const QPoint &cropOrg,
                                const QRect &targetROI);
 
+    /**
+     * @brief findTargetImg
+     * Finds the target image of a location sensitive mouse event within a screenshot that was already taken.
+     * @param targetCrop
+     * The stored full resolution target crop (see cropTargetWithMargin()).
+     * @param cropOrg
+     * The X,Y origin of the target crop in screen coordinates.
+     * @param targetROI
+     * The isolated region of interest (ROI) for the target of a given location sensitive mouse event.
+     * @param screenshot
+     * The full screenshot to search.
+     * @return
+     * The new targetROI. It should be equivalent to the input targetROI if the target has not moved.
+     */
+    static QRect findTargetImg(const QImage &targetCrop,
+                               const QPoint &cropOrg,
+                               const QRect &targetROI,
+                               const QImage &screenshot);
+
 
     /**
      * @brief cropImg
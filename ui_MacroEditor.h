@@ -77,22 +77,6 @@ public:
         verticalLayout_2->addWidget(macroIdsLabel);
 
         macroEventsTable = new MacroEventsTable(centralWidget);
-        if (macroEventsTable->columnCount() < 7)
-            macroEventsTable->setColumnCount(7);
-        QTableWidgetItem *__qtablewidgetitem = new QTableWidgetItem();
-        macroEventsTable->setHorizontalHeaderItem(0, __qtablewidgetitem);
-        QTableWidgetItem *__qtablewidgetitem1 = new QTableWidgetItem();
-        macroEventsTable->setHorizontalHeaderItem(1, __qtablewidgetitem1);
-        QTableWidgetItem *__qtablewidgetitem2 = new QTableWidgetItem();
-        macroEventsTable->setHorizontalHeaderItem(2, __qtablewidgetitem2);
-        QTableWidgetItem *__qtablewidgetitem3 = new QTableWidgetItem();
-        macroEventsTable->setHorizontalHeaderItem(3, __qtablewidgetitem3);
-        QTableWidgetItem *__qtablewidgetitem4 = new QTableWidgetItem();
-        macroEventsTable->setHorizontalHeaderItem(4, __qtablewidgetitem4);
-        QTableWidgetItem *__qtablewidgetitem5 = new QTableWidgetItem();
-        macroEventsTable->setHorizontalHeaderItem(5, __qtablewidgetitem5);
-        QTableWidgetItem *__qtablewidgetitem6 = new QTableWidgetItem();
-        macroEventsTable->setHorizontalHeaderItem(6, __qtablewidgetitem6);
         macroEventsTable->setObjectName(QStringLiteral("macroEventsTable"));
         macroEventsTable->setFont(font);
         macroEventsTable->setContextMenuPolicy(Qt::CustomContextMenu);
@@ -167,20 +151,6 @@ public:
         actionRedoButton->setStatusTip(QApplication::translate("MacroEditor", "Redo: ctrl + y", 0));
 #endif // QT_NO_STATUSTIP
         macroIdsLabel->setText(QApplication::translate("MacroEditor", "Editing Macro(s): ", 0));
-        QTableWidgetItem *___qtablewidgetitem = macroEventsTable->horizontalHeaderItem(0);
-        ___qtablewidgetitem->setText(QApplication::translate("MacroEditor", "Index", 0));
-        QTableWidgetItem *___qtablewidgetitem1 = macroEventsTable->horizontalHeaderItem(1);
-        ___qtablewidgetitem1->setText(QApplication::translate("MacroEditor", "Description", 0));
-        QTableWidgetItem *___qtablewidgetitem2 = macroEventsTable->horizontalHeaderItem(2);
-        ___qtablewidgetitem2->setText(QApplication::translate("MacroEditor", "Key String", 0));
-        QTableWidgetItem *___qtablewidgetitem3 = macroEventsTable->horizontalHeaderItem(3);
-        ___qtablewidgetitem3->setText(QApplication::translate("MacroEditor", "Delay", 0));
-        QTableWidgetItem *___qtablewidgetitem4 = macroEventsTable->horizontalHeaderItem(4);
-        ___qtablewidgetitem4->setText(QApplication::translate("MacroEditor", "Duration", 0));
-        QTableWidgetItem *___qtablewidgetitem5 = macroEventsTable->horizontalHeaderItem(5);
-        ___qtablewidgetitem5->setText(QApplication::translate("MacroEditor", "Auto Correct", 0));
-        QTableWidgetItem *___qtablewidgetitem6 = macroEventsTable->horizontalHeaderItem(6);
-        ___qtablewidgetitem6->setText(QApplication::translate("MacroEditor", "Screenshot", 0));
 #ifndef QT_NO_STATUSTIP
         macroEventsTable->setStatusTip(QApplication::translate("MacroEditor", "Left Click to Select Macro Event   ---   Right Click for Options", 0));
 #endif // QT_NO_STATUSTIP
@@ -45,6 +45,13 @@ private:
      */
     int _lastSavePos;
 
+    /**
+     * @brief _revertChanges
+     * Saved changes that were undone and then discarded by a new change, most recent first. The next save must
+     * revert them.
+     */
+    QList<T> _revertChanges;
+
 public:
 
     explicit ChangeLog();
@@ -78,7 +85,8 @@ public:
 
     /**
      * @brief hasSaveChanges
-     * Determines if save changes are available. Should be called before getSaveChanges().
+     * Determines if save changes are available, including saved changes that have since been undone.
+     * Should be called before getSaveChanges().
      * @return
      * True if save changes are available, false if not.
      */
@@ -116,11 +124,14 @@ public:
     /**
      * @brief getSaveChanges
      * Gets a list of all of the save changes for a commit to the underlying database.
-     * The save changes will include everything up to and including the current change position.
+     * The save changes will include everything after the last save up to and including the current change position.
+     * @param revertChanges
+     * (OUTPUT) The changes of earlier saves that have since been undone, most recent first. They must be reverted
+     * before the save changes are applied.
      * @return
      * A list of save changes.
      */
-    QList<T> getSaveChanges();
+    QList<T> getSaveChanges(QList<T> &revertChanges);
 
 
     /**
@@ -139,15 +150,21 @@ template <typename T>
 ChangeLog<T>::ChangeLog()
     : _changeLog(),
       _curChangeLogPos(NO_ACTIVE_CHANGES),
-      _lastSavePos(NO_ACTIVE_CHANGES)
+      _lastSavePos(NO_ACTIVE_CHANGES),
+      _revertChanges()
 {}
 
 
 template <typename T>
 void ChangeLog<T>::addChange(const T &change)
 {
-    // Discard all undo changes before addition of new change.
+    // Discard all redo changes before addition of new change.
     if ((_changeLog.size() - 1) > _curChangeLogPos) {
+        // Saved changes among them still have to be reverted by the next save.
+        for (int i = _lastSavePos; i > _curChangeLogPos; i--) {
+            _revertChanges.append(_changeLog.at(i));
+        }
+        _lastSavePos = qMin(_lastSavePos, _curChangeLogPos);
         _changeLog = _changeLog.mid(0, _curChangeLogPos + 1);
     }
 
@@ -174,7 +191,7 @@ bool ChangeLog<T>::hasRedoChange() const
 template <typename T>
 bool ChangeLog<T>::hasSaveChanges() const
 {
-    return (_curChangeLogPos > _lastSavePos);
+    return (_curChangeLogPos != _lastSavePos || !_revertChanges.isEmpty());
 }
 
 
@@ -206,19 +223,25 @@ int ChangeLog<T>::size() const
 
 
 template <typename T>
-QList<T> ChangeLog<T>::getSaveChanges()
+QList<T> ChangeLog<T>::getSaveChanges(QList<T> &revertChanges)
 {
     qDebug() << "last save pos: " << _lastSavePos;
     qDebug() << "cur change pos: " << _curChangeLogPos;
 
-    // If no save changes.
-    if (!hasSaveChanges()) {
-        return QList<T>();
+    // Saved changes that have been undone since (but are still available for redo) are reverted as well.
+    revertChanges = _revertChanges;
+    for (int i = _lastSavePos; i > _curChangeLogPos; i--) {
+        revertChanges.append(_changeLog.at(i));
     }
+    _revertChanges.clear();
 
-    int lastSavePos = _lastSavePos;
+    // The changes made since the last save.
+    QList<T> saveChanges;
+    if (_curChangeLogPos > _lastSavePos) {
+        saveChanges = _changeLog.mid(_lastSavePos + 1, _curChangeLogPos - _lastSavePos);
+    }
     _lastSavePos = _curChangeLogPos;
-    return _changeLog.mid(lastSavePos + 1, _curChangeLogPos + 1);
+    return saveChanges;
 }
 
 
@@ -228,6 +251,7 @@ void ChangeLog<T>::clear()
     _changeLog.clear();
     _curChangeLogPos = NO_ACTIVE_CHANGES;
     _lastSavePos = NO_ACTIVE_CHANGES;
+    _revertChanges.clear();
 }
 
 
@@ -5,6 +5,9 @@
 #include <QMessageBox>
 
 
+const int MacroEditor::SAVE_FINISHED_MSG_MS = 3000;
+
+
 MacroEditor::MacroEditor(MacroEditorEventListener &editorEventListener, QWidget *parent) :
     QMainWindow(parent),
     ui(new Ui::MacroEditor),
@@ -28,13 +31,12 @@ MacroEditor::~MacroEditor()
 void MacroEditor::refresh(const QList<MacroEvent> &macroEvents, const QList<int> *macroIds)
 {
     // Reset contents and show.
-    ui->macroEventsTable->setRowCount(0);
     if (macroIds != nullptr) {
         setMacroIds(*macroIds);
     }
     setMacroEvents(macroEvents);
     show();
-    ui->macroEventsTable->refreshColumnWidths(macroEvents);
+    ui->macroEventsTable->refreshColumnWidths();
 }
 
 
@@ -50,6 +52,41 @@ void MacroEditor::show()
 }
 
 
+void MacroEditor::showSaveProgress(int doneCount, int totalCount)
+{
+    if (totalCount > 0) {
+        ui->statusbar->showMessage("Saving... " + QString::number(doneCount) + "/" + QString::number(totalCount));
+    }
+    else {
+        ui->statusbar->showMessage("Saving...");
+    }
+}
+
+
+void MacroEditor::showSaveFinished()
+{
+    ui->statusbar->showMessage("Saved", SAVE_FINISHED_MSG_MS);
+}
+
+
+void MacroEditor::insertEventRows(int firstIndex, const QList<MacroEvent> &macroEvents)
+{
+    ui->macroEventsTable->insertEventRows(firstIndex, macroEvents);
+}
+
+
+void MacroEditor::removeEventRows(int firstIndex, int count)
+{
+    ui->macroEventsTable->removeEventRows(firstIndex, count);
+}
+
+
+void MacroEditor::updateEventRows(int firstIndex, const QList<MacroEvent> &macroEvents)
+{
+    ui->macroEventsTable->updateEventRows(firstIndex, macroEvents);
+}
+
+
 void MacroEditor::setMacroIds(const QList<int> &macroIds)
 {
     QString macroIdStr = "Editing Macro(s): ";
@@ -67,15 +104,14 @@ void MacroEditor::setMacroIds(const QList<int> &macroIds)
 
 void MacroEditor::setMacroEvents(const QList<MacroEvent> &macroEvents)
 {
-    ui->macroEventsTable->addMacroEvents(macroEvents);
+    ui->macroEventsTable->setMacroEvents(macroEvents);
 }
 
 
 void MacroEditor::resizeEvent(QResizeEvent *event)
 {
     QMainWindow::resizeEvent(event);
-    QList<MacroEvent> macroEvents = _editorEventListener.getLatestMacroEvents();
-    ui->macroEventsTable->refreshColumnWidths(macroEvents);
+    ui->macroEventsTable->refreshColumnWidths();
 }
 
 
@@ -40,6 +40,55 @@ public:
      */
     void show();
 
+    /**
+     * @brief showSaveProgress
+     * Shows the progress of a save in the status bar.
+     * @param doneCount
+     * The number of changes saved so far.
+     * @param totalCount
+     * The total number of changes being saved (0 if the save has not started yet).
+     */
+    void showSaveProgress(int doneCount, int totalCount);
+
+    /**
+     * @brief showSaveFinished
+     * Shows that all saves have finished in the status bar.
+     */
+    void showSaveFinished();
+
+
+public slots:
+
+    /**
+     * @brief insertEventRows
+     * Shows a contiguous range of inserted Macro Events.
+     * @param firstIndex
+     * The index of the first inserted event.
+     * @param macroEvents
+     * The inserted events.
+     */
+    void insertEventRows(int firstIndex, const QList<MacroEvent> &macroEvents);
+
+    /**
+     * @brief removeEventRows
+     * Stops showing a contiguous range of removed Macro Events.
+     * @param firstIndex
+     * The index of the first removed event.
+     * @param count
+     * The number of removed events.
+     */
+    void removeEventRows(int firstIndex, int count);
+
+    /**
+     * @brief updateEventRows
+     * Shows the latest state of a contiguous range of updated Macro Events.
+     * @param firstIndex
+     * The index of the first updated event.
+     * @param macroEvents
+     * The updated events.
+     */
+    void updateEventRows(int firstIndex, const QList<MacroEvent> &macroEvents);
+
 
 signals:
 
@@ -52,6 +101,12 @@ signals:
 
 private:
 
+    /**
+     * @brief SAVE_FINISHED_MSG_MS
+     * How long (in milliseconds) the status bar shows that a save has finished.
+     */
+    const static int SAVE_FINISHED_MSG_MS;
+
     Ui::MacroEditor *ui;
     /**
      * @brief _editorEventListener
@@ -0,0 +1,387 @@
+#include "MacroEventsTableModel.h"
+#include "record_img/RecordImageUtil.h"
+#include "model/ScreenshotThumbnails.h"
+#include <QIcon>
+#include <QColor>
+#include <QDebug>
+
+
+const int MacroEventsTableModel::EVENT_INDEX_COL         = 0;
+const int MacroEventsTableModel::EVENT_DESCRIPTION_COL   = 1;
+const int MacroEventsTableModel::EVENT_KEY_STRING_COL    = 2;
+const int MacroEventsTableModel::EVENT_DELAY_COL         = 3;
+const int MacroEventsTableModel::EVENT_DURATION_COL      = 4;
+const int MacroEventsTableModel::EVENT_AUTO_CORRECT_COL  = 5;
+const int MacroEventsTableModel::EVENT_SCREENSHOT_COL    = 6;
+const int MacroEventsTableModel::COLUMN_COUNT            = 7;
+
+
+MacroEventsTableModel::MacroEventsTableModel(QObject *parent)
+    : QAbstractTableModel(parent),
+      _editorEventListener(nullptr),
+      _macroEvents(),
+      _thumbnailSize(300, 50)
+{}
+
+
+void MacroEventsTableModel::setEventListener(MacroEditorEventListener &eventListener)
+{
+    _editorEventListener = &eventListener;
+}
+
+
+void MacroEventsTableModel::setMacroEvents(const QList<MacroEvent> &macroEvents)
+{
+    beginResetModel();
+
+    // Every row up to the last event index exists. Make sure we fill in empty disabled rows for non-uniform events.
+    int nRows = 0;
+    foreach (const MacroEvent &event, macroEvents) {
+        nRows = qMax(nRows, event.index + 1);
+    }
+    MacroEvent dummyEvent;
+    dummyEvent.type = DummyEvent;
+    _macroEvents.fill(dummyEvent, nRows);
+    foreach (const MacroEvent &event, macroEvents) {
+        if (event.index >= 0) _macroEvents[event.index] = event;
+    }
+
+    endResetModel();
+}
+
+
+void MacroEventsTableModel::setThumbnailSize(const QSize &size)
+{
+    if (size == _thumbnailSize) return;
+
+    _thumbnailSize = size;
+    if (rowCount() > 0) {
+        emit dataChanged(index(0, EVENT_SCREENSHOT_COL), index(rowCount() - 1, EVENT_SCREENSHOT_COL),
+                         QVector<int>() << Qt::DecorationRole);
+    }
+}
+
+
+void MacroEventsTableModel::prefetchScreenshots(int firstRow, int lastRow) const
+{
+    for (int row = qMax(firstRow, 0); row <= qMin(lastRow, rowCount() - 1); row++) {
+        if (!hasScreenshot(row)) continue;
+
+        // Stored thumbnails get loaded into the pixmap cache, so the full size screenshots are only decoded when
+        // a thumbnail still has to be composed.
+        const MacroMouseEvent &mEvent = _macroEvents[row].mouseEvent;
+        if (   mEvent.screenshotId < 0
+            || ScreenshotThumbnails::find(mEvent.screenshotId, mEvent.loc, _thumbnailSize).isNull())
+        {
+            mEvent.screenshot.prefetch();
+            mEvent.contextScreenshot.prefetch();
+        }
+    }
+}
+
+
+void MacroEventsTableModel::insertEventRows(int firstRow, const QList<MacroEvent> &macroEvents)
+{
+    if (macroEvents.isEmpty()) return;
+
+    beginInsertRows(QModelIndex(), firstRow, firstRow + macroEvents.size() - 1);
+    for (int i = 0; i < macroEvents.size(); i++) {
+        _macroEvents.insert(firstRow + i, macroEvents.at(i));
+    }
+    endInsertRows();
+}
+
+
+void MacroEventsTableModel::removeEventRows(int firstRow, int count)
+{
+    if (count <= 0) return;
+
+    beginRemoveRows(QModelIndex(), firstRow, firstRow + count - 1);
+    _macroEvents.remove(firstRow, count);
+    endRemoveRows();
+}
+
+
+void MacroEventsTableModel::updateEventRows(int firstRow, const QList<MacroEvent> &macroEvents)
+{
+    if (macroEvents.isEmpty()) return;
+
+    for (int i = 0; i < macroEvents.size(); i++) {
+        _macroEvents[firstRow + i] = macroEvents.at(i);
+    }
+    emit dataChanged(index(firstRow, 0), index(firstRow + macroEvents.size() - 1, COLUMN_COUNT - 1));
+}
+
+
+bool MacroEventsTableModel::isDummyRow(int row) const
+{
+    return _macroEvents.at(row).type == DummyEvent;
+}
+
+
+int MacroEventsTableModel::getEventIndex(int row) const
+{
+    return row;
+}
+
+
+int MacroEventsTableModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : _macroEvents.size();
+}
+
+
+int MacroEventsTableModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : COLUMN_COUNT;
+}
+
+
+QVariant MacroEventsTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid()) return QVariant();
+
+    const MacroEvent &event = _macroEvents.at(index.row());
+    int column = index.column();
+
+    // Dummy rows only show their index.
+    if (event.type == DummyEvent) {
+        if (role == Qt::BackgroundRole)                                     return QColor(250, 250, 250);
+        if (role == Qt::DisplayRole && column == EVENT_INDEX_COL)           return QString::number(index.row());
+        return QVariant();
+    }
+
+    switch (role) {
+    case Qt::DisplayRole:
+    case Qt::EditRole:
+        if (column == EVENT_INDEX_COL)          return QString::number(index.row());
+        if (column == EVENT_DESCRIPTION_COL)    return genEventDescr(event);
+        if (column == EVENT_KEY_STRING_COL)     return (event.type == KeyboardEvent && event.keyboardEvent.type == KeyString)
+                                                     ? event.keyboardEvent.keyString
+                                                     : QString();
+        if (column == EVENT_DELAY_COL)          return (event.delayMs >= 0) ? QString::number(event.delayMs) : QString();
+        if (column == EVENT_DURATION_COL)       return (event.durationMs >= 0) ? QString::number(event.durationMs) : QString();
+        break;
+    case Qt::TextAlignmentRole:
+        if (column == EVENT_DELAY_COL || column == EVENT_DURATION_COL) {
+            return (int)(Qt::AlignRight | Qt::AlignVCenter);
+        }
+        break;
+    case Qt::CheckStateRole:
+        if (column == EVENT_AUTO_CORRECT_COL && event.type == MouseEvent) {
+            return event.mouseEvent.autoCorrect ? Qt::Checked : Qt::Unchecked;
+        }
+        break;
+    case Qt::ToolTipRole:
+        if (column == EVENT_AUTO_CORRECT_COL) return QString("Check to enable auto correct");
+        break;
+    case Qt::DecorationRole:
+        // Only the rows that are painted get here, so thumbnails are only looked up or composed for visible rows.
+        if (column == EVENT_SCREENSHOT_COL && hasScreenshot(index.row())) {
+            QPixmap thumbnail = getThumbnail(index.row());
+            if (!thumbnail.isNull()) return QIcon(thumbnail);
+        }
+        break;
+    }
+
+    return QVariant();
+}
+
+
+bool MacroEventsTableModel::setData(const QModelIndex &index, const QVariant &value, int role)
+{
+    if (!index.isValid() || isDummyRow(index.row())) return false;
+
+    int row = index.row();
+    int column = index.column();
+    MacroEvent &event = _macroEvents[row];
+    QString updateStr = value.toString();
+    bool checked = (value.toInt() == Qt::Checked);
+
+    qDebug() << "Cell changed at: (" << row << ", " << column << ")";
+    if (role == Qt::EditRole && column == EVENT_KEY_STRING_COL) {
+        event.keyboardEvent.keyString = updateStr;
+    }
+    else if (role == Qt::EditRole && column == EVENT_DELAY_COL) {
+        qDebug() << "New Cell value is: " << updateStr;
+        event.delayMs = updateStr.toInt();
+    }
+    else if (role == Qt::EditRole && column == EVENT_DURATION_COL) {
+        qDebug() << "New Cell value is: " << updateStr;
+        event.durationMs = updateStr.toInt();
+    }
+    else if (role == Qt::CheckStateRole && column == EVENT_AUTO_CORRECT_COL) {
+        qDebug() << "Checkbox state is: " << checked;
+        event.mouseEvent.autoCorrect = checked;
+    }
+    else {
+        return false;
+    }
+    emit dataChanged(index, index);
+
+    // Feed all update events to the event listener (controller) for processing in model if we have an event listener set.
+    if (_editorEventListener != nullptr) {
+        switch (column) {
+        case EVENT_KEY_STRING_COL:      _editorEventListener->updateEventKeyString(row, updateStr);         break;
+        case EVENT_DELAY_COL:           _editorEventListener->updateEventDelay(row, updateStr.toInt());     break;
+        case EVENT_DURATION_COL:        _editorEventListener->updateEventDuration(row, updateStr.toInt());  break;
+        case EVENT_AUTO_CORRECT_COL:    _editorEventListener->updateEventAutoCorrect(row, checked);         break;
+        }
+    }
+    return true;
+}
+
+
+Qt::ItemFlags MacroEventsTableModel::flags(const QModelIndex &index) const
+{
+    // Rows can be dropped past the last row.
+    if (!index.isValid()) return Qt::ItemIsDropEnabled;
+
+    Qt::ItemFlags flags = Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsDragEnabled | Qt::ItemIsDropEnabled;
+    const MacroEvent &event = _macroEvents.at(index.row());
+    if (event.type == DummyEvent) return flags; // Disabled
+
+    switch (index.column()) {
+    case EVENT_KEY_STRING_COL:
+        // Only Key String events have a key string to edit.
+        if (event.type == KeyboardEvent && event.keyboardEvent.type == KeyString) flags |= Qt::ItemIsEditable;
+        break;
+    case EVENT_DELAY_COL:
+    case EVENT_DURATION_COL:
+        flags |= Qt::ItemIsEditable;
+        break;
+    case EVENT_AUTO_CORRECT_COL:
+        if (event.type == MouseEvent) flags |= Qt::ItemIsUserCheckable;
+        break;
+    }
+    return flags;
+}
+
+
+QVariant MacroEventsTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole) {
+        return QAbstractTableModel::headerData(section, orientation, role);
+    }
+
+    switch (section) {
+    case EVENT_INDEX_COL:           return QString("Index");
+    case EVENT_DESCRIPTION_COL:     return QString("Description");
+    case EVENT_KEY_STRING_COL:      return QString("Key String");
+    case EVENT_DELAY_COL:           return QString("Delay");
+    case EVENT_DURATION_COL:        return QString("Duration");
+    case EVENT_AUTO_CORRECT_COL:    return QString("Auto Correct");
+    case EVENT_SCREENSHOT_COL:      return QString("Screenshot");
+    default:                        return QVariant();
+    }
+}
+
+
+Qt::DropActions MacroEventsTableModel::supportedDropActions() const
+{
+    return Qt::MoveAction;
+}
+
+
+bool MacroEventsTableModel::hasScreenshot(int row) const
+{
+    const MacroEvent &event = _macroEvents.at(row);
+    return event.type == MouseEvent && !event.mouseEvent.screenshot.isNull();
+}
+
+
+QPixmap MacroEventsTableModel::getThumbnail(int row) const
+{
+    const MacroMouseEvent &mEvent = _macroEvents.at(row).mouseEvent;
+    if (mEvent.screenshotId < 0) return genThumbnail(mEvent);
+
+    QPixmap thumbnail = ScreenshotThumbnails::find(mEvent.screenshotId, mEvent.loc, _thumbnailSize);
+    if (thumbnail.isNull()) {
+        // Composed once, then kept with the screenshot if it is stored (recorded screenshots are not until saved).
+        thumbnail = genThumbnail(mEvent);
+        if (!thumbnail.isNull()) {
+            ScreenshotThumbnails::insert(mEvent.screenshotId, mEvent.loc, _thumbnailSize, thumbnail,
+                                         mEvent.screenshot.isStored());
+        }
+    }
+    return thumbnail;
+}
+
+
+QPixmap MacroEventsTableModel::genThumbnail(const MacroMouseEvent &mEvent) const
+{
+    // Show the neighborhood of the click: the sharp target crop over its upscaled surroundings.
+    QRect neighborhood(QPoint(0, 0), _thumbnailSize);
+    neighborhood.moveCenter(mEvent.loc);
+    QImage neighborhoodImg = RecordImageUtil::composeScreenshotRegion(mEvent.screenshot.image(), mEvent.screenshotOrg,
+                                                                      mEvent.contextScreenshot.image(), mEvent.contextScale,
+                                                                      neighborhood);
+    if (neighborhoodImg.width() == 0) return QPixmap();
+
+    // Blow up extremely small images.
+    QImage cropImg;
+    if (neighborhoodImg.width() < 30 && neighborhoodImg.height() < 30) {
+        cropImg = neighborhoodImg.scaled(neighborhoodImg.width() >= 30 ? neighborhoodImg.width() : 30,
+                                         neighborhoodImg.height() >= 30 ? neighborhoodImg.height() : 30);
+    }
+    else {
+        cropImg = neighborhoodImg;
+    }
+
+    // Crop the screenshot to show in table cell.
+    QRect cropRect(QPoint(-1, -1), _thumbnailSize);
+    Qt::GlobalColor fillRemainingClr = Qt::white;
+    QPoint mouseLoc = mEvent.loc;
+    QPoint screenshotOrg = neighborhood.topLeft();
+    cropImg = RecordImageUtil::cropImg(cropImg,
+                                       cropRect,
+                                       &fillRemainingClr,
+                                       &mouseLoc,
+                                       &screenshotOrg);
+    return QPixmap::fromImage(cropImg);
+}
+
+
+QString MacroEventsTableModel::genEventDescr(const MacroEvent &event) const
+{
+    switch (event.type) {
+    case MouseEvent:    return genMouseEventDescr(event.mouseEvent);
+    case KeyboardEvent: return genKeyboardEventDescr(event.keyboardEvent);
+    default:            return QString();
+    }
+}
+
+
+QString MacroEventsTableModel::genMouseEventDescr(const MacroMouseEvent &mEvent) const
+{
+    QString description = getMacroMouseEventTypeStr(mEvent.type);
+    bool locationSensitive =    mEvent.type != MacroMouseEventType::ScrollDown
+                             && mEvent.type != MacroMouseEventType::ScrollUp;
+
+    // Mouse Location Event Description.
+    if (locationSensitive) {
+        description += ": (" + QString::number(mEvent.loc.x()) + ", " + QString::number(mEvent.loc.y()) + ")";
+    }
+
+    return description;
+}
+
+
+QString MacroEventsTableModel::genKeyboardEventDescr(const MacroKeyboardEvent &kEvent) const
+{
+    QString description = getMacroKeyboardEventTypeStr(kEvent.type);
+
+    if (kEvent.type != MacroKeyboardEventType::KeyString) {
+        description += ": ";
+        if (kEvent.mod1 != -1) {
+            description += getKeyCodeStr(kEvent.mod1) + " ";
+        }
+        if (kEvent.mod2 != -1) {
+            description += getKeyCodeStr(kEvent.mod2) + " ";
+        }
+
+        description += getKeyCodeStr(kEvent.keyCode, kEvent.mod1, kEvent.mod2, kEvent.capsLock, kEvent.numLock);
+    }
+
+    return description;
+}
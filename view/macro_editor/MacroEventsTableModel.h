@@ -0,0 +1,211 @@
+#ifndef MACROEVENTSTABLEMODEL_H
+#define MACROEVENTSTABLEMODEL_H
+
+
+#include <QAbstractTableModel>
+#include <QVector>
+#include <QList>
+#include <QPixmap>
+#include <QSize>
+#include "model/MacroEvent.h"
+#include "controller/macro_editor/MacroEditorEventListener.h"
+
+
+/**
+ * @brief The MacroEventsTableModel class
+ * The item model behind the Macro Events Table. Holds the Macro Events by row and produces the cell contents only
+ * when the view asks for them, so only the visible rows cost anything. Edits are applied as row inserts, removes
+ * and updates, so they only cost as much as the rows they change. Screenshot thumbnails come from
+ * ScreenshotThumbnails, and are only composed from the full size screenshots the first time they are shown.
+ * User edits are fed to the Macro Editor Event Listener.
+ */
+class MacroEventsTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+
+    // Macro Events Columns
+    const static int EVENT_INDEX_COL;
+    const static int EVENT_DESCRIPTION_COL;
+    const static int EVENT_KEY_STRING_COL;
+    const static int EVENT_DELAY_COL;
+    const static int EVENT_DURATION_COL;
+    const static int EVENT_AUTO_CORRECT_COL;
+    const static int EVENT_SCREENSHOT_COL;
+    const static int COLUMN_COUNT;
+
+    explicit MacroEventsTableModel(QObject *parent = nullptr);
+
+    void setEventListener(MacroEditorEventListener &eventListener);
+
+    /**
+     * @brief setMacroEvents
+     * Replaces the contents of the table with the given list of Macro Events.
+     * @param macroEvents
+     * The list of Macro Events. Each event goes in the row of its index.
+     */
+    void setMacroEvents(const QList<MacroEvent> &macroEvents);
+
+    /**
+     * @brief setThumbnailSize
+     * Sets the size of the screenshot thumbnails.
+     * @param size
+     * The thumbnail size.
+     */
+    void setThumbnailSize(const QSize &size);
+
+    /**
+     * @brief prefetchScreenshots
+     * Loads the stored thumbnails of a range of rows, and queues the screenshots of the rest to be decoded in the
+     * background.
+     * @param firstRow
+     * The first row of the range.
+     * @param lastRow
+     * The last row of the range.
+     */
+    void prefetchScreenshots(int firstRow, int lastRow) const;
+
+    /**
+     * @brief insertEventRows
+     * Inserts rows for a contiguous range of Macro Events. The rows after them move down.
+     * @param firstRow
+     * The row of the first inserted event.
+     * @param macroEvents
+     * The inserted events.
+     */
+    void insertEventRows(int firstRow, const QList<MacroEvent> &macroEvents);
+
+    /**
+     * @brief removeEventRows
+     * Removes a contiguous range of rows. The rows after them move up.
+     * @param firstRow
+     * The first removed row.
+     * @param count
+     * The number of removed rows.
+     */
+    void removeEventRows(int firstRow, int count);
+
+    /**
+     * @brief updateEventRows
+     * Replaces the Macro Events shown in a contiguous range of rows.
+     * @param firstRow
+     * The row of the first updated event.
+     * @param macroEvents
+     * The updated events.
+     */
+    void updateEventRows(int firstRow, const QList<MacroEvent> &macroEvents);
+
+    /**
+     * @brief isDummyRow
+     * Checks if a row is an empty disabled row that fills in a gap for a non-uniform Macro Event.
+     * @param row
+     * The row.
+     * @return
+     * True if the row is a dummy row, false if not.
+     */
+    bool isDummyRow(int row) const;
+
+    /**
+     * @brief getEventIndex
+     * Gets the index of the Macro Event shown in a row.
+     * @param row
+     * The row.
+     * @return
+     * The event index.
+     */
+    int getEventIndex(int row) const;
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+
+    bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override;
+
+    Qt::ItemFlags flags(const QModelIndex &index) const override;
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    Qt::DropActions supportedDropActions() const override;
+
+private:
+
+    MacroEditorEventListener *_editorEventListener;
+
+    /**
+     * @brief _macroEvents
+     * The Macro Events by row. Rows that no uniform event fills hold a DummyEvent. A row is its event's index, so
+     * the stored indexes are not kept up to date.
+     */
+    QVector<MacroEvent> _macroEvents;
+
+    /**
+     * @brief _thumbnailSize
+     * The size of the screenshot thumbnails.
+     */
+    QSize _thumbnailSize;
+
+    /**
+     * @brief hasScreenshot
+     * Checks if a row has a screenshot to show.
+     * @param row
+     * The row.
+     * @return
+     * True if the row's event is a Macro Mouse Event with a screenshot, false if not.
+     */
+    bool hasScreenshot(int row) const;
+
+    /**
+     * @brief getThumbnail
+     * Gets the screenshot thumbnail of a row, composing (and keeping) it if there is none yet.
+     * @param row
+     * The row (must have a screenshot).
+     * @return
+     * The thumbnail (null if the screenshot could not be loaded).
+     */
+    QPixmap getThumbnail(int row) const;
+
+    /**
+     * @brief genThumbnail
+     * Composes the screenshot thumbnail of a Macro Mouse Event: the sharp target crop over its upscaled
+     * surroundings, centered on the location of the event.
+     * @param mEvent
+     * The Macro Mouse Event.
+     * @return
+     * The thumbnail (null if the screenshot could not be loaded).
+     */
+    QPixmap genThumbnail(const MacroMouseEvent &mEvent) const;
+
+    /**
+     * @brief genEventDescr
+     * Generates the description for a given Macro Event.
+     * @param event
+     * The Macro Event to generate the description for.
+     * @return
+     * The generated description (empty for a dummy event).
+     */
+    QString genEventDescr(const MacroEvent &event) const;
+
+    /**
+     * @brief genMouseEventDescr
+     * Generates the description for a given Macro Mouse Event.
+     * @param mEvent
+     * The Macro Mouse Event to generate the description for.
+     * @return
+     * The generated description.
+     */
+    QString genMouseEventDescr(const MacroMouseEvent &mEvent) const;
+
+    /**
+     * @brief genKeyboardEventDescr
+     * Generates a description for a given Macro Keyboard Event.
+     * @param kEvent
+     * The keyboard event to generate the description for.
+     */
+    QString genKeyboardEventDescr(const MacroKeyboardEvent &kEvent) const;
+};
+
+
+#endif // MACROEVENTSTABLEMODEL_H
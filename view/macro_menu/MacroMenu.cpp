@@ -4,7 +4,6 @@
 #include "CustomDialog.h"
 #include <QMessageBox>
 #include <QDebug>
-#include <QThread>
 #include <QDesktopWidget>
 
 
@@ -87,8 +86,17 @@ void MacroMenu::handleSelectionEditChange(const QString &text)
                                                                                (isFilterInt ? ID_ASC : NAME_ASC);
     ui->selectionTable->setSortOrder(sortOrder);
 
-    // Request the Macro Metadata using the new filter.
-    QList<MacroMetadata> macroMetaList = _eventListener.requestMacroMetadataWithFilter(text, 0, sortOrder);
+    // Search for the Macro Metadata using the new filter. Results arrive in handleSearchResults().
+    _eventListener.searchMacroMetadata(text, sortOrder);
+}
+
+
+void MacroMenu::handleSearchResults(const QString &nameOrIdFilter, const QList<MacroMetadata> &macroMetaList)
+{
+    // The user has kept typing since the search was requested.
+    QString text = ui->selectionEdit->text();
+    if (nameOrIdFilter != text) return;
+
     ui->selectionTable->refresh(macroMetaList);
     if (text != "" && ui->selectionTable->rowCount() > 0) {
         // Select first row only if text is id or name of first row.
@@ -102,19 +110,71 @@ void MacroMenu::handleSelectionEditChange(const QString &text)
 }
 
 
-void MacroMenu::handleTableSort()
+void MacroMenu::handleMacroMetadata(const QString &nameOrIdFilter, MacroMetadataSortOrder sortOrder,
+                                    const MacroMetadata *after, const QList<MacroMetadata> &macroMetaList)
+{
+    // The table has moved on since the Macro metadata was requested.
+    if (nameOrIdFilter != ui->selectionEdit->text() || sortOrder != ui->selectionTable->getSortOrder()) return;
+
+    if (after == nullptr) {
+        ui->selectionTable->refresh(macroMetaList);
+    }
+    else {
+        // Also drops pages that were requested again while the first request was still running.
+        int rowCnt = ui->selectionTable->rowCount();
+        if (rowCnt == 0 || ui->selectionTable->getRowAt(rowCnt - 1).id != after->id) return;
+        ui->selectionTable->insertRows(macroMetaList);
+    }
+    refreshButtonStates();
+}
+
+
+void MacroMenu::reloadTable(int extraRows)
 {
     QString filter = ui->selectionEdit->text();
-    int numMacrosInTable = ui->selectionTable->rowCount();
+    int numRows = ui->selectionTable->rowCount() + extraRows;
 
-    // Request Macros in sorted order.
-    QList<MacroMetadata> macroMetaList = _eventListener.requestMacroMetadataWithFilter(filter, 0, numMacrosInTable,
-                                                                                       ui->selectionTable->getSortOrder());
-    ui->selectionTable->refresh(macroMetaList);
+    // Request the Macros from the beginning. They replace the table rows in handleMacroMetadata().
+    _eventListener.requestMacroMetadataWithFilter(filter, nullptr, numRows, ui->selectionTable->getSortOrder());
+}
+
+
+void MacroMenu::handleCopyResults(const QList<MacroMetadata> &copyResult)
+{
+    QString idListStr;
+
+    // Generate the copy result ID string that will be entered in the selection edit.
+    foreach (MacroMetadata result, copyResult) {
+        idListStr += QString::number(result.id) + " ";
+    }
+    ui->selectionEdit->setText(idListStr.trimmed());
+
+    // Refresh table to only contain the results of the copy.
+    ui->selectionTable->setSortOrder(ID_ASC);
+    ui->selectionTable->refresh(copyResult);
     refreshButtonStates();
 }
 
 
+void MacroMenu::showProgress(const QString &task, int doneCount, int totalCount)
+{
+    ui->tipBar->showMessage(task + "... " + QString::number(doneCount) + "/" + QString::number(totalCount));
+}
+
+
+void MacroMenu::clearProgress()
+{
+    ui->tipBar->clearMessage();
+}
+
+
+void MacroMenu::handleTableSort()
+{
+    // Request Macros in sorted order.
+    reloadTable();
+}
+
+
 void MacroMenu::refreshButtonStates()
 {
     // Disable or enable buttons based off of new state of selected Macros in table.
@@ -221,19 +281,11 @@ void MacroMenu::removeMacros()
 
         // Make sure that the user wants to permanently delete selected Macros!
         if (confirmDeleteReply == QMessageBox::Yes) {
-            // Get selected rows and remove from DB & UI.
+            // Get selected rows and remove from DB & UI. The table is reloaded once the removal is written,
+            // which also replaces the removed rows if more are available.
             QList<int> ids = ui->selectionTable->getSelectedRowIds();
             _eventListener.removeMacros(ids);
             ui->selectionTable->removeSelectedRows();
-
-            // Get filter and settings associated with requesting replacement Macro Metadata.
-            QString filter = ui->selectionEdit->text();
-            int offset = ui->selectionTable->rowCount();
-            MacroMetadataSortOrder sortOrder = ui->selectionTable->getSortOrder();
-
-            // Replace the removed Macro Metadata rows if more are available.
-            QList<MacroMetadata> macroMetaList = _eventListener.requestMacroMetadataWithFilter(filter, offset, removeCnt, sortOrder);
-            ui->selectionTable->insertRows(macroMetaList);
         }
     }
     refreshButtonStates();
@@ -242,21 +294,10 @@ void MacroMenu::removeMacros()
 
 void MacroMenu::copyMacros()
 {
-    QString idListStr;
-
     if (ui->selectionTable->getNumSelectedRows() >= 1) {
+        // The copies are shown in handleCopyResults().
         QList<int> sourceCopyIds = ui->selectionTable->getSelectedRowIds();
-        QList<MacroMetadata> copyResult = _eventListener.copyMacros(sourceCopyIds);
-
-        // Generate the copy result ID string that will be entered in the selection edit.
-        foreach (MacroMetadata result, copyResult) {
-            idListStr += QString::number(result.id) + " ";
-        }
-        ui->selectionEdit->setText(idListStr.trimmed());
-
-        // Refresh table to only contain the results of the copy.
-        ui->selectionTable->setSortOrder(ID_ASC);
-        ui->selectionTable->refresh(copyResult);
+        _eventListener.copyMacros(sourceCopyIds);
     }
 }
 
@@ -265,15 +306,12 @@ void MacroMenu::handleScrollHitBottom()
 {
     // Get all selection settings and filters before requesting more Macro Metadata.
     QString filter = ui->selectionEdit->text();
-    int offset = ui->selectionTable->rowCount();
+    int rowCnt = ui->selectionTable->rowCount();
+    MacroMetadata lastRow = (rowCnt > 0) ? ui->selectionTable->getRowAt(rowCnt - 1) : MacroMetadata();
     MacroMetadataSortOrder sortOrder = ui->selectionTable->getSortOrder();
 
-    QList<MacroMetadata> macroMetaList = _eventListener.requestMacroMetadataWithFilter(filter, offset, sortOrder);
-    // If we got more Macro Metadata, then insert into table after delay.
-    if (macroMetaList.size() > 0) {
-        QThread::msleep(150);
-        ui->selectionTable->insertRows(macroMetaList);
-    }
+    // Continue from the last Macro in the table. More Macro Metadata is inserted in handleMacroMetadata().
+    _eventListener.requestMacroMetadataWithFilter(filter, (rowCnt > 0) ? &lastRow : nullptr, sortOrder);
 }
 
 
@@ -55,6 +55,68 @@ public:
      */
     void hide();
 
+    /**
+     * @brief handleSearchResults
+     * Displays the results of a Macro metadata search (see MacroMenuEventListener::searchMacroMetadata()).
+     * @param nameOrIdFilter
+     * The filter that was searched for. Results for a filter that no longer matches the selection edit are ignored.
+     * @param macroMetaList
+     * The Macro metadata that was found.
+     */
+    void handleSearchResults(const QString &nameOrIdFilter, const QList<MacroMetadata> &macroMetaList);
+
+    /**
+     * @brief handleMacroMetadata
+     * Displays Macro metadata that was requested with MacroMenuEventListener::requestMacroMetadataWithFilter().
+     * @param nameOrIdFilter
+     * The filter that the Macro metadata was requested with.
+     * @param sortOrder
+     * The sort order that the Macro metadata was requested with.
+     * @param after
+     * The Macro that the Macro metadata was requested after, or null if it was requested from the beginning.
+     * Metadata from the beginning replaces the table rows, while metadata after a Macro is appended to them.
+     * Metadata is ignored if the filter or sort order has changed, or if the Macro is no longer the last row.
+     * @param macroMetaList
+     * The Macro metadata.
+     */
+    void handleMacroMetadata(const QString &nameOrIdFilter, MacroMetadataSortOrder sortOrder,
+                             const MacroMetadata *after, const QList<MacroMetadata> &macroMetaList);
+
+    /**
+     * @brief reloadTable
+     * Re-reads the table rows with the current filter and sort order, e.g. once a rename or removal has been
+     * written. The rows replace the table in handleMacroMetadata().
+     * @param extraRows (OPTIONAL)
+     * How many rows to read beyond those in the table, e.g. to replace removed rows.
+     */
+    void reloadTable(int extraRows = 0);
+
+    /**
+     * @brief handleCopyResults
+     * Displays the copies made by MacroMenuEventListener::copyMacros().
+     * @param copyResult
+     * The Macro metadata of the copies.
+     */
+    void handleCopyResults(const QList<MacroMetadata> &copyResult);
+
+    /**
+     * @brief showProgress
+     * Shows the progress of a long running task in the tip bar.
+     * @param task
+     * A short description of the task.
+     * @param doneCount
+     * The number of items done so far.
+     * @param totalCount
+     * The total number of items.
+     */
+    void showProgress(const QString &task, int doneCount, int totalCount);
+
+    /**
+     * @brief clearProgress
+     * Stops showing the progress of a task.
+     */
+    void clearProgress();
+
 
 private slots:
 